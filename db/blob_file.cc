@@ -0,0 +1,86 @@
+
+
+#include "db/blob_file.h"
+
+#include "mydb/env.h"
+
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace mydb {
+
+static const size_t kBlobHeaderSize = 4; // checksum
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+    PutVarint64(dst, file_number);
+    PutVarint64(dst, offset);
+    PutVarint64(dst, size);
+}
+
+Status BlobIndex::DecodeFrom(const Slice& input) {
+    Slice in = input;
+    if (GetVarint64(&in, &file_number) && GetVarint64(&in, &offset) &&
+        GetVarint64(&in, &size) && in.empty()) {
+        return Status::OK();
+    }
+    return Status::Corruption("bad blob index");
+}
+
+BlobFileWriter::BlobFileWriter(uint64_t number, WritableFile* file)
+    : number_(number), file_(file), file_size_(0), value_bytes_(0) {}
+
+BlobFileWriter::~BlobFileWriter() { delete file_; }
+
+Status BlobFileWriter::Add(const Slice& value, BlobIndex* index) {
+    char header[kBlobHeaderSize];
+    EncodeFixed32(header,
+                  crc32c::Mask(crc32c::Value(value.data(), value.size())));
+    Status s = file_->Append(Slice(header, sizeof(header)));
+    if (s.ok()) {
+        s = file_->Append(value);
+    }
+    if (s.ok()) {
+        index->file_number = number_;
+        index->offset = file_size_;
+        index->size = value.size();
+        file_size_ += kBlobHeaderSize + value.size();
+        value_bytes_ += value.size();
+    }
+    return s;
+}
+
+Status BlobFileWriter::Finish() {
+    Status s = file_->Sync();
+    if (s.ok()) {
+        s = file_->Close();
+    }
+    return s;
+}
+
+Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+                std::string* value) {
+    const size_t n = kBlobHeaderSize + index.size;
+    value->resize(n);
+    Slice contents;
+    Status s = file->Read(index.offset, n, &contents, &(*value)[0]);
+    if (!s.ok()) {
+        return s;
+    }
+    if (contents.size() != n) {
+        return Status::Corruption("truncated blob record");
+    }
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(contents.data()));
+    contents.remove_prefix(kBlobHeaderSize);
+    if (crc != crc32c::Value(contents.data(), contents.size())) {
+        return Status::Corruption("blob checksum mismatch");
+    }
+    if (contents.data() == value->data() + kBlobHeaderSize) {
+        value->erase(0, kBlobHeaderSize);
+    } else {
+        // The file returned a pointer to its own copy of the data.
+        value->assign(contents.data(), contents.size());
+    }
+    return Status::OK();
+}
+
+} // namespace mydb
@@ -0,0 +1,77 @@
+
+
+// Values of at least Options::min_blob_size are kept out of the tables
+// in append-only blob files, so that compactions only move a small
+// reference to them instead of rewriting the value.
+//
+// A blob file is a sequence of records:
+//    checksum: fixed32     // masked crc32c of the value
+//    value: char[]
+//
+// A table refers to a value with an entry of type kTypeBlobIndex whose
+// value is an encoded BlobIndex.
+
+#ifndef STORAGE_MYDB_DB_BLOB_FILE_H_
+#define STORAGE_MYDB_DB_BLOB_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "mydb/slice.h"
+#include "mydb/status.h"
+
+namespace mydb {
+
+class RandomAccessFile;
+class WritableFile;
+
+// Location of a value in a blob file.
+struct BlobIndex {
+    uint64_t file_number;
+    uint64_t offset; // Offset of the value's record
+    uint64_t size;   // Size of the value, without the record header
+
+    void EncodeTo(std::string* dst) const;
+    Status DecodeFrom(const Slice& input);
+};
+
+class BlobFileWriter {
+  public:
+    // Append records for blob file "number" to "*file", which must be
+    // empty.  Takes ownership of "file".
+    BlobFileWriter(uint64_t number, WritableFile* file);
+
+    BlobFileWriter(const BlobFileWriter&) = delete;
+    BlobFileWriter& operator=(const BlobFileWriter&) = delete;
+
+    ~BlobFileWriter();
+
+    // Append "value" and store the index of the new record in *index.
+    Status Add(const Slice& value, BlobIndex* index);
+
+    // Flush the file to stable storage and close it.
+    Status Finish();
+
+    uint64_t number() const { return number_; }
+
+    // Bytes written to the file so far.
+    uint64_t file_size() const { return file_size_; }
+
+    // Sum of the sizes of the values added so far.
+    uint64_t value_bytes() const { return value_bytes_; }
+
+  private:
+    const uint64_t number_;
+    WritableFile* file_;
+    uint64_t file_size_;
+    uint64_t value_bytes_;
+};
+
+// Read the value that "index" refers to from "file" into *value, and
+// verify its checksum.
+Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+                std::string* value);
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_DB_BLOB_FILE_H_
@@ -2,8 +2,11 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/paced_file.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 
@@ -14,32 +17,125 @@
 namespace mydb {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob, CompressionPool* compression_pool) {
     Status s;
     meta->file_size = 0;
+    meta->oldest_blob_file = 0;
+    if (blob != nullptr) {
+        blob->total_bytes = 0;
+        if (options.min_blob_size == 0) {
+            blob = nullptr;
+        }
+    }
     iter->SeekToFirst();
 
+    // Tombstones that cover no keys are dropped.
+    const Comparator* icmp = options.comparator;
+    const Comparator* ucmp =
+        static_cast<const InternalKeyComparator*>(icmp)->user_comparator();
+    RangeTombstoneList tombstones(ucmp);
+    if (range_del_iter != nullptr) {
+        RangeTombstoneList all(ucmp);
+        s = all.AddAll(range_del_iter);
+        for (const RangeTombstone& t : all.tombstones()) {
+            if (ucmp->Compare(t.begin, t.end) < 0) {
+                tombstones.Add(t);
+            }
+        }
+    }
+
     std::string fname = TableFileName(dbname, meta->number);
-    if (iter->Valid()) {
+    bool blob_file_created = false;
+    if (s.ok() && (iter->Valid() || !tombstones.empty())) {
         WritableFile* file;
-        s = env->NewWritableFile(fname, &file);
+        s = NewOutputFile(env, options, fname, RateLimiter::Priority::kHigh,
+                          &file);
         if (!s.ok()) {
             return s;
         }
 
-        TableBuilder* builder = new TableBuilder(options, file);
-        meta->smallest.DecodeFrom(iter->key());
+        TableBuilder* builder =
+            new TableBuilder(options, file, compression_pool);
+        BlobFileWriter* blob_writer = nullptr;
+        bool empty = true;
         Slice key;
-        for (; iter->Valid(); iter->Next()) {
+        std::string blob_key, blob_index;
+        for (; s.ok() && iter->Valid(); iter->Next()) {
             key = iter->key();
-            builder->Add(key, iter->value());
+            Slice value = iter->value();
+            ParsedInternalKey ikey;
+            if (blob != nullptr && value.size() >= options.min_blob_size &&
+                ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+                // Store the value in the blob file and a reference to it in
+                // the table.
+                if (blob_writer == nullptr) {
+                    WritableFile* blob_file;
+                    s = NewOutputFile(env, options,
+                                      BlobFileName(dbname, blob->number),
+                                      RateLimiter::Priority::kHigh,
+                                      &blob_file);
+                    if (!s.ok()) {
+                        break;
+                    }
+                    blob_writer = new BlobFileWriter(blob->number, blob_file);
+                    blob_file_created = true;
+                    meta->oldest_blob_file = blob->number;
+                }
+                BlobIndex index;
+                s = blob_writer->Add(value, &index);
+                if (!s.ok()) {
+                    break;
+                }
+                ikey.type = kTypeBlobIndex;
+                blob_key.clear();
+                AppendInternalKey(&blob_key, ikey);
+                blob_index.clear();
+                index.EncodeTo(&blob_index);
+                key = blob_key;
+                value = blob_index;
+            }
+            if (empty) {
+                meta->smallest.DecodeFrom(key);
+                empty = false;
+            }
+            builder->Add(key, value);
         }
         if (!key.empty()) {
             meta->largest.DecodeFrom(key);
         }
+        if (blob_writer != nullptr) {
+            if (s.ok()) {
+                s = blob_writer->Finish();
+            }
+            blob->total_bytes = blob_writer->value_bytes();
+            delete blob_writer;
+        }
+
+        // The file's key range must include every key its tombstones cover.
+        meta->has_range_tombstones = !tombstones.empty();
+        for (const RangeTombstone& t : tombstones.tombstones()) {
+            const InternalKey start = t.StartKey();
+            builder->AddRangeTombstone(start.Encode(), t.end);
+            if (empty || icmp->Compare(start.Encode(),
+                                       meta->smallest.Encode()) < 0) {
+                meta->smallest = start;
+            }
+            const InternalKey end = t.EndKey();
+            if (empty ||
+                icmp->Compare(end.Encode(), meta->largest.Encode()) > 0) {
+                meta->largest = end;
+            }
+            empty = false;
+        }
 
         // Finish and check for builder errors
-        s = builder->Finish();
+        if (s.ok()) {
+            s = builder->Finish();
+        } else {
+            builder->Abandon();
+        }
         if (s.ok()) {
             meta->file_size = builder->FileSize();
             assert(meta->file_size > 0);
@@ -59,7 +155,7 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
         if (s.ok()) {
             // Verify that the table is usable
             Iterator* it = table_cache->NewIterator(ReadOptions(), meta->number,
-                                                    meta->file_size);
+                                                    meta->file_size, 0);
             s = it->status();
             delete it;
         }
@@ -74,6 +170,24 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
         // Keep it
     } else {
         env->RemoveFile(fname);
+        if (blob_file_created) {
+            env->RemoveFile(BlobFileName(dbname, blob->number));
+            blob->total_bytes = 0;
+        }
+    }
+    return s;
+}
+
+Status NewOutputFile(Env* env, const Options& options, const std::string& fname,
+                     RateLimiter::Priority priority, WritableFile** result) {
+    Status s = options.use_direct_io_for_flush_and_compaction
+                   ? env->NewDirectWritableFile(fname, result)
+                   : env->NewWritableFile(fname, result);
+    if (s.ok()) {
+        // Tables may end up slightly larger than max_file_size.
+        *result = NewPacedWritableFile(
+            *result, 0, options.bytes_per_sync,
+            options.max_file_size / 10 * 11, options.rate_limiter, priority);
     }
     return s;
 }
@@ -3,25 +3,48 @@
 #ifndef STORAGE_MYDB_DB_BUILDER_H_
 #define STORAGE_MYDB_DB_BUILDER_H_
 
+#include "mydb/rate_limiter.h"
 #include "mydb/status.h"
 
 namespace mydb {
 
 struct Options;
 struct FileMetaData;
+struct BlobFileMetaData;
 
+class CompressionPool;
 class Env;
 class Iterator;
 class TableCache;
 class VersionEdit;
+class WritableFile;
 
-// Build a Table file from the contents of *iter.  The generated file
+// Build a Table file from the contents of *iter and the range tombstones
+// yielded by *range_del_iter, which may be nullptr.  The generated file
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// If no data is present in either iterator, meta->file_size will be set
+// to zero, and no Table file will be produced.
+//
+// If "blob" is non-null and options.min_blob_size is non-zero, values of
+// at least that size are written to the blob file named according to
+// blob->number instead, and blob->total_bytes is set to the sum of their
+// sizes.  No blob file is produced if there is no such value.
+//
+// Data blocks are compressed on the threads of "compression_pool" if it
+// is non-null.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob, CompressionPool* compression_pool);
+
+// Create the table or blob file "fname" that a flush or a compaction
+// writes, with direct I/O if options.use_direct_io_for_flush_and_compaction
+// is set, and paced according to options.bytes_per_sync (see
+// NewPacedWritableFile()).  Writes are charged to options.rate_limiter
+// with "priority".
+Status NewOutputFile(Env* env, const Options& options, const std::string& fname,
+                     RateLimiter::Priority priority, WritableFile** result);
 
 } // namespace mydb
 
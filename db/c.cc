@@ -347,6 +347,12 @@ void mydb_writebatch_iterate(const mydb_writebatch_t* b, void* state,
         void Delete(const Slice& key) override {
             (*deleted_)(state_, key.data(), key.size());
         }
+        void DeleteRange(const Slice& begin, const Slice& end) override {
+            // Not reported: the C callbacks predate range deletions.
+        }
+        void Merge(const Slice& key, const Slice& value) override {
+            // Not reported: the C callbacks predate merge operands.
+        }
     };
     H handler;
     handler.state_ = state;
@@ -8,6 +8,7 @@
 
 #include "mydb/cache.h"
 #include "mydb/db.h"
+#include "mydb/sst_file_writer.h"
 #include "mydb/table.h"
 #include "mydb/write_batch.h"
 
@@ -156,6 +157,62 @@ class CorruptionTest : public testing::Test {
         ASSERT_TRUE(s.ok()) << s.ToString();
     }
 
+    int CountFiles(FileType filetype) {
+        std::vector<std::string> filenames;
+        EXPECT_MYDB_OK(env_.target()->GetChildren(dbname_, &filenames));
+        uint64_t number;
+        FileType type;
+        int result = 0;
+        for (size_t i = 0; i < filenames.size(); i++) {
+            if (ParseFileName(filenames[i], &number, &type) &&
+                type == filetype) {
+                result++;
+            }
+        }
+        return result;
+    }
+
+    // Ingest a table holding key->value.
+    void Ingest(const Slice& key, const Slice& value) {
+        const std::string fname =
+            testing::TempDir() + "corruption_ingest_test.ldb";
+        SstFileWriter writer(options_);
+        ASSERT_MYDB_OK(writer.Open(fname));
+        ASSERT_MYDB_OK(writer.Put(key, value));
+        ASSERT_MYDB_OK(writer.Finish());
+        ASSERT_MYDB_OK(
+            db_->IngestExternalFile({fname}, IngestExternalFileOptions()));
+        env_.RemoveFile(fname);
+    }
+
+    // The value an iterator finds for "key", which unlike Get() orders
+    // the entries of overlapping tables by sequence number.
+    std::string IteratorValue(const Slice& key) {
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        iter->Seek(key);
+        std::string result = "NOT_FOUND";
+        if (iter->Valid() && iter->key() == key) {
+            result = iter->value().ToString();
+        }
+        delete iter;
+        return result;
+    }
+
+    // Count the files of "filetype" that repair moved to the lost directory.
+    int CountLostFiles(FileType filetype) {
+        std::vector<std::string> filenames;
+        env_.target()->GetChildren(dbname_ + "/lost", &filenames); // May fail
+        uint64_t number;
+        FileType type;
+        int result = 0;
+        for (const std::string& filename : filenames) {
+            if (ParseFileName(filename, &number, &type) && type == filetype) {
+                result++;
+            }
+        }
+        return result;
+    }
+
     int Property(const std::string& name) {
         std::string property;
         int result;
@@ -268,6 +325,45 @@ TEST_F(CorruptionTest, MissingDescriptor) {
     Check(1000, 1000);
 }
 
+TEST_F(CorruptionTest, BlobFile) {
+    options_.min_blob_size = 100;
+    Reopen();
+    Build(100);
+    DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+    dbi->TEST_CompactMemTable();
+    Corrupt(kBlobFile, 2 * (kValueSize + 4) + 10, 1);
+    Reopen();
+    std::string v;
+    std::string key_space;
+    ASSERT_MYDB_OK(db_->Get(ReadOptions(), Key(1, &key_space), &v));
+    ASSERT_TRUE(
+        db_->Get(ReadOptions(), Key(2, &key_space), &v).IsCorruption());
+}
+
+TEST_F(CorruptionTest, BlobFileRepair) {
+    options_.min_blob_size = 100;
+    Reopen();
+    Build(100);
+    DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+    dbi->TEST_CompactMemTable();
+    Build(10);
+    dbi->TEST_CompactMemTable();
+    dbi->TEST_CompactRange(0, nullptr, nullptr);
+
+    Corrupt(kDescriptorFile, 0, 1000);
+    RepairDB();
+    Reopen();
+    Check(100, 100);
+
+    // The repaired blob files are deleted once nothing refers to them.
+    std::string key_space;
+    for (int i = 0; i < 100; i++) {
+        ASSERT_MYDB_OK(db_->Delete(WriteOptions(), Key(i, &key_space)));
+    }
+    db_->CompactRange(nullptr, nullptr);
+    ASSERT_EQ(0, CountFiles(kBlobFile));
+}
+
 TEST_F(CorruptionTest, SequenceNumberRecovery) {
     ASSERT_MYDB_OK(db_->Put(WriteOptions(), "foo", "v1"));
     ASSERT_MYDB_OK(db_->Put(WriteOptions(), "foo", "v2"));
@@ -289,6 +385,34 @@ TEST_F(CorruptionTest, SequenceNumberRecovery) {
     ASSERT_EQ("v6", v);
 }
 
+TEST_F(CorruptionTest, IngestedTableRepair) {
+    ASSERT_MYDB_OK(db_->Put(WriteOptions(), "foo", "v1"));
+    DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+    dbi->TEST_CompactMemTable();
+    Ingest("foo", "v2");
+
+    // The MANIFEST still holds the table's sequence number.
+    RepairDB();
+    Reopen();
+    ASSERT_EQ("v2", IteratorValue("foo"));
+    ASSERT_EQ(0, CountLostFiles(kTableFile));
+}
+
+TEST_F(CorruptionTest, IngestedTableRepairWithoutManifest) {
+    ASSERT_MYDB_OK(db_->Put(WriteOptions(), "foo", "v1"));
+    DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+    dbi->TEST_CompactMemTable();
+    Ingest("foo", "v2");
+
+    // The table cannot be placed among the other writes, so it is set
+    // aside to be ingested again.
+    Corrupt(kDescriptorFile, 0, 1000);
+    RepairDB();
+    Reopen();
+    ASSERT_EQ("v1", IteratorValue("foo"));
+    ASSERT_EQ(1, CountLostFiles(kTableFile));
+}
+
 TEST_F(CorruptionTest, CorruptedDescriptor) {
     ASSERT_MYDB_OK(db_->Put(WriteOptions(), "foo", "hello"));
     DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
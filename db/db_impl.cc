@@ -2,6 +2,7 @@
 
 #include "db/db_impl.h"
 
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -9,6 +10,9 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_context.h"
+#include "db/paced_file.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
@@ -16,10 +20,13 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <deque>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "mydb/compaction_filter.h"
 #include "mydb/db.h"
 #include "mydb/env.h"
 #include "mydb/status.h"
@@ -28,6 +35,7 @@
 
 #include "port/port.h"
 #include "table/block.h"
+#include "table/compression_pool.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
@@ -41,11 +49,12 @@ const int kNumNonTableCacheFiles = 10;
 // Information kept for every waiting writer
 struct DBImpl::Writer {
     explicit Writer(port::Mutex* mu)
-        : batch(nullptr), sync(false), done(false), cv(mu) {}
+        : batch(nullptr), sync(false), exclusive(false), done(false), cv(mu) {}
 
     Status status;
     WriteBatch* batch;
     bool sync;
+    bool exclusive; // Never part of a batch group
     bool done;
     port::CondVar cv;
 };
@@ -56,13 +65,38 @@ struct DBImpl::CompactionState {
         uint64_t number;
         uint64_t file_size;
         InternalKey smallest, largest;
+        uint64_t oldest_blob_file; // Zero if the file refers to no blob
+        bool has_range_tombstones;
     };
 
     Output* current_output() { return &outputs[outputs.size() - 1]; }
 
     explicit CompactionState(Compaction* c)
-        : compaction(c), smallest_snapshot(0), outfile(nullptr),
-          builder(nullptr), total_bytes(0) {}
+        : compaction(c), smallest_snapshot(0), has_lower_bound(false),
+          outfile(nullptr), builder(nullptr), total_bytes(0),
+          blob_writer(nullptr) {}
+
+    // Record that the blob "blob_index" refers to is no longer needed.
+    void AddBlobGarbage(const Slice& blob_index) {
+        BlobIndex index;
+        if (index.DecodeFrom(blob_index).ok()) {
+            blob_garbage[index.file_number] += index.size;
+        }
+    }
+
+    // Clip *t to the key range of the current output, which starts at
+    // lower_bound and ends before *upper_bound (or is unbounded if
+    // upper_bound is nullptr).  Returns false if nothing is left.
+    bool ClipToOutput(const Comparator* ucmp, const Slice* upper_bound,
+                      RangeTombstone* t) const {
+        if (has_lower_bound && ucmp->Compare(t->begin, lower_bound) < 0) {
+            t->begin = lower_bound;
+        }
+        if (upper_bound != nullptr && ucmp->Compare(t->end, *upper_bound) > 0) {
+            t->end = upper_bound->ToString();
+        }
+        return ucmp->Compare(t->begin, t->end) < 0;
+    }
 
     Compaction* const compaction;
 
@@ -72,6 +106,13 @@ struct DBImpl::CompactionState {
     // we can drop all entries for the same key with sequence numbers < S.
     SequenceNumber smallest_snapshot;
 
+    // Range tombstones from the inputs that are still needed.  Each output
+    // gets the part of them between its first user key and the first user
+    // key of the next output, so that output key ranges do not overlap.
+    std::vector<RangeTombstone> tombstones;
+    std::string lower_bound;
+    bool has_lower_bound;
+
     std::vector<Output> outputs;
 
     // State kept for output being generated
@@ -79,6 +120,13 @@ struct DBImpl::CompactionState {
     TableBuilder* builder;
 
     uint64_t total_bytes;
+
+    // Blob files produced by compaction, and the one being generated
+    std::vector<BlobFileMetaData> blob_outputs;
+    BlobFileWriter* blob_writer;
+
+    // Bytes of the input blob files that the outputs no longer refer to
+    std::map<uint64_t, uint64_t> blob_garbage;
 };
 
 // Fix user-supplied options to be reasonable
@@ -97,9 +145,15 @@ Options SanitizeOptions(const std::string& dbname,
     result.comparator = icmp;
     result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
     ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
+    ClipToRange(&result.table_preload_threads, 0, 64);
+    ClipToRange(&result.max_manifest_file_size, 4 << 10, 1 << 30);
     ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
     ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
     ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+    ClipToRange(&result.tiered_size_ratio, 0, 1000);
+    ClipToRange(&result.tiered_max_sorted_runs, 2, 64);
+    ClipToRange(&result.blob_file_size, 1 << 20, 1 << 30);
+    ClipToRange(&result.blob_gc_live_ratio, 0.0, 1.0);
     if (result.info_log == nullptr) {
         // Open a log file in the same directory as the db
         src.env->CreateDir(dbname); // In case it does not exist
@@ -113,7 +167,8 @@ Options SanitizeOptions(const std::string& dbname,
         }
     }
     if (result.block_cache == nullptr) {
-        result.block_cache = NewLRUCache(8 << 20);
+        result.block_cache = NewLRUCache(
+            8 << 20, result.cache_index_and_filter_blocks ? 0.5 : 0.0);
     }
     return result;
 }
@@ -123,20 +178,50 @@ static int TableCacheSize(const Options& sanitized_options) {
     return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
-DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
+// Wrap a log file that already holds "file_size" bytes so that it is
+// written out every wal_bytes_per_sync bytes, and has room for about a
+// memtable's worth of records reserved ahead of time.
+static WritableFile* PaceLogFile(const Options& sanitized_options,
+                                 WritableFile* file, uint64_t file_size) {
+    return NewPacedWritableFile(file, file_size,
+                                sanitized_options.wal_bytes_per_sync,
+                                sanitized_options.write_buffer_size / 10 * 11,
+                                nullptr, RateLimiter::Priority::kHigh);
+}
+
+// Create the writer for a log file that already holds "file_size" bytes,
+// which compresses records as the options ask for.
+static log::Writer* NewLogWriter(const Options& sanitized_options,
+                                 WritableFile* file, uint64_t file_size) {
+    log::Writer* writer = new log::Writer(file, file_size);
+    writer->SetCompression(sanitized_options.wal_compression,
+                           sanitized_options.zstd_compression_level,
+                           sanitized_options.wal_compression_min_size);
+    return writer;
+}
+
+DBImpl::DBImpl(const Options& raw_options, const std::string& dbname,
+               const std::string& secondary_path)
     : env_(raw_options.env), internal_comparator_(raw_options.comparator),
       internal_filter_policy_(raw_options.filter_policy),
-      options_(SanitizeOptions(dbname, &internal_comparator_,
+      options_(SanitizeOptions(secondary_path.empty() ? dbname
+                                                      : secondary_path,
+                               &internal_comparator_,
                                &internal_filter_policy_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
-      dbname_(dbname),
+      dbname_(dbname), secondary_(!secondary_path.empty()),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      compression_pool_(options_.compression_threads > 1
+                            ? new CompressionPool(env_,
+                                                  options_.compression_threads)
+                            : nullptr),
       db_lock_(nullptr), shutting_down_(false),
       background_work_finished_signal_(&mutex_), mem_(nullptr), imm_(nullptr),
       has_imm_(false), logfile_(nullptr), logfile_number_(0), log_(nullptr),
       seed_(0), tmp_batch_(new WriteBatch),
-      background_compaction_scheduled_(false), manual_compaction_(nullptr),
+      background_compaction_scheduled_(false), ingesting_(false),
+      file_deletions_paused_(0), manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
                                &internal_comparator_)) {}
 
@@ -162,6 +247,7 @@ DBImpl::~DBImpl() {
     delete log_;
     delete logfile_;
     delete table_cache_;
+    delete compression_pool_;
 
     if (owns_info_log_) {
         delete options_.info_log;
@@ -223,6 +309,10 @@ void DBImpl::RemoveObsoleteFiles() {
         // or may not have been committed, so we cannot safely garbage collect.
         return;
     }
+    if (file_deletions_paused_ > 0) {
+        // A checkpoint may still link or copy files that are obsolete now.
+        return;
+    }
 
     // Make a set of all of the live files
     std::set<uint64_t> live = pending_outputs_;
@@ -247,6 +337,7 @@ void DBImpl::RemoveObsoleteFiles() {
                 keep = (number >= versions_->ManifestFileNumber());
                 break;
             case kTableFile:
+            case kBlobFile:
                 keep = (live.find(number) != live.end());
                 break;
             case kTempFile:
@@ -264,7 +355,7 @@ void DBImpl::RemoveObsoleteFiles() {
 
             if (!keep) {
                 files_to_delete.push_back(std::move(filename));
-                if (type == kTableFile) {
+                if (type == kTableFile || type == kBlobFile) {
                     table_cache_->Evict(number);
                 }
                 Log(options_.info_log, "Delete type=%d #%lld\n",
@@ -379,6 +470,140 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
     return Status::OK();
 }
 
+// Limit on the bytes of log records read ahead of the memtable inserts
+// during recovery.
+static const size_t kMaxQueuedRecoveryBytes = 4 << 20;
+
+// Reads the records of a log on a thread of its own during recovery, so
+// that decoding and checksumming them overlaps with inserting them into
+// the memtable.
+class LogRecordReader {
+  public:
+    // "reporter" is told about corruptions, and may set *status, which
+    // only the reading thread may look at until Finish() returns.
+    LogRecordReader(log::Reader* reader, log::Reader::Reporter* reporter,
+                    const Status* status)
+        : reader_(reader), reporter_(reporter), status_(status), cv_(&mu_),
+          queued_bytes_(0), done_(false), stop_(false) {}
+
+    LogRecordReader(const LogRecordReader&) = delete;
+    LogRecordReader& operator=(const LogRecordReader&) = delete;
+
+    ~LogRecordReader() { assert(done_); }
+
+    void Start(Env* env) { env->StartThread(&LogRecordReader::Run, this); }
+
+    // Store the next record in *record and return true, or return false
+    // at the end of the log.
+    bool Next(std::string* record) {
+        MutexLock l(&mu_);
+        while (records_.empty() && !done_) {
+            cv_.Wait();
+        }
+        if (records_.empty()) {
+            return false;
+        }
+        record->swap(records_.front());
+        records_.pop_front();
+        queued_bytes_ -= record->size();
+        cv_.SignalAll();
+        return true;
+    }
+
+    // Stop reading, and wait for the reading thread to finish.
+    void Finish() {
+        MutexLock l(&mu_);
+        stop_ = true;
+        cv_.SignalAll();
+        while (!done_) {
+            cv_.Wait();
+        }
+    }
+
+  private:
+    static void Run(void* arg) {
+        reinterpret_cast<LogRecordReader*>(arg)->ReadRecords();
+    }
+
+    void ReadRecords() {
+        std::string scratch;
+        Slice record;
+        while (reader_->ReadRecord(&record, &scratch) && status_->ok()) {
+            if (record.size() < 12) {
+                reporter_->Corruption(
+                    record.size(), Status::Corruption("log record too small"));
+                continue;
+            }
+            MutexLock l(&mu_);
+            while (queued_bytes_ > kMaxQueuedRecoveryBytes && !stop_) {
+                cv_.Wait();
+            }
+            if (stop_) {
+                break;
+            }
+            records_.emplace_back(record.data(), record.size());
+            queued_bytes_ += record.size();
+            cv_.SignalAll();
+        }
+        MutexLock l(&mu_);
+        done_ = true;
+        cv_.SignalAll();
+    }
+
+    log::Reader* const reader_;
+    log::Reader::Reporter* const reporter_;
+    const Status* const status_;
+
+    port::Mutex mu_;
+    port::CondVar cv_ GUARDED_BY(mu_);
+    std::deque<std::string> records_ GUARDED_BY(mu_);
+    size_t queued_bytes_ GUARDED_BY(mu_);
+    bool done_ GUARDED_BY(mu_);
+    bool stop_ GUARDED_BY(mu_);
+};
+
+// Writes the memtables that fill up while a log is replayed to level-0
+// tables on a thread of its own, so that replay goes on meanwhile.  The
+// memtables are written in order, one at a time.
+struct DBImpl::RecoveryFlusher {
+    RecoveryFlusher(DBImpl* db, VersionEdit* edit)
+        : db(db), edit(edit), cv(&db->mutex_), closed(false), done(false) {}
+
+    DBImpl* const db;
+    VersionEdit* const edit;
+
+    // The fields below are guarded by db->mutex_.
+    port::CondVar cv;
+    std::deque<MemTable*> queue;
+    bool closed; // No more memtables will be queued
+    bool done;   // The flushing thread has finished
+    Status status;
+};
+
+void DBImpl::RecoveryFlushThread(void* arg) {
+    RecoveryFlusher* f = reinterpret_cast<RecoveryFlusher*>(arg);
+    DBImpl* db = f->db;
+    db->mutex_.Lock();
+    while (true) {
+        while (f->queue.empty() && !f->closed) {
+            f->cv.Wait();
+        }
+        if (f->queue.empty()) {
+            break;
+        }
+        MemTable* mem = f->queue.front();
+        if (f->status.ok()) {
+            f->status = db->WriteLevel0Table(mem, f->edit, nullptr);
+        }
+        f->queue.pop_front();
+        mem->Unref();
+        f->cv.SignalAll();
+    }
+    f->done = true;
+    f->cv.SignalAll();
+    db->mutex_.Unlock();
+}
+
 Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
                               bool* save_manifest, VersionEdit* edit,
                               SequenceNumber* max_sequence) {
@@ -407,12 +632,14 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         return status;
     }
 
-    // Create the log reader.
+    // Create the log reader.  It reports corruptions to its own status
+    // while it runs on the reading thread.
+    Status read_status;
     LogReporter reporter;
     reporter.env = env_;
     reporter.info_log = options_.info_log;
     reporter.fname = fname.c_str();
-    reporter.status = (options_.paranoid_checks ? &status : nullptr);
+    reporter.status = (options_.paranoid_checks ? &read_status : nullptr);
     // We intentionally make log::Reader do checksumming even if
     // paranoid_checks==false so that corruptions cause entire commits
     // to be skipped instead of propagating bad information (like overly
@@ -422,18 +649,21 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     Log(options_.info_log, "Recovering log #%llu",
         (unsigned long long)log_number);
 
-    // Read all the records and add to a memtable
-    std::string scratch;
-    Slice record;
+    // Read the records on one thread, add them to a memtable on this one,
+    // and write full memtables to level-0 on a third.  Nothing else runs
+    // while the database is being opened, so mutex_ is only needed to
+    // hand memtables to the flushing thread.
+    LogRecordReader records(&reader, &reporter, &read_status);
+    RecoveryFlusher flusher(this, edit);
+    records.Start(env_);
+    env_->StartThread(&DBImpl::RecoveryFlushThread, &flusher);
+    mutex_.Unlock();
+
+    std::string record;
     WriteBatch batch;
     int compactions = 0;
     MemTable* mem = nullptr;
-    while (reader.ReadRecord(&record, &scratch) && status.ok()) {
-        if (record.size() < 12) {
-            reporter.Corruption(record.size(),
-                                Status::Corruption("log record too small"));
-            continue;
-        }
+    while (records.Next(&record)) {
         WriteBatchInternal::SetContents(&batch, record);
 
         if (mem == nullptr) {
@@ -454,10 +684,15 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
             compactions++;
             *save_manifest = true;
-            status = WriteLevel0Table(mem, edit, nullptr);
-            mem->Unref();
+            MutexLock l(&mutex_);
+            // Keep at most one memtable waiting for the flushing thread.
+            while (!flusher.queue.empty() && flusher.status.ok()) {
+                flusher.cv.Wait();
+            }
+            flusher.queue.push_back(mem);
+            flusher.cv.SignalAll();
             mem = nullptr;
-            if (!status.ok()) {
+            if (!flusher.status.ok()) {
                 // Reflect errors immediately so that conditions like full
                 // file-systems cause the DB::Open() to fail.
                 break;
@@ -465,6 +700,19 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         }
     }
 
+    records.Finish();
+    mutex_.Lock();
+    flusher.closed = true;
+    flusher.cv.SignalAll();
+    while (!flusher.done) {
+        flusher.cv.Wait();
+    }
+    if (status.ok()) {
+        status = read_status;
+    }
+    if (status.ok()) {
+        status = flusher.status;
+    }
     delete file;
 
     // See if we should keep reusing the last log file.
@@ -476,7 +724,8 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         if (env_->GetFileSize(fname, &lfile_size).ok() &&
             env_->NewAppendableFile(fname, &logfile_).ok()) {
             Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
-            log_ = new log::Writer(logfile_, lfile_size);
+            logfile_ = PaceLogFile(options_, logfile_, lfile_size);
+            log_ = NewLogWriter(options_, logfile_, lfile_size);
             logfile_number_ = log_number;
             if (mem != nullptr) {
                 mem_ = mem;
@@ -508,6 +757,11 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     FileMetaData meta;
     meta.number = versions_->NewFileNumber();
     pending_outputs_.insert(meta.number);
+    BlobFileMetaData blob;
+    if (options_.min_blob_size > 0) {
+        blob.number = versions_->NewFileNumber();
+        pending_outputs_.insert(blob.number);
+    }
     Iterator* iter = mem->NewIterator();
     Log(options_.info_log, "Level-0 table #%llu: started",
         (unsigned long long)meta.number);
@@ -515,7 +769,11 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     Status s;
     {
         mutex_.Unlock();
-        s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+        Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+        s = BuildTable(dbname_, env_, TableOptions(0, false), table_cache_,
+                       iter, range_del_iter, &meta,
+                       blob.number != 0 ? &blob : nullptr, compression_pool_);
+        delete range_del_iter;
         mutex_.Lock();
     }
 
@@ -524,6 +782,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
         s.ToString().c_str());
     delete iter;
     pending_outputs_.erase(meta.number);
+    pending_outputs_.erase(blob.number);
 
     // Note that if file_size is zero, the file has been deleted and
     // should not be added to the manifest.
@@ -535,13 +794,15 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
             level =
                 base->PickLevelForMemTableOutput(min_user_key, max_user_key);
         }
-        edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                      meta.largest);
+        edit->AddFile(level, meta);
+        if (blob.total_bytes > 0) {
+            edit->AddBlobFile(blob.number, blob.total_bytes);
+        }
     }
 
     CompactionStats stats;
     stats.micros = env_->NowMicros() - start_micros;
-    stats.bytes_written = meta.file_size;
+    stats.bytes_written = meta.file_size + blob.total_bytes;
     stats_[level].Add(stats);
     return s;
 }
@@ -580,6 +841,9 @@ void DBImpl::CompactMemTable() {
 }
 
 void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
+    if (secondary_) {
+        return;
+    }
     int max_level_with_files = 1;
     {
         MutexLock l(&mutex_);
@@ -664,10 +928,15 @@ void DBImpl::MaybeScheduleCompaction() {
     mutex_.AssertHeld();
     if (background_compaction_scheduled_) {
         // Already scheduled
+    } else if (secondary_) {
+        // The primary compacts the files
     } else if (shutting_down_.load(std::memory_order_acquire)) {
         // DB is being deleted; no more background compactions
     } else if (!bg_error_.ok()) {
         // Already got an error; no more changes
+    } else if (ingesting_) {
+        // IngestExternalFile() needs the current version to stay put; it
+        // reschedules when done.
     } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
                !versions_->NeedsCompaction()) {
         // No work to be done
@@ -735,15 +1004,14 @@ void DBImpl::BackgroundCompaction() {
         assert(c->num_input_files(0) == 1);
         FileMetaData* f = c->input(0, 0);
         c->edit()->RemoveFile(c->level(), f->number);
-        c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                           f->largest);
+        c->edit()->AddFile(c->output_level(), *f);
         status = versions_->LogAndApply(c->edit(), &mutex_);
         if (!status.ok()) {
             RecordBackgroundError(status);
         }
         VersionSet::LevelSummaryStorage tmp;
         Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-            static_cast<unsigned long long>(f->number), c->level() + 1,
+            static_cast<unsigned long long>(f->number), c->output_level(),
             static_cast<unsigned long long>(f->file_size),
             status.ToString().c_str(), versions_->LevelSummary(&tmp));
     } else {
@@ -792,13 +1060,31 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
         assert(compact->outfile == nullptr);
     }
     delete compact->outfile;
+    delete compact->blob_writer;
     for (size_t i = 0; i < compact->outputs.size(); i++) {
         const CompactionState::Output& out = compact->outputs[i];
         pending_outputs_.erase(out.number);
     }
+    for (size_t i = 0; i < compact->blob_outputs.size(); i++) {
+        pending_outputs_.erase(compact->blob_outputs[i].number);
+    }
     delete compact;
 }
 
+Options DBImpl::TableOptions(int level, bool bottommost) const {
+    Options options = options_;
+    if (bottommost && options_.bottommost_zstd) {
+        options.compression = kZstdCompression;
+        options.zstd_compression_level =
+            options_.bottommost_zstd_compression_level;
+    } else if (!options_.compression_per_level.empty()) {
+        const size_t n = options_.compression_per_level.size();
+        options.compression =
+            options_.compression_per_level[std::min<size_t>(level, n - 1)];
+    }
+    return options;
+}
+
 Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     assert(compact != nullptr);
     assert(compact->builder == nullptr);
@@ -811,21 +1097,28 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
         out.number = file_number;
         out.smallest.Clear();
         out.largest.Clear();
+        out.oldest_blob_file = 0;
+        out.has_range_tombstones = false;
         compact->outputs.push_back(out);
         mutex_.Unlock();
     }
 
     // Make the output file
     std::string fname = TableFileName(dbname_, file_number);
-    Status s = env_->NewWritableFile(fname, &compact->outfile);
+    Status s = NewOutputFile(env_, options_, fname,
+                             RateLimiter::Priority::kLow, &compact->outfile);
     if (s.ok()) {
-        compact->builder = new TableBuilder(options_, compact->outfile);
+        const Compaction* c = compact->compaction;
+        compact->builder = new TableBuilder(
+            TableOptions(c->output_level(), c->IsBottommostLevel()),
+            compact->outfile, compression_pool_);
     }
     return s;
 }
 
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
-                                          Iterator* input) {
+                                          Iterator* input,
+                                          const Slice* upper_bound) {
     assert(compact != nullptr);
     assert(compact->outfile != nullptr);
     assert(compact->builder != nullptr);
@@ -833,9 +1126,34 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
     const uint64_t output_number = compact->current_output()->number;
     assert(output_number != 0);
 
+    // Add this output's share of the range tombstones and widen its key
+    // range to cover them.
+    const uint64_t current_entries = compact->builder->NumEntries();
+    CompactionState::Output* out = compact->current_output();
+    bool empty = (current_entries == 0);
+    for (RangeTombstone t : compact->tombstones) {
+        if (!compact->ClipToOutput(user_comparator(), upper_bound, &t)) {
+            continue;
+        }
+        const InternalKey start = t.StartKey();
+        compact->builder->AddRangeTombstone(start.Encode(), t.end);
+        out->has_range_tombstones = true;
+        if (empty || internal_comparator_.Compare(start, out->smallest) < 0) {
+            out->smallest = start;
+        }
+        const InternalKey end = t.EndKey();
+        if (empty || internal_comparator_.Compare(end, out->largest) > 0) {
+            out->largest = end;
+        }
+        empty = false;
+    }
+    if (upper_bound != nullptr) {
+        compact->lower_bound = upper_bound->ToString();
+        compact->has_lower_bound = true;
+    }
+
     // Check for iterator errors
     Status s = input->status();
-    const uint64_t current_entries = compact->builder->NumEntries();
     if (s.ok()) {
         s = compact->builder->Finish();
     } else {
@@ -857,16 +1175,17 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
     delete compact->outfile;
     compact->outfile = nullptr;
 
-    if (s.ok() && current_entries > 0) {
+    if (s.ok() && !empty) {
         // Verify that the table is usable
         Iterator* iter = table_cache_->NewIterator(ReadOptions(), output_number,
-                                                   current_bytes);
+                                                   current_bytes, 0);
         s = iter->status();
         delete iter;
         if (s.ok()) {
             Log(options_.info_log,
                 "Generated table #%llu@%d: %lld keys, %lld bytes",
-                (unsigned long long)output_number, compact->compaction->level(),
+                (unsigned long long)output_number,
+                compact->compaction->output_level(),
                 (unsigned long long)current_entries,
                 (unsigned long long)current_bytes);
         }
@@ -874,33 +1193,298 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
     return s;
 }
 
+// Describe the inputs of "c" as "<files>@<level> + ..." for the info log.
+static std::string CompactionInputSummary(Compaction* c) {
+    std::string result;
+    for (int which = 0; which < c->num_input_levels(); which++) {
+        if (which > 0) {
+            result += " + ";
+        }
+        char buf[40];
+        std::snprintf(buf, sizeof(buf), "%d@%d", c->num_input_files(which),
+                      c->input_level(which));
+        result += buf;
+    }
+    return result;
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
     mutex_.AssertHeld();
-    Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
-        compact->compaction->num_input_files(0), compact->compaction->level(),
-        compact->compaction->num_input_files(1),
-        compact->compaction->level() + 1,
+    Log(options_.info_log, "Compacted %s files => %lld bytes",
+        CompactionInputSummary(compact->compaction).c_str(),
         static_cast<long long>(compact->total_bytes));
 
     // Add compaction outputs
-    compact->compaction->AddInputDeletions(compact->compaction->edit());
-    const int level = compact->compaction->level();
+    VersionEdit* edit = compact->compaction->edit();
+    compact->compaction->AddInputDeletions(edit);
+    const int level = compact->compaction->output_level();
     for (size_t i = 0; i < compact->outputs.size(); i++) {
         const CompactionState::Output& out = compact->outputs[i];
-        compact->compaction->edit()->AddFile(
-            level + 1, out.number, out.file_size, out.smallest, out.largest);
+        FileMetaData f;
+        f.number = out.number;
+        f.file_size = out.file_size;
+        f.smallest = out.smallest;
+        f.largest = out.largest;
+        f.oldest_blob_file = out.oldest_blob_file;
+        f.has_range_tombstones = out.has_range_tombstones;
+        edit->AddFile(level, f);
+    }
+    for (size_t i = 0; i < compact->blob_outputs.size(); i++) {
+        const BlobFileMetaData& b = compact->blob_outputs[i];
+        edit->AddBlobFile(b.number, b.total_bytes);
+    }
+    for (const auto& kvp : compact->blob_garbage) {
+        edit->AddBlobGarbage(kvp.first, kvp.second);
+    }
+    return versions_->LogAndApply(edit, &mutex_);
+}
+
+Status DBImpl::AddToCompactionOutput(CompactionState* compact,
+                                     const Slice& key, const Slice& value) {
+    // Open output file if necessary
+    if (compact->builder == nullptr) {
+        Status s = OpenCompactionOutputFile(compact);
+        if (!s.ok()) {
+            return s;
+        }
+    }
+
+    Slice output_key = key;
+    Slice output_value = value;
+    std::string blob_key, blob_value, encoded_index;
+    ParsedInternalKey ikey;
+    BlobIndex index;
+    bool is_blob = false;
+    if (ParseInternalKey(key, &ikey)) {
+        Slice separated;
+        bool separate = false;
+        if (ikey.type == kTypeValue && options_.min_blob_size > 0 &&
+            value.size() >= options_.min_blob_size) {
+            separated = value;
+            separate = true;
+        } else if (ikey.type == kTypeBlobIndex &&
+                   index.DecodeFrom(value).ok()) {
+            is_blob = true;
+            if (compact->compaction->ShouldRelocateBlob(index.file_number)) {
+                // Move the value out of a blob file being collected.
+                Status s = table_cache_->GetBlob(value, &blob_value);
+                if (!s.ok()) {
+                    return s;
+                }
+                compact->blob_garbage[index.file_number] += index.size;
+                separated = blob_value;
+                separate = true;
+            }
+        }
+        if (separate) {
+            Status s = AddToCompactionBlobFile(compact, separated, &index);
+            if (!s.ok()) {
+                return s;
+            }
+            ikey.type = kTypeBlobIndex;
+            AppendInternalKey(&blob_key, ikey);
+            index.EncodeTo(&encoded_index);
+            output_key = blob_key;
+            output_value = encoded_index;
+            is_blob = true;
+        }
+    }
+
+    CompactionState::Output* out = compact->current_output();
+    if (compact->builder->NumEntries() == 0) {
+        out->smallest.DecodeFrom(output_key);
+    }
+    out->largest.DecodeFrom(output_key);
+    if (is_blob && (out->oldest_blob_file == 0 ||
+                    index.file_number < out->oldest_blob_file)) {
+        out->oldest_blob_file = index.file_number;
+    }
+    compact->builder->Add(output_key, output_value);
+    return Status::OK();
+}
+
+Status DBImpl::AddToCompactionBlobFile(CompactionState* compact,
+                                       const Slice& value, BlobIndex* index) {
+    if (compact->blob_writer == nullptr) {
+        uint64_t file_number;
+        {
+            mutex_.Lock();
+            file_number = versions_->NewFileNumber();
+            pending_outputs_.insert(file_number);
+            BlobFileMetaData b;
+            b.number = file_number;
+            compact->blob_outputs.push_back(b);
+            mutex_.Unlock();
+        }
+        WritableFile* file;
+        Status s = NewOutputFile(env_, options_,
+                                 BlobFileName(dbname_, file_number),
+                                 RateLimiter::Priority::kLow, &file);
+        if (!s.ok()) {
+            return s;
+        }
+        compact->blob_writer = new BlobFileWriter(file_number, file);
     }
-    return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+    Status s = compact->blob_writer->Add(value, index);
+    if (s.ok() &&
+        compact->blob_writer->file_size() >= options_.blob_file_size) {
+        s = FinishCompactionBlobFile(compact);
+    }
+    return s;
+}
+
+Status DBImpl::FinishCompactionBlobFile(CompactionState* compact) {
+    assert(compact->blob_writer != nullptr);
+    BlobFileWriter* writer = compact->blob_writer;
+    Status s = writer->Finish();
+    compact->blob_outputs.back().total_bytes = writer->value_bytes();
+    if (s.ok()) {
+        Log(options_.info_log, "Generated blob file #%llu: %lld bytes",
+            (unsigned long long)writer->number(),
+            (unsigned long long)writer->file_size());
+    }
+    delete writer;
+    compact->blob_writer = nullptr;
+    return s;
+}
+
+Status DBImpl::AddValueToCompactionOutput(CompactionState* compact,
+                                          const Slice& user_key,
+                                          SequenceNumber sequence,
+                                          ValueType type, const Slice& value) {
+    Slice output_value = value;
+    std::string blob_value, new_value;
+    const CompactionFilter* filter = options_.compaction_filter;
+    if (filter != nullptr) {
+        // The filter sees the value itself, not its blob index.
+        Slice filter_value = value;
+        if (type == kTypeBlobIndex) {
+            Status s = table_cache_->GetBlob(value, &blob_value);
+            if (!s.ok()) {
+                return s;
+            }
+            filter_value = blob_value;
+        }
+        switch (filter->Filter(compact->compaction->level(), user_key,
+                               filter_value, &new_value)) {
+        case CompactionFilter::kKeep:
+            break;
+        case CompactionFilter::kRemove:
+            if (type == kTypeBlobIndex) {
+                compact->AddBlobGarbage(value);
+            }
+            if (sequence <= compact->smallest_snapshot &&
+                compact->compaction->IsBaseLevelForKey(user_key)) {
+                // Nothing older is left for a deletion to hide.  Above the
+                // oldest snapshot, older entries may still be kept for it.
+                return Status::OK();
+            }
+            type = kTypeDeletion;
+            output_value = Slice();
+            break;
+        case CompactionFilter::kChangeValue:
+            if (type == kTypeBlobIndex) {
+                compact->AddBlobGarbage(value);
+            }
+            type = kTypeValue;
+            output_value = new_value;
+            break;
+        }
+    }
+    InternalKey key(user_key, sequence, type);
+    return AddToCompactionOutput(compact, key.Encode(), output_value);
+}
+
+Status DBImpl::MergeCompactionOperands(CompactionState* compact,
+                                       Iterator* input,
+                                       const RangeTombstoneList& tombstones,
+                                       bool filter,
+                                       SequenceNumber* last_sequence_for_key) {
+    // Every snapshot sees the operands below smallest_snapshot together
+    // with the entry they apply to, so they can be combined.  Collect the
+    // operands newest first until that entry turns up.
+    ParsedInternalKey ikey;
+    ParseInternalKey(input->key(), &ikey);
+    const std::string user_key = ikey.user_key.ToString();
+    const SequenceNumber sequence = ikey.sequence;
+    MergeContext merge_context(options_.merge_operator);
+    std::vector<std::string> keys, operands;
+    std::string base;
+    bool has_base = false;
+    bool found_base = false;
+    while (input->Valid()) {
+        if (!ParseInternalKey(input->key(), &ikey) ||
+            user_comparator()->Compare(ikey.user_key, user_key) != 0) {
+            break;
+        }
+        if (ikey.sequence < tombstones.MaxCoveringSequence(
+                                ikey.user_key, compact->smallest_snapshot)) {
+            // Deleted by a range tombstone, as is everything below.
+            found_base = true;
+            break;
+        }
+        *last_sequence_for_key = ikey.sequence;
+        if (ikey.type != kTypeMerge) {
+            found_base = true;
+            if (ikey.type == kTypeValue) {
+                base = input->value().ToString();
+                has_base = true;
+            } else if (ikey.type == kTypeBlobIndex) {
+                // The merge result replaces the blob.
+                Status s = table_cache_->GetBlob(input->value(), &base);
+                if (!s.ok()) {
+                    return s;
+                }
+                compact->AddBlobGarbage(input->value());
+                has_base = true;
+            }
+            input->Next();
+            break;
+        }
+        keys.push_back(input->key().ToString());
+        operands.push_back(input->value().ToString());
+        merge_context.AddOlderOperand(input->value());
+        input->Next();
+    }
+    if (!found_base) {
+        // With no older data below this compaction the operands apply to no
+        // value at all.
+        found_base = compact->compaction->IsBaseLevelForKey(user_key);
+    }
+
+    if (found_base) {
+        Slice base_slice(base);
+        std::string value;
+        Status s = merge_context.Merge(
+            user_key, has_base ? &base_slice : nullptr, &value);
+        if (!s.ok()) {
+            return s;
+        }
+        if (!filter) {
+            InternalKey key(user_key, sequence, kTypeValue);
+            return AddToCompactionOutput(compact, key.Encode(), value);
+        }
+        return AddValueToCompactionOutput(compact, user_key, sequence,
+                                          kTypeValue, value);
+    }
+    std::string operand;
+    if (keys.size() > 1 && merge_context.PartialMerge(user_key, &operand)) {
+        return AddToCompactionOutput(compact, keys[0], operand);
+    }
+    Status s;
+    for (size_t i = 0; i < keys.size() && s.ok(); i++) {
+        s = AddToCompactionOutput(compact, keys[i], operands[i]);
+    }
+    return s;
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
     const uint64_t start_micros = env_->NowMicros();
     int64_t imm_micros = 0; // Micros spent doing imm_ compactions
 
-    Log(options_.info_log, "Compacting %d@%d + %d@%d files",
-        compact->compaction->num_input_files(0), compact->compaction->level(),
-        compact->compaction->num_input_files(1),
-        compact->compaction->level() + 1);
+    Log(options_.info_log, "Compacting %s files to level-%d",
+        CompactionInputSummary(compact->compaction).c_str(),
+        compact->compaction->output_level());
 
     assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
     assert(compact->builder == nullptr);
@@ -910,19 +1494,54 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     } else {
         compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
     }
+    // The compaction filter may only change entries that no snapshot sees:
+    // a newer version of the key can live outside this compaction, so only
+    // the snapshots tell whether an older one is still read.
+    const bool has_snapshots = !snapshots_.empty();
+    const SequenceNumber newest_snapshot =
+        has_snapshots ? snapshots_.newest()->sequence_number() : 0;
 
     Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
     // Release mutex while we're actually doing the compaction work
     mutex_.Unlock();
 
-    input->SeekToFirst();
+    // Range tombstones of the inputs hide the entries they cover from every
+    // snapshot.  A tombstone is obsolete once no snapshot predates it and
+    // there is no older data below the output level for it to hide.
     Status status;
+    RangeTombstoneList tombstones(user_comparator());
+    for (int which = 0;
+         which < compact->compaction->num_input_levels() && status.ok();
+         which++) {
+        for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+            const FileMetaData* f = compact->compaction->input(which, i);
+            if (!f->has_range_tombstones) {
+                continue;
+            }
+            status = table_cache_->AddRangeTombstones(f->number, f->file_size,
+                                                      &tombstones);
+            if (!status.ok()) {
+                break;
+            }
+        }
+    }
+    tombstones.Finish();
+    for (const RangeTombstone& t : tombstones.tombstones()) {
+        if (user_comparator()->Compare(t.begin, t.end) < 0 &&
+            (t.sequence > compact->smallest_snapshot ||
+             !compact->compaction->IsBaseLevelForRange(t.begin, t.end))) {
+            compact->tombstones.push_back(t);
+        }
+    }
+
+    input->SeekToFirst();
     ParsedInternalKey ikey;
     std::string current_user_key;
     bool has_current_user_key = false;
     SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-    while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+    while (status.ok() && input->Valid() &&
+           !shutting_down_.load(std::memory_order_acquire)) {
         // Prioritize immutable compaction work
         if (has_imm_.load(std::memory_order_relaxed)) {
             const uint64_t imm_start = env_->NowMicros();
@@ -936,10 +1555,18 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
             imm_micros += (env_->NowMicros() - imm_start);
         }
 
+        // Close the output file if it is big enough.  Outputs are only
+        // switched between user keys, since an output's range tombstones
+        // end at the first user key of the next output.
         Slice key = input->key();
-        if (compact->compaction->ShouldStopBefore(key) &&
-            compact->builder != nullptr) {
-            status = FinishCompactionOutputFile(compact, input);
+        const Slice user_key = key.size() >= 8 ? ExtractUserKey(key) : key;
+        const bool stop = compact->compaction->ShouldStopBefore(key);
+        if (compact->builder != nullptr &&
+            (stop || compact->builder->FileSize() >=
+                         compact->compaction->MaxOutputFileSize()) &&
+            user_comparator()->Compare(
+                user_key, compact->current_output()->largest.user_key()) != 0) {
+            status = FinishCompactionOutputFile(compact, input, &user_key);
             if (!status.ok()) {
                 break;
             }
@@ -947,6 +1574,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
         // Handle key/value, add to state, etc.
         bool drop = false;
+        bool merge = false;
+        bool filter = false;
+        bool unseen = false;
         if (!ParseInternalKey(key, &ikey)) {
             // Do not hide error keys
             current_user_key.clear();
@@ -962,10 +1592,14 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
                 has_current_user_key = true;
                 last_sequence_for_key = kMaxSequenceNumber;
             }
-
             if (last_sequence_for_key <= compact->smallest_snapshot) {
                 // Hidden by an newer entry for same user key
                 drop = true; // (A)
+            } else if (ikey.sequence <
+                       tombstones.MaxCoveringSequence(
+                           ikey.user_key, compact->smallest_snapshot)) {
+                // Deleted by a range tombstone visible to every snapshot
+                drop = true;
             } else if (ikey.type == kTypeDeletion &&
                        ikey.sequence <= compact->smallest_snapshot &&
                        compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
@@ -980,6 +1614,17 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
                 drop = true;
             }
 
+            merge = !drop && ikey.type == kTypeMerge &&
+                    ikey.sequence <= compact->smallest_snapshot &&
+                    options_.merge_operator != nullptr;
+            unseen = !has_snapshots || ikey.sequence > newest_snapshot;
+            filter = !drop &&
+                     (ikey.type == kTypeValue ||
+                      ikey.type == kTypeBlobIndex) &&
+                     unseen && options_.compaction_filter != nullptr;
+            if (drop && ikey.type == kTypeBlobIndex) {
+                compact->AddBlobGarbage(input->value());
+            }
             last_sequence_for_key = ikey.sequence;
         }
 #if 0
@@ -992,27 +1637,23 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
-        if (!drop) {
-            // Open output file if necessary
-            if (compact->builder == nullptr) {
-                status = OpenCompactionOutputFile(compact);
-                if (!status.ok()) {
-                    break;
-                }
-            }
-            if (compact->builder->NumEntries() == 0) {
-                compact->current_output()->smallest.DecodeFrom(key);
+        if (merge) {
+            // Leaves input at the first entry not merged.
+            status = MergeCompactionOperands(compact, input, tombstones, unseen,
+                                             &last_sequence_for_key);
+            continue;
+        }
+        if (filter) {
+            status = AddValueToCompactionOutput(
+                compact, ikey.user_key, ikey.sequence, ikey.type,
+                input->value());
+            if (!status.ok()) {
+                break;
             }
-            compact->current_output()->largest.DecodeFrom(key);
-            compact->builder->Add(key, input->value());
-
-            // Close output file if it is big enough
-            if (compact->builder->FileSize() >=
-                compact->compaction->MaxOutputFileSize()) {
-                status = FinishCompactionOutputFile(compact, input);
-                if (!status.ok()) {
-                    break;
-                }
+        } else if (!drop) {
+            status = AddToCompactionOutput(compact, key, input->value());
+            if (!status.ok()) {
+                break;
             }
         }
 
@@ -1022,8 +1663,20 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
         status = Status::IOError("Deleting DB during compaction");
     }
+    if (status.ok() && compact->builder == nullptr) {
+        // Tombstones past the last output still need a file.
+        for (RangeTombstone t : compact->tombstones) {
+            if (compact->ClipToOutput(user_comparator(), nullptr, &t)) {
+                status = OpenCompactionOutputFile(compact);
+                break;
+            }
+        }
+    }
     if (status.ok() && compact->builder != nullptr) {
-        status = FinishCompactionOutputFile(compact, input);
+        status = FinishCompactionOutputFile(compact, input, nullptr);
+    }
+    if (status.ok() && compact->blob_writer != nullptr) {
+        status = FinishCompactionBlobFile(compact);
     }
     if (status.ok()) {
         status = input->status();
@@ -1033,7 +1686,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     CompactionStats stats;
     stats.micros = env_->NowMicros() - start_micros - imm_micros;
-    for (int which = 0; which < 2; which++) {
+    for (int which = 0; which < compact->compaction->num_input_levels();
+         which++) {
         for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
             stats.bytes_read += compact->compaction->input(which, i)->file_size;
         }
@@ -1041,9 +1695,12 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     for (size_t i = 0; i < compact->outputs.size(); i++) {
         stats.bytes_written += compact->outputs[i].file_size;
     }
+    for (size_t i = 0; i < compact->blob_outputs.size(); i++) {
+        stats.bytes_written += compact->blob_outputs[i].total_bytes;
+    }
 
     mutex_.Lock();
-    stats_[compact->compaction->level() + 1].Add(stats);
+    stats_[compact->compaction->output_level()].Add(stats);
 
     if (status.ok()) {
         status = InstallCompactionResults(compact);
@@ -1084,9 +1741,13 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+                                      uint32_t* seed,
+                                      RangeTombstoneList** tombstones) {
     mutex_.Lock();
     *latest_snapshot = versions_->LastSequence();
+    MemTable* const mem = mem_;
+    MemTable* const imm = imm_;
+    Version* const current = versions_->current();
 
     // Collect together all needed child iterators
     std::vector<Iterator*> list;
@@ -1107,6 +1768,36 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 
     *seed = ++seed_;
     mutex_.Unlock();
+
+    if (tombstones != nullptr) {
+        // The iterator holds references to everything read here.
+        RangeTombstoneList* list = new RangeTombstoneList(user_comparator());
+        Status s;
+        for (MemTable* m : {mem, imm}) {
+            Iterator* iter =
+                (m != nullptr) ? m->NewRangeTombstoneIterator() : nullptr;
+            if (iter != nullptr) {
+                s = list->AddAll(iter);
+                delete iter;
+            }
+            if (!s.ok()) {
+                break;
+            }
+        }
+        if (s.ok()) {
+            s = current->AddRangeTombstones(list);
+        }
+        list->Finish();
+        if (!s.ok() || list->empty()) {
+            delete list;
+            list = nullptr;
+        }
+        if (!s.ok()) {
+            delete internal_iter;
+            internal_iter = NewErrorIterator(s);
+        }
+        *tombstones = list;
+    }
     return internal_iter;
 }
 
@@ -1149,12 +1840,18 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
         mutex_.Unlock();
         // First look in the memtable, then in the immutable memtable (if any).
         LookupKey lkey(key, snapshot);
-        if (mem->Get(lkey, value, &s)) {
+        SequenceNumber max_covering_tombstone_seq = 0;
+        MergeContext merge_context(options_.merge_operator);
+        if (mem->Get(lkey, value, &s, &max_covering_tombstone_seq,
+                     &merge_context)) {
             // Done
-        } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
+        } else if (imm != nullptr &&
+                   imm->Get(lkey, value, &s, &max_covering_tombstone_seq,
+                            &merge_context)) {
             // Done
         } else {
-            s = current->Get(options, lkey, value, &stats);
+            s = current->Get(options, lkey, value, &stats,
+                             max_covering_tombstone_seq, &merge_context);
             have_stat_update = true;
         }
         mutex_.Lock();
@@ -1173,14 +1870,16 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
     SequenceNumber latest_snapshot;
     uint32_t seed;
-    Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
+    RangeTombstoneList* tombstones;
+    Iterator* iter =
+        NewInternalIterator(options, &latest_snapshot, &seed, &tombstones);
     return NewDBIterator(
         this, user_comparator(), iter,
         (options.snapshot != nullptr
              ? static_cast<const SnapshotImpl*>(options.snapshot)
                    ->sequence_number()
              : latest_snapshot),
-        seed);
+        seed, tombstones, options_.merge_operator);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1190,6 +1889,10 @@ void DBImpl::RecordReadSample(Slice key) {
     }
 }
 
+Status DBImpl::GetBlob(const Slice& blob_index, std::string* value) {
+    return table_cache_->GetBlob(blob_index, value);
+}
+
 const Snapshot* DBImpl::GetSnapshot() {
     MutexLock l(&mutex_);
     return snapshots_.New(versions_->LastSequence());
@@ -1209,7 +1912,23 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
     return DB::Delete(options, key);
 }
 
+Status DBImpl::DeleteRange(const WriteOptions& options, const Slice& begin,
+                           const Slice& end) {
+    return DB::DeleteRange(options, begin, end);
+}
+
+Status DBImpl::Merge(const WriteOptions& options, const Slice& key,
+                     const Slice& value) {
+    if (options_.merge_operator == nullptr) {
+        return Status::InvalidArgument("merge_operator is not set");
+    }
+    return DB::Merge(options, key, value);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+    if (secondary_) {
+        return Status::NotSupported("Write", "secondary instance");
+    }
     Writer w(&mutex_);
     w.batch = updates;
     w.sync = options.sync;
@@ -1308,6 +2027,10 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
     ++iter; // Advance past "first"
     for (; iter != writers_.end(); ++iter) {
         Writer* w = *iter;
+        if (w->exclusive) {
+            // Must reach the front of the queue itself.
+            break;
+        }
         if (w->sync && !first->sync) {
             // Do not include a sync write into a batch handled by a non-sync
             // write.
@@ -1402,9 +2125,9 @@ Status DBImpl::MakeRoomForWrite(bool force) {
             }
             delete logfile_;
 
-            logfile_ = lfile;
+            logfile_ = PaceLogFile(options_, lfile, 0);
             logfile_number_ = new_log_number;
-            log_ = new log::Writer(lfile);
+            log_ = NewLogWriter(options_, logfile_, 0);
             imm_ = mem_;
             has_imm_.store(true, std::memory_order_release);
             mem_ = new MemTable(internal_comparator_);
@@ -1416,6 +2139,463 @@ Status DBImpl::MakeRoomForWrite(bool force) {
     return s;
 }
 
+Status DBImpl::ReadExternalFile(const std::string& path, FileMetaData* meta) {
+    Status s = env_->GetFileSize(path, &meta->file_size);
+    RandomAccessFile* file = nullptr;
+    if (s.ok()) {
+        s = env_->NewRandomAccessFile(path, &file);
+    }
+    Table* table = nullptr;
+    if (s.ok()) {
+        s = Table::Open(options_, file, meta->file_size, &table);
+    }
+    if (s.ok()) {
+        ReadOptions read_options;
+        read_options.fill_cache = false;
+        Iterator* iter = table->NewIterator(read_options);
+        iter->SeekToFirst();
+        if (iter->Valid()) {
+            meta->smallest.DecodeFrom(iter->key());
+            iter->SeekToLast();
+        }
+        if (iter->Valid()) {
+            meta->largest.DecodeFrom(iter->key());
+        }
+        s = iter->status();
+        if (s.ok() && !iter->Valid()) {
+            s = Status::InvalidArgument(path, "empty file");
+        }
+        delete iter;
+    }
+    if (s.ok()) {
+        ParsedInternalKey smallest, largest;
+        if (!ParseInternalKey(meta->smallest.Encode(), &smallest) ||
+            !ParseInternalKey(meta->largest.Encode(), &largest) ||
+            smallest.sequence != 0 || largest.sequence != 0) {
+            s = Status::InvalidArgument(path, "not written by SstFileWriter");
+        }
+    }
+    delete table;
+    delete file;
+    return s;
+}
+
+Status DBImpl::IngestExternalFile(
+    const std::vector<std::string>& paths,
+    const IngestExternalFileOptions& ingest_options) {
+    if (secondary_) {
+        return Status::NotSupported("IngestExternalFile",
+                                    "secondary instance");
+    }
+    std::vector<FileMetaData> files(paths.size());
+    Status s;
+    for (size_t i = 0; i < paths.size() && s.ok(); i++) {
+        s = ReadExternalFile(paths[i], &files[i]);
+    }
+    if (!s.ok() || files.empty()) {
+        return s;
+    }
+
+    std::vector<const FileMetaData*> sorted;
+    for (const FileMetaData& f : files) {
+        sorted.push_back(&f);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [this](const FileMetaData* a, const FileMetaData* b) {
+                  return internal_comparator_.Compare(a->smallest,
+                                                      b->smallest) < 0;
+              });
+    for (size_t i = 1; i < sorted.size(); i++) {
+        if (user_comparator()->Compare(sorted[i - 1]->largest.user_key(),
+                                       sorted[i]->smallest.user_key()) >= 0) {
+            return Status::InvalidArgument("external files overlap");
+        }
+    }
+
+    // Hold off writes while the files are added.
+    Writer w(&mutex_);
+    w.exclusive = true;
+    MutexLock l(&mutex_);
+    writers_.push_back(&w);
+    while (&w != writers_.front()) {
+        w.cv.Wait();
+    }
+
+    // Older entries for the same keys must not be flushed after the files
+    // are added, since a later level-0 file would shadow them.
+    bool flush = false;
+    Iterator* mem_iter = mem_->NewIterator();
+    for (const FileMetaData& f : files) {
+        // The file's keys use sequence 0, which sorts after every entry
+        // for the same user key.
+        const InternalKey start(f.smallest.user_key(), kMaxSequenceNumber,
+                                kValueTypeForSeek);
+        mem_iter->Seek(start.Encode());
+        if (mem_iter->Valid() &&
+            user_comparator()->Compare(ExtractUserKey(mem_iter->key()),
+                                       f.largest.user_key()) <= 0) {
+            flush = true;
+        }
+    }
+    delete mem_iter;
+    Iterator* range_del_iter = mem_->NewRangeTombstoneIterator();
+    if (range_del_iter != nullptr) {
+        RangeTombstoneList tombstones(user_comparator());
+        s = tombstones.AddAll(range_del_iter);
+        delete range_del_iter;
+        for (const RangeTombstone& t : tombstones.tombstones()) {
+            for (const FileMetaData& f : files) {
+                if (user_comparator()->Compare(t.begin,
+                                               f.largest.user_key()) <= 0 &&
+                    user_comparator()->Compare(t.end,
+                                               f.smallest.user_key()) > 0) {
+                    flush = true;
+                }
+            }
+        }
+    }
+    if (s.ok() && flush) {
+        s = MakeRoomForWrite(true /* force */);
+    }
+    while (s.ok() && imm_ != nullptr) {
+        if (bg_error_.ok()) {
+            background_work_finished_signal_.Wait();
+        } else {
+            s = bg_error_;
+        }
+    }
+
+    // Levels are picked against the current version, so no compaction may
+    // install another one until the files are in place.
+    ingesting_ = true;
+    while (background_compaction_scheduled_) {
+        background_work_finished_signal_.Wait();
+    }
+
+    std::vector<uint64_t> numbers;
+    std::vector<bool> moved;
+    if (s.ok()) {
+        for (size_t i = 0; i < files.size(); i++) {
+            numbers.push_back(versions_->NewFileNumber());
+            pending_outputs_.insert(numbers[i]);
+        }
+        mutex_.Unlock();
+        for (size_t i = 0; i < files.size() && s.ok(); i++) {
+            const std::string fname = TableFileName(dbname_, numbers[i]);
+            moved.push_back(ingest_options.move_files &&
+                            env_->RenameFile(paths[i], fname).ok());
+            if (!moved[i]) {
+                s = CopyFile(env_, paths[i], fname);
+            }
+        }
+        mutex_.Lock();
+    }
+
+    if (s.ok()) {
+        // All of the files share one new sequence number.
+        const SequenceNumber sequence = versions_->LastSequence() + 1;
+        Version* base = versions_->current();
+        VersionEdit edit;
+        for (size_t i = 0; i < files.size(); i++) {
+            FileMetaData& f = files[i];
+            ParsedInternalKey smallest, largest;
+            ParseInternalKey(f.smallest.Encode(), &smallest);
+            ParseInternalKey(f.largest.Encode(), &largest);
+            f.smallest =
+                InternalKey(smallest.user_key, sequence, smallest.type);
+            f.largest = InternalKey(largest.user_key, sequence, largest.type);
+
+            // Use the deepest level with no overlapping data at or above it.
+            const Slice smallest_user_key = f.smallest.user_key();
+            const Slice largest_user_key = f.largest.user_key();
+            int level = 0;
+            if (!base->OverlapInLevel(0, &smallest_user_key,
+                                      &largest_user_key)) {
+                while (level + 1 < config::kNumLevels &&
+                       !base->OverlapInLevel(level + 1, &smallest_user_key,
+                                             &largest_user_key)) {
+                    level++;
+                }
+            }
+            edit.AddFile(level, numbers[i], f.file_size, f.smallest,
+                         f.largest, sequence);
+            Log(options_.info_log, "Ingested table #%llu@%d: %llu bytes",
+                (unsigned long long)numbers[i], level,
+                (unsigned long long)f.file_size);
+        }
+        versions_->SetLastSequence(sequence);
+        s = versions_->LogAndApply(&edit, &mutex_);
+    }
+
+    for (size_t i = 0; i < numbers.size(); i++) {
+        pending_outputs_.erase(numbers[i]);
+        if (!s.ok() && i < moved.size()) {
+            const std::string fname = TableFileName(dbname_, numbers[i]);
+            if (moved[i]) {
+                env_->RenameFile(fname, paths[i]);
+            } else {
+                env_->RemoveFile(fname);
+            }
+        }
+    }
+
+    ingesting_ = false;
+    writers_.pop_front();
+    if (!writers_.empty()) {
+        writers_.front()->cv.Signal();
+    }
+    MaybeScheduleCompaction();
+    return s;
+}
+
+// Hard-link "src" to "dst", or copy it if that fails, e.g. because "dst"
+// is on another file system.
+static Status LinkOrCopyFile(Env* env, const std::string& src,
+                             const std::string& dst) {
+    Status s = env->LinkFile(src, dst);
+    if (!s.ok()) {
+        s = CopyFile(env, src, dst);
+    }
+    return s;
+}
+
+// Copy the first "size" bytes of "src" to "dst" and sync the copy.
+static Status CopyFilePrefix(Env* env, const std::string& src,
+                             const std::string& dst, uint64_t size) {
+    SequentialFile* in;
+    Status s = env->NewSequentialFile(src, &in);
+    if (!s.ok()) {
+        return s;
+    }
+    WritableFile* out;
+    s = env->NewWritableFile(dst, &out);
+    if (!s.ok()) {
+        delete in;
+        return s;
+    }
+    static const size_t kBufferSize = 1 << 20;
+    char* space = new char[kBufferSize];
+    while (s.ok() && size > 0) {
+        Slice fragment;
+        s = in->Read(std::min<uint64_t>(size, kBufferSize), &fragment, space);
+        if (s.ok() && fragment.empty()) {
+            s = Status::Corruption(src, "file is shorter than expected");
+        }
+        if (s.ok()) {
+            s = out->Append(fragment);
+            size -= fragment.size();
+        }
+    }
+    delete[] space;
+    delete in;
+    if (s.ok()) {
+        s = out->Sync();
+    }
+    if (s.ok()) {
+        s = out->Close();
+    }
+    delete out;
+    return s;
+}
+
+Status DBImpl::CreateCheckpoint(const std::string& dir) {
+    if (secondary_) {
+        return Status::NotSupported("CreateCheckpoint", "secondary instance");
+    }
+    if (env_->FileExists(dir)) {
+        return Status::InvalidArgument(dir, "exists");
+    }
+    Status s = env_->CreateDir(dir);
+    if (!s.ok()) {
+        return s;
+    }
+
+    // Pick the files that make up the current state while no file may be
+    // deleted: the tables and blob files of the current version, the
+    // prefix of the MANIFEST that describes it, and the logs that hold
+    // the writes which are not in a table yet.  The logs are copied as
+    // they are when the copy is made, so they may hold later writes too.
+    std::vector<uint64_t> table_numbers;
+    std::vector<uint64_t> blob_numbers;
+    std::vector<uint64_t> log_numbers;
+    uint64_t manifest_number;
+    uint64_t manifest_size;
+    {
+        MutexLock l(&mutex_);
+        file_deletions_paused_++;
+        Version* current = versions_->current();
+        std::vector<FileMetaData*> files;
+        current->GetAllFiles(&files);
+        for (FileMetaData* f : files) {
+            table_numbers.push_back(f->number);
+        }
+        current->GetBlobFiles(&blob_numbers);
+        manifest_number = versions_->ManifestFileNumber();
+        manifest_size = versions_->ManifestFileSize();
+        if (versions_->PrevLogNumber() != 0) {
+            log_numbers.push_back(versions_->PrevLogNumber());
+        }
+        log_numbers.push_back(versions_->LogNumber());
+        if (logfile_number_ != versions_->LogNumber()) {
+            log_numbers.push_back(logfile_number_);
+        }
+    }
+
+    for (size_t i = 0; i < table_numbers.size() && s.ok(); i++) {
+        s = LinkOrCopyFile(env_, TableFileName(dbname_, table_numbers[i]),
+                           TableFileName(dir, table_numbers[i]));
+    }
+    for (size_t i = 0; i < blob_numbers.size() && s.ok(); i++) {
+        s = LinkOrCopyFile(env_, BlobFileName(dbname_, blob_numbers[i]),
+                           BlobFileName(dir, blob_numbers[i]));
+    }
+    if (s.ok()) {
+        s = CopyFilePrefix(env_, DescriptorFileName(dbname_, manifest_number),
+                           DescriptorFileName(dir, manifest_number),
+                           manifest_size);
+    }
+    for (size_t i = 0; i < log_numbers.size() && s.ok(); i++) {
+        s = CopyFile(env_, LogFileName(dbname_, log_numbers[i]),
+                     LogFileName(dir, log_numbers[i]));
+    }
+    if (s.ok()) {
+        s = SetCurrentFile(env_, dir, manifest_number);
+    }
+
+    {
+        MutexLock l(&mutex_);
+        file_deletions_paused_--;
+        RemoveObsoleteFiles();
+    }
+
+    if (!s.ok()) {
+        std::vector<std::string> filenames;
+        env_->GetChildren(dir, &filenames); // Ignoring errors on purpose
+        for (const std::string& filename : filenames) {
+            env_->RemoveFile(dir + "/" + filename);
+        }
+        env_->RemoveDir(dir);
+    }
+    return s;
+}
+
+Status DBImpl::TryCatchUpWithPrimary() {
+    if (!secondary_) {
+        return Status::NotSupported("TryCatchUpWithPrimary",
+                                    "not a secondary instance");
+    }
+    MutexLock l(&mutex_);
+    return CatchUpWithPrimary();
+}
+
+Status DBImpl::CatchUpWithPrimary() {
+    mutex_.AssertHeld();
+    // A live log that is gone by the time it is read was flushed by the
+    // primary after the MANIFEST was read.  Skipping it would expose the
+    // writes of newer logs without its own, so the MANIFEST is read again
+    // and the memtable rebuilt from the logs that are still live.
+    static const int kMaxAttempts = 10;
+    bool rebuild = (mem_ == nullptr);
+    for (int attempt = 0; attempt < kMaxAttempts; attempt++) {
+        const uint64_t old_log_number = versions_->LogNumber();
+        Status s = versions_->TailManifest();
+        if (!s.ok()) {
+            return s;
+        }
+
+        // Once the primary has flushed its older logs, their writes are
+        // read from tables, and the memtable only needs the records of the
+        // newer logs, which are read again from the start.
+        if (rebuild || versions_->LogNumber() != old_log_number) {
+            if (mem_ != nullptr) {
+                mem_->Unref();
+            }
+            mem_ = new MemTable(internal_comparator_);
+            mem_->Ref();
+            primary_log_offsets_.clear();
+        }
+
+        std::vector<std::string> filenames;
+        s = env_->GetChildren(dbname_, &filenames);
+        if (!s.ok()) {
+            return s;
+        }
+        std::vector<uint64_t> logs;
+        uint64_t number;
+        FileType type;
+        for (const std::string& filename : filenames) {
+            if (ParseFileName(filename, &number, &type) && type == kLogFile &&
+                (number >= versions_->LogNumber() ||
+                 number == versions_->PrevLogNumber())) {
+                logs.push_back(number);
+            }
+        }
+        std::sort(logs.begin(), logs.end());
+
+        SequenceNumber max_sequence = versions_->LastSequence();
+        for (size_t i = 0; i < logs.size() && s.ok(); i++) {
+            s = ReadPrimaryLog(logs[i], &max_sequence);
+        }
+        if (s.IsNotFound()) {
+            rebuild = true;
+            continue;
+        }
+        // Reads see the new records only once they are all in the memtable.
+        if (s.ok() && max_sequence > versions_->LastSequence()) {
+            versions_->SetLastSequence(max_sequence);
+        }
+        return s;
+    }
+    return Status::IOError(dbname_, "primary keeps deleting its logs");
+}
+
+Status DBImpl::ReadPrimaryLog(uint64_t log_number,
+                              SequenceNumber* max_sequence) {
+    struct LogReporter : public log::Reader::Reporter {
+        Status* status;
+        void Corruption(size_t bytes, const Status& s) override {
+            if (this->status->ok())
+                *this->status = s;
+        }
+    };
+
+    mutex_.AssertHeld();
+    SequentialFile* file;
+    Status s = env_->NewSequentialFile(LogFileName(dbname_, log_number), &file);
+    if (!s.ok()) {
+        return s;
+    }
+
+    // A record that is still being written reads as the end of the log,
+    // and is added by a later call.
+    uint64_t& offset = primary_log_offsets_[log_number];
+    LogReporter reporter;
+    reporter.status = &s;
+    log::Reader reader(file, &reporter, true /*checksum*/, offset);
+    Slice record;
+    std::string scratch;
+    WriteBatch batch;
+    while (reader.ReadRecord(&record, &scratch) && s.ok()) {
+        if (record.size() < 12) {
+            s = Status::Corruption("log record too small");
+            break;
+        }
+        WriteBatchInternal::SetContents(&batch, record);
+        s = WriteBatchInternal::InsertInto(&batch, mem_);
+        if (!s.ok()) {
+            break;
+        }
+        const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                        WriteBatchInternal::Count(&batch) - 1;
+        if (last_seq > *max_sequence) {
+            *max_sequence = last_seq;
+        }
+        offset = reader.LastRecordEndOffset();
+    }
+    delete file;
+    return s;
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value) {
     value->clear();
 
@@ -1512,8 +2692,95 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
     return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin,
+                       const Slice& end) {
+    WriteBatch batch;
+    batch.DeleteRange(begin, end);
+    return Write(opt, &batch);
+}
+
+Status DB::Merge(const WriteOptions& opt, const Slice& key,
+                 const Slice& value) {
+    WriteBatch batch;
+    batch.Merge(key, value);
+    return Write(opt, &batch);
+}
+
+Status DB::TryCatchUpWithPrimary() {
+    return Status::NotSupported("TryCatchUpWithPrimary");
+}
+
 DB::~DB() = default;
 
+namespace {
+
+// Opens tables on several threads for DBImpl::PreloadTables().
+struct TablePreloader {
+    TablePreloader(TableCache* cache, std::vector<FileMetaData*> files)
+        : cache(cache), files(std::move(files)), next(0), cv(&mu),
+          live_threads(0) {}
+
+    static void Run(void* arg) {
+        TablePreloader* p = reinterpret_cast<TablePreloader*>(arg);
+        size_t i;
+        while ((i = p->next.fetch_add(1)) < p->files.size()) {
+            // Failures are left for the reads of the table to report.
+            p->cache->Load(p->files[i]->number, p->files[i]->file_size);
+        }
+        MutexLock l(&p->mu);
+        p->live_threads--;
+        p->cv.SignalAll();
+    }
+
+    TableCache* const cache;
+    const std::vector<FileMetaData*> files;
+    std::atomic<size_t> next; // Index of the next file to open
+    port::Mutex mu;
+    port::CondVar cv;
+    int live_threads GUARDED_BY(mu);
+};
+
+} // namespace
+
+void DBImpl::PreloadTables() {
+    mutex_.AssertHeld();
+    if (options_.table_preload_threads <= 0) {
+        return;
+    }
+    Version* current = versions_->current();
+    std::vector<FileMetaData*> files;
+    current->GetAllFiles(&files);
+    // Opening more tables than the cache holds would evict the first ones.
+    const size_t limit = TableCacheSize(options_);
+    if (files.size() > limit) {
+        files.resize(limit);
+    }
+    if (files.empty()) {
+        return;
+    }
+    const uint64_t start_micros = env_->NowMicros();
+    current->Ref();
+    mutex_.Unlock();
+    {
+        TablePreloader preloader(table_cache_, files);
+        MutexLock l(&preloader.mu);
+        const int threads = std::min<size_t>(options_.table_preload_threads,
+                                             preloader.files.size());
+        for (int i = 0; i < threads; i++) {
+            preloader.live_threads++;
+            env_->StartThread(&TablePreloader::Run, &preloader);
+        }
+        while (preloader.live_threads > 0) {
+            preloader.cv.Wait();
+        }
+    }
+    mutex_.Lock();
+    current->Unref();
+    Log(options_.info_log, "Preloaded %d tables in %llu us",
+        static_cast<int>(files.size()),
+        static_cast<unsigned long long>(env_->NowMicros() - start_micros));
+}
+
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     *dbptr = nullptr;
 
@@ -1531,9 +2798,9 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
                                          &lfile);
         if (s.ok()) {
             edit.SetLogNumber(new_log_number);
-            impl->logfile_ = lfile;
+            impl->logfile_ = PaceLogFile(impl->options_, lfile, 0);
             impl->logfile_number_ = new_log_number;
-            impl->log_ = new log::Writer(lfile);
+            impl->log_ = NewLogWriter(impl->options_, impl->logfile_, 0);
             impl->mem_ = new MemTable(impl->internal_comparator_);
             impl->mem_->Ref();
         }
@@ -1545,6 +2812,7 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     }
     if (s.ok()) {
         impl->RemoveObsoleteFiles();
+        impl->PreloadTables();
         impl->MaybeScheduleCompaction();
     }
     impl->mutex_.Unlock();
@@ -1557,6 +2825,28 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     return s;
 }
 
+Status DB::OpenAsSecondary(const Options& options, const std::string& dbname,
+                           const std::string& secondary_path, DB** dbptr) {
+    *dbptr = nullptr;
+    if (secondary_path.empty()) {
+        return Status::InvalidArgument("empty secondary path");
+    }
+    if (!options.env->FileExists(CurrentFileName(dbname))) {
+        return Status::InvalidArgument(dbname, "does not exist");
+    }
+
+    DBImpl* impl = new DBImpl(options, dbname, secondary_path);
+    impl->mutex_.Lock();
+    Status s = impl->CatchUpWithPrimary();
+    impl->mutex_.Unlock();
+    if (s.ok()) {
+        *dbptr = impl;
+    } else {
+        delete impl;
+    }
+    return s;
+}
+
 Snapshot::~Snapshot() = default;
 
 Status DestroyDB(const std::string& dbname, const Options& options) {
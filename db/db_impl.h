@@ -8,6 +8,7 @@
 #include "db/snapshot.h"
 #include <atomic>
 #include <deque>
+#include <map>
 #include <set>
 #include <string>
 
@@ -19,7 +20,11 @@
 
 namespace mydb {
 
+struct BlobIndex;
+struct FileMetaData;
+class CompressionPool;
 class MemTable;
+class RangeTombstoneList;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -27,7 +32,10 @@ class VersionSet;
 
 class DBImpl : public DB {
   public:
-    DBImpl(const Options& options, const std::string& dbname);
+    // A non-empty "secondary_path" makes this a secondary instance (see
+    // DB::OpenAsSecondary) that keeps its info log there.
+    DBImpl(const Options& options, const std::string& dbname,
+           const std::string& secondary_path = std::string());
 
     DBImpl(const DBImpl&) = delete;
     DBImpl& operator=(const DBImpl&) = delete;
@@ -38,6 +46,10 @@ class DBImpl : public DB {
     Status Put(const WriteOptions&, const Slice& key,
                const Slice& value) override;
     Status Delete(const WriteOptions&, const Slice& key) override;
+    Status DeleteRange(const WriteOptions&, const Slice& begin,
+                       const Slice& end) override;
+    Status Merge(const WriteOptions&, const Slice& key,
+                 const Slice& value) override;
     Status Write(const WriteOptions& options, WriteBatch* updates) override;
     Status Get(const ReadOptions& options, const Slice& key,
                std::string* value) override;
@@ -48,6 +60,11 @@ class DBImpl : public DB {
     void GetApproximateSizes(const Range* range, int n,
                              uint64_t* sizes) override;
     void CompactRange(const Slice* begin, const Slice* end) override;
+    Status IngestExternalFile(
+        const std::vector<std::string>& paths,
+        const IngestExternalFileOptions& options) override;
+    Status CreateCheckpoint(const std::string& dir) override;
+    Status TryCatchUpWithPrimary() override;
 
     // Extra methods (for testing) that are not in the public DB interface
 
@@ -71,9 +88,15 @@ class DBImpl : public DB {
     // bytes.
     void RecordReadSample(Slice key);
 
+    // Read the value that the encoded BlobIndex "blob_index" refers to into
+    // *value.  The caller must hold a reference to a version that contains
+    // the blob file.
+    Status GetBlob(const Slice& blob_index, std::string* value);
+
   private:
     friend class DB;
     struct CompactionState;
+    struct RecoveryFlusher;
     struct Writer;
 
     // Information for a manual compaction
@@ -101,9 +124,13 @@ class DBImpl : public DB {
         int64_t bytes_written;
     };
 
+    // If tombstones is non-null, also sets *tombstones to the finished list
+    // of range tombstones in the state the iterator reads, or to nullptr if
+    // there are none.  The caller owns the list.
     Iterator* NewInternalIterator(const ReadOptions&,
                                   SequenceNumber* latest_snapshot,
-                                  uint32_t* seed);
+                                  uint32_t* seed,
+                                  RangeTombstoneList** tombstones = nullptr);
 
     Status NewDB();
 
@@ -128,11 +155,34 @@ class DBImpl : public DB {
                           SequenceNumber* max_sequence)
         EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+    // Writes the memtables filled by RecoverLogFile() to level-0.
+    static void RecoveryFlushThread(void* arg);
+
+    // Open the tables of the current version on
+    // options_.table_preload_threads threads (see Options).
+    void PreloadTables() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
     Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
         EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+    // Return the options for building a table in "level".  "bottommost"
+    // is true if no level below "level" holds any data.
+    Options TableOptions(int level, bool bottommost) const;
+
     Status MakeRoomForWrite(bool force /* compact even if there is room? */)
         EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+    // Apply the primary's new MANIFEST edits to a secondary instance, and
+    // add the new records of the primary's live logs to mem_.
+    Status CatchUpWithPrimary() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    // Add the records that the primary appended to log "log_number" since
+    // the last call to mem_, and raise *max_sequence to the last sequence
+    // number they use.  Returns NotFound if the primary deleted the log.
+    Status ReadPrimaryLog(uint64_t log_number, SequenceNumber* max_sequence)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+    // Fill in the size and key range of an external table to ingest.
+    Status ReadExternalFile(const std::string& path, FileMetaData* meta);
     WriteBatch* BuildBatchGroup(Writer** last_writer)
         EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -148,8 +198,38 @@ class DBImpl : public DB {
         EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
     Status OpenCompactionOutputFile(CompactionState* compact);
+    // Add an entry to the current output, opening one if necessary.  Large
+    // values and values in blob files being garbage collected are written
+    // to the current blob output.
+    Status AddToCompactionOutput(CompactionState* compact, const Slice& key,
+                                 const Slice& value);
+    // Append "value" to the current blob output, opening one if necessary,
+    // and store its location in *index.
+    Status AddToCompactionBlobFile(CompactionState* compact,
+                                   const Slice& value, BlobIndex* index);
+    Status FinishCompactionBlobFile(CompactionState* compact);
+    // Add a value that no snapshot sees to the current output, after
+    // passing it through Options::compaction_filter.  "type" is
+    // kTypeValue, or kTypeBlobIndex if "value" refers to a blob.
+    Status AddValueToCompactionOutput(CompactionState* compact,
+                                      const Slice& user_key,
+                                      SequenceNumber sequence, ValueType type,
+                                      const Slice& value);
+    // *input is at the newest merge operand for its key that every snapshot
+    // sees.  Consume it and the older entries it can be combined with, and
+    // write the result, passing a full merge result through
+    // Options::compaction_filter if "filter" is true, i.e. if no snapshot
+    // sees the newest operand.  Sets
+    // *last_sequence_for_key to the oldest entry consumed.
+    Status MergeCompactionOperands(CompactionState* compact, Iterator* input,
+                                   const RangeTombstoneList& tombstones,
+                                   bool filter,
+                                   SequenceNumber* last_sequence_for_key);
+    // Finish the current output, whose key range ends before the user key
+    // *upper_bound, or is unbounded if upper_bound is nullptr.
     Status FinishCompactionOutputFile(CompactionState* compact,
-                                      Iterator* input);
+                                      Iterator* input,
+                                      const Slice* upper_bound);
     Status InstallCompactionResults(CompactionState* compact)
         EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -165,10 +245,15 @@ class DBImpl : public DB {
     const bool owns_info_log_;
     const bool owns_cache_;
     const std::string dbname_;
+    const bool secondary_; // Following another process's writes?
 
     // table_cache_ provides its own synchronization
     TableCache* const table_cache_;
 
+    // Compresses the data blocks of the tables written by flushes and
+    // compactions.  nullptr unless options_.compression_threads > 1.
+    CompressionPool* const compression_pool_;
+
     // Lock over the persistent DB state.  Non-null iff successfully acquired.
     FileLock* db_lock_;
 
@@ -197,6 +282,17 @@ class DBImpl : public DB {
     // Has a background compaction been scheduled or is running?
     bool background_compaction_scheduled_ GUARDED_BY(mutex_);
 
+    // Is IngestExternalFile() holding off background compactions?
+    bool ingesting_ GUARDED_BY(mutex_);
+
+    // Number of CreateCheckpoint() calls holding off the deletion of
+    // obsolete files.
+    int file_deletions_paused_ GUARDED_BY(mutex_);
+
+    // For a secondary instance, the length of the prefix of each of the
+    // primary's live logs that has been added to mem_.
+    std::map<uint64_t, uint64_t> primary_log_offsets_ GUARDED_BY(mutex_);
+
     ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
     VersionSet* const versions_ GUARDED_BY(mutex_);
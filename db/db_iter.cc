@@ -5,6 +5,8 @@
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/merge_context.h"
+#include "db/range_tombstone.h"
 
 #include "mydb/env.h"
 #include "mydb/iterator.h"
@@ -40,30 +42,40 @@ class DBIter : public Iterator {
   public:
     // Which direction is the iterator currently moving?
     // (1) When moving forward, the internal iterator is positioned at
-    //     the exact entry that yields this->key(), this->value()
+    //     the exact entry that yields this->key(), this->value(), unless
+    //     that entry is a merge operand: then the entries combined into
+    //     this->value() have been consumed and the internal iterator is
+    //     positioned at or after the first entry not merged.
     // (2) When moving backwards, the internal iterator is positioned
     //     just before all entries whose user key == this->key().
     enum Direction { kForward, kReverse };
 
     DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-           uint32_t seed)
+           uint32_t seed, RangeTombstoneList* tombstones,
+           const MergeOperator* merge_operator)
         : db_(db), user_comparator_(cmp), iter_(iter), sequence_(s),
-          direction_(kForward), valid_(false), rnd_(seed),
+          tombstones_(tombstones), merge_context_(merge_operator),
+          direction_(kForward), merged_(false), valid_(false), rnd_(seed),
           bytes_until_read_sampling_(RandomCompactionPeriod()) {}
 
     DBIter(const DBIter&) = delete;
     DBIter& operator=(const DBIter&) = delete;
 
-    ~DBIter() override { delete iter_; }
+    ~DBIter() override {
+        delete iter_;
+        delete tombstones_;
+    }
     bool Valid() const override { return valid_; }
     Slice key() const override {
         assert(valid_);
-        return (direction_ == kForward) ? ExtractUserKey(iter_->key())
-                                        : saved_key_;
+        return (direction_ == kForward && !merged_)
+                   ? ExtractUserKey(iter_->key())
+                   : saved_key_;
     }
     Slice value() const override {
         assert(valid_);
-        return (direction_ == kForward) ? iter_->value() : saved_value_;
+        return (direction_ == kForward && !merged_) ? iter_->value()
+                                                    : saved_value_;
     }
     Status status() const override {
         if (status_.ok()) {
@@ -82,8 +94,17 @@ class DBIter : public Iterator {
   private:
     void FindNextUserEntry(bool skipping, std::string* skip);
     void FindPrevUserEntry();
+    void MergeOlderEntries();
+    void ReadBlobValue();
     bool ParseKey(ParsedInternalKey* key);
 
+    // Is the entry a value hidden by a range tombstone?
+    bool IsCovered(const ParsedInternalKey& ikey) const {
+        return tombstones_ != nullptr &&
+               ikey.sequence <
+                   tombstones_->MaxCoveringSequence(ikey.user_key, sequence_);
+    }
+
     inline void SaveKey(const Slice& k, std::string* dst) {
         dst->assign(k.data(), k.size());
     }
@@ -107,10 +128,15 @@ class DBIter : public Iterator {
     const Comparator* const user_comparator_;
     Iterator* const iter_;
     SequenceNumber const sequence_;
+    RangeTombstoneList* const tombstones_;
+    MergeContext merge_context_;
     Status status_;
     std::string saved_key_;   // == current key when direction_==kReverse
     std::string saved_value_; // == current raw value when direction_==kReverse
     Direction direction_;
+    // Forward, and saved_key_/saved_value_ hold the entry: the result of a
+    // merge, or a value read from a blob file.
+    bool merged_;
     bool valid_;
     Random rnd_;
     size_t bytes_until_read_sampling_;
@@ -154,6 +180,14 @@ void DBIter::Next() {
             return;
         }
         // saved_key_ already contains the key to skip past.
+    } else if (merged_) {
+        // iter_ is already past the operands merged into this->value(),
+        // and saved_key_ contains the key to skip past.
+        if (!iter_->Valid()) {
+            valid_ = false;
+            saved_key_.clear();
+            return;
+        }
     } else {
         // Store in saved_key_ the current key so we skip it below.
         SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
@@ -175,6 +209,7 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
     // Loop until we hit an acceptable entry to yield
     assert(iter_->Valid());
     assert(direction_ == kForward);
+    merged_ = false;
     do {
         ParsedInternalKey ikey;
         if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
@@ -189,12 +224,46 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
                 if (skipping &&
                     user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
                     // Entry hidden
+                } else if (IsCovered(ikey)) {
+                    // Deleted by a range tombstone; older entries for this
+                    // key are covered too.
+                    SaveKey(ikey.user_key, skip);
+                    skipping = true;
                 } else {
                     valid_ = true;
                     saved_key_.clear();
                     return;
                 }
                 break;
+            case kTypeBlobIndex:
+                if (skipping &&
+                    user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+                    // Entry hidden
+                } else if (IsCovered(ikey)) {
+                    SaveKey(ikey.user_key, skip);
+                    skipping = true;
+                } else {
+                    SaveKey(ikey.user_key, &saved_key_);
+                    ReadBlobValue();
+                    return;
+                }
+                break;
+            case kTypeMerge:
+                if (skipping &&
+                    user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+                    // Entry hidden
+                } else if (IsCovered(ikey)) {
+                    SaveKey(ikey.user_key, skip);
+                    skipping = true;
+                } else {
+                    SaveKey(ikey.user_key, &saved_key_);
+                    MergeOlderEntries();
+                    return;
+                }
+                break;
+            case kTypeRangeDeletion:
+                // Range tombstones are not part of the internal iterator.
+                break;
             }
         }
         iter_->Next();
@@ -203,14 +272,84 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
     valid_ = false;
 }
 
+void DBIter::ReadBlobValue() {
+    // iter_ is at the blob index of the entry for saved_key_.  Read the
+    // value and move past the index, as after a merge.
+    Status s = db_->GetBlob(iter_->value(), &saved_value_);
+    if (!s.ok()) {
+        status_ = s;
+        valid_ = false;
+        return;
+    }
+    iter_->Next();
+    merged_ = true;
+    valid_ = true;
+}
+
+void DBIter::MergeOlderEntries() {
+    // iter_ is at the newest visible operand for saved_key_.  Collect the
+    // operands below it down to the value (or deletion) they apply to.
+    merge_context_.Clear();
+    merge_context_.AddOlderOperand(iter_->value());
+    Slice base;
+    std::string blob;
+    bool has_base = false;
+    for (iter_->Next(); iter_->Valid(); iter_->Next()) {
+        ParsedInternalKey ikey;
+        if (!ParseKey(&ikey)) {
+            continue;
+        }
+        if (user_comparator_->Compare(ikey.user_key, saved_key_) != 0) {
+            break;
+        }
+        if (IsCovered(ikey) || ikey.type == kTypeDeletion) {
+            break;
+        } else if (ikey.type == kTypeValue) {
+            base = iter_->value();
+            has_base = true;
+            break;
+        } else if (ikey.type == kTypeBlobIndex) {
+            Status s = db_->GetBlob(iter_->value(), &blob);
+            if (!s.ok()) {
+                merge_context_.Clear();
+                status_ = s;
+                valid_ = false;
+                return;
+            }
+            base = blob;
+            has_base = true;
+            break;
+        }
+        merge_context_.AddOlderOperand(iter_->value());
+    }
+
+    // Any entries left for saved_key_ are skipped by the next Next().
+    Status s = merge_context_.Merge(saved_key_, has_base ? &base : nullptr,
+                                    &saved_value_);
+    merge_context_.Clear();
+    if (!s.ok()) {
+        status_ = s;
+        valid_ = false;
+        return;
+    }
+    merged_ = true;
+    valid_ = true;
+}
+
 void DBIter::Prev() {
     assert(valid_);
 
     if (direction_ == kForward) { // Switch directions?
         // iter_ is pointing at the current entry.  Scan backwards until
         // the key changes so we can use the normal reverse scanning code.
-        assert(iter_->Valid()); // Otherwise valid_ would have been false
-        SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+        if (!merged_) {
+            assert(iter_->Valid()); // Otherwise valid_ would have been false
+            SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+        } else if (!iter_->Valid()) {
+            // The merge consumed the last entries; saved_key_ holds the key.
+            iter_->SeekToLast();
+        }
+        merged_ = false;
         while (true) {
             iter_->Prev();
             if (!iter_->Valid()) {
@@ -234,6 +373,9 @@ void DBIter::FindPrevUserEntry() {
     assert(direction_ == kReverse);
 
     ValueType value_type = kTypeDeletion;
+    bool has_base = false; // Does saved_value_ hold a value to merge into?
+    bool base_is_blob = false; // Is that value a blob index?
+    merge_context_.Clear();
     if (iter_->Valid()) {
         do {
             ParsedInternalKey ikey;
@@ -244,11 +386,22 @@ void DBIter::FindPrevUserEntry() {
                     // previous keys,
                     break;
                 }
-                value_type = ikey.type;
+                const ValueType previous_type = value_type;
+                value_type = IsCovered(ikey) ? kTypeDeletion : ikey.type;
                 if (value_type == kTypeDeletion) {
                     saved_key_.clear();
                     ClearSavedValue();
+                    merge_context_.Clear();
+                } else if (value_type == kTypeMerge) {
+                    if (previous_type == kTypeDeletion) {
+                        has_base = false;
+                    }
+                    SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+                    merge_context_.AddNewerOperand(iter_->value());
                 } else {
+                    has_base = true;
+                    base_is_blob = (value_type == kTypeBlobIndex);
+                    merge_context_.Clear();
                     Slice raw_value = iter_->value();
                     if (saved_value_.capacity() > raw_value.size() + 1048576) {
                         std::string empty;
@@ -262,6 +415,28 @@ void DBIter::FindPrevUserEntry() {
         } while (iter_->Valid());
     }
 
+    if (value_type != kTypeDeletion && has_base && base_is_blob) {
+        // Only the value that is returned is read from its blob file.
+        std::string blob_index;
+        blob_index.swap(saved_value_);
+        Status s = db_->GetBlob(blob_index, &saved_value_);
+        if (!s.ok()) {
+            status_ = s;
+            value_type = kTypeDeletion;
+        }
+    }
+
+    if (value_type == kTypeMerge) {
+        Slice base(saved_value_);
+        Status s = merge_context_.Merge(saved_key_, has_base ? &base : nullptr,
+                                        &saved_value_);
+        merge_context_.Clear();
+        if (!s.ok()) {
+            status_ = s;
+            value_type = kTypeDeletion;
+        }
+    }
+
     if (value_type == kTypeDeletion) {
         // End
         valid_ = false;
@@ -275,6 +450,7 @@ void DBIter::FindPrevUserEntry() {
 
 void DBIter::Seek(const Slice& target) {
     direction_ = kForward;
+    merged_ = false;
     ClearSavedValue();
     saved_key_.clear();
     AppendInternalKey(&saved_key_,
@@ -289,6 +465,7 @@ void DBIter::Seek(const Slice& target) {
 
 void DBIter::SeekToFirst() {
     direction_ = kForward;
+    merged_ = false;
     ClearSavedValue();
     iter_->SeekToFirst();
     if (iter_->Valid()) {
@@ -300,6 +477,7 @@ void DBIter::SeekToFirst() {
 
 void DBIter::SeekToLast() {
     direction_ = kReverse;
+    merged_ = false;
     ClearSavedValue();
     iter_->SeekToLast();
     FindPrevUserEntry();
@@ -309,8 +487,10 @@ void DBIter::SeekToLast() {
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-    return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        uint32_t seed, RangeTombstoneList* tombstones,
+                        const MergeOperator* merge_operator) {
+    return new DBIter(db, user_key_comparator, internal_iter, sequence, seed,
+                      tombstones, merge_operator);
 }
 
 } // namespace mydb
@@ -11,13 +11,19 @@
 namespace mydb {
 
 class DBImpl;
+class MergeOperator;
+class RangeTombstoneList;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Values hidden by one of the finished
+// "*tombstones", which may be nullptr, are skipped.  The iterator takes
+// ownership of "*tombstones".  Merge operands are combined with
+// "*merge_operator".
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed, RangeTombstoneList* tombstones,
+                        const MergeOperator* merge_operator);
 
 } // namespace mydb
 
@@ -8,15 +8,22 @@
 #include "db/write_batch_internal.h"
 #include <atomic>
 #include <cinttypes>
+#include <map>
+#include <set>
 #include <string>
 
 #include "mydb/cache.h"
+#include "mydb/compaction_filter.h"
 #include "mydb/env.h"
 #include "mydb/filter_policy.h"
+#include "mydb/merge_operator.h"
+#include "mydb/rate_limiter.h"
+#include "mydb/sst_file_writer.h"
 #include "mydb/table.h"
 
 #include "port/port.h"
 #include "port/thread_annotations.h"
+#include "util/coding.h"
 #include "util/hash.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -40,6 +47,76 @@ static std::string RandomKey(Random* rnd) {
 }
 
 namespace {
+// Appends operands to the value, separated by commas.
+class AppendOperator : public MergeOperator {
+  public:
+    const char* Name() const override { return "test.AppendOperator"; }
+    bool FullMerge(const Slice& key, const Slice* existing_value,
+                   const std::vector<Slice>& operands,
+                   std::string* new_value) const override {
+        new_value->clear();
+        if (existing_value != nullptr) {
+            new_value->assign(existing_value->data(), existing_value->size());
+        }
+        for (const Slice& operand : operands) {
+            if (!new_value->empty()) {
+                new_value->push_back(',');
+            }
+            new_value->append(operand.data(), operand.size());
+        }
+        return true;
+    }
+};
+
+// Adds decimal operands to a decimal value.  Operands may be combined.
+class CounterOperator : public MergeOperator {
+  public:
+    const char* Name() const override { return "test.CounterOperator"; }
+    bool FullMerge(const Slice& key, const Slice* existing_value,
+                   const std::vector<Slice>& operands,
+                   std::string* new_value) const override {
+        uint64_t sum = existing_value != nullptr ? Parse(*existing_value) : 0;
+        for (const Slice& operand : operands) {
+            sum += Parse(operand);
+        }
+        *new_value = NumberToString(sum);
+        return true;
+    }
+    bool PartialMerge(const Slice& key, const Slice& left_operand,
+                      const Slice& right_operand,
+                      std::string* new_value) const override {
+        *new_value = NumberToString(Parse(left_operand) + Parse(right_operand));
+        return true;
+    }
+
+  private:
+    static uint64_t Parse(Slice s) {
+        uint64_t v = 0;
+        ConsumeDecimalNumber(&s, &v);
+        return v;
+    }
+};
+
+// Removes values of keys starting with "drop" and upper-cases values of
+// keys starting with "up".
+class TestCompactionFilter : public CompactionFilter {
+  public:
+    const char* Name() const override { return "test.CompactionFilter"; }
+    Decision Filter(int level, const Slice& key, const Slice& existing_value,
+                    std::string* new_value) const override {
+        if (key.starts_with("drop")) {
+            return kRemove;
+        } else if (key.starts_with("up")) {
+            *new_value = existing_value.ToString();
+            for (size_t i = 0; i < new_value->size(); i++) {
+                (*new_value)[i] = toupper((*new_value)[i]);
+            }
+            return kChangeValue;
+        }
+        return kKeep;
+    }
+};
+
 class AtomicCounter {
   public:
     AtomicCounter() : count_(0) {}
@@ -305,6 +382,9 @@ class DBTest : public testing::Test {
         case kUncompressed:
             options.compression = kNoCompression;
             break;
+        case kBlobFiles:
+            options.min_blob_size = 1;
+            break;
         default:
             break;
         }
@@ -422,6 +502,14 @@ class DBTest : public testing::Test {
                     case kTypeDeletion:
                         result += "DEL";
                         break;
+                    case kTypeMerge:
+                        result += "MERGE " + iter->value().ToString();
+                        break;
+                    case kTypeBlobIndex:
+                        result += "BLOB";
+                        break;
+                    case kTypeRangeDeletion:
+                        break;
                     }
                 }
                 iter->Next();
@@ -450,6 +538,18 @@ class DBTest : public testing::Test {
         return result;
     }
 
+    // Return the number of sorted runs seen by a tiered compaction: each
+    // level-0 file and each non-empty level.
+    int NumSortedRuns() {
+        int result = NumTableFilesAtLevel(0);
+        for (int level = 1; level < config::kNumLevels; level++) {
+            if (NumTableFilesAtLevel(level) > 0) {
+                result++;
+            }
+        }
+        return result;
+    }
+
     // Return spread of files per level
     std::string FilesPerLevel() {
         std::string result;
@@ -473,6 +573,21 @@ class DBTest : public testing::Test {
         return static_cast<int>(files.size());
     }
 
+    // Return the numbers of the blob files in the database directory.
+    std::set<uint64_t> BlobFileNumbers() {
+        std::vector<std::string> files;
+        env_->GetChildren(dbname_, &files);
+        std::set<uint64_t> result;
+        uint64_t number;
+        FileType type;
+        for (size_t i = 0; i < files.size(); i++) {
+            if (ParseFileName(files[i], &number, &type) && type == kBlobFile) {
+                result.insert(number);
+            }
+        }
+        return result;
+    }
+
     uint64_t Size(const Slice& start, const Slice& limit) {
         Range r(start, limit);
         uint64_t size;
@@ -567,7 +682,14 @@ class DBTest : public testing::Test {
 
   private:
     // Sequence of option configurations to try
-    enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+    enum OptionConfig {
+        kDefault,
+        kReuse,
+        kFilter,
+        kUncompressed,
+        kBlobFiles,
+        kEnd
+    };
 
     const FilterPolicy* filter_policy_;
     int option_config_;
@@ -1135,6 +1257,28 @@ TEST_F(DBTest, RecoverWithLargeLog) {
     ASSERT_GT(NumTableFilesAtLevel(0), 1);
 }
 
+TEST_F(DBTest, RecoverWithManyFlushes) {
+    // A log larger than what recovery reads ahead, whose keys are
+    // overwritten in memtables that are flushed while replay goes on.
+    Options options = CurrentOptions();
+    options.write_buffer_size = 100000000;
+    Reopen(&options);
+    Random rnd(301);
+    std::vector<std::string> values(500);
+    for (int i = 0; i < 3000; i++) {
+        values[i % values.size()] = RandomString(&rnd, 2000);
+        ASSERT_MYDB_OK(Put(Key(i % values.size()), values[i % values.size()]));
+    }
+    ASSERT_EQ(0, TotalTableFiles());
+
+    options.write_buffer_size = 100000;
+    Reopen(&options);
+    ASSERT_GT(TotalTableFiles(), 0);
+    for (size_t i = 0; i < values.size(); i++) {
+        ASSERT_EQ(values[i], Get(Key(i)));
+    }
+}
+
 TEST_F(DBTest, CompactionsGenerateMultipleFiles) {
     Options options = CurrentOptions();
     options.write_buffer_size = 100000000; // Large write buffer
@@ -1235,6 +1379,7 @@ TEST_F(DBTest, ApproximateSizes) {
         Options options = CurrentOptions();
         options.write_buffer_size = 100000000; // Large write buffer
         options.compression = kNoCompression;
+        options.min_blob_size = 0; // Keep the values in the tables
         DestroyAndReopen();
 
         ASSERT_TRUE(Between(Size("", "xyz"), 0, 0));
@@ -1296,6 +1441,7 @@ TEST_F(DBTest, ApproximateSizes_MixOfSmallAndLarge) {
     do {
         Options options = CurrentOptions();
         options.compression = kNoCompression;
+        options.min_blob_size = 0; // Keep the values in the tables
         Reopen();
 
         Random rnd(301);
@@ -1390,6 +1536,10 @@ TEST_F(DBTest, Snapshot) {
 
 TEST_F(DBTest, HiddenValuesAreRemoved) {
     do {
+        if (CurrentOptions().min_blob_size > 0) {
+            // The tables hold no values whose size could be checked.
+            continue;
+        }
         Random rnd(301);
         FillLevels("a", "z");
 
@@ -1860,6 +2010,66 @@ TEST_F(DBTest, WriteSyncError) {
     ASSERT_EQ("NOT_FOUND", Get("k3"));
 }
 
+TEST_F(DBTest, ManifestRollover) {
+    Options options = CurrentOptions();
+    options.max_manifest_file_size = 4096;
+    Reopen(&options);
+
+    std::set<std::string> manifests;
+    for (int i = 0; i < 200; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), Key(i)));
+        dbfull()->TEST_CompactMemTable();
+        std::string current;
+        ASSERT_MYDB_OK(
+            ReadFileToString(env_, CurrentFileName(dbname_), &current));
+        manifests.insert(current);
+    }
+    ASSERT_GT(manifests.size(), 2);
+
+    // Replaced MANIFESTs are deleted.
+    std::vector<std::string> filenames;
+    ASSERT_MYDB_OK(env_->GetChildren(dbname_, &filenames));
+    int manifest_files = 0;
+    uint64_t number;
+    FileType type;
+    for (const std::string& filename : filenames) {
+        if (ParseFileName(filename, &number, &type) &&
+            type == kDescriptorFile) {
+            manifest_files++;
+        }
+    }
+    ASSERT_EQ(1, manifest_files);
+
+    Reopen(&options);
+    for (int i = 0; i < 200; i++) {
+        ASSERT_EQ(Key(i), Get(Key(i)));
+    }
+}
+
+TEST_F(DBTest, ManifestRolloverWriteError) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.max_manifest_file_size = 1; // Every edit replaces the MANIFEST
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("foo", "bar"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_MYDB_OK(Put("baz", "qux"));
+
+    // The new MANIFEST cannot be written; the old one stays current.
+    env_->manifest_write_error_.store(true, std::memory_order_release);
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("bar", Get("foo"));
+    env_->manifest_write_error_.store(false, std::memory_order_release);
+
+    Reopen(&options);
+    ASSERT_EQ("bar", Get("foo"));
+    ASSERT_EQ("qux", Get("baz"));
+    ASSERT_MYDB_OK(Put("foo", "v2"));
+    dbfull()->TEST_CompactMemTable();
+    Reopen(&options);
+    ASSERT_EQ("v2", Get("foo"));
+}
+
 TEST_F(DBTest, ManifestWriteError) {
     // Test for the following problem:
     // (a) Compaction produces file F
@@ -1994,138 +2204,1265 @@ TEST_F(DBTest, BloomFilter) {
     delete options.filter_policy;
 }
 
-TEST_F(DBTest, LogCloseError) {
-    // Regression test for bug where we could ignore log file
-    // Close() error when switching to a new log file.
-    const int kValueSize = 20000;
-    const int kWriteCount = 10;
-    const int kWriteBufferSize = (kValueSize * kWriteCount) / 2;
-
+TEST_F(DBTest, PreloadTables) {
     Options options = CurrentOptions();
     options.env = env_;
-    options.write_buffer_size = kWriteBufferSize; // Small write buffer
+    options.block_cache = NewLRUCache(0); // Prevent cache hits
     Reopen(&options);
-    env_->log_file_close_.store(true, std::memory_order_release);
+    const int kTables = 5;
+    for (int i = 0; i < kTables; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), "v"));
+        dbfull()->TEST_CompactMemTable();
+    }
 
-    std::string value(kValueSize, 'x');
-    Status s;
-    for (int i = 0; i < kWriteCount && s.ok(); i++) {
-        s = Put(Key(i), value);
+    // Without preloading, the first read of each table also reads its
+    // footer and index.
+    env_->count_random_reads_ = true;
+    Reopen(&options);
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < kTables; i++) {
+        ASSERT_EQ("v", Get(Key(i)));
     }
-    ASSERT_TRUE(!s.ok()) << "succeeded even after log file Close failure";
+    ASSERT_GT(env_->random_read_counter_.Read(), kTables);
 
-    // Future writes should also fail after an earlier error.
-    s = Put("hello", "world");
-    ASSERT_TRUE(!s.ok()) << "write succeeded after log file Close failure";
+    options.table_preload_threads = 3;
+    Reopen(&options);
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < kTables; i++) {
+        ASSERT_EQ("v", Get(Key(i)));
+    }
+    ASSERT_EQ(kTables, env_->random_read_counter_.Read());
 
-    env_->log_file_close_.store(false, std::memory_order_release);
+    Close();
+    delete options.block_cache;
 }
 
-// Multi-threaded test:
-namespace {
-
-static const int kNumThreads = 4;
-static const int kTestSeconds = 10;
-static const int kNumKeys = 1000;
-
-struct MTState {
-    DBTest* test;
-    std::atomic<bool> stop;
-    std::atomic<int> counter[kNumThreads];
-    std::atomic<bool> thread_done[kNumThreads];
-};
+TEST_F(DBTest, PartitionedIndexAndFilters) {
+    env_->count_random_reads_ = true;
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.block_cache = NewLRUCache(8 << 20);
+    options.filter_policy = NewBloomFilterPolicy(10);
+    options.partition_index_and_filters = true;
+    options.metadata_block_size = 256;
+    Reopen(&options);
 
-struct MTThread {
-    MTState* state;
-    int id;
-};
+    const int N = 10000;
+    for (int i = 0; i < N; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), Key(i)));
+    }
+    Compact("a", "z");
+    for (int i = 0; i < N; i += 100) {
+        ASSERT_MYDB_OK(Put(Key(i), Key(i) + "v2"));
+    }
+    dbfull()->TEST_CompactMemTable();
 
-static void MTThreadBody(void* arg) {
-    MTThread* t = reinterpret_cast<MTThread*>(arg);
-    int id = t->id;
-    DB* db = t->state->test->db_;
-    int counter = 0;
-    std::fprintf(stderr, "... starting thread %d\n", id);
-    Random rnd(1000 + id);
-    std::string value;
-    char valbuf[1500];
-    while (!t->state->stop.load(std::memory_order_acquire)) {
-        t->state->counter[id].store(counter, std::memory_order_release);
+    // Prevent auto compactions triggered by seeks
+    env_->delay_data_sync_.store(true, std::memory_order_release);
 
-        int key = rnd.Uniform(kNumKeys);
-        char keybuf[20];
-        std::snprintf(keybuf, sizeof(keybuf), "%016d", key);
+    for (int i = 0; i < N; i++) {
+        ASSERT_EQ(i % 100 == 0 ? Key(i) + "v2" : Key(i), Get(Key(i)));
+    }
 
-        if (rnd.OneIn(2)) {
-            // Write values of the form <key, my id, counter>.
-            // We add some padding for force compactions.
-            std::snprintf(valbuf, sizeof(valbuf), "%d.%d.%-1000d", key, id,
-                          static_cast<int>(counter));
-            ASSERT_MYDB_OK(
-                db->Put(WriteOptions(), Slice(keybuf), Slice(valbuf)));
-        } else {
-            // Read a value and verify that it matches the pattern written
-            // above.
-            Status s = db->Get(ReadOptions(), Slice(keybuf), &value);
-            if (s.IsNotFound()) {
-                // Key has not yet been written
-            } else {
-                // Check that the writer thread counter is >= the counter in the
-                // value
-                ASSERT_MYDB_OK(s);
-                int k, w, c;
-                ASSERT_EQ(3, sscanf(value.c_str(), "%d.%d.%d", &k, &w, &c))
-                    << value;
-                ASSERT_EQ(k, key);
-                ASSERT_GE(w, 0);
-                ASSERT_LT(w, kNumThreads);
-                ASSERT_LE(c,
-                          t->state->counter[w].load(std::memory_order_acquire));
-            }
-        }
-        counter++;
+    // Missing keys should be rejected by the cached filter partitions
+    // without index or data reads.
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+        ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
     }
-    t->state->thread_done[id].store(true, std::memory_order_release);
-    std::fprintf(stderr, "... stopping thread %d after %d ops\n", id, counter);
-}
+    int reads = env_->random_read_counter_.Read();
+    std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
+    ASSERT_LE(reads, 3 * N / 100);
 
-} // namespace
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        count++;
+    }
+    ASSERT_MYDB_OK(iter->status());
+    ASSERT_EQ(N, count);
+    iter->Seek(Key(5000) + ".missing");
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(Key(5001), iter->key().ToString());
+    delete iter;
 
-TEST_F(DBTest, MultiThreaded) {
-    do {
-        // Initialize state
-        MTState mt;
-        mt.test = this;
-        mt.stop.store(false, std::memory_order_release);
-        for (int id = 0; id < kNumThreads; id++) {
-            mt.counter[id].store(false, std::memory_order_release);
-            mt.thread_done[id].store(false, std::memory_order_release);
-        }
+    env_->delay_data_sync_.store(false, std::memory_order_release);
+    Close();
+    delete options.block_cache;
+    delete options.filter_policy;
+}
 
-        // Start threads
-        MTThread thread[kNumThreads];
-        for (int id = 0; id < kNumThreads; id++) {
-            thread[id].state = &mt;
-            thread[id].id = id;
-            env_->StartThread(MTThreadBody, &thread[id]);
-        }
+TEST_F(DBTest, CacheIndexAndFilterBlocks) {
+    env_->count_random_reads_ = true;
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.block_cache = NewLRUCache(8 << 20, 0.5);
+    options.filter_policy = NewBloomFilterPolicy(10);
+    options.cache_index_and_filter_blocks = true;
+    Reopen(&options);
 
-        // Let them run for a while
-        DelayMilliseconds(kTestSeconds * 1000);
+    const int N = 10000;
+    for (int i = 0; i < N; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), Key(i)));
+    }
+    Compact("a", "z");
+    dbfull()->TEST_CompactMemTable();
 
-        // Stop the threads and wait for them to finish
-        mt.stop.store(true, std::memory_order_release);
-        for (int id = 0; id < kNumThreads; id++) {
-            while (!mt.thread_done[id].load(std::memory_order_acquire)) {
-                DelayMilliseconds(100);
-            }
-        }
-    } while (ChangeOptions());
-}
+    // Prevent auto compactions triggered by seeks
+    env_->delay_data_sync_.store(true, std::memory_order_release);
 
-namespace {
-typedef std::map<std::string, std::string> KVMap;
-}
+    for (int i = 0; i < N; i++) {
+        ASSERT_EQ(Key(i), Get(Key(i)));
+    }
+
+    // Missing keys are still rejected by the filters without data reads.
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++) {
+        ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+    }
+    int reads = env_->random_read_counter_.Read();
+    std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
+    ASSERT_LE(reads, 3 * N / 100);
+
+    env_->delay_data_sync_.store(false, std::memory_order_release);
+    Close();
+    delete options.block_cache;
+    delete options.filter_policy;
+}
+
+TEST_F(DBTest, DataBlockHashIndex) {
+    Options options = CurrentOptions();
+    options.data_block_hash_index = true;
+    Reopen(&options);
+
+    const int N = 2000;
+    for (int i = 0; i < N; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), "v1"));
+    }
+    const Snapshot* snapshot = db_->GetSnapshot();
+    for (int i = 0; i < N; i += 2) {
+        ASSERT_MYDB_OK(Put(Key(i), "v2"));
+    }
+    dbfull()->TEST_CompactMemTable();
+
+    for (int i = 0; i < N; i++) {
+        ASSERT_EQ(i % 2 == 0 ? "v2" : "v1", Get(Key(i)));
+        ASSERT_EQ("v1", Get(Key(i), snapshot));
+        ASSERT_EQ("NOT_FOUND", Get(Key(i) + "x"));
+    }
+
+    db_->ReleaseSnapshot(snapshot);
+    Compact("a", "z");
+    for (int i = 0; i < N; i++) {
+        ASSERT_EQ(i % 2 == 0 ? "v2" : "v1", Get(Key(i)));
+    }
+
+    // Scans ignore the index.
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        count++;
+    }
+    ASSERT_EQ(N, count);
+    delete iter;
+}
+
+TEST_F(DBTest, DeleteRange) {
+    do {
+        ASSERT_MYDB_OK(Put("a", "va"));
+        ASSERT_MYDB_OK(Put("b", "vb"));
+        ASSERT_MYDB_OK(Put("c", "vc"));
+        ASSERT_MYDB_OK(Put("d", "vd"));
+        const Snapshot* snapshot = db_->GetSnapshot();
+        ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+        ASSERT_MYDB_OK(Put("c", "vc2"));
+        ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+        ASSERT_EQ("NOT_FOUND", Get("b"));
+        ASSERT_EQ("vb", Get("b", snapshot));
+
+        dbfull()->TEST_CompactMemTable();
+        ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+        ASSERT_EQ("NOT_FOUND", Get("b"));
+        ASSERT_EQ("vb", Get("b", snapshot));
+
+        Reopen();
+        ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+        db_->ReleaseSnapshot(snapshot);
+    } while (ChangeOptions());
+}
+
+TEST_F(DBTest, DeleteRangeAcrossLevels) {
+    const int N = 1000;
+    for (int i = 0; i < N; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), "v"));
+    }
+    Compact(Key(0), Key(N));
+    ASSERT_EQ(0, NumTableFilesAtLevel(0));
+
+    // A tombstone in a level-0 file hides keys in deeper levels.
+    ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), Key(100), Key(900)));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("v", Get(Key(99)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(100)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(899)));
+    ASSERT_EQ("v", Get(Key(900)));
+
+    // Keys written after the tombstone are visible.
+    ASSERT_MYDB_OK(Put(Key(500), "v2"));
+    dbfull()->TEST_CompactMemTable();
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        count++;
+    }
+    ASSERT_EQ(N - 800 + 1, count);
+    iter->Seek(Key(100));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(Key(500), iter->key().ToString());
+    iter->Prev();
+    ASSERT_EQ(Key(99), iter->key().ToString());
+    delete iter;
+
+    // Compacting everything drops the covered keys and the tombstone.
+    const uint64_t before = Size(Key(0), Key(N));
+    Compact(Key(0), Key(N));
+    ASSERT_LT(Size(Key(0), Key(N)), before);
+    ASSERT_EQ("[ ]", AllEntriesFor(Key(200)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(200)));
+    ASSERT_EQ("v2", Get(Key(500)));
+    ASSERT_EQ("v", Get(Key(999)));
+}
+
+TEST_F(DBTest, DeleteRangeSnapshotKeepsData) {
+    for (int i = 0; i < 100; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), "v"));
+    }
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), Key(0), Key(100)));
+    Compact(Key(0), Key(100));
+    ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+    ASSERT_EQ("v", Get(Key(50), snapshot));
+    db_->ReleaseSnapshot(snapshot);
+    ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+
+    // The tombstone survives a reopen even though its memtable is gone.
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+    ASSERT_EQ("", Contents());
+}
+
+TEST_F(DBTest, DeleteRangeIteratorOpensOnlyTombstoneTables) {
+    env_->count_random_reads_ = true;
+    Options options = CurrentOptions();
+    options.env = env_;
+    Reopen(&options);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), "v"));
+    }
+    Compact(Key(0), Key(1000));
+
+    // No table has a tombstone, so creating an iterator reads nothing.
+    Reopen(&options);
+    env_->random_read_counter_.Reset();
+    delete db_->NewIterator(ReadOptions());
+    ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+    ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), Key(100), Key(200)));
+    dbfull()->TEST_CompactMemTable();
+    Reopen(&options);
+    env_->random_read_counter_.Reset();
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    ASSERT_GT(env_->random_read_counter_.Read(), 0);
+    iter->Seek(Key(100));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(Key(200), iter->key().ToString());
+    delete iter;
+}
+
+TEST_F(DBTest, Merge) {
+    AppendOperator append;
+    do {
+        Options options = CurrentOptions();
+        options.merge_operator = &append;
+        Reopen(&options);
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "a", "1"));
+        ASSERT_MYDB_OK(Put("b", "x"));
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "b", "1"));
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "b", "2"));
+        ASSERT_MYDB_OK(Put("c", "y"));
+        const Snapshot* snapshot = db_->GetSnapshot();
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "c", "1"));
+        ASSERT_EQ("(a->1)(b->x,1,2)(c->y,1)", Contents());
+        ASSERT_EQ("y", Get("c", snapshot));
+
+        // Operands in the memtable apply to values in files.
+        dbfull()->TEST_CompactMemTable();
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "a", "2"));
+        ASSERT_MYDB_OK(Delete("b"));
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "b", "3"));
+        ASSERT_EQ("(a->1,2)(b->3)(c->y,1)", Contents());
+        ASSERT_EQ("y", Get("c", snapshot));
+
+        dbfull()->TEST_CompactMemTable();
+        ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), "c", "d"));
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "c", "2"));
+        ASSERT_EQ("(a->1,2)(b->3)(c->2)", Contents());
+        ASSERT_EQ("y", Get("c", snapshot));
+        db_->ReleaseSnapshot(snapshot);
+
+        Reopen(&options);
+        ASSERT_EQ("(a->1,2)(b->3)(c->2)", Contents());
+        Compact("a", "z");
+        ASSERT_EQ("(a->1,2)(b->3)(c->2)", Contents());
+    } while (ChangeOptions());
+}
+
+TEST_F(DBTest, MergeIteratorDirectionChanges) {
+    AppendOperator append;
+    Options options = CurrentOptions();
+    options.merge_operator = &append;
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("a", "va"));
+    ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "b", "1"));
+    ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "b", "2"));
+    ASSERT_MYDB_OK(Put("c", "vc"));
+    ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "c", "3"));
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->Seek("b");
+    ASSERT_EQ("b->1,2", IterStatus(iter));
+    iter->Next();
+    ASSERT_EQ("c->vc,3", IterStatus(iter));
+    iter->Prev();
+    ASSERT_EQ("b->1,2", IterStatus(iter));
+    iter->Prev();
+    ASSERT_EQ("a->va", IterStatus(iter));
+    iter->Next();
+    ASSERT_EQ("b->1,2", IterStatus(iter));
+
+    // The merge of the last key consumes every remaining entry.
+    iter->SeekToLast();
+    ASSERT_EQ("c->vc,3", IterStatus(iter));
+    iter->Prev();
+    iter->Next();
+    ASSERT_EQ("c->vc,3", IterStatus(iter));
+    iter->Prev();
+    ASSERT_EQ("b->1,2", IterStatus(iter));
+    iter->Next();
+    iter->Next();
+    ASSERT_EQ("(invalid)", IterStatus(iter));
+    iter->Seek("c");
+    iter->Prev();
+    ASSERT_EQ("b->1,2", IterStatus(iter));
+    delete iter;
+}
+
+TEST_F(DBTest, MergeCompaction) {
+    CounterOperator counter;
+    Options options = CurrentOptions();
+    options.merge_operator = &counter;
+    Reopen(&options);
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "counter", "1"));
+        dbfull()->TEST_CompactMemTable();
+    }
+    ASSERT_EQ("10", Get("counter"));
+
+    // The operands of a key with no older data collapse into a value.
+    Compact("a", "z");
+    ASSERT_EQ("[ 10 ]", AllEntriesFor("counter"));
+
+    // Operands stacked on an older level are combined into one.
+    ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "counter", "5"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "counter", "7"));
+    ASSERT_EQ("[ MERGE 7, MERGE 5, 10 ]", AllEntriesFor("counter"));
+    ASSERT_EQ("22", Get("counter"));
+    Reopen(&options);
+    ASSERT_EQ("22", Get("counter"));
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_EQ("[ MERGE 12, 10 ]", AllEntriesFor("counter"));
+    ASSERT_EQ("22", Get("counter"));
+
+    // A snapshot keeps the operands it sees apart from newer ones.
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_MYDB_OK(db_->Merge(WriteOptions(), "counter", "1"));
+    Compact("a", "z");
+    ASSERT_EQ("23", Get("counter"));
+    ASSERT_EQ("22", Get("counter", snapshot));
+    db_->ReleaseSnapshot(snapshot);
+    Compact("a", "z");
+    ASSERT_EQ("23", Get("counter"));
+}
+
+TEST_F(DBTest, MergeWithoutOperator) {
+    ASSERT_TRUE(db_->Merge(WriteOptions(), "a", "1").IsInvalidArgument());
+
+    // Operands written through a batch cannot be read back.
+    WriteBatch batch;
+    batch.Merge("a", "1");
+    ASSERT_MYDB_OK(db_->Write(WriteOptions(), &batch));
+    std::string value;
+    ASSERT_TRUE(db_->Get(ReadOptions(), "a", &value).IsNotSupportedError());
+}
+
+TEST_F(DBTest, CompactionFilter) {
+    // An older value in a deeper level must stay hidden once the newer
+    // value is removed.
+    ASSERT_MYDB_OK(Put("drop1", "old"));
+    ASSERT_MYDB_OK(Put("key", "v1"));
+    Compact("a", "z");
+    ASSERT_EQ("0,0,1", FilesPerLevel());
+
+    TestCompactionFilter filter;
+    Options options = CurrentOptions();
+    options.compaction_filter = &filter;
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("drop1", "new"));
+    ASSERT_MYDB_OK(Put("drop2", "v"));
+    ASSERT_MYDB_OK(Put("up", "value"));
+    ASSERT_MYDB_OK(Put("key", "v2"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("new", Get("drop1"));
+    ASSERT_EQ("value", Get("up"));
+
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+    ASSERT_EQ("NOT_FOUND", Get("drop1"));
+    ASSERT_EQ("NOT_FOUND", Get("drop2"));
+    ASSERT_EQ("VALUE", Get("up"));
+    ASSERT_EQ("v2", Get("key"));
+    ASSERT_EQ("(key->v2)(up->VALUE)", Contents());
+
+    // Values a snapshot can see are left alone.
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_MYDB_OK(Put("drop3", "v"));
+    const Snapshot* snapshot2 = db_->GetSnapshot();
+    Compact("a", "z");
+    ASSERT_EQ("v", Get("drop3"));
+    db_->ReleaseSnapshot(snapshot);
+    db_->ReleaseSnapshot(snapshot2);
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+        dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+    }
+    ASSERT_EQ("NOT_FOUND", Get("drop3"));
+}
+
+TEST_F(DBTest, CompactionFilterSnapshotOfOverwrittenValue) {
+    TestCompactionFilter filter;
+    Options options = CurrentOptions();
+    options.compaction_filter = &filter;
+    Reopen(&options);
+
+    // The older value is older than every snapshot, but the snapshot
+    // still reads it since the newer value was written later.
+    ASSERT_MYDB_OK(Put("drop", "old"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_MYDB_OK(Put("drop", "new"));
+    dbfull()->TEST_CompactMemTable();
+    Compact("a", "z");
+    ASSERT_EQ("old", Get("drop", snapshot));
+    ASSERT_EQ("new", Get("drop"));
+
+    db_->ReleaseSnapshot(snapshot);
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+        dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+    }
+    ASSERT_EQ("NOT_FOUND", Get("drop"));
+}
+
+TEST_F(DBTest, CompactionFilterSnapshotOfValueOverwrittenElsewhere) {
+    TestCompactionFilter filter;
+    Options options = CurrentOptions();
+    options.compaction_filter = &filter;
+    Reopen(&options);
+
+    // The newer value lives in a level the compaction does not read, so
+    // the older one is the newest entry its compaction sees.
+    ASSERT_MYDB_OK(Put("drop", "old"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,0,1", FilesPerLevel());
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_MYDB_OK(Put("drop", "new"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,1,1", FilesPerLevel());
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("0,1,0,1", FilesPerLevel());
+    ASSERT_EQ("old", Get("drop", snapshot));
+
+    // Values written after the newest snapshot are still filtered.
+    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+    ASSERT_EQ("NOT_FOUND", Get("drop"));
+    ASSERT_EQ("old", Get("drop", snapshot));
+    db_->ReleaseSnapshot(snapshot);
+}
+
+TEST_F(DBTest, TTLCompactionFilter) {
+    const CompactionFilter* filter = NewTTLCompactionFilter(env_);
+    Options options = CurrentOptions();
+    options.compaction_filter = filter;
+    Reopen(&options);
+
+    const uint64_t now = env_->NowMicros() / 1000000;
+    std::string expired, live, forever;
+    PutFixed64(&expired, now - 1);
+    expired.append("expired");
+    PutFixed64(&live, now + 3600);
+    live.append("live");
+    PutFixed64(&forever, 0);
+    forever.append("forever");
+    ASSERT_MYDB_OK(Put("a", expired));
+    ASSERT_MYDB_OK(Put("b", live));
+    ASSERT_MYDB_OK(Put("c", forever));
+    ASSERT_MYDB_OK(Put("d", "short"));
+
+    // Expired values are only removed by compactions.
+    ASSERT_EQ(expired, Get("a"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ(expired, Get("a"));
+    ASSERT_EQ("0,0,1", FilesPerLevel());
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_EQ(live, Get("b"));
+    ASSERT_EQ(forever, Get("c"));
+    ASSERT_EQ("short", Get("d"));
+
+    Close();
+    delete filter;
+}
+
+TEST_F(DBTest, DynamicLevelBytes) {
+    Options options = CurrentOptions();
+    options.dynamic_level_bytes = true;
+    options.write_buffer_size = 1 << 20;
+    Reopen(&options);
+
+    // While the database is small, level-0 compacts into the last level.
+    ASSERT_MYDB_OK(Put("foo", "v1"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("1", FilesPerLevel());
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_EQ("0,0,0,0,0,0,1", FilesPerLevel());
+
+    // Once the last level outgrows the level-1 limit, the level above it
+    // becomes the base level, and the levels above that stay empty.
+    Random rnd(301);
+    std::vector<std::string> values;
+    for (int i = 0; i < 25000; i++) {
+        values.push_back(RandomString(&rnd, 1000));
+        ASSERT_MYDB_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int level = 1; level < config::kNumLevels - 2; level++) {
+        ASSERT_EQ(0, NumTableFilesAtLevel(level)) << FilesPerLevel();
+    }
+    ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+    for (int i = 0; i < 25000; i++) {
+        ASSERT_EQ(values[i], Get(Key(i)));
+    }
+    ASSERT_EQ("v1", Get("foo"));
+}
+
+TEST_F(DBTest, TieredCompaction) {
+    Options options = CurrentOptions();
+    options.compaction_style = kTiered;
+    options.tiered_max_sorted_runs = 4;
+    options.write_buffer_size = 100000;
+    Reopen(&options);
+
+    Random rnd(301);
+    std::vector<std::string> values(200);
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 100; i++) {
+            const int k = rnd.Uniform(values.size());
+            values[k] = RandomString(&rnd, 1000);
+            ASSERT_MYDB_OK(Put(Key(k), values[k]));
+        }
+        dbfull()->TEST_CompactMemTable();
+        for (int i = 0;
+             i < 1000 && NumSortedRuns() >= options.tiered_max_sorted_runs;
+             i++) {
+            DelayMilliseconds(10);
+        }
+        ASSERT_LT(NumSortedRuns(), options.tiered_max_sorted_runs)
+            << FilesPerLevel();
+        for (size_t k = 0; k < values.size(); k++) {
+            ASSERT_EQ(values[k].empty() ? "NOT_FOUND" : values[k], Get(Key(k)));
+        }
+    }
+
+    // The tables stay readable with either compaction style.
+    options.compaction_style = kLeveled;
+    Reopen(&options);
+    Compact(Key(0), Key(values.size()));
+    for (size_t k = 0; k < values.size(); k++) {
+        ASSERT_EQ(values[k].empty() ? "NOT_FOUND" : values[k], Get(Key(k)));
+    }
+}
+
+TEST_F(DBTest, ParallelCompression) {
+    Options options = CurrentOptions();
+    options.compression_threads = 4;
+    options.write_buffer_size = 100000;
+    Reopen(&options);
+
+    Random rnd(301);
+    std::vector<std::string> values;
+    for (int i = 0; i < 2000; i++) {
+        values.push_back(RandomString(&rnd, 200));
+        ASSERT_MYDB_OK(Put(Key(i), values[i]));
+    }
+    Compact("a", "z");
+    ASSERT_GT(TotalTableFiles(), 0);
+    for (int i = 0; i < 2000; i++) {
+        ASSERT_EQ(values[i], Get(Key(i)));
+    }
+}
+
+static bool ZstdCompressionSupported() {
+    std::string out;
+    Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    return port::Zstd_Compress(/*level=*/1, in.data(), in.size(), &out);
+}
+
+TEST_F(DBTest, CompressionPerLevel) {
+    if (!ZstdCompressionSupported()) {
+        GTEST_SKIP() << "zstd compression not supported";
+    }
+    Options options = CurrentOptions();
+    options.compression_per_level = {kNoCompression, kNoCompression,
+                                     kNoCompression, kZstdCompression};
+    Reopen(&options);
+
+    for (int i = 0; i < 100; i++) {
+        ASSERT_MYDB_OK(Put(Key(i), std::string(1000, 'x')));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,0,1", FilesPerLevel());
+    ASSERT_GT(Size(Key(0), Key(100)), 100000);
+
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("0,0,0,1", FilesPerLevel());
+    ASSERT_LT(Size(Key(0), Key(100)), 10000);
+    ASSERT_EQ(std::string(1000, 'x'), Get(Key(50)));
+}
+
+TEST_F(DBTest, BottommostZstdCompression) {
+    if (!ZstdCompressionSupported()) {
+        GTEST_SKIP() << "zstd compression not supported";
+    }
+    Options options = CurrentOptions();
+    options.compression = kNoCompression;
+    options.bottommost_zstd = true;
+    Reopen(&options);
+
+    // "a" keys end up in the bottommost level.
+    for (int i = 0; i < 100; i++) {
+        ASSERT_MYDB_OK(Put("a" + Key(i), std::string(1000, 'x')));
+    }
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    dbfull()->TEST_CompactRange(3, nullptr, nullptr);
+    ASSERT_EQ("0,0,0,0,1", FilesPerLevel());
+    ASSERT_LT(Size("a", "b"), 10000);
+
+    // "b" keys are compacted into a level above it and stay uncompressed.
+    for (int i = 0; i < 100; i++) {
+        ASSERT_MYDB_OK(Put("b" + Key(i), std::string(1000, 'x')));
+    }
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("0,0,0,1,1", FilesPerLevel());
+    ASSERT_GT(Size("b", "c"), 100000);
+    ASSERT_EQ(std::string(1000, 'x'), Get("a" + Key(50)));
+    ASSERT_EQ(std::string(1000, 'x'), Get("b" + Key(50)));
+}
+
+TEST_F(DBTest, BlobFiles) {
+    Options options = CurrentOptions();
+    options.min_blob_size = 100;
+    Reopen(&options);
+
+    Random rnd(301);
+    const std::string big = RandomString(&rnd, 1000);
+    ASSERT_MYDB_OK(Put("a", "small"));
+    ASSERT_MYDB_OK(Put("b", big));
+    ASSERT_MYDB_OK(Put("c", big + "c"));
+    ASSERT_TRUE(BlobFileNumbers().empty());
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ(1, BlobFileNumbers().size());
+    ASSERT_EQ("[ small ]", AllEntriesFor("a"));
+    ASSERT_EQ("[ BLOB ]", AllEntriesFor("b"));
+    ASSERT_EQ(big, Get("b"));
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->Seek("b");
+    ASSERT_EQ("b->" + big, IterStatus(iter));
+    iter->Next();
+    ASSERT_EQ("c->" + big + "c", IterStatus(iter));
+    iter->Prev();
+    ASSERT_EQ("b->" + big, IterStatus(iter));
+    iter->Prev();
+    ASSERT_EQ("a->small", IterStatus(iter));
+    iter->SeekToLast();
+    ASSERT_EQ("c->" + big + "c", IterStatus(iter));
+    delete iter;
+
+    // Compactions move the references, not the values.
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("d", big + "d"));
+    Compact("a", "z");
+    ASSERT_EQ(2, BlobFileNumbers().size());
+    ASSERT_EQ(big + "c", Get("c"));
+    ASSERT_EQ(big + "d", Get("d"));
+
+    // The values stay readable once the option is turned off.
+    options.min_blob_size = 0;
+    Reopen(&options);
+    ASSERT_EQ("(a->small)(b->" + big + ")(c->" + big + "c)(d->" + big + "d)",
+              Contents());
+}
+
+TEST_F(DBTest, BlobGarbageCollection) {
+    Options options = CurrentOptions();
+    options.min_blob_size = 100;
+    Reopen(&options);
+
+    // Fill a blob file whose table ends up in the last level.
+    Random rnd(301);
+    std::vector<std::string> values(10);
+    for (size_t i = 0; i < values.size(); i++) {
+        values[i] = RandomString(&rnd, 1000);
+        ASSERT_MYDB_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int level = 2; level < config::kNumLevels - 1; level++) {
+        dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+    }
+    ASSERT_EQ("0,0,0,0,0,0,1", FilesPerLevel());
+    const std::set<uint64_t> old_blobs = BlobFileNumbers();
+    ASSERT_EQ(1, old_blobs.size());
+
+    // Overwrite most of its values.  Once the compaction into the last
+    // level drops them, the few live ones are moved to a new blob file and
+    // the old one is deleted.
+    for (size_t i = 0; i < 8; i++) {
+        values[i] = RandomString(&rnd, 1000);
+        ASSERT_MYDB_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+        dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+    }
+    for (int i = 0; i < 1000 && BlobFileNumbers().count(*old_blobs.begin());
+         i++) {
+        DelayMilliseconds(10);
+    }
+    const std::set<uint64_t> new_blobs = BlobFileNumbers();
+    ASSERT_EQ(2, new_blobs.size());
+    ASSERT_EQ(0, new_blobs.count(*old_blobs.begin()));
+    ASSERT_EQ("0,0,0,0,0,0,1", FilesPerLevel());
+    for (size_t i = 0; i < values.size(); i++) {
+        ASSERT_EQ(values[i], Get(Key(i)));
+    }
+
+    // Deleting the remaining values deletes their blob files.
+    for (size_t i = 0; i < values.size(); i++) {
+        ASSERT_MYDB_OK(Delete(Key(i)));
+    }
+    Compact(Key(0), Key(values.size()));
+    ASSERT_TRUE(BlobFileNumbers().empty());
+
+    Reopen(&options);
+    ASSERT_EQ("", Contents());
+}
+
+TEST_F(DBTest, DirectIO) {
+    Options options = CurrentOptions();
+    options.use_direct_reads = true;
+    options.use_direct_io_for_flush_and_compaction = true;
+    options.write_buffer_size = 100000;
+    options.min_blob_size = 2000;
+    Reopen(&options);
+
+    // Enough data for flushes and compactions, with some values in blob
+    // files.
+    Random rnd(301);
+    std::map<std::string, std::string> values;
+    for (int i = 0; i < 2000; i++) {
+        const std::string key = Key(rnd.Uniform(1000));
+        values[key] = RandomString(&rnd, (i % 50 == 0) ? 3000 : 300);
+        ASSERT_MYDB_OK(Put(key, values[key]));
+    }
+    Compact("a", "z");
+    ASSERT_FALSE(BlobFileNumbers().empty());
+    for (int pass = 0; pass < 2; pass++) {
+        for (const auto& kv : values) {
+            ASSERT_EQ(kv.second, Get(kv.first));
+        }
+        ReadOptions read_options;
+        read_options.readahead_size = 65536;
+        Iterator* iter = db_->NewIterator(read_options);
+        auto expected = values.begin();
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expected) {
+            ASSERT_TRUE(expected != values.end());
+            ASSERT_EQ(expected->first, iter->key().ToString());
+            ASSERT_EQ(expected->second, iter->value().ToString());
+        }
+        ASSERT_TRUE(expected == values.end());
+        ASSERT_MYDB_OK(iter->status());
+        delete iter;
+        Reopen(&options);
+    }
+}
+
+TEST_F(DBTest, BytesPerSync) {
+    Options options = CurrentOptions();
+    options.bytes_per_sync = 4096;
+    options.wal_bytes_per_sync = 4096;
+    options.write_buffer_size = 100000;
+    options.min_blob_size = 2000;
+    options.reuse_logs = true;
+    Reopen(&options);
+
+    Random rnd(301);
+    std::map<std::string, std::string> values;
+    for (int pass = 0; pass < 3; pass++) {
+        for (int i = 0; i < 1000; i++) {
+            const std::string key = Key(rnd.Uniform(1000));
+            values[key] = RandomString(&rnd, (i % 50 == 0) ? 3000 : 300);
+            ASSERT_MYDB_OK(Put(key, values[key]));
+        }
+        // The last log is reused and appended to on the next pass.
+        Reopen(&options);
+        for (const auto& kv : values) {
+            ASSERT_EQ(kv.second, Get(kv.first));
+        }
+    }
+    Compact("a", "z");
+    for (const auto& kv : values) {
+        ASSERT_EQ(kv.second, Get(kv.first));
+    }
+}
+
+TEST_F(DBTest, WalCompression) {
+    Options options = CurrentOptions();
+    options.wal_compression = kZstdCompression;
+    options.wal_compression_min_size = 1000;
+    options.reuse_logs = true;
+    Reopen(&options);
+
+    // Batches large enough to be compressed, if zstd is available, and
+    // small ones that are not.
+    Random rnd(301);
+    std::map<std::string, std::string> values;
+    for (int pass = 0; pass < 3; pass++) {
+        for (int i = 0; i < 100; i++) {
+            WriteBatch batch;
+            for (int j = 0; j < (i % 2 == 0 ? 50 : 1); j++) {
+                const std::string key = Key(rnd.Uniform(1000));
+                values[key] = std::string(100 + rnd.Uniform(100),
+                                          static_cast<char>('a' + j % 26));
+                batch.Put(key, values[key]);
+            }
+            ASSERT_MYDB_OK(db_->Write(WriteOptions(), &batch));
+        }
+        // Recovers from, and then appends to, the compressed log.
+        Reopen(&options);
+        for (const auto& kv : values) {
+            ASSERT_EQ(kv.second, Get(kv.first));
+        }
+    }
+}
+
+TEST_F(DBTest, RateLimiter) {
+    RateLimiter* limiter = NewGenericRateLimiter(1 << 30);
+    Options options = CurrentOptions();
+    options.rate_limiter = limiter;
+    Reopen(&options);
+
+    // Two overlapping tables, which a compaction has to merge.
+    Random rnd(301);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_MYDB_OK(Put(Key(i), RandomString(&rnd, 300)));
+        }
+        ASSERT_MYDB_OK(dbfull()->TEST_CompactMemTable());
+    }
+    ASSERT_GT(limiter->GetTotalBytesThrough(RateLimiter::Priority::kHigh),
+              2 * 300000);
+    ASSERT_EQ(0, limiter->GetTotalBytesThrough(RateLimiter::Priority::kLow));
+    Compact("a", "z");
+    // The compaction read both tables and wrote one at low priority.
+    ASSERT_GT(limiter->GetTotalBytesThrough(RateLimiter::Priority::kLow),
+              3 * 300000);
+    ASSERT_EQ(300, Get(Key(10)).size());
+    Close();
+    delete limiter;
+}
+
+TEST_F(DBTest, MmapReads) {
+    Options options = CurrentOptions();
+    options.use_mmap_reads = true;
+    options.compression = kNoCompression;
+    options.write_buffer_size = 100000;
+    options.min_blob_size = 2000;
+    options.max_open_files = 20; // A table cache of ten tables
+    Reopen(&options);
+
+    // More tables than the table cache holds, so that mappings are
+    // dropped and made again, and some values in blob files.
+    Random rnd(301);
+    std::map<std::string, std::string> values;
+    for (int i = 0; i < 3000; i++) {
+        const std::string key = Key(rnd.Uniform(2000));
+        values[key] = RandomString(&rnd, (i % 50 == 0) ? 3000 : 300);
+        ASSERT_MYDB_OK(Put(key, values[key]));
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        for (const auto& kv : values) {
+            ASSERT_EQ(kv.second, Get(kv.first));
+        }
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        auto expected = values.begin();
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expected) {
+            ASSERT_TRUE(expected != values.end());
+            ASSERT_EQ(expected->first, iter->key().ToString());
+            ASSERT_EQ(expected->second, iter->value().ToString());
+        }
+        ASSERT_TRUE(expected == values.end());
+        ASSERT_MYDB_OK(iter->status());
+        delete iter;
+        // Compaction inputs are read with a sequential access hint.
+        Compact("a", "z");
+    }
+}
+
+TEST_F(DBTest, IngestKeyInMemtable) {
+    Options options = CurrentOptions();
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("k", "memtable-old"));
+
+    const std::string fname = testing::TempDir() + "db_ingest_test.ldb";
+    SstFileWriter writer(options);
+    ASSERT_MYDB_OK(writer.Open(fname));
+    ASSERT_MYDB_OK(writer.Put("k", "ingested-new"));
+    ASSERT_MYDB_OK(writer.Finish());
+    ASSERT_MYDB_OK(
+        db_->IngestExternalFile({fname}, IngestExternalFileOptions()));
+    env_->RemoveFile(fname);
+
+    ASSERT_EQ("ingested-new", Get("k"));
+    Reopen(&options);
+    ASSERT_EQ("ingested-new", Get("k"));
+}
+
+TEST_F(DBTest, Checkpoint) {
+    Options options = CurrentOptions();
+    options.min_blob_size = 1000;
+    Reopen(&options);
+
+    // Values in a table, in a blob file and in the log.
+    ASSERT_MYDB_OK(Put("a", "va"));
+    ASSERT_MYDB_OK(Put("b", std::string(2000, 'b')));
+    ASSERT_MYDB_OK(Put("c", "vc"));
+    ASSERT_MYDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_MYDB_OK(Put("a", "va2"));
+
+    const std::string dir = testing::TempDir() + "db_checkpoint_test";
+    DestroyDB(dir, Options());
+    ASSERT_MYDB_OK(db_->CreateCheckpoint(dir));
+    ASSERT_TRUE(db_->CreateCheckpoint(dir).IsInvalidArgument());
+
+    // Later writes, and compactions that delete the tables the checkpoint
+    // links to, leave the checkpoint alone.
+    ASSERT_MYDB_OK(Put("c", "vc2"));
+    ASSERT_MYDB_OK(Put("d", "vd"));
+    Compact("a", "z");
+
+    options.create_if_missing = false;
+    DB* checkpoint = nullptr;
+    ASSERT_MYDB_OK(DB::Open(options, dir, &checkpoint));
+    std::string value;
+    ASSERT_MYDB_OK(checkpoint->Get(ReadOptions(), "a", &value));
+    ASSERT_EQ("va2", value);
+    ASSERT_MYDB_OK(checkpoint->Get(ReadOptions(), "b", &value));
+    ASSERT_EQ(std::string(2000, 'b'), value);
+    ASSERT_MYDB_OK(checkpoint->Get(ReadOptions(), "c", &value));
+    ASSERT_EQ("vc", value);
+    ASSERT_TRUE(checkpoint->Get(ReadOptions(), "d", &value).IsNotFound());
+    delete checkpoint;
+    ASSERT_MYDB_OK(DestroyDB(dir, options));
+
+    ASSERT_EQ("va2", Get("a"));
+    ASSERT_EQ("vc2", Get("c"));
+}
+
+TEST_F(DBTest, OpenAsSecondary) {
+    Options options = CurrentOptions();
+    options.min_blob_size = 1000;
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("a", "va"));
+    ASSERT_MYDB_OK(Put("b", std::string(2000, 'b')));
+    ASSERT_MYDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_MYDB_OK(Put("c", "vc"));
+
+    const std::string secondary_path =
+        testing::TempDir() + "db_secondary_test";
+    DB* secondary = nullptr;
+    ASSERT_MYDB_OK(
+        DB::OpenAsSecondary(options, dbname_, secondary_path, &secondary));
+    std::string value;
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "a", &value));
+    ASSERT_EQ("va", value);
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "b", &value));
+    ASSERT_EQ(std::string(2000, 'b'), value);
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "c", &value));
+    ASSERT_EQ("vc", value);
+    ASSERT_TRUE(
+        secondary->Put(WriteOptions(), "d", "vd").IsNotSupportedError());
+    ASSERT_TRUE(db_->TryCatchUpWithPrimary().IsNotSupportedError());
+
+    // Writes to the primary show up after a catch-up.
+    ASSERT_MYDB_OK(Put("c", "vc2"));
+    ASSERT_MYDB_OK(Delete("a"));
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "c", &value));
+    ASSERT_EQ("vc", value);
+    ASSERT_MYDB_OK(secondary->TryCatchUpWithPrimary());
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "c", &value));
+    ASSERT_EQ("vc2", value);
+    ASSERT_TRUE(secondary->Get(ReadOptions(), "a", &value).IsNotFound());
+
+    // So do flushes and compactions, after which the records of the old
+    // logs are read from tables.
+    ASSERT_MYDB_OK(Put("d", "vd"));
+    Compact("a", "z");
+    ASSERT_MYDB_OK(Put("e", "ve"));
+    ASSERT_MYDB_OK(secondary->TryCatchUpWithPrimary());
+    ASSERT_MYDB_OK(secondary->TryCatchUpWithPrimary());
+    Iterator* iter = secondary->NewIterator(ReadOptions());
+    std::string contents;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        contents += iter->key().ToString() + "=" + iter->value().ToString() +
+                    " ";
+    }
+    ASSERT_MYDB_OK(iter->status());
+    delete iter;
+    ASSERT_EQ("b=" + std::string(2000, 'b') + " c=vc2 d=vd e=ve ", contents);
+
+    // Reopening the primary replaces its MANIFEST, which is then read
+    // from the start.
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("f", "vf"));
+    ASSERT_MYDB_OK(secondary->TryCatchUpWithPrimary());
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "e", &value));
+    ASSERT_EQ("ve", value);
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "f", &value));
+    ASSERT_EQ("vf", value);
+    delete secondary;
+
+    DestroyDB(secondary_path, Options());
+}
+
+// Lets the primary finish a delayed flush, which deletes its oldest live
+// log, just before a secondary opens that log.
+class FlushBeforeLogReadEnv : public EnvWrapper {
+  public:
+    // Set to fire on the next log opened; cleared once it has fired.
+    bool armed;
+
+    explicit FlushBeforeLogReadEnv(SpecialEnv* primary_env)
+        : EnvWrapper(primary_env), armed(false), primary_env_(primary_env) {}
+
+    Status NewSequentialFile(const std::string& f,
+                             SequentialFile** r) override {
+        if (armed && IsLogFile(f)) {
+            armed = false;
+            primary_env_->delay_data_sync_.store(false,
+                                                 std::memory_order_release);
+            for (int i = 0; i < 1000 && target()->FileExists(f); i++) {
+                DelayMilliseconds(10);
+            }
+        }
+        return target()->NewSequentialFile(f, r);
+    }
+
+  private:
+    SpecialEnv* const primary_env_;
+};
+
+TEST_F(DBTest, SecondaryCatchUpWhileLogIsFlushed) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.write_buffer_size = 100000;
+    Reopen(&options);
+    ASSERT_MYDB_OK(Put("x", "v1"));
+
+    const std::string secondary_path =
+        testing::TempDir() + "db_secondary_flush_test";
+    FlushBeforeLogReadEnv secondary_env(env_);
+    Options secondary_options = options;
+    secondary_options.env = &secondary_env;
+    DB* secondary = nullptr;
+    ASSERT_MYDB_OK(DB::OpenAsSecondary(secondary_options, dbname_,
+                                       secondary_path, &secondary));
+
+    // "x" is overwritten in the primary's current log.  The next write
+    // switches to a new log while the flush of the old one is held up.
+    ASSERT_MYDB_OK(Put("x", "v2"));
+    env_->delay_data_sync_.store(true, std::memory_order_release);
+    ASSERT_MYDB_OK(Put("filler", std::string(200000, 'f')));
+    ASSERT_MYDB_OK(Put("y", "v1"));
+
+    // The old log is gone by the time the secondary reads it.
+    secondary_env.armed = true;
+    ASSERT_MYDB_OK(secondary->TryCatchUpWithPrimary());
+    ASSERT_FALSE(secondary_env.armed);
+    std::string value;
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "y", &value));
+    ASSERT_EQ("v1", value);
+    ASSERT_MYDB_OK(secondary->Get(ReadOptions(), "x", &value));
+    ASSERT_EQ("v2", value);
+    delete secondary;
+
+    DestroyDB(secondary_path, Options());
+}
+
+TEST_F(DBTest, LogCloseError) {
+    // Regression test for bug where we could ignore log file
+    // Close() error when switching to a new log file.
+    const int kValueSize = 20000;
+    const int kWriteCount = 10;
+    const int kWriteBufferSize = (kValueSize * kWriteCount) / 2;
+
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.write_buffer_size = kWriteBufferSize; // Small write buffer
+    Reopen(&options);
+    env_->log_file_close_.store(true, std::memory_order_release);
+
+    std::string value(kValueSize, 'x');
+    Status s;
+    for (int i = 0; i < kWriteCount && s.ok(); i++) {
+        s = Put(Key(i), value);
+    }
+    ASSERT_TRUE(!s.ok()) << "succeeded even after log file Close failure";
+
+    // Future writes should also fail after an earlier error.
+    s = Put("hello", "world");
+    ASSERT_TRUE(!s.ok()) << "write succeeded after log file Close failure";
+
+    env_->log_file_close_.store(false, std::memory_order_release);
+}
+
+// Multi-threaded test:
+namespace {
+
+static const int kNumThreads = 4;
+static const int kTestSeconds = 10;
+static const int kNumKeys = 1000;
+
+struct MTState {
+    DBTest* test;
+    std::atomic<bool> stop;
+    std::atomic<int> counter[kNumThreads];
+    std::atomic<bool> thread_done[kNumThreads];
+};
+
+struct MTThread {
+    MTState* state;
+    int id;
+};
+
+static void MTThreadBody(void* arg) {
+    MTThread* t = reinterpret_cast<MTThread*>(arg);
+    int id = t->id;
+    DB* db = t->state->test->db_;
+    int counter = 0;
+    std::fprintf(stderr, "... starting thread %d\n", id);
+    Random rnd(1000 + id);
+    std::string value;
+    char valbuf[1500];
+    while (!t->state->stop.load(std::memory_order_acquire)) {
+        t->state->counter[id].store(counter, std::memory_order_release);
+
+        int key = rnd.Uniform(kNumKeys);
+        char keybuf[20];
+        std::snprintf(keybuf, sizeof(keybuf), "%016d", key);
+
+        if (rnd.OneIn(2)) {
+            // Write values of the form <key, my id, counter>.
+            // We add some padding for force compactions.
+            std::snprintf(valbuf, sizeof(valbuf), "%d.%d.%-1000d", key, id,
+                          static_cast<int>(counter));
+            ASSERT_MYDB_OK(
+                db->Put(WriteOptions(), Slice(keybuf), Slice(valbuf)));
+        } else {
+            // Read a value and verify that it matches the pattern written
+            // above.
+            Status s = db->Get(ReadOptions(), Slice(keybuf), &value);
+            if (s.IsNotFound()) {
+                // Key has not yet been written
+            } else {
+                // Check that the writer thread counter is >= the counter in the
+                // value
+                ASSERT_MYDB_OK(s);
+                int k, w, c;
+                ASSERT_EQ(3, sscanf(value.c_str(), "%d.%d.%d", &k, &w, &c))
+                    << value;
+                ASSERT_EQ(k, key);
+                ASSERT_GE(w, 0);
+                ASSERT_LT(w, kNumThreads);
+                ASSERT_LE(c,
+                          t->state->counter[w].load(std::memory_order_acquire));
+            }
+        }
+        counter++;
+    }
+    t->state->thread_done[id].store(true, std::memory_order_release);
+    std::fprintf(stderr, "... stopping thread %d after %d ops\n", id, counter);
+}
+
+} // namespace
+
+TEST_F(DBTest, MultiThreaded) {
+    do {
+        // Initialize state
+        MTState mt;
+        mt.test = this;
+        mt.stop.store(false, std::memory_order_release);
+        for (int id = 0; id < kNumThreads; id++) {
+            mt.counter[id].store(false, std::memory_order_release);
+            mt.thread_done[id].store(false, std::memory_order_release);
+        }
+
+        // Start threads
+        MTThread thread[kNumThreads];
+        for (int id = 0; id < kNumThreads; id++) {
+            thread[id].state = &mt;
+            thread[id].id = id;
+            env_->StartThread(MTThreadBody, &thread[id]);
+        }
+
+        // Let them run for a while
+        DelayMilliseconds(kTestSeconds * 1000);
+
+        // Stop the threads and wait for them to finish
+        mt.stop.store(true, std::memory_order_release);
+        for (int id = 0; id < kNumThreads; id++) {
+            while (!mt.thread_done[id].load(std::memory_order_acquire)) {
+                DelayMilliseconds(100);
+            }
+        }
+    } while (ChangeOptions());
+}
+
+namespace {
+typedef std::map<std::string, std::string> KVMap;
+}
 
 class ModelDB : public DB {
   public:
@@ -2142,6 +3479,14 @@ class ModelDB : public DB {
     Status Delete(const WriteOptions& o, const Slice& key) override {
         return DB::Delete(o, key);
     }
+    Status DeleteRange(const WriteOptions& o, const Slice& begin,
+                       const Slice& end) override {
+        return DB::DeleteRange(o, begin, end);
+    }
+    Status Merge(const WriteOptions& o, const Slice& key,
+                 const Slice& value) override {
+        return DB::Merge(o, key, value);
+    }
     Status Get(const ReadOptions& options, const Slice& key,
                std::string* value) override {
         assert(false); // Not implemented
@@ -2171,15 +3516,35 @@ class ModelDB : public DB {
         class Handler : public WriteBatch::Handler {
           public:
             KVMap* map_;
+            const MergeOperator* merge_operator_;
             void Put(const Slice& key, const Slice& value) override {
                 (*map_)[key.ToString()] = value.ToString();
             }
             void Delete(const Slice& key) override {
                 map_->erase(key.ToString());
             }
+            void DeleteRange(const Slice& begin, const Slice& end) override {
+                if (begin.compare(end) < 0) {
+                    map_->erase(map_->lower_bound(begin.ToString()),
+                                map_->lower_bound(end.ToString()));
+                }
+            }
+            void Merge(const Slice& key, const Slice& value) override {
+                KVMap::iterator it = map_->find(key.ToString());
+                Slice existing;
+                if (it != map_->end()) {
+                    existing = it->second;
+                }
+                std::string result;
+                merge_operator_->FullMerge(
+                    key, it != map_->end() ? &existing : nullptr,
+                    std::vector<Slice>(1, value), &result);
+                (*map_)[key.ToString()] = result;
+            }
         };
         Handler handler;
         handler.map_ = &map_;
+        handler.merge_operator_ = options_.merge_operator;
         return batch->Iterate(&handler);
     }
 
@@ -2192,6 +3557,14 @@ class ModelDB : public DB {
         }
     }
     void CompactRange(const Slice* start, const Slice* end) override {}
+    Status IngestExternalFile(
+        const std::vector<std::string>& paths,
+        const IngestExternalFileOptions& options) override {
+        return Status::NotSupported("IngestExternalFile");
+    }
+    Status CreateCheckpoint(const std::string& dir) override {
+        return Status::NotSupported("CreateCheckpoint");
+    }
 
   private:
     class ModelIter : public Iterator {
@@ -2394,4 +3767,226 @@ TEST_F(DBTest, Randomized) {
     } while (ChangeOptions());
 }
 
+TEST_F(DBTest, RandomizedDeleteRange) {
+    Random rnd(test::RandomSeed());
+    do {
+        ModelDB model(CurrentOptions());
+        const int N = 2000;
+        const Snapshot* model_snap = nullptr;
+        const Snapshot* db_snap = nullptr;
+        std::string k, v;
+        for (int step = 0; step < N; step++) {
+            int p = rnd.Uniform(100);
+            if (p < 60) { // Put
+                k = RandomKey(&rnd);
+                v = RandomString(&rnd, rnd.Uniform(8));
+                ASSERT_MYDB_OK(model.Put(WriteOptions(), k, v));
+                ASSERT_MYDB_OK(db_->Put(WriteOptions(), k, v));
+            } else if (p < 80) { // Delete
+                k = RandomKey(&rnd);
+                ASSERT_MYDB_OK(model.Delete(WriteOptions(), k));
+                ASSERT_MYDB_OK(db_->Delete(WriteOptions(), k));
+            } else { // DeleteRange, possibly empty
+                std::string begin = RandomKey(&rnd);
+                std::string end = RandomKey(&rnd);
+                ASSERT_MYDB_OK(model.DeleteRange(WriteOptions(), begin, end));
+                ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), begin, end));
+            }
+
+            if ((step % 100) == 0) {
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, nullptr, nullptr));
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, model_snap, db_snap));
+                for (int i = 0; i < 20; i++) {
+                    k = RandomKey(&rnd);
+                    std::string expected = "NOT_FOUND";
+                    Iterator* miter = model.NewIterator(ReadOptions());
+                    miter->Seek(k);
+                    if (miter->Valid() && miter->key() == k) {
+                        expected = miter->value().ToString();
+                    }
+                    delete miter;
+                    ASSERT_EQ(expected, Get(k)) << "step " << step;
+                }
+                if (model_snap != nullptr)
+                    model.ReleaseSnapshot(model_snap);
+                if (db_snap != nullptr)
+                    db_->ReleaseSnapshot(db_snap);
+
+                // Move tombstones through flushes and compactions.
+                switch ((step / 100) % 3) {
+                case 0:
+                    dbfull()->TEST_CompactMemTable();
+                    break;
+                case 1:
+                    db_->CompactRange(nullptr, nullptr);
+                    break;
+                case 2:
+                    Reopen();
+                    break;
+                }
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, nullptr, nullptr));
+
+                model_snap = model.GetSnapshot();
+                db_snap = db_->GetSnapshot();
+            }
+        }
+        if (model_snap != nullptr)
+            model.ReleaseSnapshot(model_snap);
+        if (db_snap != nullptr)
+            db_->ReleaseSnapshot(db_snap);
+    } while (ChangeOptions());
+}
+
+TEST_F(DBTest, RandomizedMerge) {
+    AppendOperator append;
+    Random rnd(test::RandomSeed());
+    do {
+        Options options = CurrentOptions();
+        options.merge_operator = &append;
+        Reopen(&options);
+        ModelDB model(options);
+        const int N = 1000;
+        const Snapshot* model_snap = nullptr;
+        const Snapshot* db_snap = nullptr;
+        std::string k, v;
+        for (int step = 0; step < N; step++) {
+            int p = rnd.Uniform(100);
+            if (p < 30) { // Put
+                k = RandomKey(&rnd);
+                v = RandomString(&rnd, rnd.Uniform(8));
+                ASSERT_MYDB_OK(model.Put(WriteOptions(), k, v));
+                ASSERT_MYDB_OK(db_->Put(WriteOptions(), k, v));
+            } else if (p < 70) { // Merge
+                k = RandomKey(&rnd);
+                v = RandomString(&rnd, rnd.Uniform(4));
+                ASSERT_MYDB_OK(model.Merge(WriteOptions(), k, v));
+                ASSERT_MYDB_OK(db_->Merge(WriteOptions(), k, v));
+            } else if (p < 90) { // Delete
+                k = RandomKey(&rnd);
+                ASSERT_MYDB_OK(model.Delete(WriteOptions(), k));
+                ASSERT_MYDB_OK(db_->Delete(WriteOptions(), k));
+            } else { // DeleteRange, possibly empty
+                std::string begin = RandomKey(&rnd);
+                std::string end = RandomKey(&rnd);
+                ASSERT_MYDB_OK(model.DeleteRange(WriteOptions(), begin, end));
+                ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), begin, end));
+            }
+
+            if ((step % 100) == 0) {
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, nullptr, nullptr));
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, model_snap, db_snap));
+                for (int i = 0; i < 20; i++) {
+                    k = RandomKey(&rnd);
+                    std::string expected = "NOT_FOUND";
+                    Iterator* miter = model.NewIterator(ReadOptions());
+                    miter->Seek(k);
+                    if (miter->Valid() && miter->key() == k) {
+                        expected = miter->value().ToString();
+                    }
+                    delete miter;
+                    ASSERT_EQ(expected, Get(k)) << "step " << step;
+                }
+                if (model_snap != nullptr)
+                    model.ReleaseSnapshot(model_snap);
+                if (db_snap != nullptr)
+                    db_->ReleaseSnapshot(db_snap);
+
+                // Move operands through flushes and compactions.
+                switch ((step / 100) % 3) {
+                case 0:
+                    dbfull()->TEST_CompactMemTable();
+                    break;
+                case 1:
+                    db_->CompactRange(nullptr, nullptr);
+                    break;
+                case 2:
+                    Reopen(&options);
+                    break;
+                }
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, nullptr, nullptr));
+
+                model_snap = model.GetSnapshot();
+                db_snap = db_->GetSnapshot();
+            }
+        }
+        if (model_snap != nullptr)
+            model.ReleaseSnapshot(model_snap);
+        if (db_snap != nullptr)
+            db_->ReleaseSnapshot(db_snap);
+    } while (ChangeOptions());
+}
+
+TEST_F(DBTest, RandomizedTieredCompaction) {
+    AppendOperator append;
+    Random rnd(test::RandomSeed());
+    do {
+        Options options = CurrentOptions();
+        options.compaction_style = kTiered;
+        options.tiered_max_sorted_runs = 3;
+        options.merge_operator = &append;
+        Reopen(&options);
+        ModelDB model(options);
+        const int N = 2000;
+        const Snapshot* model_snap = nullptr;
+        const Snapshot* db_snap = nullptr;
+        std::string k, v;
+        for (int step = 0; step < N; step++) {
+            int p = rnd.Uniform(100);
+            if (p < 45) { // Put
+                k = RandomKey(&rnd);
+                v = RandomString(&rnd, rnd.Uniform(8));
+                ASSERT_MYDB_OK(model.Put(WriteOptions(), k, v));
+                ASSERT_MYDB_OK(db_->Put(WriteOptions(), k, v));
+            } else if (p < 70) { // Merge
+                k = RandomKey(&rnd);
+                v = RandomString(&rnd, rnd.Uniform(4));
+                ASSERT_MYDB_OK(model.Merge(WriteOptions(), k, v));
+                ASSERT_MYDB_OK(db_->Merge(WriteOptions(), k, v));
+            } else if (p < 95) { // Delete
+                k = RandomKey(&rnd);
+                ASSERT_MYDB_OK(model.Delete(WriteOptions(), k));
+                ASSERT_MYDB_OK(db_->Delete(WriteOptions(), k));
+            } else { // DeleteRange, possibly empty
+                std::string begin = RandomKey(&rnd);
+                std::string end = RandomKey(&rnd);
+                ASSERT_MYDB_OK(model.DeleteRange(WriteOptions(), begin, end));
+                ASSERT_MYDB_OK(db_->DeleteRange(WriteOptions(), begin, end));
+            }
+
+            // Flush often so that compactions merge many small runs.
+            if ((step % 50) == 0) {
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, nullptr, nullptr));
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, model_snap, db_snap));
+                if (model_snap != nullptr)
+                    model.ReleaseSnapshot(model_snap);
+                if (db_snap != nullptr)
+                    db_->ReleaseSnapshot(db_snap);
+
+                if ((step % 500) == 0) {
+                    Reopen(&options);
+                } else {
+                    dbfull()->TEST_CompactMemTable();
+                }
+                ASSERT_TRUE(
+                    CompareIterators(step, &model, db_, nullptr, nullptr));
+
+                model_snap = model.GetSnapshot();
+                db_snap = db_->GetSnapshot();
+            }
+        }
+        if (model_snap != nullptr)
+            model.ReleaseSnapshot(model_snap);
+        if (db_snap != nullptr)
+            db_->ReleaseSnapshot(db_snap);
+    } while (ChangeOptions());
+}
+
 } // namespace mydb
@@ -50,14 +50,20 @@ class InternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+enum ValueType {
+    kTypeDeletion = 0x0,
+    kTypeValue = 0x1,
+    kTypeRangeDeletion = 0x2,
+    kTypeMerge = 0x3,
+    kTypeBlobIndex = 0x4 // The value is a BlobIndex (see db/blob_file.h)
+};
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 typedef uint64_t SequenceNumber;
 
@@ -178,7 +184,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
     result->sequence = num >> 8;
     result->type = static_cast<ValueType>(c);
     result->user_key = Slice(internal_key.data(), n - 8);
-    return (c <= static_cast<uint8_t>(kTypeValue));
+    return (c <= static_cast<uint8_t>(kTypeBlobIndex));
 }
 
 // A helper class useful for DBImpl::Get()
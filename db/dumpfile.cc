@@ -4,6 +4,7 @@
 
 #include "mydb/dumpfile.h"
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
 #include "db/log_reader.h"
@@ -89,6 +90,22 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
         r += "'\n";
         dst_->Append(r);
     }
+    void DeleteRange(const Slice& begin, const Slice& end) override {
+        std::string r = "  del-range '";
+        AppendEscapedStringTo(&r, begin);
+        r += "' '";
+        AppendEscapedStringTo(&r, end);
+        r += "'\n";
+        dst_->Append(r);
+    }
+    void Merge(const Slice& key, const Slice& value) override {
+        std::string r = "  merge '";
+        AppendEscapedStringTo(&r, key);
+        r += "' '";
+        AppendEscapedStringTo(&r, value);
+        r += "'\n";
+        dst_->Append(r);
+    }
 
     WritableFile* dst_;
 };
@@ -190,12 +207,29 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
                 r += "del";
             } else if (key.type == kTypeValue) {
                 r += "val";
+            } else if (key.type == kTypeMerge) {
+                r += "merge";
+            } else if (key.type == kTypeBlobIndex) {
+                r += "blob";
             } else {
                 AppendNumberTo(&r, key.type);
             }
-            r += " => '";
-            AppendEscapedStringTo(&r, iter->value());
-            r += "'\n";
+            BlobIndex index;
+            if (key.type == kTypeBlobIndex &&
+                index.DecodeFrom(iter->value()).ok()) {
+                // E.g. "#12 @ 4096, 1000 bytes"
+                r += " => #";
+                AppendNumberTo(&r, index.file_number);
+                r += " @ ";
+                AppendNumberTo(&r, index.offset);
+                r += ", ";
+                AppendNumberTo(&r, index.size);
+                r += " bytes\n";
+            } else {
+                r += " => '";
+                AppendEscapedStringTo(&r, iter->value());
+                r += "'\n";
+            }
             dst->Append(r);
         }
     }
@@ -34,6 +34,11 @@ std::string TableFileName(const std::string& dbname, uint64_t number) {
     return MakeFileName(dbname, number, "ldb");
 }
 
+std::string BlobFileName(const std::string& dbname, uint64_t number) {
+    assert(number > 0);
+    return MakeFileName(dbname, number, "blob");
+}
+
 std::string SSTTableFileName(const std::string& dbname, uint64_t number) {
     assert(number > 0);
     return MakeFileName(dbname, number, "sst");
@@ -73,7 +78,7 @@ std::string OldInfoLogFileName(const std::string& dbname) {
 //    dbname/LOG
 //    dbname/LOG.old
 //    dbname/MANIFEST-[0-9]+
-//    dbname/[0-9]+.(log|sst|ldb)
+//    dbname/[0-9]+.(log|sst|ldb|blob)
 bool ParseFileName(const std::string& filename, uint64_t* number,
                    FileType* type) {
     Slice rest(filename);
@@ -109,6 +114,8 @@ bool ParseFileName(const std::string& filename, uint64_t* number,
             *type = kLogFile;
         } else if (suffix == Slice(".sst") || suffix == Slice(".ldb")) {
             *type = kTableFile;
+        } else if (suffix == Slice(".blob")) {
+            *type = kBlobFile;
         } else if (suffix == Slice(".dbtmp")) {
             *type = kTempFile;
         } else {
@@ -24,7 +24,8 @@ enum FileType {
     kDescriptorFile,
     kCurrentFile,
     kTempFile,
-    kInfoLogFile // Either the current one, or an old one
+    kInfoLogFile, // Either the current one, or an old one
+    kBlobFile
 };
 
 // Return the name of the log file with the specified number
@@ -37,6 +38,11 @@ std::string LogFileName(const std::string& dbname, uint64_t number);
 // "dbname".
 std::string TableFileName(const std::string& dbname, uint64_t number);
 
+// Return the name of the blob file with the specified number
+// in the db named by "dbname".  The result will be prefixed with
+// "dbname".
+std::string BlobFileName(const std::string& dbname, uint64_t number);
+
 // Return the legacy file name for an sstable with the specified number
 // in the db named by "dbname". The result will be prefixed with
 // "dbname".
@@ -18,9 +18,14 @@ enum RecordType {
     // For fragments
     kFirstType = 2,
     kMiddleType = 3,
-    kLastType = 4
+    kLastType = 4,
+
+    // Like kFullType and kFirstType, for a record whose payload is a
+    // compression type byte followed by the compressed contents.
+    kCompressedFullType = 5,
+    kCompressedFirstType = 6
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kCompressedFirstType;
 
 static const int kBlockSize = 32768;
 
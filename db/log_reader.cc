@@ -6,6 +6,7 @@
 
 #include "mydb/env.h"
 
+#include "table/format.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -18,8 +19,9 @@ Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
                uint64_t initial_offset)
     : file_(file), reporter_(reporter), checksum_(checksum),
       backing_store_(new char[kBlockSize]), buffer_(), eof_(false),
-      last_record_offset_(0), end_of_buffer_offset_(0),
-      initial_offset_(initial_offset), resyncing_(initial_offset > 0) {}
+      last_record_offset_(0), last_record_end_offset_(0),
+      end_of_buffer_offset_(0), initial_offset_(initial_offset),
+      resyncing_(initial_offset > 0) {}
 
 Reader::~Reader() { delete[] backing_store_; }
 
@@ -56,6 +58,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
     scratch->clear();
     record->clear();
     bool in_fragmented_record = false;
+    bool compressed = false; // The fragmented record is compressed
     // Record offset of the logical record that we're reading
     // 0 is a dummy value to make compilers happy
     uint64_t prospective_record_offset = 0;
@@ -84,6 +87,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
         switch (record_type) {
         case kFullType:
+        case kCompressedFullType:
             if (in_fragmented_record) {
                 // Handle bug in earlier versions of log::Writer where
                 // it could emit an empty kFirstType record at the tail end
@@ -97,10 +101,16 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
             prospective_record_offset = physical_record_offset;
             scratch->clear();
             *record = fragment;
+            if (record_type == kCompressedFullType &&
+                !UncompressRecord(record, scratch)) {
+                break;
+            }
             last_record_offset_ = prospective_record_offset;
+            last_record_end_offset_ = end_of_buffer_offset_ - buffer_.size();
             return true;
 
         case kFirstType:
+        case kCompressedFirstType:
             if (in_fragmented_record) {
                 // Handle bug in earlier versions of log::Writer where
                 // it could emit an empty kFirstType record at the tail end
@@ -114,6 +124,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
             prospective_record_offset = physical_record_offset;
             scratch->assign(fragment.data(), fragment.size());
             in_fragmented_record = true;
+            compressed = (record_type == kCompressedFirstType);
             break;
 
         case kMiddleType:
@@ -132,7 +143,13 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
             } else {
                 scratch->append(fragment.data(), fragment.size());
                 *record = Slice(*scratch);
+                if (compressed && !UncompressRecord(record, scratch)) {
+                    in_fragmented_record = false;
+                    break;
+                }
                 last_record_offset_ = prospective_record_offset;
+                last_record_end_offset_ =
+                    end_of_buffer_offset_ - buffer_.size();
                 return true;
             }
             break;
@@ -173,6 +190,28 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
 uint64_t Reader::LastRecordOffset() { return last_record_offset_; }
 
+uint64_t Reader::LastRecordEndOffset() { return last_record_end_offset_; }
+
+bool Reader::UncompressRecord(Slice* record, std::string* scratch) {
+    Status s;
+    if (record->empty()) {
+        s = Status::Corruption("missing compression type");
+    } else {
+        BlockContents contents;
+        s = UncompressBlock(Slice(record->data() + 1, record->size() - 1),
+                            (*record)[0], &contents);
+        if (s.ok()) {
+            scratch->assign(contents.data.data(), contents.data.size());
+            delete[] contents.data.data();
+            *record = Slice(*scratch);
+            return true;
+        }
+    }
+    ReportDrop(record->size(), s);
+    scratch->clear();
+    return false;
+}
+
 void Reader::ReportCorruption(uint64_t bytes, const char* reason) {
     ReportDrop(bytes, Status::Corruption(reason));
 }
@@ -5,6 +5,7 @@
 
 #include "db/log_format.h"
 #include <cstdint>
+#include <string>
 
 #include "mydb/slice.h"
 #include "mydb/status.h"
@@ -58,6 +59,13 @@ class Reader {
     // Undefined before the first call to ReadRecord.
     uint64_t LastRecordOffset();
 
+    // Returns the physical offset just past the last record returned by
+    // ReadRecord, where a new Reader can resume reading a file that is
+    // still being appended to.
+    //
+    // Undefined before the first call to ReadRecord.
+    uint64_t LastRecordEndOffset();
+
   private:
     // Extend record types with the following special values
     enum {
@@ -79,6 +87,11 @@ class Reader {
     // Return type, or one of the preceding special values
     unsigned int ReadPhysicalRecord(Slice* result);
 
+    // Replace the compressed record in *record with its uncompressed
+    // contents, stored in *scratch.  Reports a corruption and returns
+    // false if that fails.
+    bool UncompressRecord(Slice* record, std::string* scratch);
+
     // Reports dropped bytes to the reporter.
     // buffer_ must be updated to remove the dropped bytes prior to invocation.
     void ReportCorruption(uint64_t bytes, const char* reason);
@@ -93,6 +106,8 @@ class Reader {
 
     // Offset of the last record returned by ReadRecord.
     uint64_t last_record_offset_;
+    // Offset just past the end of the last record returned by ReadRecord.
+    uint64_t last_record_end_offset_;
     // Offset of the first location past the end of buffer_.
     uint64_t end_of_buffer_offset_;
 
@@ -5,6 +5,7 @@
 
 #include "mydb/env.h"
 
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 #include "util/random.h"
@@ -54,6 +55,10 @@ class LogTest : public testing::Test {
         writer_ = new Writer(&dest_, dest_.contents_.size());
     }
 
+    void SetCompression(CompressionType type, size_t min_size) {
+        writer_->SetCompression(type, 1, min_size);
+    }
+
     void Write(const std::string& msg) {
         ASSERT_TRUE(!reading_) << "Write() after starting to read";
         writer_->AddRecord(Slice(msg));
@@ -162,6 +167,34 @@ class LogTest : public testing::Test {
         delete offset_reader;
     }
 
+    void CheckResumingAfterEachRecord() {
+        WriteInitialOffsetLog();
+        ASSERT_EQ(WrittenBytes(), writer_->file_size());
+        reading_ = true;
+        source_.contents_ = Slice(dest_.contents_);
+        for (int i = 0; i < num_initial_offset_records_; i++) {
+            Slice record;
+            std::string scratch;
+            ASSERT_TRUE(reader_->ReadRecord(&record, &scratch));
+
+            // A new reader that starts where this record ends returns the
+            // next record.
+            StringSource source;
+            source.contents_ = Slice(dest_.contents_);
+            Reader resumed(&source, &report_, true /*checksum*/,
+                           reader_->LastRecordEndOffset());
+            if (i + 1 < num_initial_offset_records_) {
+                ASSERT_TRUE(resumed.ReadRecord(&record, &scratch));
+                ASSERT_EQ(initial_offset_last_record_offsets_[i + 1],
+                          resumed.LastRecordOffset());
+            } else {
+                ASSERT_EQ(WrittenBytes(), reader_->LastRecordEndOffset());
+                ASSERT_TRUE(!resumed.ReadRecord(&record, &scratch));
+            }
+        }
+        ASSERT_EQ(0, DroppedBytes());
+    }
+
   private:
     class StringDest : public WritableFile {
       public:
@@ -386,6 +419,75 @@ TEST_F(LogTest, BadRecordType) {
     ASSERT_EQ("OK", MatchError("unknown record type"));
 }
 
+// A string of random lowercase letters, which compresses to about 60%.
+static std::string LowercaseString(size_t n, Random* rnd) {
+    std::string result;
+    for (size_t i = 0; i < n; i++) {
+        result.push_back(static_cast<char>('a' + rnd->Uniform(26)));
+    }
+    return result;
+}
+
+static bool ZstdSupported() {
+    std::string compressed;
+    return port::Zstd_Compress(1, "x", 1, &compressed);
+}
+
+TEST_F(LogTest, CompressedRecords) {
+    if (!ZstdSupported()) {
+        GTEST_SKIP() << "zstd compression not supported";
+    }
+    SetCompression(kZstdCompression, 1000);
+    Random rnd(301);
+    const std::string small = LowercaseString(999, &rnd);
+    const std::string medium = LowercaseString(5000, &rnd);
+    const std::string large = LowercaseString(3 * kBlockSize, &rnd);
+    Write(small);
+    Write(medium);
+    Write(large);
+    Write(std::string(2000, 'x'));
+    Write("");
+    ASSERT_LT(WrittenBytes(), small.size() + (medium.size() + large.size()) *
+                                                 7 / 10);
+    ASSERT_EQ(small, Read());
+    ASSERT_EQ(medium, Read());
+    ASSERT_EQ(large, Read());
+    ASSERT_EQ(std::string(2000, 'x'), Read());
+    ASSERT_EQ("", Read());
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, IncompressibleRecordIsStoredRaw) {
+    SetCompression(kZstdCompression, 0);
+    Random rnd(301);
+    std::string data;
+    for (int i = 0; i < 1000; i++) {
+        data.push_back(static_cast<char>(rnd.Uniform(256)));
+    }
+    Write(data);
+    ASSERT_EQ(kHeaderSize + data.size(), WrittenBytes());
+    ASSERT_EQ(data, Read());
+    ASSERT_EQ("EOF", Read());
+}
+
+TEST_F(LogTest, BadCompressionType) {
+    if (!ZstdSupported()) {
+        GTEST_SKIP() << "zstd compression not supported";
+    }
+    SetCompression(kZstdCompression, 0);
+    Write(std::string(1000, 'x'));
+    Write("foo");
+    const int length = static_cast<int>(WrittenBytes() - 2 * kHeaderSize - 3);
+    // The compression type is the first byte of the payload.
+    SetByte(kHeaderSize, 0x7f);
+    FixChecksum(0, length);
+    ASSERT_EQ("foo", Read());
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(length, DroppedBytes());
+    ASSERT_EQ("OK", MatchError("bad block type"));
+}
+
 TEST_F(LogTest, TruncatedTrailingRecordIsIgnored) {
     Write("foo");
     ShrinkSize(4); // Drop all payload as well as a header byte
@@ -555,6 +657,8 @@ TEST_F(LogTest, ReadInitialOffsetIntoBlockPadding) {
     CheckInitialOffsetRecord(3 * log::kBlockSize - 3, 5);
 }
 
+TEST_F(LogTest, ResumeAfterEachRecord) { CheckResumingAfterEachRecord(); }
+
 TEST_F(LogTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(LogTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
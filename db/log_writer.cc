@@ -6,6 +6,7 @@
 
 #include "mydb/env.h"
 
+#include "table/format.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -19,20 +20,47 @@ static void InitTypeCrc(uint32_t* type_crc) {
     }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
+Writer::Writer(WritableFile* dest)
+    : dest_(dest), block_offset_(0), file_size_(0),
+      compression_(kNoCompression), zstd_compression_level_(0),
+      compression_min_size_(0) {
     InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : dest_(dest), block_offset_(dest_length % kBlockSize),
+      file_size_(dest_length), compression_(kNoCompression),
+      zstd_compression_level_(0), compression_min_size_(0) {
     InitTypeCrc(type_crc_);
 }
 
 Writer::~Writer() = default;
 
+void Writer::SetCompression(CompressionType type, int zstd_compression_level,
+                            size_t min_size) {
+    compression_ = type;
+    zstd_compression_level_ = zstd_compression_level;
+    compression_min_size_ = min_size;
+}
+
 Status Writer::AddRecord(const Slice& slice) {
-    const char* ptr = slice.data();
-    size_t left = slice.size();
+    Slice payload = slice;
+    bool compressed = false;
+    if (compression_ != kNoCompression &&
+        slice.size() >= compression_min_size_) {
+        std::string output;
+        CompressionType type = compression_;
+        CompressBlock(slice, zstd_compression_level_, &output, &type);
+        if (type != kNoCompression) {
+            compressed_.assign(1, static_cast<char>(type));
+            compressed_.append(output);
+            payload = compressed_;
+            compressed = true;
+        }
+    }
+
+    const char* ptr = payload.data();
+    size_t left = payload.size();
 
     // Fragment the record if necessary and emit it.  Note that if slice
     // is empty, we still want to iterate once to emit a single
@@ -49,6 +77,7 @@ Status Writer::AddRecord(const Slice& slice) {
                 // 7)
                 static_assert(kHeaderSize == 7, "");
                 dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+                file_size_ += leftover;
             }
             block_offset_ = 0;
         }
@@ -62,9 +91,9 @@ Status Writer::AddRecord(const Slice& slice) {
         RecordType type;
         const bool end = (left == fragment_length);
         if (begin && end) {
-            type = kFullType;
+            type = compressed ? kCompressedFullType : kFullType;
         } else if (begin) {
-            type = kFirstType;
+            type = compressed ? kCompressedFirstType : kFirstType;
         } else if (end) {
             type = kLastType;
         } else {
@@ -104,6 +133,7 @@ Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
         }
     }
     block_offset_ += kHeaderSize + length;
+    file_size_ += kHeaderSize + length;
     return s;
 }
 
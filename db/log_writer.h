@@ -5,7 +5,9 @@
 
 #include "db/log_format.h"
 #include <cstdint>
+#include <string>
 
+#include "mydb/options.h"
 #include "mydb/slice.h"
 #include "mydb/status.h"
 
@@ -32,13 +34,29 @@ class Writer {
 
     ~Writer();
 
+    // Compress records of at least "min_size" bytes that AddRecord() is
+    // given from now on with "type", when that saves enough space.
+    // Readers of versions without compressed records drop such records
+    // as corrupted.
+    void SetCompression(CompressionType type, int zstd_compression_level,
+                        size_t min_size);
+
     Status AddRecord(const Slice& slice);
 
+    // Length of "*dest", including the records added so far.
+    uint64_t file_size() const { return file_size_; }
+
   private:
     Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
 
     WritableFile* dest_;
     int block_offset_; // Current offset in block
+    uint64_t file_size_;
+
+    CompressionType compression_;
+    int zstd_compression_level_;
+    size_t compression_min_size_;
+    std::string compressed_; // Payload of the current compressed record
 
     // crc32c values for all supported record types.  These are
     // pre-computed to reduce the overhead of computing the crc of the
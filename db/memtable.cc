@@ -3,6 +3,7 @@
 #include "db/memtable.h"
 
 #include "db/dbformat.h"
+#include "db/merge_context.h"
 
 #include "mydb/comparator.h"
 #include "mydb/env.h"
@@ -20,7 +21,8 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 }
 
 MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+    : comparator_(comparator), refs_(0), table_(comparator_, &arena_),
+      range_del_table_(comparator_, &arena_) {}
 
 MemTable::~MemTable() { assert(refs_ == 0); }
 
@@ -74,6 +76,12 @@ class MemTableIterator : public Iterator {
 
 Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
+Iterator* MemTable::NewRangeTombstoneIterator() {
+    Table::Iterator iter(&range_del_table_);
+    iter.SeekToFirst();
+    return iter.Valid() ? new MemTableIterator(&range_del_table_) : nullptr;
+}
+
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
     // Format of an entry is concatenation of:
@@ -97,14 +105,43 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
     p = EncodeVarint32(p, val_size);
     std::memcpy(p, value.data(), val_size);
     assert(p + val_size == buf + encoded_len);
-    table_.Insert(buf);
+    if (type == kTypeRangeDeletion) {
+        range_del_table_.Insert(buf);
+    } else {
+        table_.Insert(buf);
+    }
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   SequenceNumber* max_covering_tombstone_seq,
+                   MergeContext* merge_context) {
+    const Comparator* ucmp = comparator_.comparator.user_comparator();
+    const SequenceNumber snapshot =
+        DecodeFixed64(key.internal_key().data() + key.user_key().size()) >> 8;
+
+    // Tombstones are sorted by their beginning, so only those up to the
+    // first one starting after the key can cover it.
+    Table::Iterator tombstones(&range_del_table_);
+    for (tombstones.SeekToFirst(); tombstones.Valid(); tombstones.Next()) {
+        const char* entry = tombstones.key();
+        uint32_t key_length;
+        const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
+        Slice begin(key_ptr, key_length - 8);
+        if (ucmp->Compare(begin, key.user_key()) > 0) {
+            break;
+        }
+        const SequenceNumber seq =
+            DecodeFixed64(key_ptr + key_length - 8) >> 8;
+        Slice end = GetLengthPrefixedSlice(key_ptr + key_length);
+        if (seq <= snapshot && seq > *max_covering_tombstone_seq &&
+            ucmp->Compare(key.user_key(), end) < 0) {
+            *max_covering_tombstone_seq = seq;
+        }
+    }
+
     Slice memkey = key.memtable_key();
     Table::Iterator iter(&table_);
-    iter.Seek(memkey.data());
-    if (iter.Valid()) {
+    for (iter.Seek(memkey.data()); iter.Valid(); iter.Next()) {
         // entry format is:
         //    klength  varint32
         //    userkey  char[klength]
@@ -117,20 +154,40 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
         const char* entry = iter.key();
         uint32_t key_length;
         const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
-        if (comparator_.comparator.user_comparator()->Compare(
-                Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
-            // Correct user key
-            const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-            switch (static_cast<ValueType>(tag & 0xff)) {
-            case kTypeValue: {
-                Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        Slice user_key(key_ptr, key_length - 8);
+        if (ucmp->Compare(user_key, key.user_key()) != 0) {
+            break;
+        }
+        // Correct user key
+        const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+        ValueType type = static_cast<ValueType>(tag & 0xff);
+        if ((tag >> 8) < *max_covering_tombstone_seq) {
+            type = kTypeDeletion;
+        }
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        switch (type) {
+        case kTypeValue:
+            if (merge_context->empty()) {
                 value->assign(v.data(), v.size());
-                return true;
+            } else {
+                *s = merge_context->Merge(key.user_key(), &v, value);
             }
-            case kTypeDeletion:
+            return true;
+        case kTypeDeletion:
+            if (merge_context->empty()) {
                 *s = Status::NotFound(Slice());
-                return true;
+            } else {
+                *s = merge_context->Merge(key.user_key(), nullptr, value);
             }
+            return true;
+        case kTypeMerge:
+            // Keep looking for the value the operand applies to.
+            merge_context->AddOlderOperand(v);
+            break;
+        case kTypeRangeDeletion:
+        case kTypeBlobIndex:
+            // Never stored in a memtable.
+            return false;
         }
     }
     return false;
@@ -15,6 +15,7 @@ namespace mydb {
 
 class InternalKeyComparator;
 class MemTableIterator;
+class MergeContext;
 
 class MemTable {
   public:
@@ -49,17 +50,35 @@ class MemTable {
     // db/format.{h,cc} module.
     Iterator* NewIterator();
 
+    // Return an iterator over the range tombstones in the memtable, in the
+    // encoding described in db/range_tombstone.h, or nullptr if there are
+    // none.  The same lifetime rules apply as for NewIterator().
+    Iterator* NewRangeTombstoneIterator();
+
     // Add an entry into memtable that maps key to value at the
     // specified sequence number and with the specified type.
-    // Typically value will be empty if type==kTypeDeletion.
+    // Typically value will be empty if type==kTypeDeletion.  For
+    // type==kTypeRangeDeletion, key and value are the beginning and end
+    // of the deleted range.
     void Add(SequenceNumber seq, ValueType type, const Slice& key,
              const Slice& value);
 
-    // If memtable contains a value for key, store it in *value and return true.
-    // If memtable contains a deletion for key, store a NotFound() error
-    // in *status and return true.
+    // Raise *max_covering_tombstone_seq to the sequence number of the
+    // newest range tombstone in the memtable that covers the key and is
+    // visible at the sequence number of the lookup.
+    //
+    // Merge operands for key are added to *merge_context, newest first.
+    //
+    // If memtable contains a value for key, store it (with the operands
+    // applied) in *value and return true.
+    // If memtable contains a deletion for key, or an entry older than
+    // *max_covering_tombstone_seq, store the operands applied to no value
+    // in *value, or a NotFound() error in *status if there are none, and
+    // return true.
     // Else, return false.
-    bool Get(const LookupKey& key, std::string* value, Status* s);
+    bool Get(const LookupKey& key, std::string* value, Status* s,
+             SequenceNumber* max_covering_tombstone_seq,
+             MergeContext* merge_context);
 
   private:
     friend class MemTableIterator;
@@ -80,6 +99,7 @@ class MemTable {
     int refs_;
     Arena arena_;
     Table table_;
+    Table range_del_table_; // Range tombstones, kept out of table_
 };
 
 } // namespace mydb
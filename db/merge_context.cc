@@ -0,0 +1,47 @@
+
+
+#include "db/merge_context.h"
+
+#include <cassert>
+#include <vector>
+
+#include "mydb/merge_operator.h"
+
+namespace mydb {
+
+Status MergeContext::Merge(const Slice& user_key, const Slice* base,
+                           std::string* value) const {
+    assert(!operands_.empty());
+    if (merge_operator_ == nullptr) {
+        return Status::NotSupported("merge operand without a merge operator",
+                                    user_key);
+    }
+    std::vector<Slice> operands(operands_.begin(), operands_.end());
+    std::string result;
+    if (!merge_operator_->FullMerge(user_key, base, operands, &result)) {
+        return Status::Corruption("merge operator failed for", user_key);
+    }
+    value->swap(result);
+    return Status::OK();
+}
+
+bool MergeContext::PartialMerge(const Slice& user_key,
+                                std::string* operand) const {
+    assert(!operands_.empty());
+    if (merge_operator_ == nullptr) {
+        return false;
+    }
+    std::string result = operands_.front();
+    std::string combined;
+    for (size_t i = 1; i < operands_.size(); i++) {
+        if (!merge_operator_->PartialMerge(user_key, result, operands_[i],
+                                           &combined)) {
+            return false;
+        }
+        result.swap(combined);
+    }
+    operand->swap(result);
+    return true;
+}
+
+} // namespace mydb
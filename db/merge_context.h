@@ -0,0 +1,63 @@
+
+
+// A MergeContext gathers the merge operands of a single key while a read
+// walks its entries, and applies them to the value they are stacked on
+// once that value (or its absence) is known.
+
+#ifndef STORAGE_MYDB_DB_MERGE_CONTEXT_H_
+#define STORAGE_MYDB_DB_MERGE_CONTEXT_H_
+
+#include <deque>
+#include <string>
+
+#include "mydb/slice.h"
+#include "mydb/status.h"
+
+namespace mydb {
+
+class MergeOperator;
+
+class MergeContext {
+  public:
+    // "merge_operator" may be nullptr, in which case merging fails.
+    explicit MergeContext(const MergeOperator* merge_operator)
+        : merge_operator_(merge_operator) {}
+
+    MergeContext(const MergeContext&) = delete;
+    MergeContext& operator=(const MergeContext&) = delete;
+
+    // Add an operand older than every operand added so far.  Used when
+    // walking entries from newest to oldest.
+    void AddOlderOperand(const Slice& operand) {
+        operands_.push_front(operand.ToString());
+    }
+
+    // Add an operand newer than every operand added so far.  Used when
+    // walking entries from oldest to newest.
+    void AddNewerOperand(const Slice& operand) {
+        operands_.push_back(operand.ToString());
+    }
+
+    bool empty() const { return operands_.empty(); }
+    size_t size() const { return operands_.size(); }
+    void Clear() { operands_.clear(); }
+
+    // Apply the operands to *base, or to no value if base is nullptr, and
+    // store the result in *value.
+    // REQUIRES: !empty()
+    Status Merge(const Slice& user_key, const Slice* base,
+                 std::string* value) const;
+
+    // Combine all operands into a single operand stored in *operand.
+    // Returns false if the merge operator could not combine some pair.
+    // REQUIRES: !empty()
+    bool PartialMerge(const Slice& user_key, std::string* operand) const;
+
+  private:
+    const MergeOperator* const merge_operator_;
+    std::deque<std::string> operands_; // Oldest first
+};
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_DB_MERGE_CONTEXT_H_
@@ -0,0 +1,119 @@
+
+
+#include "db/paced_file.h"
+
+#include "mydb/env.h"
+
+namespace mydb {
+
+namespace {
+
+class PacedWritableFile final : public WritableFile {
+  public:
+    PacedWritableFile(WritableFile* base, uint64_t file_size,
+                      uint64_t bytes_per_sync,
+                      uint64_t preallocation_block_size,
+                      RateLimiter* rate_limiter,
+                      RateLimiter::Priority priority)
+        : base_(base), rate_limiter_(rate_limiter), priority_(priority),
+          bytes_per_sync_(bytes_per_sync),
+          preallocation_block_size_(preallocation_block_size),
+          size_(file_size), synced_(file_size), allocated_(file_size) {}
+
+    ~PacedWritableFile() override { delete base_; }
+
+    Status Append(const Slice& data) override {
+        if (rate_limiter_ != nullptr) {
+            rate_limiter_->Request(data.size(), priority_);
+        }
+        if (preallocation_block_size_ > 0 &&
+            size_ + data.size() > allocated_) {
+            Preallocate(size_ + data.size());
+        }
+        Status s = base_->Append(data);
+        if (!s.ok()) {
+            return s;
+        }
+        size_ += data.size();
+        if (bytes_per_sync_ > 0 && size_ - synced_ >= bytes_per_sync_) {
+            s = SyncRange();
+        }
+        return s;
+    }
+
+    Status Close() override { return base_->Close(); }
+
+    Status Flush() override { return base_->Flush(); }
+
+    Status Sync() override {
+        Status s = base_->Sync();
+        if (s.ok()) {
+            synced_ = size_;
+        }
+        return s;
+    }
+
+    Status Allocate(uint64_t offset, uint64_t len) override {
+        return base_->Allocate(offset, len);
+    }
+
+    Status RangeSync(uint64_t offset, uint64_t len) override {
+        return base_->RangeSync(offset, len);
+    }
+
+  private:
+    // Reserve space up to at least "end", rounded up to a whole number
+    // of blocks.  Failing to do so only costs performance.
+    void Preallocate(uint64_t end) {
+        const uint64_t blocks = (end + preallocation_block_size_ - 1) /
+                                preallocation_block_size_;
+        const uint64_t new_allocated = blocks * preallocation_block_size_;
+        if (base_->Allocate(allocated_, new_allocated - allocated_).ok()) {
+            allocated_ = new_allocated;
+        } else {
+            preallocation_block_size_ = 0;
+        }
+    }
+
+    // Start writing out the data appended since the last sync.
+    Status SyncRange() {
+        Status s = base_->Flush();
+        if (s.ok()) {
+            s = base_->RangeSync(synced_, size_ - synced_);
+        }
+        if (s.ok()) {
+            synced_ = size_;
+        } else if (s.IsNotSupportedError()) {
+            bytes_per_sync_ = 0;
+            s = Status::OK();
+        }
+        return s;
+    }
+
+    WritableFile* const base_;
+    RateLimiter* const rate_limiter_;
+    const RateLimiter::Priority priority_;
+    uint64_t bytes_per_sync_;
+    uint64_t preallocation_block_size_;
+    uint64_t size_;      // Bytes in the file, including unflushed ones
+    uint64_t synced_;    // Bytes handed to RangeSync() or Sync()
+    uint64_t allocated_; // Bytes reserved with Allocate()
+};
+
+} // namespace
+
+WritableFile* NewPacedWritableFile(WritableFile* base, uint64_t file_size,
+                                   uint64_t bytes_per_sync,
+                                   uint64_t preallocation_block_size,
+                                   RateLimiter* rate_limiter,
+                                   RateLimiter::Priority priority) {
+    if (bytes_per_sync == 0 && preallocation_block_size == 0 &&
+        rate_limiter == nullptr) {
+        return base;
+    }
+    return new PacedWritableFile(base, file_size, bytes_per_sync,
+                                 preallocation_block_size, rate_limiter,
+                                 priority);
+}
+
+} // namespace mydb
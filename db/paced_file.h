@@ -0,0 +1,40 @@
+
+
+// A WritableFile wrapper that spreads out the cost of writing a file to
+// stable storage.  Without it, the data of a table or a log file sits in
+// the page cache until the final Sync(), which then has to write all of
+// it at once and stalls the writer; the file also grows one extent at a
+// time as the filesystem finds room for it.  The wrapper can also hold
+// background writes to the rate of a RateLimiter.
+
+#ifndef STORAGE_MYDB_DB_PACED_FILE_H_
+#define STORAGE_MYDB_DB_PACED_FILE_H_
+
+#include <cstdint>
+
+#include "mydb/rate_limiter.h"
+
+namespace mydb {
+
+class WritableFile;
+
+// Return a file that appends to "base", which already holds "file_size"
+// bytes, and takes ownership of it.
+//
+// Every "bytes_per_sync" bytes, the data appended since the last sync
+// is flushed and handed to base->RangeSync(), so the operating system
+// writes it out in the background.  Space is reserved with
+// base->Allocate() in chunks of "preallocation_block_size" bytes ahead
+// of the data.  Either is disabled by a value of zero, and is given up
+// if "base" does not support it.  If "rate_limiter" is non-null, every
+// append is charged to it with "priority" first.  Returns "base" itself
+// if none of this is enabled.
+WritableFile* NewPacedWritableFile(WritableFile* base, uint64_t file_size,
+                                   uint64_t bytes_per_sync,
+                                   uint64_t preallocation_block_size,
+                                   RateLimiter* rate_limiter,
+                                   RateLimiter::Priority priority);
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_DB_PACED_FILE_H_
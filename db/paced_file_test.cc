@@ -0,0 +1,125 @@
+
+
+#include "db/paced_file.h"
+
+#include <vector>
+
+#include "mydb/env.h"
+
+#include "gtest/gtest.h"
+
+namespace mydb {
+
+// Records the calls made to it.
+class RecordingFile : public WritableFile {
+  public:
+    explicit RecordingFile(bool supported) : supported_(supported) {}
+
+    Status Append(const Slice& data) override { return Status::OK(); }
+    Status Close() override { return Status::OK(); }
+    Status Flush() override { return Status::OK(); }
+    Status Sync() override { return Status::OK(); }
+
+    Status Allocate(uint64_t offset, uint64_t len) override {
+        allocations.push_back(Range{offset, len});
+        return supported_ ? Status::OK() : Status::NotSupported("Allocate");
+    }
+
+    Status RangeSync(uint64_t offset, uint64_t len) override {
+        syncs.push_back(Range{offset, len});
+        return supported_ ? Status::OK() : Status::NotSupported("RangeSync");
+    }
+
+    struct Range {
+        uint64_t offset;
+        uint64_t len;
+    };
+
+    std::vector<Range> allocations;
+    std::vector<Range> syncs;
+
+  private:
+    const bool supported_;
+};
+
+TEST(PacedFileTest, Disabled) {
+    RecordingFile* base = new RecordingFile(true);
+    WritableFile* file = NewPacedWritableFile(base, 0, 0, 0, nullptr,
+                                              RateLimiter::Priority::kHigh);
+    ASSERT_EQ(base, file);
+    delete file;
+}
+
+TEST(PacedFileTest, SyncsEveryBytesPerSync) {
+    RecordingFile* base = new RecordingFile(true);
+    WritableFile* file = NewPacedWritableFile(base, 0, 1000, 0, nullptr,
+                                              RateLimiter::Priority::kHigh);
+    std::string data(300, 'x');
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(file->Append(data).ok());
+    }
+    // Synced after 1200 and 2400 bytes.
+    ASSERT_EQ(2, base->syncs.size());
+    ASSERT_EQ(0, base->syncs[0].offset);
+    ASSERT_EQ(1200, base->syncs[0].len);
+    ASSERT_EQ(1200, base->syncs[1].offset);
+    ASSERT_EQ(1200, base->syncs[1].len);
+    ASSERT_TRUE(base->allocations.empty());
+
+    // A full sync restarts the count.
+    ASSERT_TRUE(file->Sync().ok());
+    ASSERT_TRUE(file->Append(std::string(999, 'x')).ok());
+    ASSERT_EQ(2, base->syncs.size());
+    ASSERT_TRUE(file->Append(data).ok());
+    ASSERT_EQ(3, base->syncs.size());
+    ASSERT_EQ(3000, base->syncs[2].offset);
+    ASSERT_EQ(1299, base->syncs[2].len);
+    delete file;
+}
+
+TEST(PacedFileTest, PreallocatesInBlocks) {
+    RecordingFile* base = new RecordingFile(true);
+    // The file already holds 1500 bytes.
+    WritableFile* file = NewPacedWritableFile(base, 1500, 0, 1000, nullptr,
+                                              RateLimiter::Priority::kHigh);
+    ASSERT_TRUE(file->Append(std::string(400, 'x')).ok());
+    ASSERT_EQ(1, base->allocations.size());
+    ASSERT_EQ(1500, base->allocations[0].offset);
+    ASSERT_EQ(500, base->allocations[0].len);
+    ASSERT_TRUE(file->Append(std::string(100, 'x')).ok());
+    ASSERT_EQ(1, base->allocations.size());
+    ASSERT_TRUE(file->Append(std::string(2500, 'x')).ok());
+    ASSERT_EQ(2, base->allocations.size());
+    ASSERT_EQ(2000, base->allocations[1].offset);
+    ASSERT_EQ(3000, base->allocations[1].len);
+    ASSERT_TRUE(base->syncs.empty());
+    delete file;
+}
+
+TEST(PacedFileTest, GivesUpIfNotSupported) {
+    RecordingFile* base = new RecordingFile(false);
+    WritableFile* file = NewPacedWritableFile(base, 0, 100, 100, nullptr,
+                                              RateLimiter::Priority::kHigh);
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(file->Append(std::string(100, 'x')).ok());
+    }
+    ASSERT_EQ(1, base->allocations.size());
+    ASSERT_EQ(1, base->syncs.size());
+    delete file;
+}
+
+TEST(PacedFileTest, ChargesRateLimiter) {
+    RateLimiter* limiter = NewGenericRateLimiter(1 << 30);
+    RecordingFile* base = new RecordingFile(true);
+    WritableFile* file = NewPacedWritableFile(base, 0, 0, 0, limiter,
+                                              RateLimiter::Priority::kLow);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(file->Append(std::string(1000, 'x')).ok());
+    }
+    ASSERT_EQ(3000, limiter->GetTotalBytesThrough(RateLimiter::Priority::kLow));
+    ASSERT_EQ(0, limiter->GetTotalBytesThrough(RateLimiter::Priority::kHigh));
+    delete file;
+    delete limiter;
+}
+
+} // namespace mydb
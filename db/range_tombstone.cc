@@ -0,0 +1,97 @@
+
+
+#include "db/range_tombstone.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "mydb/comparator.h"
+#include "mydb/iterator.h"
+
+namespace mydb {
+
+RangeTombstoneList::RangeTombstoneList(const Comparator* user_comparator)
+    : user_comparator_(user_comparator), finished_(false) {}
+
+void RangeTombstoneList::Add(const RangeTombstone& tombstone) {
+    assert(!finished_);
+    tombstones_.push_back(tombstone);
+}
+
+Status RangeTombstoneList::AddAll(Iterator* iter) {
+    assert(!finished_);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        ParsedInternalKey ikey;
+        if (!ParseInternalKey(iter->key(), &ikey) ||
+            ikey.type != kTypeRangeDeletion) {
+            return Status::Corruption("bad range tombstone");
+        }
+        tombstones_.push_back(
+            RangeTombstone(ikey.user_key, iter->value(), ikey.sequence));
+    }
+    return iter->status();
+}
+
+void RangeTombstoneList::Finish() {
+    assert(!finished_);
+    finished_ = true;
+
+    const Comparator* ucmp = user_comparator_;
+    auto less = [ucmp](const std::string& a, const std::string& b) {
+        return ucmp->Compare(a, b) < 0;
+    };
+    auto equal = [ucmp](const std::string& a, const std::string& b) {
+        return ucmp->Compare(a, b) == 0;
+    };
+    for (const RangeTombstone& t : tombstones_) {
+        if (ucmp->Compare(t.begin, t.end) < 0) {
+            bounds_.push_back(t.begin);
+            bounds_.push_back(t.end);
+        }
+    }
+    std::sort(bounds_.begin(), bounds_.end(), less);
+    bounds_.erase(std::unique(bounds_.begin(), bounds_.end(), equal),
+                  bounds_.end());
+
+    sequences_.resize(bounds_.empty() ? 0 : bounds_.size() - 1);
+    for (const RangeTombstone& t : tombstones_) {
+        if (ucmp->Compare(t.begin, t.end) >= 0) {
+            continue;
+        }
+        size_t first =
+            std::lower_bound(bounds_.begin(), bounds_.end(), t.begin, less) -
+            bounds_.begin();
+        size_t last =
+            std::lower_bound(bounds_.begin(), bounds_.end(), t.end, less) -
+            bounds_.begin();
+        for (size_t i = first; i < last; i++) {
+            sequences_[i].push_back(t.sequence);
+        }
+    }
+    for (std::vector<SequenceNumber>& seqs : sequences_) {
+        std::sort(seqs.begin(), seqs.end(), std::greater<SequenceNumber>());
+    }
+}
+
+SequenceNumber
+RangeTombstoneList::MaxCoveringSequence(const Slice& user_key,
+                                        SequenceNumber snapshot) const {
+    assert(finished_);
+    const Comparator* ucmp = user_comparator_;
+    // Find the last fragment starting at or before user_key.
+    auto iter = std::upper_bound(
+        bounds_.begin(), bounds_.end(), user_key,
+        [ucmp](const Slice& a, const std::string& b) {
+            return ucmp->Compare(a, b) < 0;
+        });
+    if (iter == bounds_.begin() || iter == bounds_.end()) {
+        return 0;
+    }
+    const std::vector<SequenceNumber>& seqs =
+        sequences_[iter - bounds_.begin() - 1];
+    auto visible = std::lower_bound(seqs.begin(), seqs.end(), snapshot,
+                                    std::greater<SequenceNumber>());
+    return visible == seqs.end() ? 0 : *visible;
+}
+
+} // namespace mydb
@@ -0,0 +1,92 @@
+
+
+// A range tombstone hides every key in [begin, end) written before the
+// tombstone's sequence number.  Tombstones are kept apart from point
+// entries: memtables hold them in a separate skiplist and tables in a
+// meta block.  Both store a tombstone as the internal key
+// (begin, sequence, kTypeRangeDeletion) mapping to the value "end".
+
+#ifndef STORAGE_MYDB_DB_RANGE_TOMBSTONE_H_
+#define STORAGE_MYDB_DB_RANGE_TOMBSTONE_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+
+namespace mydb {
+
+class Iterator;
+
+struct RangeTombstone {
+    RangeTombstone() : sequence(0) {}
+    RangeTombstone(const Slice& b, const Slice& e, SequenceNumber s)
+        : begin(b.ToString()), end(e.ToString()), sequence(s) {}
+
+    // The internal key this tombstone is stored under.
+    InternalKey StartKey() const {
+        return InternalKey(begin, sequence, kTypeRangeDeletion);
+    }
+
+    // An internal key that sorts after every key the tombstone covers and
+    // before every real entry for "end".  Used as a file's largest key.
+    InternalKey EndKey() const {
+        return InternalKey(end, kMaxSequenceNumber, kTypeRangeDeletion);
+    }
+
+    std::string begin;
+    std::string end;
+    SequenceNumber sequence;
+};
+
+// A set of range tombstones that can be queried by user key.
+//
+// Tombstones are added first; Finish() then splits them at every begin
+// and end point into non-overlapping fragments so that a lookup is a
+// binary search.  A finished list is immutable and safe to share between
+// threads.
+class RangeTombstoneList {
+  public:
+    explicit RangeTombstoneList(const Comparator* user_comparator);
+
+    RangeTombstoneList(const RangeTombstoneList&) = delete;
+    RangeTombstoneList& operator=(const RangeTombstoneList&) = delete;
+
+    // REQUIRES: Finish() has not been called.
+    void Add(const RangeTombstone& tombstone);
+
+    // Add every tombstone yielded by *iter, which must be in the encoding
+    // described above.
+    // REQUIRES: Finish() has not been called.
+    Status AddAll(Iterator* iter);
+
+    void Finish();
+
+    bool empty() const { return tombstones_.empty(); }
+
+    // The tombstones in the order they were added.
+    const std::vector<RangeTombstone>& tombstones() const {
+        return tombstones_;
+    }
+
+    // Return the largest sequence number no greater than "snapshot" of a
+    // tombstone covering user_key, or zero if there is none.  An entry for
+    // user_key is deleted iff its sequence number is below the result.
+    // REQUIRES: Finish() has been called.
+    SequenceNumber MaxCoveringSequence(const Slice& user_key,
+                                       SequenceNumber snapshot) const;
+
+  private:
+    const Comparator* const user_comparator_;
+    std::vector<RangeTombstone> tombstones_;
+
+    // Fragment i covers [bounds_[i], bounds_[i + 1]) and lists the sequence
+    // numbers of the tombstones covering it in decreasing order.
+    std::vector<std::string> bounds_;
+    std::vector<std::vector<SequenceNumber>> sequences_;
+    bool finished_;
+};
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_DB_RANGE_TOMBSTONE_H_
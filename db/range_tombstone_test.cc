@@ -0,0 +1,43 @@
+
+
+#include "db/range_tombstone.h"
+
+#include "mydb/comparator.h"
+
+#include "gtest/gtest.h"
+
+namespace mydb {
+
+TEST(RangeTombstoneTest, Empty) {
+    RangeTombstoneList list(BytewiseComparator());
+    list.Finish();
+    ASSERT_TRUE(list.empty());
+    ASSERT_EQ(0, list.MaxCoveringSequence("a", kMaxSequenceNumber));
+}
+
+TEST(RangeTombstoneTest, Overlapping) {
+    RangeTombstoneList list(BytewiseComparator());
+    list.Add(RangeTombstone("a", "e", 10));
+    list.Add(RangeTombstone("c", "g", 20));
+    list.Add(RangeTombstone("e", "f", 5));
+    list.Add(RangeTombstone("x", "x", 30)); // Covers nothing
+    list.Finish();
+    ASSERT_EQ(4, list.tombstones().size());
+
+    ASSERT_EQ(0, list.MaxCoveringSequence("", 100));
+    ASSERT_EQ(10, list.MaxCoveringSequence("a", 100));
+    ASSERT_EQ(10, list.MaxCoveringSequence("b", 100));
+    ASSERT_EQ(20, list.MaxCoveringSequence("c", 100));
+    ASSERT_EQ(20, list.MaxCoveringSequence("e", 100));
+    ASSERT_EQ(20, list.MaxCoveringSequence("fzz", 100));
+    ASSERT_EQ(0, list.MaxCoveringSequence("g", 100));
+    ASSERT_EQ(0, list.MaxCoveringSequence("x", 100));
+
+    // Tombstones newer than the snapshot do not count.
+    ASSERT_EQ(10, list.MaxCoveringSequence("d", 19));
+    ASSERT_EQ(5, list.MaxCoveringSequence("e", 9));
+    ASSERT_EQ(0, list.MaxCoveringSequence("e", 4));
+    ASSERT_EQ(0, list.MaxCoveringSequence("b", 9));
+}
+
+} // namespace mydb
@@ -12,6 +12,14 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every blob file that a table refers to is added, with the
+//        values the tables refer to as its only live bytes
+// (4) Tables added with DB::IngestExternalFile() store every key with
+//     sequence number zero; the real one is only kept in the MANIFEST.
+//     It is read back from whatever MANIFEST records survive.  Reading a
+//     table at zero would let older data shadow it, so an ingested table
+//     whose sequence number is lost is moved to the lost directory, to be
+//     ingested again after the repair.
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
@@ -22,6 +30,9 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <map>
+
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -29,6 +40,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -49,7 +61,7 @@ class Repairer {
           options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
           owns_info_log_(options_.info_log != options.info_log),
           owns_cache_(options_.block_cache != options.block_cache),
-          next_file_number_(1) {
+          next_file_number_(1), ingested_tables_(0) {
         // TableCache can be small since we expect each table to be opened once.
         table_cache_ = new TableCache(dbname_, options_, 10);
     }
@@ -78,10 +90,12 @@ class Repairer {
             }
             Log(options_.info_log,
                 "**** Repaired mydb %s; "
-                "recovered %d files; %llu bytes. "
+                "recovered %d files; %llu bytes; "
+                "moved %d ingested tables to lost/. "
                 "Some data may have been lost. "
                 "****",
-                dbname_.c_str(), static_cast<int>(tables_.size()), bytes);
+                dbname_.c_str(), static_cast<int>(tables_.size()), bytes,
+                ingested_tables_);
         }
         return status;
     }
@@ -116,6 +130,8 @@ class Repairer {
                         logs_.push_back(number);
                     } else if (type == kTableFile) {
                         table_numbers_.push_back(number);
+                    } else if (type == kBlobFile) {
+                        blob_bytes_[number] = 0;
                     } else {
                         // Ignore other files
                     }
@@ -202,7 +218,10 @@ class Repairer {
         FileMetaData meta;
         meta.number = next_file_number_++;
         Iterator* iter = mem->NewIterator();
-        status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+        Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+        status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                            range_del_iter, &meta, nullptr, nullptr);
+        delete range_del_iter;
         delete iter;
         mem->Unref();
         mem = nullptr;
@@ -217,7 +236,47 @@ class Repairer {
         return status;
     }
 
+    void ReadIngestedSequenceNumbers() {
+        struct LogReporter : public log::Reader::Reporter {
+            Logger* info_log;
+            const std::string* fname;
+            void Corruption(size_t bytes, const Status& s) override {
+                Log(info_log, "%s: dropping %d bytes; %s", fname->c_str(),
+                    static_cast<int>(bytes), s.ToString().c_str());
+            }
+        };
+
+        for (size_t i = 0; i < manifests_.size(); i++) {
+            const std::string fname = dbname_ + "/" + manifests_[i];
+            SequentialFile* file;
+            if (!env_->NewSequentialFile(fname, &file).ok()) {
+                continue;
+            }
+            LogReporter reporter;
+            reporter.info_log = options_.info_log;
+            reporter.fname = &fname;
+            log::Reader reader(file, &reporter, true /*checksum*/,
+                               0 /*initial_offset*/);
+            std::string scratch;
+            Slice record;
+            while (reader.ReadRecord(&record, &scratch)) {
+                VersionEdit edit;
+                if (!edit.DecodeFrom(record).ok()) {
+                    continue;
+                }
+                for (const auto& kvp : edit.new_files()) {
+                    if (kvp.second.global_seqno != 0) {
+                        ingested_seqnos_[kvp.second.number] =
+                            kvp.second.global_seqno;
+                    }
+                }
+            }
+            delete file;
+        }
+    }
+
     void ExtractMetaData() {
+        ReadIngestedSequenceNumbers();
         for (size_t i = 0; i < table_numbers_.size(); i++) {
             ScanTable(table_numbers_[i]);
         }
@@ -228,7 +287,8 @@ class Repairer {
         // on checksum verification.
         ReadOptions r;
         r.verify_checksums = options_.paranoid_checks;
-        return table_cache_->NewIterator(r, meta.number, meta.file_size);
+        return table_cache_->NewIterator(r, meta.number, meta.file_size,
+                                         meta.global_seqno);
     }
 
     void ScanTable(uint64_t number) {
@@ -276,15 +336,56 @@ class Repairer {
             if (parsed.sequence > t.max_sequence) {
                 t.max_sequence = parsed.sequence;
             }
+            if (parsed.type == kTypeBlobIndex) {
+                AddBlobReference(&t, iter->value());
+            }
         }
         if (!iter->status().ok()) {
             status = iter->status();
         }
         delete iter;
+
+        // Widen the key range to cover the table's range tombstones.
+        RangeTombstoneList tombstones(icmp_.user_comparator());
+        if (status.ok()) {
+            status = table_cache_->AddRangeTombstones(
+                t.meta.number, t.meta.file_size, &tombstones);
+        }
+        t.meta.has_range_tombstones = !tombstones.empty();
+        for (const RangeTombstone& tombstone : tombstones.tombstones()) {
+            const InternalKey start = tombstone.StartKey();
+            const InternalKey end = tombstone.EndKey();
+            if (empty || icmp_.Compare(start, t.meta.smallest) < 0) {
+                t.meta.smallest = start;
+            }
+            if (empty || icmp_.Compare(end, t.meta.largest) > 0) {
+                t.meta.largest = end;
+            }
+            empty = false;
+            if (tombstone.sequence > t.max_sequence) {
+                t.max_sequence = tombstone.sequence;
+            }
+        }
         Log(options_.info_log, "Table #%llu: %d entries %s",
             (unsigned long long)t.meta.number, counter,
             status.ToString().c_str());
 
+        if (!empty && t.max_sequence == 0) {
+            // Only ingested tables hold nothing but sequence zero.
+            auto it = ingested_seqnos_.find(t.meta.number);
+            if (it == ingested_seqnos_.end()) {
+                ArchiveFile(fname);
+                ingested_tables_++;
+                Log(options_.info_log,
+                    "**** Table #%llu was ingested and its sequence number "
+                    "is lost; moved it to lost/.  Ingest it again to restore "
+                    "its %d entries. ****",
+                    (unsigned long long)t.meta.number, counter);
+                return;
+            }
+            t.meta.global_seqno = it->second;
+            t.max_sequence = it->second;
+        }
         if (status.ok()) {
             tables_.push_back(t);
         } else {
@@ -292,6 +393,23 @@ class Repairer {
         }
     }
 
+    void AddBlobReference(TableInfo* t, const Slice& blob_index) {
+        BlobIndex index;
+        if (!index.DecodeFrom(blob_index).ok()) {
+            return;
+        }
+        auto it = blob_bytes_.find(index.file_number);
+        if (it == blob_bytes_.end()) {
+            // The value is lost; reading it reports an error.
+            return;
+        }
+        it->second += index.size;
+        if (t->meta.oldest_blob_file == 0 ||
+            index.file_number < t->meta.oldest_blob_file) {
+            t->meta.oldest_blob_file = index.file_number;
+        }
+    }
+
     void RepairTable(const std::string& src, TableInfo t) {
         // We will copy src contents to a new table and then rename the
         // new table over the source.
@@ -368,9 +486,15 @@ class Repairer {
 
         for (size_t i = 0; i < tables_.size(); i++) {
             // TODO(opt): separate out into multiple levels
-            const TableInfo& t = tables_[i];
-            edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                          t.meta.largest);
+            edit_.AddFile(0, tables_[i].meta);
+        }
+
+        // Blob files that no table refers to are deleted once the database
+        // is opened.
+        for (const auto& kvp : blob_bytes_) {
+            if (kvp.second > 0) {
+                edit_.AddBlobFile(kvp.first, kvp.second);
+            }
         }
 
         // std::fprintf(stderr,
@@ -438,9 +562,13 @@ class Repairer {
 
     std::vector<std::string> manifests_;
     std::vector<uint64_t> table_numbers_;
+    std::map<uint64_t, uint64_t> blob_bytes_; // Bytes referred to, by number
+    // Global sequence numbers of ingested tables, by number
+    std::map<uint64_t, SequenceNumber> ingested_seqnos_;
     std::vector<uint64_t> logs_;
     std::vector<TableInfo> tables_;
     uint64_t next_file_number_;
+    int ingested_tables_; // Moved to lost/, see (4) above
 };
 } // namespace
 
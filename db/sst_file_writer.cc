@@ -0,0 +1,128 @@
+
+
+#include "mydb/sst_file_writer.h"
+
+#include "db/dbformat.h"
+
+#include "mydb/env.h"
+#include "mydb/table_builder.h"
+
+namespace mydb {
+
+struct SstFileWriter::Rep {
+    Rep(const Options& opt)
+        : env(opt.env), user_comparator(opt.comparator),
+          internal_comparator(opt.comparator),
+          internal_filter_policy(opt.filter_policy), options(opt),
+          file(nullptr), builder(nullptr), file_size(0) {
+        // Entries are stored as internal keys, exactly as in the database's
+        // own tables.
+        options.comparator = &internal_comparator;
+        options.filter_policy =
+            (opt.filter_policy != nullptr) ? &internal_filter_policy : nullptr;
+    }
+
+    Env* env;
+    const Comparator* user_comparator;
+    InternalKeyComparator internal_comparator;
+    InternalFilterPolicy internal_filter_policy;
+    Options options;
+    std::string fname;
+    WritableFile* file;
+    TableBuilder* builder;
+    uint64_t file_size; // Size of the last finished file
+    std::string last_key; // Last user key added
+    std::string key_buf;
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {}
+
+SstFileWriter::~SstFileWriter() {
+    if (rep_->builder != nullptr) {
+        rep_->builder->Abandon();
+        delete rep_->builder;
+        delete rep_->file;
+        rep_->env->RemoveFile(rep_->fname);
+    }
+    delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+    Rep* r = rep_;
+    if (r->builder != nullptr) {
+        return Status::InvalidArgument("file already open", r->fname);
+    }
+    Status s = r->env->NewWritableFile(fname, &r->file);
+    if (s.ok()) {
+        r->fname = fname;
+        r->last_key.clear();
+        r->builder = new TableBuilder(r->options, r->file);
+    }
+    return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+    return Add(key, value, false);
+}
+
+Status SstFileWriter::Delete(const Slice& key) {
+    return Add(key, Slice(), true);
+}
+
+Status SstFileWriter::Add(const Slice& key, const Slice& value,
+                          bool deletion) {
+    Rep* r = rep_;
+    if (r->builder == nullptr) {
+        return Status::InvalidArgument("file not open");
+    }
+    if (r->builder->NumEntries() > 0 &&
+        r->user_comparator->Compare(key, r->last_key) <= 0) {
+        return Status::InvalidArgument("keys must be added in order", key);
+    }
+    r->last_key.assign(key.data(), key.size());
+
+    // Ingestion assigns the real sequence number; the file records zero.
+    r->key_buf.clear();
+    AppendInternalKey(&r->key_buf,
+                      ParsedInternalKey(key, 0,
+                                        deletion ? kTypeDeletion : kTypeValue));
+    r->builder->Add(r->key_buf, value);
+    return r->builder->status();
+}
+
+Status SstFileWriter::Finish() {
+    Rep* r = rep_;
+    if (r->builder == nullptr) {
+        return Status::InvalidArgument("file not open");
+    }
+    Status s;
+    if (r->builder->NumEntries() == 0) {
+        r->builder->Abandon();
+        s = Status::InvalidArgument("no keys added", r->fname);
+    } else {
+        s = r->builder->Finish();
+    }
+    if (s.ok()) {
+        s = r->file->Sync();
+    }
+    if (s.ok()) {
+        s = r->file->Close();
+    }
+    r->file_size = s.ok() ? r->builder->FileSize() : 0;
+    delete r->builder;
+    r->builder = nullptr;
+    delete r->file;
+    r->file = nullptr;
+    if (!s.ok()) {
+        r->env->RemoveFile(r->fname);
+    }
+    return s;
+}
+
+uint64_t SstFileWriter::FileSize() const {
+    return rep_->builder == nullptr ? rep_->file_size
+                                    : rep_->builder->FileSize();
+}
+
+} // namespace mydb
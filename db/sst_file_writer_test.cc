@@ -0,0 +1,228 @@
+
+
+#include "mydb/sst_file_writer.h"
+
+#include "db/db_impl.h"
+#include "db/version_set.h"
+
+#include "mydb/db.h"
+#include "mydb/env.h"
+#include "mydb/filter_policy.h"
+
+#include "util/logging.h"
+#include "util/testutil.h"
+
+#include "gtest/gtest.h"
+
+namespace mydb {
+
+class SstFileWriterTest : public testing::Test {
+  public:
+    SstFileWriterTest() : env_(Env::Default()), db_(nullptr) {
+        dbname_ = testing::TempDir() + "sst_file_writer_test";
+        filter_policy_ = NewBloomFilterPolicy(10);
+        options_.filter_policy = filter_policy_;
+        DestroyDB(dbname_, options_);
+        options_.create_if_missing = true;
+        Reopen();
+    }
+
+    ~SstFileWriterTest() {
+        delete db_;
+        DestroyDB(dbname_, Options());
+        for (const std::string& f : external_) {
+            env_->RemoveFile(f);
+        }
+        delete filter_policy_;
+    }
+
+    void Reopen() {
+        delete db_;
+        db_ = nullptr;
+        ASSERT_MYDB_OK(DB::Open(options_, dbname_, &db_));
+    }
+
+    // Write an external file holding keys [first, last] with the given
+    // value prefix and return its name.
+    std::string WriteFile(int first, int last, const std::string& value) {
+        std::string fname = testing::TempDir() + "sst_file_writer_test_" +
+                            NumberToString(external_.size()) + ".ldb";
+        external_.push_back(fname);
+        SstFileWriter writer(options_);
+        EXPECT_MYDB_OK(writer.Open(fname));
+        for (int i = first; i <= last; i++) {
+            EXPECT_MYDB_OK(writer.Put(Key(i), value + NumberToString(i)));
+        }
+        EXPECT_MYDB_OK(writer.Finish());
+        EXPECT_GT(writer.FileSize(), 0);
+        return fname;
+    }
+
+    Status Ingest(const std::vector<std::string>& files,
+                  bool move_files = false) {
+        IngestExternalFileOptions ingest_options;
+        ingest_options.move_files = move_files;
+        return db_->IngestExternalFile(files, ingest_options);
+    }
+
+    std::string Get(const std::string& key,
+                    const Snapshot* snapshot = nullptr) {
+        ReadOptions read_options;
+        read_options.snapshot = snapshot;
+        std::string result;
+        Status s = db_->Get(read_options, key, &result);
+        if (s.IsNotFound()) {
+            result = "NOT_FOUND";
+        } else if (!s.ok()) {
+            result = s.ToString();
+        }
+        return result;
+    }
+
+    int FilesAtLevel(int level) {
+        std::string property;
+        EXPECT_TRUE(db_->GetProperty(
+            "mydb.num-files-at-level" + NumberToString(level), &property));
+        return std::stoi(property);
+    }
+
+    static std::string Key(int i) {
+        char buf[100];
+        std::snprintf(buf, sizeof(buf), "key%06d", i);
+        return std::string(buf);
+    }
+
+    Env* env_;
+    std::string dbname_;
+    const FilterPolicy* filter_policy_;
+    Options options_;
+    DB* db_;
+    std::vector<std::string> external_;
+};
+
+TEST_F(SstFileWriterTest, OutOfOrderKeys) {
+    std::string fname = testing::TempDir() + "sst_file_writer_test_order";
+    SstFileWriter writer(options_);
+    ASSERT_TRUE(writer.Put("a", "v").IsInvalidArgument());
+    ASSERT_MYDB_OK(writer.Open(fname));
+    ASSERT_MYDB_OK(writer.Put("b", "v"));
+    ASSERT_TRUE(writer.Put("a", "v").IsInvalidArgument());
+    ASSERT_TRUE(writer.Delete("b").IsInvalidArgument());
+    ASSERT_MYDB_OK(writer.Delete("c"));
+    ASSERT_MYDB_OK(writer.Finish());
+    env_->RemoveFile(fname);
+}
+
+TEST_F(SstFileWriterTest, EmptyFile) {
+    std::string fname = testing::TempDir() + "sst_file_writer_test_empty";
+    SstFileWriter writer(options_);
+    ASSERT_MYDB_OK(writer.Open(fname));
+    ASSERT_TRUE(writer.Finish().IsInvalidArgument());
+    ASSERT_FALSE(env_->FileExists(fname));
+}
+
+TEST_F(SstFileWriterTest, IngestIntoEmptyDB) {
+    ASSERT_MYDB_OK(Ingest({WriteFile(0, 99, "a")}));
+    ASSERT_EQ("a0", Get(Key(0)));
+    ASSERT_EQ("a99", Get(Key(99)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(100)));
+
+    // Nothing overlaps, so the file goes straight to the bottom level.
+    ASSERT_EQ(1, FilesAtLevel(config::kNumLevels - 1));
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        ASSERT_EQ(Key(count), iter->key().ToString());
+        count++;
+    }
+    ASSERT_MYDB_OK(iter->status());
+    ASSERT_EQ(100, count);
+    iter->Seek(Key(50));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("a50", iter->value().ToString());
+    delete iter;
+}
+
+TEST_F(SstFileWriterTest, NewerThanExistingData) {
+    for (int i = 0; i < 100; i += 2) {
+        ASSERT_MYDB_OK(db_->Put(WriteOptions(), Key(i), "old"));
+    }
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_MYDB_OK(Ingest({WriteFile(0, 49, "a"), WriteFile(50, 99, "b")}));
+
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ((i < 50 ? "a" : "b") + NumberToString(i), Get(Key(i)));
+        ASSERT_EQ(i % 2 == 0 ? "old" : "NOT_FOUND", Get(Key(i), snapshot));
+    }
+    db_->ReleaseSnapshot(snapshot);
+
+    // Later writes still win over the ingested values.
+    ASSERT_MYDB_OK(db_->Put(WriteOptions(), Key(3), "new"));
+    ASSERT_EQ("new", Get(Key(3)));
+
+    Reopen();
+    ASSERT_EQ("a1", Get(Key(1)));
+    ASSERT_EQ("new", Get(Key(3)));
+    db_->CompactRange(nullptr, nullptr);
+    ASSERT_EQ("a1", Get(Key(1)));
+    ASSERT_EQ("a2", Get(Key(2)));
+    ASSERT_EQ("new", Get(Key(3)));
+    ASSERT_EQ("b98", Get(Key(98)));
+}
+
+TEST_F(SstFileWriterTest, Deletions) {
+    ASSERT_MYDB_OK(db_->Put(WriteOptions(), "a", "va"));
+    ASSERT_MYDB_OK(db_->Put(WriteOptions(), "b", "vb"));
+    reinterpret_cast<DBImpl*>(db_)->TEST_CompactMemTable();
+
+    std::string fname = testing::TempDir() + "sst_file_writer_test_del";
+    external_.push_back(fname);
+    SstFileWriter writer(options_);
+    ASSERT_MYDB_OK(writer.Open(fname));
+    ASSERT_MYDB_OK(writer.Delete("a"));
+    ASSERT_MYDB_OK(writer.Put("c", "vc"));
+    ASSERT_MYDB_OK(writer.Finish());
+
+    ASSERT_MYDB_OK(Ingest({fname}));
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_EQ("vb", Get("b"));
+    ASSERT_EQ("vc", Get("c"));
+    db_->CompactRange(nullptr, nullptr);
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_EQ("vb", Get("b"));
+}
+
+TEST_F(SstFileWriterTest, MoveFiles) {
+    std::string copied = WriteFile(0, 9, "a");
+    std::string moved = WriteFile(10, 19, "b");
+    ASSERT_MYDB_OK(Ingest({copied}));
+    ASSERT_MYDB_OK(Ingest({moved}, true));
+    ASSERT_TRUE(env_->FileExists(copied));
+    ASSERT_FALSE(env_->FileExists(moved));
+    ASSERT_EQ("a5", Get(Key(5)));
+    ASSERT_EQ("b15", Get(Key(15)));
+}
+
+TEST_F(SstFileWriterTest, RejectsOverlappingFiles) {
+    Status s = Ingest({WriteFile(0, 10, "a"), WriteFile(10, 20, "b")});
+    ASSERT_TRUE(s.IsInvalidArgument());
+    ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+}
+
+TEST_F(SstFileWriterTest, RejectsDatabaseTables) {
+    ASSERT_MYDB_OK(db_->Put(WriteOptions(), "a", "va"));
+    reinterpret_cast<DBImpl*>(db_)->TEST_CompactMemTable();
+    std::vector<std::string> children;
+    ASSERT_MYDB_OK(env_->GetChildren(dbname_, &children));
+    std::vector<std::string> tables;
+    for (const std::string& child : children) {
+        if (child.size() > 4 && child.substr(child.size() - 4) == ".ldb") {
+            tables.push_back(dbname_ + "/" + child);
+        }
+    }
+    ASSERT_EQ(1, tables.size());
+    ASSERT_TRUE(Ingest(tables).IsInvalidArgument());
+}
+
+} // namespace mydb
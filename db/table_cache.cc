@@ -2,7 +2,11 @@
 
 #include "db/table_cache.h"
 
+#include <algorithm>
+
+#include "db/blob_file.h"
 #include "db/filename.h"
+#include "db/range_tombstone.h"
 
 #include "mydb/env.h"
 #include "mydb/table.h"
@@ -11,13 +15,17 @@
 
 namespace mydb {
 
+// Blob files share the cache with tables, under the same kind of key:
+// file numbers are never reused, so they cannot collide.
 struct TableAndFile {
     RandomAccessFile* file;
-    Table* table;
+    Table* table;                   // nullptr for a blob file
+    RangeTombstoneList* tombstones; // nullptr if the table has none
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
     TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+    delete tf->tombstones;
     delete tf->table;
     delete tf->file;
     delete tf;
@@ -29,6 +37,100 @@ static void UnrefEntry(void* arg1, void* arg2) {
     cache->Release(h);
 }
 
+namespace {
+
+// Iterates over an ingested table, whose keys are stored with sequence
+// number zero, reporting them with the table's global sequence number.
+// An ingested table holds at most one entry per user key, so the
+// rewritten keys keep their order.
+class GlobalSeqnoIterator : public Iterator {
+  public:
+    GlobalSeqnoIterator(const Comparator* icmp, Iterator* iter,
+                        SequenceNumber global_seqno)
+        : icmp_(icmp), iter_(iter), global_seqno_(global_seqno) {}
+
+    ~GlobalSeqnoIterator() override { delete iter_; }
+
+    bool Valid() const override { return iter_->Valid(); }
+    void SeekToFirst() override {
+        iter_->SeekToFirst();
+        UpdateKey();
+    }
+    void SeekToLast() override {
+        iter_->SeekToLast();
+        UpdateKey();
+    }
+    void Seek(const Slice& target) override {
+        iter_->Seek(target);
+        UpdateKey();
+        // The stored entry for target's user key sorts after target, but
+        // sorts before it once its sequence number is rewritten if that
+        // number is larger than target's.
+        if (Valid() && icmp_->Compare(key_, target) < 0) {
+            Next();
+        }
+    }
+    void Next() override {
+        iter_->Next();
+        UpdateKey();
+    }
+    void Prev() override {
+        iter_->Prev();
+        UpdateKey();
+    }
+    Slice key() const override { return key_; }
+    Slice value() const override { return iter_->value(); }
+    Status status() const override {
+        return status_.ok() ? iter_->status() : status_;
+    }
+
+  private:
+    void UpdateKey() {
+        key_.clear();
+        if (iter_->Valid()) {
+            ParsedInternalKey ikey;
+            if (ParseInternalKey(iter_->key(), &ikey)) {
+                ikey.sequence = global_seqno_;
+                AppendInternalKey(&key_, ikey);
+            } else {
+                status_ = Status::Corruption("corrupted key in ingested file");
+                key_ = iter_->key().ToString();
+            }
+        }
+    }
+
+    const Comparator* const icmp_;
+    Iterator* const iter_;
+    const SequenceNumber global_seqno_;
+    std::string key_;
+    Status status_;
+};
+
+// Wraps the callback of TableCache::Get() for an ingested table.
+struct IngestedGetState {
+    void* arg;
+    void (*handle_result)(void*, const Slice&, const Slice&);
+    SequenceNumber global_seqno;
+    SequenceNumber sequence; // Sequence number of the lookup key
+};
+
+void SaveIngestedEntry(void* arg, const Slice& k, const Slice& v) {
+    IngestedGetState* state = reinterpret_cast<IngestedGetState*>(arg);
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(k, &ikey)) {
+        // Let the caller report the corruption.
+        (*state->handle_result)(state->arg, k, v);
+    } else if (state->global_seqno <= state->sequence) {
+        ikey.sequence = state->global_seqno;
+        std::string key;
+        AppendInternalKey(&key, ikey);
+        (*state->handle_result)(state->arg, key, v);
+    }
+    // Otherwise the entry is newer than the lookup.
+}
+
+} // namespace
+
 TableCache::TableCache(const std::string& dbname, const Options& options,
                        int entries)
     : env_(options.env), dbname_(dbname), options_(options),
@@ -36,6 +138,23 @@ TableCache::TableCache(const std::string& dbname, const Options& options,
 
 TableCache::~TableCache() { delete cache_; }
 
+Status TableCache::OpenFile(const std::string& fname,
+                            RandomAccessFile** file) {
+    if (options_.use_direct_reads) {
+        return env_->NewDirectRandomAccessFile(fname, file);
+    }
+    if (options_.use_mmap_reads) {
+        Status s = env_->NewMmapRandomAccessFile(fname, file);
+        if (s.ok()) {
+            // Most reads are point lookups that need a single block, so
+            // do not fault in the pages around it.
+            (*file)->Hint(RandomAccessFile::kRandom);
+        }
+        return s;
+    }
+    return env_->NewRandomAccessFile(fname, file);
+}
+
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
                              Cache::Handle** handle) {
     Status s;
@@ -47,16 +166,33 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
         std::string fname = TableFileName(dbname_, file_number);
         RandomAccessFile* file = nullptr;
         Table* table = nullptr;
-        s = env_->NewRandomAccessFile(fname, &file);
+        s = OpenFile(fname, &file);
         if (!s.ok()) {
             std::string old_fname = SSTTableFileName(dbname_, file_number);
-            if (env_->NewRandomAccessFile(old_fname, &file).ok()) {
+            if (OpenFile(old_fname, &file).ok()) {
                 s = Status::OK();
             }
         }
         if (s.ok()) {
             s = Table::Open(options_, file, file_size, &table);
         }
+        RangeTombstoneList* tombstones = nullptr;
+        Iterator* tombstone_iter =
+            s.ok() ? table->NewRangeTombstoneIterator() : nullptr;
+        if (tombstone_iter != nullptr) {
+            const Comparator* ucmp =
+                static_cast<const InternalKeyComparator*>(options_.comparator)
+                    ->user_comparator();
+            tombstones = new RangeTombstoneList(ucmp);
+            s = tombstones->AddAll(tombstone_iter);
+            tombstones->Finish();
+            delete tombstone_iter;
+            if (!s.ok()) {
+                delete tombstones;
+                delete table;
+                table = nullptr;
+            }
+        }
 
         if (!s.ok()) {
             assert(table == nullptr);
@@ -67,6 +203,7 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
             TableAndFile* tf = new TableAndFile;
             tf->file = file;
             tf->table = table;
+            tf->tombstones = tombstones;
             *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
         }
     }
@@ -75,6 +212,7 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
+                                  SequenceNumber global_seqno,
                                   Table** tableptr) {
     if (tableptr != nullptr) {
         *tableptr = nullptr;
@@ -89,6 +227,10 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
     Table* table =
         reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
     Iterator* result = table->NewIterator(options);
+    if (global_seqno != 0) {
+        result =
+            new GlobalSeqnoIterator(options_.comparator, result, global_seqno);
+    }
     result->RegisterCleanup(&UnrefEntry, cache_, handle);
     if (tableptr != nullptr) {
         *tableptr = table;
@@ -97,20 +239,112 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 }
 
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
-                       uint64_t file_size, const Slice& k, void* arg,
+                       uint64_t file_size, SequenceNumber global_seqno,
+                       const Slice& k,
+                       SequenceNumber* max_covering_tombstone_seq, void* arg,
                        void (*handle_result)(void*, const Slice&,
                                              const Slice&)) {
     Cache::Handle* handle = nullptr;
     Status s = FindTable(file_number, file_size, &handle);
     if (s.ok()) {
-        Table* t =
-            reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-        s = t->InternalGet(options, k, arg, handle_result);
+        TableAndFile* tf =
+            reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+        Table* t = tf->table;
+        ParsedInternalKey ikey;
+        if (tf->tombstones != nullptr && ParseInternalKey(k, &ikey)) {
+            *max_covering_tombstone_seq = std::max(
+                *max_covering_tombstone_seq,
+                tf->tombstones->MaxCoveringSequence(ikey.user_key,
+                                                    ikey.sequence));
+        }
+        if (global_seqno != 0 && ParseInternalKey(k, &ikey)) {
+            IngestedGetState state;
+            state.arg = arg;
+            state.handle_result = handle_result;
+            state.global_seqno = global_seqno;
+            state.sequence = ikey.sequence;
+            s = t->InternalGet(options, k, &state, &SaveIngestedEntry);
+        } else {
+            s = t->InternalGet(options, k, arg, handle_result);
+        }
+        cache_->Release(handle);
+    }
+    return s;
+}
+
+Status TableCache::AddRangeTombstones(uint64_t file_number,
+                                      uint64_t file_size,
+                                      RangeTombstoneList* list) {
+    Cache::Handle* handle = nullptr;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (s.ok()) {
+        TableAndFile* tf =
+            reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+        if (tf->tombstones != nullptr) {
+            for (const RangeTombstone& t : tf->tombstones->tombstones()) {
+                list->Add(t);
+            }
+        }
         cache_->Release(handle);
     }
     return s;
 }
 
+Status TableCache::FindBlobFile(uint64_t file_number, Cache::Handle** handle) {
+    char buf[sizeof(file_number)];
+    EncodeFixed64(buf, file_number);
+    Slice key(buf, sizeof(buf));
+    *handle = cache_->Lookup(key);
+    if (*handle != nullptr) {
+        return Status::OK();
+    }
+    RandomAccessFile* file = nullptr;
+    Status s = OpenFile(BlobFileName(dbname_, file_number), &file);
+    if (s.ok()) {
+        TableAndFile* tf = new TableAndFile;
+        tf->file = file;
+        tf->table = nullptr;
+        tf->tombstones = nullptr;
+        *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
+    }
+    return s;
+}
+
+Status TableCache::GetBlob(const Slice& blob_index, std::string* value) {
+    BlobIndex index;
+    Status s = index.DecodeFrom(blob_index);
+    Cache::Handle* handle = nullptr;
+    if (s.ok()) {
+        s = FindBlobFile(index.file_number, &handle);
+    }
+    if (s.ok()) {
+        TableAndFile* tf =
+            reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+        s = ReadBlob(tf->file, index, value);
+        cache_->Release(handle);
+    }
+    return s;
+}
+
+Status TableCache::Load(uint64_t file_number, uint64_t file_size) {
+    Cache::Handle* handle = nullptr;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (s.ok()) {
+        cache_->Release(handle);
+    }
+    return s;
+}
+
+void TableCache::Hint(uint64_t file_number, uint64_t file_size,
+                      RandomAccessFile::AccessPattern pattern) {
+    Cache::Handle* handle = nullptr;
+    if (FindTable(file_number, file_size, &handle).ok()) {
+        reinterpret_cast<TableAndFile*>(cache_->Value(handle))
+            ->file->Hint(pattern);
+        cache_->Release(handle);
+    }
+}
+
 void TableCache::Evict(uint64_t file_number) {
     char buf[sizeof(file_number)];
     EncodeFixed64(buf, file_number);
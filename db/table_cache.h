@@ -10,13 +10,14 @@
 #include <string>
 
 #include "mydb/cache.h"
+#include "mydb/env.h"
 #include "mydb/table.h"
 
 #include "port/port.h"
 
 namespace mydb {
 
-class Env;
+class RangeTombstoneList;
 
 class TableCache {
   public:
@@ -28,26 +29,57 @@ class TableCache {
     ~TableCache();
 
     // Return an iterator for the specified file number (the corresponding
-    // file length must be exactly "file_size" bytes).  If "tableptr" is
+    // file length must be exactly "file_size" bytes).  A non-zero
+    // "global_seqno" marks an ingested file: its keys are reported with
+    // that sequence number instead of the zero stored in the file.  If
+    // "tableptr" is
     // non-null, also sets "*tableptr" to point to the Table object
     // underlying the returned iterator, or to nullptr if no Table object
     // underlies the returned iterator.  The returned "*tableptr" object is
     // owned by the cache and should not be deleted, and is valid for as long as
     // the returned iterator is live.
     Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
-                          uint64_t file_size, Table** tableptr = nullptr);
-
-    // If a seek to internal key "k" in specified file finds an entry,
-    // call (*handle_result)(arg, found_key, found_value).
+                          uint64_t file_size, SequenceNumber global_seqno,
+                          Table** tableptr = nullptr);
+
+    // Raise *max_covering_tombstone_seq to the sequence number of the
+    // newest range tombstone in the specified file that covers "k" and is
+    // visible at its sequence number.  Then, if a seek to internal key "k"
+    // in the file finds an entry, call (*handle_result)(arg, found_key,
+    // found_value).  For an ingested file, entries newer than the sequence
+    // number of "k" are not found.
     Status Get(const ReadOptions& options, uint64_t file_number,
-               uint64_t file_size, const Slice& k, void* arg,
+               uint64_t file_size, SequenceNumber global_seqno, const Slice& k,
+               SequenceNumber* max_covering_tombstone_seq, void* arg,
                void (*handle_result)(void*, const Slice&, const Slice&));
 
-    // Evict any entry for the specified file number
+    // Add the range tombstones stored in the specified file to *list.
+    Status AddRangeTombstones(uint64_t file_number, uint64_t file_size,
+                              RangeTombstoneList* list);
+
+    // Read the value that the encoded BlobIndex "blob_index" refers to into
+    // *value.  Blob files are kept open in the cache like tables.
+    Status GetBlob(const Slice& blob_index, std::string* value);
+
+    // Open the specified table unless it is in the cache already, so that
+    // later reads find it there.
+    Status Load(uint64_t file_number, uint64_t file_size);
+
+    // Hint how the specified table is going to be read from now on (see
+    // RandomAccessFile::Hint()).
+    void Hint(uint64_t file_number, uint64_t file_size,
+              RandomAccessFile::AccessPattern pattern);
+
+    // Evict any entry for the specified table or blob file number
     void Evict(uint64_t file_number);
 
   private:
     Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+    Status FindBlobFile(uint64_t file_number, Cache::Handle**);
+
+    // Open "fname" for reading, with direct I/O or through a memory map if
+    // options_ asks for it.
+    Status OpenFile(const std::string& fname, RandomAccessFile** file);
 
     Env* const env_;
     const std::string dbname_;
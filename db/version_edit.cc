@@ -19,7 +19,12 @@ enum Tag {
     kDeletedFile = 6,
     kNewFile = 7,
     // 8 was used for large value refs
-    kPrevLogNumber = 9
+    kPrevLogNumber = 9,
+    kIngestedFile = 10,
+    kBlobReferencingFile = 11,
+    kNewBlobFile = 12,
+    kBlobGarbage = 13,
+    kRangeTombstoneFile = 14
 };
 
 void VersionEdit::Clear() {
@@ -36,6 +41,8 @@ void VersionEdit::Clear() {
     compact_pointers_.clear();
     deleted_files_.clear();
     new_files_.clear();
+    new_blob_files_.clear();
+    blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -74,12 +81,42 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
     for (size_t i = 0; i < new_files_.size(); i++) {
         const FileMetaData& f = new_files_[i].second;
-        PutVarint32(dst, kNewFile);
+        // Ingested files never refer to blob files.  Other files keep the
+        // old encoding unless they do.
+        assert(f.global_seqno == 0 || f.oldest_blob_file == 0);
+        if (f.global_seqno != 0) {
+            PutVarint32(dst, kIngestedFile);
+        } else if (f.oldest_blob_file != 0) {
+            PutVarint32(dst, kBlobReferencingFile);
+        } else {
+            PutVarint32(dst, kNewFile);
+        }
         PutVarint32(dst, new_files_[i].first); // level
         PutVarint64(dst, f.number);
         PutVarint64(dst, f.file_size);
         PutLengthPrefixedSlice(dst, f.smallest.Encode());
         PutLengthPrefixedSlice(dst, f.largest.Encode());
+        if (f.global_seqno != 0) {
+            PutVarint64(dst, f.global_seqno);
+        } else if (f.oldest_blob_file != 0) {
+            PutVarint64(dst, f.oldest_blob_file);
+        }
+        if (f.has_range_tombstones) {
+            PutVarint32(dst, kRangeTombstoneFile);
+            PutVarint64(dst, f.number);
+        }
+    }
+
+    for (size_t i = 0; i < new_blob_files_.size(); i++) {
+        PutVarint32(dst, kNewBlobFile);
+        PutVarint64(dst, new_blob_files_[i].number);
+        PutVarint64(dst, new_blob_files_[i].total_bytes);
+    }
+
+    for (size_t i = 0; i < blob_garbage_.size(); i++) {
+        PutVarint32(dst, kBlobGarbage);
+        PutVarint64(dst, blob_garbage_[i].first);  // blob file number
+        PutVarint64(dst, blob_garbage_[i].second); // bytes
     }
 }
 
@@ -112,6 +149,8 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
     int level;
     uint64_t number;
     FileMetaData f;
+    BlobFileMetaData b;
+    uint64_t bytes;
     Slice str;
     InternalKey key;
 
@@ -185,6 +224,60 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
             }
             break;
 
+        case kIngestedFile:
+            if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+                GetVarint64(&input, &f.file_size) &&
+                GetInternalKey(&input, &f.smallest) &&
+                GetInternalKey(&input, &f.largest) &&
+                GetVarint64(&input, &f.global_seqno) && f.global_seqno != 0) {
+                new_files_.push_back(std::make_pair(level, f));
+                f.global_seqno = 0;
+            } else {
+                msg = "ingested-file entry";
+            }
+            break;
+
+        case kBlobReferencingFile:
+            if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+                GetVarint64(&input, &f.file_size) &&
+                GetInternalKey(&input, &f.smallest) &&
+                GetInternalKey(&input, &f.largest) &&
+                GetVarint64(&input, &f.oldest_blob_file) &&
+                f.oldest_blob_file != 0) {
+                new_files_.push_back(std::make_pair(level, f));
+                f.oldest_blob_file = 0;
+            } else {
+                msg = "blob-referencing-file entry";
+            }
+            break;
+
+        case kNewBlobFile:
+            if (GetVarint64(&input, &b.number) &&
+                GetVarint64(&input, &b.total_bytes)) {
+                new_blob_files_.push_back(b);
+            } else {
+                msg = "new-blob-file entry";
+            }
+            break;
+
+        case kRangeTombstoneFile:
+            // Follows the entry of the file it marks.
+            if (GetVarint64(&input, &number) && !new_files_.empty() &&
+                new_files_.back().second.number == number) {
+                new_files_.back().second.has_range_tombstones = true;
+            } else {
+                msg = "range-tombstone-file entry";
+            }
+            break;
+
+        case kBlobGarbage:
+            if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+                blob_garbage_.push_back(std::make_pair(number, bytes));
+            } else {
+                msg = "blob garbage";
+            }
+            break;
+
         default:
             msg = "unknown tag";
             break;
@@ -249,6 +342,29 @@ std::string VersionEdit::DebugString() const {
         r.append(f.smallest.DebugString());
         r.append(" .. ");
         r.append(f.largest.DebugString());
+        if (f.global_seqno != 0) {
+            r.append(" @ ");
+            AppendNumberTo(&r, f.global_seqno);
+        }
+        if (f.oldest_blob_file != 0) {
+            r.append(" blobs from ");
+            AppendNumberTo(&r, f.oldest_blob_file);
+        }
+        if (f.has_range_tombstones) {
+            r.append(" with range tombstones");
+        }
+    }
+    for (size_t i = 0; i < new_blob_files_.size(); i++) {
+        r.append("\n  AddBlobFile: ");
+        AppendNumberTo(&r, new_blob_files_[i].number);
+        r.append(" ");
+        AppendNumberTo(&r, new_blob_files_[i].total_bytes);
+    }
+    for (size_t i = 0; i < blob_garbage_.size(); i++) {
+        r.append("\n  BlobGarbage: ");
+        AppendNumberTo(&r, blob_garbage_[i].first);
+        r.append(" ");
+        AppendNumberTo(&r, blob_garbage_[i].second);
     }
     r.append("\n}\n");
     return r;
@@ -13,7 +13,9 @@ namespace mydb {
 class VersionSet;
 
 struct FileMetaData {
-    FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+    FileMetaData()
+        : refs(0), allowed_seeks(1 << 30), file_size(0), global_seqno(0),
+          oldest_blob_file(0), has_range_tombstones(false) {}
 
     int refs;
     int allowed_seeks; // Seeks allowed until compaction
@@ -21,6 +23,26 @@ struct FileMetaData {
     uint64_t file_size;   // File size in bytes
     InternalKey smallest; // Smallest internal key served by table
     InternalKey largest;  // Largest internal key served by table
+
+    // Non-zero for an ingested file, whose keys are stored with sequence
+    // number zero and are served with this sequence number instead.
+    SequenceNumber global_seqno;
+
+    // Number of the oldest blob file the table refers to, or zero if it
+    // refers to none.
+    uint64_t oldest_blob_file;
+
+    // Does the table have a range tombstone block?  Only such tables are
+    // opened to collect the tombstones for an iterator or a compaction.
+    bool has_range_tombstones;
+};
+
+struct BlobFileMetaData {
+    BlobFileMetaData() : number(0), total_bytes(0), garbage_bytes(0) {}
+
+    uint64_t number;
+    uint64_t total_bytes;   // Sum of the sizes of the values in the file
+    uint64_t garbage_bytes; // Part of total_bytes no table refers to anymore
 };
 
 class VersionEdit {
@@ -58,20 +80,47 @@ class VersionEdit {
     // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
     // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
     void AddFile(int level, uint64_t file, uint64_t file_size,
-                 const InternalKey& smallest, const InternalKey& largest) {
+                 const InternalKey& smallest, const InternalKey& largest,
+                 SequenceNumber global_seqno = 0) {
         FileMetaData f;
         f.number = file;
         f.file_size = file_size;
         f.smallest = smallest;
         f.largest = largest;
+        f.global_seqno = global_seqno;
+        new_files_.push_back(std::make_pair(level, f));
+    }
+
+    // Add the file described by "f" at the specified level.
+    void AddFile(int level, const FileMetaData& f) {
         new_files_.push_back(std::make_pair(level, f));
     }
 
+    // Add a blob file holding "total_bytes" bytes of values.
+    void AddBlobFile(uint64_t number, uint64_t total_bytes) {
+        BlobFileMetaData b;
+        b.number = number;
+        b.total_bytes = total_bytes;
+        new_blob_files_.push_back(b);
+    }
+
+    // Record that "bytes" bytes of values in blob file "number" are no
+    // longer referred to.  A blob file is removed once all of its bytes
+    // are garbage.
+    void AddBlobGarbage(uint64_t number, uint64_t bytes) {
+        blob_garbage_.push_back(std::make_pair(number, bytes));
+    }
+
     // Delete the specified "file" from the specified "level".
     void RemoveFile(int level, uint64_t file) {
         deleted_files_.insert(std::make_pair(level, file));
     }
 
+    // The files added by this edit, with their levels.
+    const std::vector<std::pair<int, FileMetaData>>& new_files() const {
+        return new_files_;
+    }
+
     void EncodeTo(std::string* dst) const;
     Status DecodeFrom(const Slice& src);
 
@@ -96,6 +145,8 @@ class VersionEdit {
     std::vector<std::pair<int, InternalKey>> compact_pointers_;
     DeletedFileSet deleted_files_;
     std::vector<std::pair<int, FileMetaData>> new_files_;
+    std::vector<BlobFileMetaData> new_blob_files_;
+    std::vector<std::pair<uint64_t, uint64_t>> blob_garbage_;
 };
 
 } // namespace mydb
@@ -25,6 +25,23 @@ TEST(VersionEditTest, EncodeDecode) {
         edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
                      InternalKey("foo", kBig + 500 + i, kTypeValue),
                      InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+        edit.AddFile(5, kBig + 350 + i, kBig + 450 + i,
+                     InternalKey("bar", kBig + 550 + i, kTypeValue),
+                     InternalKey("baz", kBig + 550 + i, kTypeValue),
+                     kBig + 550 + i);
+        FileMetaData f;
+        f.number = kBig + 370 + i;
+        f.file_size = kBig + 470 + i;
+        f.smallest = InternalKey("car", kBig + 570 + i, kTypeBlobIndex);
+        f.largest = InternalKey("cat", kBig + 570 + i, kTypeValue);
+        f.oldest_blob_file = kBig + 800 + i;
+        edit.AddFile(6, f);
+        f.number = kBig + 380 + i;
+        f.oldest_blob_file = 0;
+        f.has_range_tombstones = true;
+        edit.AddFile(6, f);
+        edit.AddBlobFile(kBig + 800 + i, kBig + 810 + i);
+        edit.AddBlobGarbage(kBig + 800 + i, kBig + 820 + i);
         edit.RemoveFile(4, kBig + 700 + i);
         edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
     }
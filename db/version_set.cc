@@ -6,6 +6,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_context.h"
 #include "db/table_cache.h"
 #include <algorithm>
 #include <cstdio>
@@ -157,8 +158,8 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
-// 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// 24-byte value containing the file number, file size and global
+// sequence number, all encoded using EncodeFixed64.
 class Version::LevelFileNumIterator : public Iterator {
   public:
     LevelFileNumIterator(const InternalKeyComparator& icmp,
@@ -194,6 +195,7 @@ class Version::LevelFileNumIterator : public Iterator {
         assert(Valid());
         EncodeFixed64(value_buf_, (*flist_)[index_]->number);
         EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+        EncodeFixed64(value_buf_ + 16, (*flist_)[index_]->global_seqno);
         return Slice(value_buf_, sizeof(value_buf_));
     }
     Status status() const override { return Status::OK(); }
@@ -203,19 +205,21 @@ class Version::LevelFileNumIterator : public Iterator {
     const std::vector<FileMetaData*>* const flist_;
     uint32_t index_;
 
-    // Backing store for value().  Holds the file number and size.
-    mutable char value_buf_[16];
+    // Backing store for value().  Holds the file number, size and global
+    // sequence number.
+    mutable char value_buf_[24];
 };
 
 static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
                                  const Slice& file_value) {
     TableCache* cache = reinterpret_cast<TableCache*>(arg);
-    if (file_value.size() != 16) {
+    if (file_value.size() != 24) {
         return NewErrorIterator(
             Status::Corruption("FileReader invoked with unexpected value"));
     } else {
         return cache->NewIterator(options, DecodeFixed64(file_value.data()),
-                                  DecodeFixed64(file_value.data() + 8));
+                                  DecodeFixed64(file_value.data() + 8),
+                                  DecodeFixed64(file_value.data() + 16));
     }
 }
 
@@ -231,7 +235,8 @@ void Version::AddIterators(const ReadOptions& options,
     // Merge all level zero files together since they may overlap
     for (size_t i = 0; i < files_[0].size(); i++) {
         iters->push_back(vset_->table_cache_->NewIterator(
-            options, files_[0][i]->number, files_[0][i]->file_size));
+            options, files_[0][i]->number, files_[0][i]->file_size,
+            files_[0][i]->global_seqno));
     }
 
     // For levels > 0, we can use a concatenating iterator that sequentially
@@ -251,12 +256,20 @@ enum SaverState {
     kFound,
     kDeleted,
     kCorrupt,
+    kMerge,
+    kBlob,
 };
 struct Saver {
     SaverState state;
     const Comparator* ucmp;
     Slice user_key;
     std::string* value;
+    // Entries older than this are hidden by a range tombstone.
+    SequenceNumber max_covering_tombstone_seq;
+    // Operands found so far, and the sequence number of the oldest one.
+    MergeContext* merge_context;
+    SequenceNumber merge_sequence;
+    Status merge_status;
 };
 } // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -264,12 +277,29 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     ParsedInternalKey parsed_key;
     if (!ParseInternalKey(ikey, &parsed_key)) {
         s->state = kCorrupt;
-    } else {
-        if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-            s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
-            if (s->state == kFound) {
-                s->value->assign(v.data(), v.size());
-            }
+    } else if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
+        ValueType type = parsed_key.type;
+        if (parsed_key.sequence < s->max_covering_tombstone_seq) {
+            type = kTypeDeletion;
+        }
+        if (type == kTypeBlobIndex) {
+            // The value and any operands are applied by the caller once
+            // the value has been read from its blob file.
+            s->state = kBlob;
+            s->value->assign(v.data(), v.size());
+        } else if (type == kTypeMerge) {
+            s->state = kMerge;
+            s->merge_context->AddOlderOperand(v);
+            s->merge_sequence = parsed_key.sequence;
+        } else if (!s->merge_context->empty()) {
+            s->state = kFound;
+            s->merge_status = s->merge_context->Merge(
+                s->user_key, type == kTypeValue ? &v : nullptr, s->value);
+        } else if (type == kTypeValue) {
+            s->state = kFound;
+            s->value->assign(v.data(), v.size());
+        } else {
+            s->state = kDeleted;
         }
     }
 }
@@ -324,7 +354,9 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
 }
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    std::string* value, GetStats* stats,
+                    SequenceNumber max_covering_tombstone_seq,
+                    MergeContext* merge_context) {
     stats->seek_file = nullptr;
     stats->seek_file_level = -1;
 
@@ -354,17 +386,37 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
             state->last_file_read = f;
             state->last_file_read_level = level;
 
+            state->saver.state = kNotFound;
             state->s = state->vset->table_cache_->Get(
-                *state->options, f->number, f->file_size, state->ikey,
+                *state->options, f->number, f->file_size, f->global_seqno,
+                state->ikey, &state->saver.max_covering_tombstone_seq,
                 &state->saver, SaveValue);
+            // Older entries for a merged key may follow in the same file.
+            while (state->s.ok() && state->saver.state == kMerge &&
+                   state->saver.merge_sequence > 0) {
+                LookupKey older(state->saver.user_key,
+                                state->saver.merge_sequence - 1);
+                state->saver.state = kNotFound;
+                state->s = state->vset->table_cache_->Get(
+                    *state->options, f->number, f->file_size,
+                    f->global_seqno, older.internal_key(),
+                    &state->saver.max_covering_tombstone_seq, &state->saver,
+                    SaveValue);
+            }
             if (!state->s.ok()) {
                 state->found = true;
                 return false;
             }
             switch (state->saver.state) {
             case kNotFound:
+            case kMerge:
                 return true; // Keep searching in other files
             case kFound:
+                state->s = state->saver.merge_status;
+                state->found = true;
+                return false;
+            case kBlob:
+                state->s = state->ResolveBlob();
                 state->found = true;
                 return false;
             case kDeleted:
@@ -380,6 +432,25 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
             // "control reaches end of non-void function".
             return false;
         }
+
+        // Replace the blob index in saver.value with the value it refers
+        // to, and apply the pending operands, if any.
+        Status ResolveBlob() {
+            std::string* value = saver.value;
+            MergeContext* merge_context = saver.merge_context;
+            if (merge_context->empty()) {
+                std::string index;
+                index.swap(*value);
+                return vset->table_cache_->GetBlob(index, value);
+            }
+            std::string base;
+            Status s = vset->table_cache_->GetBlob(*value, &base);
+            if (s.ok()) {
+                Slice base_slice(base);
+                s = merge_context->Merge(saver.user_key, &base_slice, value);
+            }
+            return s;
+        }
     };
 
     State state;
@@ -396,12 +467,33 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
     state.saver.ucmp = vset_->icmp_.user_comparator();
     state.saver.user_key = k.user_key();
     state.saver.value = value;
+    state.saver.max_covering_tombstone_seq = max_covering_tombstone_seq;
+    state.saver.merge_context = merge_context;
+    state.saver.merge_sequence = 0;
 
     ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
+    if (!state.found && !merge_context->empty()) {
+        // The operands apply to a key with no value.
+        return merge_context->Merge(k.user_key(), nullptr, value);
+    }
     return state.found ? state.s : Status::NotFound(Slice());
 }
 
+Status Version::AddRangeTombstones(RangeTombstoneList* list) {
+    Status s;
+    for (int level = 0; level < config::kNumLevels && s.ok(); level++) {
+        for (size_t i = 0; i < files_[level].size() && s.ok(); i++) {
+            const FileMetaData* f = files_[level][i];
+            if (f->has_range_tombstones) {
+                s = vset_->table_cache_->AddRangeTombstones(
+                    f->number, f->file_size, list);
+            }
+        }
+    }
+    return s;
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
     FileMetaData* f = stats.seek_file;
     if (f != nullptr) {
@@ -473,6 +565,16 @@ bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                         const Slice& largest_user_key) {
     int level = 0;
+    if (vset_->options_->compaction_style == kTiered) {
+        // Every flush becomes a new sorted run in level-0.
+        return level;
+    }
+    if (vset_->options_->dynamic_level_bytes) {
+        // Levels above the base level must stay empty; a flush that does
+        // not overlap anything is moved to the base level by a trivial
+        // compaction instead.
+        return level;
+    }
     if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
         // Push to next level if there is no overlap in next level,
         // and the #bytes overlapping in the level after that are limited.
@@ -544,6 +646,29 @@ void Version::GetOverlappingInputs(int level, const InternalKey* begin,
     }
 }
 
+bool Version::BlobFileNeedsGC(uint64_t blob_file_number) const {
+    auto it = blob_files_.find(blob_file_number);
+    if (it == blob_files_.end()) {
+        return false;
+    }
+    const BlobFileMetaData& b = it->second;
+    const double live_bytes = b.total_bytes - b.garbage_bytes;
+    return b.garbage_bytes > 0 &&
+           live_bytes < vset_->options_->blob_gc_live_ratio * b.total_bytes;
+}
+
+void Version::GetAllFiles(std::vector<FileMetaData*>* files) const {
+    for (int level = 0; level < config::kNumLevels; level++) {
+        files->insert(files->end(), files_[level].begin(), files_[level].end());
+    }
+}
+
+void Version::GetBlobFiles(std::vector<uint64_t>* numbers) const {
+    for (const auto& kvp : blob_files_) {
+        numbers->push_back(kvp.first);
+    }
+}
+
 std::string Version::DebugString() const {
     std::string r;
     for (int level = 0; level < config::kNumLevels; level++) {
@@ -567,6 +692,20 @@ std::string Version::DebugString() const {
             r.append("]\n");
         }
     }
+    if (!blob_files_.empty()) {
+        //   --- blob files ---
+        //   12:4096-1024
+        r.append("--- blob files ---\n");
+        for (const auto& kvp : blob_files_) {
+            r.push_back(' ');
+            AppendNumberTo(&r, kvp.second.number);
+            r.push_back(':');
+            AppendNumberTo(&r, kvp.second.total_bytes);
+            r.push_back('-');
+            AppendNumberTo(&r, kvp.second.garbage_bytes);
+            r.push_back('\n');
+        }
+    }
     return r;
 }
 
@@ -599,10 +738,12 @@ class VersionSet::Builder {
     VersionSet* vset_;
     Version* base_;
     LevelState levels_[config::kNumLevels];
+    std::map<uint64_t, BlobFileMetaData> blob_files_;
 
   public:
     // Initialize a builder with the files from *base and other info from *vset
-    Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+    Builder(VersionSet* vset, Version* base)
+        : vset_(vset), base_(base), blob_files_(base->blob_files_) {
         base_->Ref();
         BySmallestKey cmp;
         cmp.internal_comparator = &vset_->icmp_;
@@ -674,6 +815,20 @@ class VersionSet::Builder {
             levels_[level].deleted_files.erase(f->number);
             levels_[level].added_files->insert(f);
         }
+
+        // Add new blob files
+        for (size_t i = 0; i < edit->new_blob_files_.size(); i++) {
+            const BlobFileMetaData& b = edit->new_blob_files_[i];
+            blob_files_[b.number] = b;
+        }
+
+        // Account for blob garbage
+        for (size_t i = 0; i < edit->blob_garbage_.size(); i++) {
+            auto it = blob_files_.find(edit->blob_garbage_[i].first);
+            if (it != blob_files_.end()) {
+                it->second.garbage_bytes += edit->blob_garbage_[i].second;
+            }
+        }
     }
 
     // Save the current state in *v.
@@ -726,6 +881,14 @@ class VersionSet::Builder {
             }
 #endif
         }
+
+        // Drop blob files that no table refers to anymore.
+        for (const auto& kvp : blob_files_) {
+            const BlobFileMetaData& b = kvp.second;
+            if (b.garbage_bytes < b.total_bytes) {
+                v->blob_files_.insert(kvp);
+            }
+        }
     }
 
     void MaybeAddFile(Version* v, int level, FileMetaData* f) {
@@ -753,7 +916,8 @@ VersionSet::VersionSet(const std::string& dbname, const Options* options,
       manifest_file_number_(0), // Filled by Recover()
       last_sequence_(0), log_number_(0), prev_log_number_(0),
       descriptor_file_(nullptr), descriptor_log_(nullptr),
-      dummy_versions_(this), current_(nullptr) {
+      manifest_edit_bytes_(0), manifest_file_size_(0), dummy_versions_(this),
+      current_(nullptr) {
     AppendVersion(new Version(this));
 }
 
@@ -782,6 +946,25 @@ void VersionSet::AppendVersion(Version* v) {
 }
 
 Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
+    // Replace a MANIFEST that has grown too large with a new one that
+    // starts with a snapshot of the current state.  The old one stays in
+    // use until CURRENT points to the new one.  The new number must be
+    // allocated before the edit records the next file number.
+    uint64_t new_manifest_file_number = manifest_file_number_;
+    WritableFile* old_descriptor_file = nullptr;
+    log::Writer* old_descriptor_log = nullptr;
+    const uint64_t old_manifest_edit_bytes = manifest_edit_bytes_;
+    if (descriptor_log_ != nullptr &&
+        manifest_edit_bytes_ >= options_->max_manifest_file_size) {
+        old_descriptor_file = descriptor_file_;
+        old_descriptor_log = descriptor_log_;
+        descriptor_file_ = nullptr;
+        descriptor_log_ = nullptr;
+        new_manifest_file_number = NewFileNumber();
+        Log(options_->info_log, "Replacing MANIFEST of %llu bytes of edits",
+            static_cast<unsigned long long>(old_manifest_edit_bytes));
+    }
+
     if (edit->has_log_number_) {
         assert(edit->log_number_ >= log_number_);
         assert(edit->log_number_ < next_file_number_);
@@ -806,31 +989,40 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
 
     // Initialize new descriptor log file if necessary by creating
     // a temporary file that contains a snapshot of the current version.
+    // The snapshot is encoded while *mu still guards the files' metadata;
+    // the file is created and written below with *mu released, and only
+    // installed once the lock is held again.
     std::string new_manifest_file;
-    Status s;
-    if (descriptor_log_ == nullptr) {
-        // No reason to unlock *mu here since we only hit this path in the
-        // first call to LogAndApply (when opening the database).
-        assert(descriptor_file_ == nullptr);
-        new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
-        s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
-        if (s.ok()) {
-            descriptor_log_ = new log::Writer(descriptor_file_);
-            s = WriteSnapshot(descriptor_log_);
-        }
+    std::string snapshot;
+    WritableFile* descriptor_file = descriptor_file_;
+    log::Writer* descriptor_log = descriptor_log_;
+    if (descriptor_log == nullptr) {
+        assert(descriptor_file == nullptr);
+        new_manifest_file =
+            DescriptorFileName(dbname_, new_manifest_file_number);
+        EncodeSnapshot(&snapshot);
     }
 
     // Unlock during expensive MANIFEST log write
+    Status s;
+    std::string record;
     {
         mu->Unlock();
 
+        if (!new_manifest_file.empty()) {
+            s = env_->NewWritableFile(new_manifest_file, &descriptor_file);
+            if (s.ok()) {
+                descriptor_log = new log::Writer(descriptor_file);
+                s = descriptor_log->AddRecord(snapshot);
+            }
+        }
+
         // Write new record to MANIFEST log
         if (s.ok()) {
-            std::string record;
             edit->EncodeTo(&record);
-            s = descriptor_log_->AddRecord(record);
+            s = descriptor_log->AddRecord(record);
             if (s.ok()) {
-                s = descriptor_file_->Sync();
+                s = descriptor_file->Sync();
             }
             if (!s.ok()) {
                 Log(options_->info_log, "MANIFEST write: %s\n",
@@ -841,7 +1033,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
         // If we just created a new descriptor file, install it by writing a
         // new CURRENT file that points to it.
         if (s.ok() && !new_manifest_file.empty()) {
-            s = SetCurrentFile(env_, dbname_, manifest_file_number_);
+            s = SetCurrentFile(env_, dbname_, new_manifest_file_number);
         }
 
         mu->Lock();
@@ -849,18 +1041,33 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
 
     // Install the new version
     if (s.ok()) {
+        if (!new_manifest_file.empty()) {
+            descriptor_file_ = descriptor_file;
+            descriptor_log_ = descriptor_log;
+            manifest_edit_bytes_ = 0;
+        }
         AppendVersion(v);
         log_number_ = edit->log_number_;
         prev_log_number_ = edit->prev_log_number_;
+        manifest_file_number_ = new_manifest_file_number;
+        manifest_edit_bytes_ += record.size();
+        manifest_file_size_ = descriptor_log_->file_size();
+        // The replaced MANIFEST is deleted with the other obsolete files.
+        delete old_descriptor_log;
+        delete old_descriptor_file;
     } else {
         delete v;
         if (!new_manifest_file.empty()) {
-            delete descriptor_log_;
-            delete descriptor_file_;
-            descriptor_log_ = nullptr;
-            descriptor_file_ = nullptr;
+            delete descriptor_log;
+            delete descriptor_file;
             env_->RemoveFile(new_manifest_file);
         }
+        if (old_descriptor_log != nullptr) {
+            // Go on with the old MANIFEST.
+            descriptor_file_ = old_descriptor_file;
+            descriptor_log_ = old_descriptor_log;
+            manifest_edit_bytes_ = old_manifest_edit_bytes;
+        }
     }
 
     return s;
@@ -1004,6 +1211,97 @@ Status VersionSet::Recover(bool* save_manifest) {
     return s;
 }
 
+Status VersionSet::TailManifest() {
+    struct LogReporter : public log::Reader::Reporter {
+        Status* status;
+        void Corruption(size_t bytes, const Status& s) override {
+            if (this->status->ok())
+                *this->status = s;
+        }
+    };
+
+    std::string current;
+    Status s = ReadFileToString(env_, CurrentFileName(dbname_), &current);
+    if (!s.ok()) {
+        return s;
+    }
+    uint64_t number;
+    FileType type;
+    if (current.empty() || current[current.size() - 1] != '\n' ||
+        !ParseFileName(current.substr(0, current.size() - 1), &number,
+                       &type) ||
+        type != kDescriptorFile) {
+        return Status::Corruption("CURRENT does not name a MANIFEST");
+    }
+
+    SequentialFile* file;
+    s = env_->NewSequentialFile(DescriptorFileName(dbname_, number), &file);
+    if (!s.ok()) {
+        return s;
+    }
+
+    // A new MANIFEST starts with a snapshot of the whole state, so it is
+    // applied to an empty version.
+    const bool new_manifest = (number != manifest_file_number_);
+    uint64_t offset = new_manifest ? 0 : manifest_file_size_;
+    Builder builder(this, new_manifest ? new Version(this) : current_);
+    uint64_t log_number = log_number_;
+    uint64_t prev_log_number = prev_log_number_;
+    uint64_t last_sequence = last_sequence_;
+    int read_records = 0;
+    {
+        LogReporter reporter;
+        reporter.status = &s;
+        log::Reader reader(file, &reporter, true /*checksum*/, offset);
+        Slice record;
+        std::string scratch;
+        // A record that is still being written reads as the end of the
+        // file, and is applied by a later call.
+        while (reader.ReadRecord(&record, &scratch) && s.ok()) {
+            VersionEdit edit;
+            s = edit.DecodeFrom(record);
+            if (s.ok() && edit.has_comparator_ &&
+                edit.comparator_ != icmp_.user_comparator()->Name()) {
+                s = Status::InvalidArgument(
+                    edit.comparator_ + " does not match existing comparator ",
+                    icmp_.user_comparator()->Name());
+            }
+            if (!s.ok()) {
+                break;
+            }
+            builder.Apply(&edit);
+            if (edit.has_log_number_) {
+                log_number = edit.log_number_;
+            }
+            if (edit.has_prev_log_number_) {
+                prev_log_number = edit.prev_log_number_;
+            }
+            if (edit.has_next_file_number_) {
+                MarkFileNumberUsed(edit.next_file_number_);
+            }
+            if (edit.has_last_sequence_) {
+                last_sequence = std::max(last_sequence, edit.last_sequence_);
+            }
+            offset = reader.LastRecordEndOffset();
+            ++read_records;
+        }
+    }
+    delete file;
+
+    if (s.ok() && (read_records > 0 || new_manifest)) {
+        Version* v = new Version(this);
+        builder.SaveTo(v);
+        Finalize(v);
+        AppendVersion(v);
+        manifest_file_number_ = number;
+        manifest_file_size_ = offset;
+        log_number_ = log_number;
+        prev_log_number_ = prev_log_number;
+        last_sequence_ = last_sequence;
+    }
+    return s;
+}
+
 bool VersionSet::ReuseManifest(const std::string& dscname,
                                const std::string& dscbase) {
     if (!options_->reuse_logs) {
@@ -1032,6 +1330,7 @@ bool VersionSet::ReuseManifest(const std::string& dscname,
     Log(options_->info_log, "Reusing MANIFEST %s\n", dscname.c_str());
     descriptor_log_ = new log::Writer(descriptor_file_, manifest_size);
     manifest_file_number_ = manifest_number;
+    manifest_edit_bytes_ = manifest_size;
     return true;
 }
 
@@ -1042,6 +1341,63 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
 }
 
 void VersionSet::Finalize(Version* v) {
+    if (options_->compaction_style == kTiered) {
+        // Every level-0 file and every non-empty level is a sorted run.
+        // Level-0 files are still bounded by count so that a burst of
+        // flushes does not stall writes.
+        int runs = v->files_[0].size();
+        for (int level = 1; level < config::kNumLevels; level++) {
+            if (!v->files_[level].empty()) {
+                runs++;
+            }
+        }
+        const double file_score =
+            v->files_[0].size() /
+            static_cast<double>(config::kL0_CompactionTrigger);
+        const double run_score =
+            runs / static_cast<double>(options_->tiered_max_sorted_runs);
+        v->compaction_level_ = 0;
+        v->compaction_score_ = std::max(file_score, run_score);
+        return;
+    }
+
+    // Size limit of each level.  By default these are fixed.  With
+    // dynamic_level_bytes they are derived backwards from the size of the
+    // last level, and level-0 compacts straight into the "base" level, the
+    // first level whose limit is not below the level-1 default.  Levels
+    // above it stay empty.
+    double max_bytes[config::kNumLevels];
+    v->base_level_ = 1;
+    if (options_->dynamic_level_bytes) {
+        const int last = config::kNumLevels - 1;
+        const double base_bytes = MaxBytesForLevel(options_, 1);
+        double limit = TotalFileSize(v->files_[last]);
+        int base = last;
+        while (base > 1 && limit > base_bytes) {
+            base--;
+            limit /= 10;
+        }
+        // Levels that already hold data, e.g. because the database used
+        // fixed limits before, are compacted downwards from the top.
+        for (int level = 1; level < base; level++) {
+            if (!v->files_[level].empty()) {
+                base = level;
+                break;
+            }
+        }
+        v->base_level_ = base;
+
+        limit = TotalFileSize(v->files_[last]);
+        for (int level = last - 1; level >= 1; level--) {
+            limit /= 10;
+            max_bytes[level] = std::max(limit, base_bytes / 10);
+        }
+    } else {
+        for (int level = 1; level < config::kNumLevels; level++) {
+            max_bytes[level] = MaxBytesForLevel(options_, level);
+        }
+    }
+
     // Precomputed best level for next compaction
     int best_level = -1;
     double best_score = -1;
@@ -1065,8 +1421,7 @@ void VersionSet::Finalize(Version* v) {
         } else {
             // Compute the ratio of current size to size limit.
             const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-            score = static_cast<double>(level_bytes) /
-                    MaxBytesForLevel(options_, level);
+            score = static_cast<double>(level_bytes) / max_bytes[level];
         }
 
         if (score > best_score) {
@@ -1077,9 +1432,25 @@ void VersionSet::Finalize(Version* v) {
 
     v->compaction_level_ = best_level;
     v->compaction_score_ = best_score;
+
+    // Compact the tables that refer to blob files with too much garbage,
+    // so that their live values are moved out of them.  The tables that
+    // refer to the oldest blob files are found in the deepest levels, so
+    // search from the bottom.
+    for (int level = config::kNumLevels - 1;
+         level >= 0 && v->file_to_compact_ == nullptr; level--) {
+        for (size_t i = 0; i < v->files_[level].size(); i++) {
+            FileMetaData* f = v->files_[level][i];
+            if (v->NeedsBlobGC(f)) {
+                v->file_to_compact_ = f;
+                v->file_to_compact_level_ = level;
+                break;
+            }
+        }
+    }
 }
 
-Status VersionSet::WriteSnapshot(log::Writer* log) {
+void VersionSet::EncodeSnapshot(std::string* record) {
     // TODO: Break up into multiple records to reduce memory usage on recovery?
 
     // Save metadata
@@ -1099,15 +1470,20 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     for (int level = 0; level < config::kNumLevels; level++) {
         const std::vector<FileMetaData*>& files = current_->files_[level];
         for (size_t i = 0; i < files.size(); i++) {
-            const FileMetaData* f = files[i];
-            edit.AddFile(level, f->number, f->file_size, f->smallest,
-                         f->largest);
+            edit.AddFile(level, *files[i]);
         }
     }
 
-    std::string record;
-    edit.EncodeTo(&record);
-    return log->AddRecord(record);
+    // Save blob files
+    for (const auto& kvp : current_->blob_files_) {
+        const BlobFileMetaData& b = kvp.second;
+        edit.AddBlobFile(b.number, b.total_bytes);
+        if (b.garbage_bytes > 0) {
+            edit.AddBlobGarbage(b.number, b.garbage_bytes);
+        }
+    }
+
+    edit.EncodeTo(record);
 }
 
 int VersionSet::NumLevelFiles(int level) const {
@@ -1148,9 +1524,9 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
                 // "ikey" falls in the range for this table.  Add the
                 // approximate offset of "ikey" within the table.
                 Table* tableptr;
-                Iterator* iter =
-                    table_cache_->NewIterator(ReadOptions(), files[i]->number,
-                                              files[i]->file_size, &tableptr);
+                Iterator* iter = table_cache_->NewIterator(
+                    ReadOptions(), files[i]->number, files[i]->file_size,
+                    files[i]->global_seqno, &tableptr);
                 if (tableptr != nullptr) {
                     result += tableptr->ApproximateOffsetOf(ikey.Encode());
                 }
@@ -1170,6 +1546,9 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
                 live->insert(files[i]->number);
             }
         }
+        for (const auto& kvp : v->blob_files_) {
+            live->insert(kvp.first);
+        }
     }
 }
 
@@ -1235,20 +1614,29 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
     ReadOptions options;
     options.verify_checksums = options_->paranoid_checks;
     options.fill_cache = false;
+    options.readahead_size = options_->compaction_readahead_size;
+    options.rate_limiter = options_->rate_limiter;
 
     // Level-0 files have to be merged together.  For other levels,
     // we will make a concatenating iterator per level.
     // TODO(opt): use concatenating iterator for level-0 if there is no overlap
-    const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+    const int space = (c->level() == 0 ? c->inputs_[0].size() : 1) +
+                      c->num_input_levels() - 1;
     Iterator** list = new Iterator*[space];
     int num = 0;
-    for (int which = 0; which < 2; which++) {
+    for (int which = 0; which < c->num_input_levels(); which++) {
+        // The inputs are read from start to end, and deleted afterwards.
+        for (FileMetaData* f : c->inputs_[which]) {
+            table_cache_->Hint(f->number, f->file_size,
+                               RandomAccessFile::kSequential);
+        }
         if (!c->inputs_[which].empty()) {
-            if (c->level() + which == 0) {
+            if (c->input_level(which) == 0) {
                 const std::vector<FileMetaData*>& files = c->inputs_[which];
                 for (size_t i = 0; i < files.size(); i++) {
                     list[num++] = table_cache_->NewIterator(
-                        options, files[i]->number, files[i]->file_size);
+                        options, files[i]->number, files[i]->file_size,
+                        files[i]->global_seqno);
                 }
             } else {
                 // Create concatenating iterator for the files from this level
@@ -1266,6 +1654,10 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 }
 
 Compaction* VersionSet::PickCompaction() {
+    if (options_->compaction_style == kTiered) {
+        return PickTieredCompaction();
+    }
+
     Compaction* c;
     int level;
 
@@ -1277,7 +1669,7 @@ Compaction* VersionSet::PickCompaction() {
         level = current_->compaction_level_;
         assert(level >= 0);
         assert(level + 1 < config::kNumLevels);
-        c = new Compaction(options_, level);
+        c = new Compaction(options_, level, CompactionOutputLevel(level));
 
         // Pick the first file that comes after compact_pointer_[level]
         for (size_t i = 0; i < current_->files_[level].size(); i++) {
@@ -1295,7 +1687,14 @@ Compaction* VersionSet::PickCompaction() {
         }
     } else if (seek_compaction) {
         level = current_->file_to_compact_level_;
-        c = new Compaction(options_, level);
+        if (level == config::kNumLevels - 1) {
+            // Only blob garbage collection picks a file of the last level.
+            // It is rewritten in place.
+            c = new Compaction(options_, level, level);
+            c->num_input_levels_ = 1;
+        } else {
+            c = new Compaction(options_, level, CompactionOutputLevel(level));
+        }
         c->inputs_[0].push_back(current_->file_to_compact_);
     } else {
         return nullptr;
@@ -1403,21 +1802,26 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
 
 void VersionSet::SetupOtherInputs(Compaction* c) {
     const int level = c->level();
+    const int output_level = c->output_level();
     InternalKey smallest, largest;
 
     AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
+    if (c->num_input_levels_ == 1) {
+        // The inputs are rewritten in place.
+        return;
+    }
     GetRange(c->inputs_[0], &smallest, &largest);
 
-    current_->GetOverlappingInputs(level + 1, &smallest, &largest,
+    current_->GetOverlappingInputs(output_level, &smallest, &largest,
                                    &c->inputs_[1]);
-    AddBoundaryInputs(icmp_, current_->files_[level + 1], &c->inputs_[1]);
+    AddBoundaryInputs(icmp_, current_->files_[output_level], &c->inputs_[1]);
 
     // Get entire range covered by compaction
     InternalKey all_start, all_limit;
     GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
 
     // See if we can grow the number of inputs in "level" without
-    // changing the number of "level+1" files we pick up.
+    // changing the number of "output_level" files we pick up.
     if (!c->inputs_[1].empty()) {
         std::vector<FileMetaData*> expanded0;
         current_->GetOverlappingInputs(level, &all_start, &all_limit,
@@ -1432,9 +1836,10 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
             InternalKey new_start, new_limit;
             GetRange(expanded0, &new_start, &new_limit);
             std::vector<FileMetaData*> expanded1;
-            current_->GetOverlappingInputs(level + 1, &new_start, &new_limit,
-                                           &expanded1);
-            AddBoundaryInputs(icmp_, current_->files_[level + 1], &expanded1);
+            current_->GetOverlappingInputs(output_level, &new_start,
+                                           &new_limit, &expanded1);
+            AddBoundaryInputs(icmp_, current_->files_[output_level],
+                              &expanded1);
             if (expanded1.size() == c->inputs_[1].size()) {
                 Log(options_->info_log,
                     "Expanding@%d %d+%d (%ld+%ld bytes) to %d+%d (%ld+%ld "
@@ -1453,10 +1858,10 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
     }
 
     // Compute the set of grandparent files that overlap this compaction
-    // (parent == level+1; grandparent == level+2)
-    if (level + 2 < config::kNumLevels) {
-        current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
-                                       &c->grandparents_);
+    // (parent == output_level; grandparent == output_level+1)
+    if (output_level + 1 < config::kNumLevels) {
+        current_->GetOverlappingInputs(output_level + 1, &all_start,
+                                       &all_limit, &c->grandparents_);
     }
 
     // Update the place where we will do the next compaction for this level.
@@ -1467,6 +1872,99 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
     c->edit_.SetCompactPointer(level, largest);
 }
 
+int VersionSet::CompactionOutputLevel(int level) const {
+    if (level == 0) {
+        return current_->base_level_;
+    }
+    return level + 1;
+}
+
+Compaction* VersionSet::PickTieredCompaction() {
+    if (current_->compaction_score_ < 1) {
+        return nullptr;
+    }
+
+    // Collect the sorted runs from newest to oldest: level-0 files in
+    // decreasing file number order, then each non-empty level.  Flushes
+    // only ever write to level-0 and compactions only to the other levels,
+    // so this is also the order in which the runs were written.
+    struct SortedRun {
+        int level;
+        FileMetaData* file; // Only set for level-0 runs
+        uint64_t size;
+    };
+    std::vector<SortedRun> runs;
+    std::vector<FileMetaData*> level0 = current_->files_[0];
+    std::sort(level0.begin(), level0.end(), NewestFirst);
+    for (size_t i = 0; i < level0.size(); i++) {
+        runs.push_back(SortedRun{0, level0[i], level0[i]->file_size});
+    }
+    for (int level = 1; level < config::kNumLevels; level++) {
+        if (!current_->files_[level].empty()) {
+            runs.push_back(SortedRun{
+                level, nullptr,
+                static_cast<uint64_t>(TotalFileSize(current_->files_[level]))});
+        }
+    }
+    if (runs.size() < 2) {
+        return nullptr;
+    }
+
+    // Always start with the newest run and all of level-0, since the
+    // output goes to a level.  Then pick up older runs of similar size, and
+    // enough runs to get below the sorted run limit.
+    size_t min_runs = std::max<size_t>(2, level0.size());
+    const size_t max_runs = options_->tiered_max_sorted_runs;
+    if (runs.size() >= max_runs) {
+        min_runs = std::max(min_runs, runs.size() - max_runs + 2);
+    }
+    size_t picked = 0;
+    uint64_t picked_size = 0;
+    while (picked < runs.size()) {
+        const SortedRun& next = runs[picked];
+        if (picked >= min_runs &&
+            next.size * 100 >
+                picked_size * (100 + options_->tiered_size_ratio)) {
+            break;
+        }
+        picked_size += next.size;
+        picked++;
+    }
+
+    // The output replaces the oldest picked level, or, if only level-0
+    // files were picked, goes to the deepest free level above the next
+    // older run.  The older runs then all live in deeper levels.
+    int output_level = config::kNumLevels - 1;
+    if (runs[picked - 1].level > 0) {
+        output_level = runs[picked - 1].level;
+    } else if (picked < runs.size()) {
+        output_level = runs[picked].level - 1;
+        if (output_level == 0) {
+            // Level-1 is in use, so merge it in too.
+            output_level = 1;
+            picked++;
+        }
+    }
+
+    Compaction* c = new Compaction(options_, runs[0].level, output_level);
+    c->num_input_levels_ = 0;
+    for (size_t i = 0; i < picked; i++) {
+        const int level = runs[i].level;
+        if (c->num_input_levels_ == 0 ||
+            c->input_levels_[c->num_input_levels_ - 1] != level) {
+            c->input_levels_[c->num_input_levels_++] = level;
+        }
+        if (level > 0) {
+            c->inputs_[c->num_input_levels_ - 1] = current_->files_[level];
+        } else {
+            c->inputs_[c->num_input_levels_ - 1].push_back(runs[i].file);
+        }
+    }
+    c->input_version_ = current_;
+    c->input_version_->Ref();
+    return c;
+}
+
 Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
                                      const InternalKey* end) {
     std::vector<FileMetaData*> inputs;
@@ -1492,7 +1990,8 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
         }
     }
 
-    Compaction* c = new Compaction(options_, level);
+    Compaction* c =
+        new Compaction(options_, level, CompactionOutputLevel(level));
     c->input_version_ = current_;
     c->input_version_->Ref();
     c->inputs_[0] = inputs;
@@ -1500,10 +1999,13 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
     return c;
 }
 
-Compaction::Compaction(const Options* options, int level)
-    : level_(level), max_output_file_size_(MaxFileSizeForLevel(options, level)),
-      input_version_(nullptr), grandparent_index_(0), seen_key_(false),
-      overlapped_bytes_(0) {
+Compaction::Compaction(const Options* options, int level, int output_level)
+    : level_(level), output_level_(output_level),
+      max_output_file_size_(MaxFileSizeForLevel(options, level)),
+      input_version_(nullptr), num_input_levels_(2), grandparent_index_(0),
+      seen_key_(false), overlapped_bytes_(0) {
+    input_levels_[0] = level;
+    input_levels_[1] = output_level;
     for (int i = 0; i < config::kNumLevels; i++) {
         level_ptrs_[i] = 0;
     }
@@ -1520,23 +2022,35 @@ bool Compaction::IsTrivialMove() const {
     // Avoid a move if there is lots of overlapping grandparent data.
     // Otherwise, the move could create a parent file that will require
     // a very expensive merge later on.
-    return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+    // A file that refers to blob garbage must be rewritten to collect it.
+    return (num_input_levels_ == 2 && input_levels_[1] == output_level_ &&
+            num_input_files(0) == 1 && num_input_files(1) == 0 &&
+            !input_version_->NeedsBlobGC(inputs_[0][0]) &&
             TotalFileSize(grandparents_) <=
                 MaxGrandParentOverlapBytes(vset->options_));
 }
 
 void Compaction::AddInputDeletions(VersionEdit* edit) {
-    for (int which = 0; which < 2; which++) {
+    for (int which = 0; which < num_input_levels_; which++) {
         for (size_t i = 0; i < inputs_[which].size(); i++) {
-            edit->RemoveFile(level_ + which, inputs_[which][i]->number);
+            edit->RemoveFile(input_levels_[which], inputs_[which][i]->number);
+        }
+    }
+}
+
+bool Compaction::IsBottommostLevel() const {
+    for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+        if (!input_version_->files_[lvl].empty()) {
+            return false;
         }
     }
+    return true;
 }
 
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
     // Maybe use binary search to find right entry instead of linear search?
     const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-    for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+    for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
         const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
         while (level_ptrs_[lvl] < files.size()) {
             FileMetaData* f = files[level_ptrs_[lvl]];
@@ -1555,6 +2069,19 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
     return true;
 }
 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+    for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+        if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Compaction::ShouldRelocateBlob(uint64_t blob_file_number) const {
+    return input_version_->BlobFileNeedsGC(blob_file_number);
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
     const VersionSet* vset = input_version_->vset_;
     // Scan to find earliest grandparent file that contains key.
@@ -28,9 +28,12 @@ namespace log {
 class Writer;
 }
 
+class RangeTombstoneList;
+
 class Compaction;
 class Iterator;
 class MemTable;
+class MergeContext;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -67,11 +70,21 @@ class Version {
     // REQUIRES: This version has been saved (see VersionSet::SaveTo)
     void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+    // Add the range tombstones of the files in this Version to *list.
+    // Only files recorded as having range tombstones are opened.
+    // REQUIRES: lock is not held
+    Status AddRangeTombstones(RangeTombstoneList* list);
+
     // Lookup the value for key.  If found, store it in *val and
-    // return OK.  Else return a non-OK status.  Fills *stats.
+    // return OK.  Else return a non-OK status.  Fills *stats.  Entries
+    // older than max_covering_tombstone_seq, the newest range tombstone
+    // covering key found in the memtables, are treated as deleted.
+    // *merge_context holds the merge operands found in the memtables and
+    // collects the ones found in files; they are applied to the value.
     // REQUIRES: lock is not held
     Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-               GetStats* stats);
+               GetStats* stats, SequenceNumber max_covering_tombstone_seq,
+               MergeContext* merge_context);
 
     // Adds "stats" into the current state.  Returns true if a new
     // compaction may need to be triggered, false otherwise.
@@ -110,6 +123,24 @@ class Version {
 
     int NumFiles(int level) const { return files_[level].size(); }
 
+    // Append the files of all levels to *files, level-0 first.
+    void GetAllFiles(std::vector<FileMetaData*>* files) const;
+
+    // Append the numbers of the blob files of this version to *numbers.
+    void GetBlobFiles(std::vector<uint64_t>* numbers) const;
+
+    // Returns true if the specified blob file holds enough garbage to be
+    // collected, i.e. if compactions should move its live values to a new
+    // blob file.
+    bool BlobFileNeedsGC(uint64_t blob_file_number) const;
+
+    // Returns true if the oldest blob file that "f" refers to needs to be
+    // garbage collected.
+    bool NeedsBlobGC(const FileMetaData* f) const {
+        return f->oldest_blob_file != 0 &&
+               BlobFileNeedsGC(f->oldest_blob_file);
+    }
+
     // Return a human readable string that describes this version's contents.
     std::string DebugString() const;
 
@@ -122,7 +153,7 @@ class Version {
     explicit Version(VersionSet* vset)
         : vset_(vset), next_(this), prev_(this), refs_(0),
           file_to_compact_(nullptr), file_to_compact_level_(-1),
-          compaction_score_(-1), compaction_level_(-1) {}
+          compaction_score_(-1), compaction_level_(-1), base_level_(1) {}
 
     Version(const Version&) = delete;
     Version& operator=(const Version&) = delete;
@@ -147,7 +178,8 @@ class Version {
     // List of files per level
     std::vector<FileMetaData*> files_[config::kNumLevels];
 
-    // Next file to compact based on seek stats.
+    // Next file to compact based on seek stats, or because it refers to
+    // a blob file that needs to be garbage collected.
     FileMetaData* file_to_compact_;
     int file_to_compact_level_;
 
@@ -156,6 +188,13 @@ class Version {
     // are initialized by Finalize().
     double compaction_score_;
     int compaction_level_;
+
+    // Level that level-0 files are compacted into.  This is level-1 unless
+    // Options::dynamic_level_bytes is set.  Initialized by Finalize().
+    int base_level_;
+
+    // Blob files that tables of this version may refer to, by number.
+    std::map<uint64_t, BlobFileMetaData> blob_files_;
 };
 
 class VersionSet {
@@ -178,12 +217,22 @@ class VersionSet {
     // Recover the last saved descriptor from persistent storage.
     Status Recover(bool* save_manifest);
 
+    // Apply the edits that another process appended to the MANIFEST named
+    // by CURRENT since the last call, or all of its edits if CURRENT names
+    // a different MANIFEST now.  Used by secondary instances, which follow
+    // a database without ever writing its MANIFEST.
+    Status TailManifest();
+
     // Return the current version.
     Version* current() const { return current_; }
 
     // Return the current manifest file number
     uint64_t ManifestFileNumber() const { return manifest_file_number_; }
 
+    // Return the length of the prefix of the current manifest file that
+    // describes the current version.
+    uint64_t ManifestFileSize() const { return manifest_file_size_; }
+
     // Allocate and return a new file number
     uint64_t NewFileNumber() { return next_file_number_++; }
 
@@ -245,6 +294,11 @@ class VersionSet {
     // Returns true iff some level needs a compaction.
     bool NeedsCompaction() const {
         Version* v = current_;
+        if (options_->compaction_style == kTiered) {
+            // Tiered compactions always merge whole runs and are never
+            // triggered by seeks.
+            return v->compaction_score_ >= 1;
+        }
         return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
     }
 
@@ -282,8 +336,14 @@ class VersionSet {
 
     void SetupOtherInputs(Compaction* c);
 
-    // Save current contents to *log
-    Status WriteSnapshot(log::Writer* log);
+    // Return the level that a compaction of "level" writes to.
+    int CompactionOutputLevel(int level) const;
+
+    // Pick the sorted runs to merge for a kTiered compaction of current_.
+    Compaction* PickTieredCompaction();
+
+    // Encode the current contents as a single MANIFEST record in *record.
+    void EncodeSnapshot(std::string* record);
 
     void AppendVersion(Version* v);
 
@@ -302,6 +362,9 @@ class VersionSet {
     // Opened lazily
     WritableFile* descriptor_file_;
     log::Writer* descriptor_log_;
+    // Bytes of edits in the MANIFEST after its initial snapshot.
+    uint64_t manifest_edit_bytes_;
+    uint64_t manifest_file_size_;
     Version dummy_versions_; // Head of circular doubly-linked list of versions.
     Version* current_;       // == dummy_versions_.prev_
 
@@ -317,16 +380,29 @@ class Compaction {
 
     // Return the level that is being compacted.  Inputs from "level"
     // and "level+1" will be merged to produce a set of "level+1" files.
+    // A tiered compaction may merge more levels; "level" is then the
+    // newest of them.
     int level() const { return level_; }
 
+    // Return the level that receives the output of this compaction.
+    int output_level() const { return output_level_; }
+
     // Return the object that holds the edits to the descriptor done
     // by this compaction.
     VersionEdit* edit() { return &edit_; }
 
-    // "which" must be either 0 or 1
+    // Return the number of levels that provide inputs, ordered from the
+    // newest level to the oldest one.  This is 2 unless the compaction is
+    // a tiered one.
+    int num_input_levels() const { return num_input_levels_; }
+
+    // Return the level of the inputs numbered "which".
+    int input_level(int which) const { return input_levels_[which]; }
+
+    // "which" must be less than num_input_levels()
     int num_input_files(int which) const { return inputs_[which].size(); }
 
-    // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+    // Return the ith input file at "input_level(which)".
     FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
 
     // Maximum size of files to build during this compaction.
@@ -340,10 +416,22 @@ class Compaction {
     void AddInputDeletions(VersionEdit* edit);
 
     // Returns true if the information we have available guarantees that
-    // the compaction is producing data in "level+1" for which no data exists
-    // in levels greater than "level+1".
+    // the compaction is producing data in "output_level()" for which no
+    // data exists in levels greater than "output_level()".
     bool IsBaseLevelForKey(const Slice& user_key);
 
+    // Returns true if no data exists in levels greater than "output_level()".
+    bool IsBottommostLevel() const;
+
+    // Returns true if no data exists in levels greater than "output_level()"
+    // for any key in [begin, end].  Unlike IsBaseLevelForKey(), may be
+    // called with ranges in any order.
+    bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
+    // Returns true if this compaction should move the values it finds in
+    // the specified blob file to a new one.
+    bool ShouldRelocateBlob(uint64_t blob_file_number) const;
+
     // Returns true iff we should stop building the current output
     // before processing "internal_key".
     bool ShouldStopBefore(const Slice& internal_key);
@@ -356,15 +444,20 @@ class Compaction {
     friend class Version;
     friend class VersionSet;
 
-    Compaction(const Options* options, int level);
+    Compaction(const Options* options, int level, int output_level);
 
     int level_;
+    int output_level_;
     uint64_t max_output_file_size_;
     Version* input_version_;
     VersionEdit edit_;
 
-    // Each compaction reads inputs from "level_" and "level_+1"
-    std::vector<FileMetaData*> inputs_[2]; // The two sets of inputs
+    // Each compaction reads inputs from "level_" and "level_+1", except
+    // for tiered compactions, which read whole sorted runs from any number
+    // of levels.
+    int num_input_levels_;
+    int input_levels_[config::kNumLevels];
+    std::vector<FileMetaData*> inputs_[config::kNumLevels];
 
     // State used to check for number of overlapping grandparent files
     // (parent == level_ + 1, grandparent == level_ + 2)
@@ -379,7 +472,7 @@ class Compaction {
     // level_ptrs_ holds indices into input_version_->levels_: our state
     // is that we are positioned at one of the file ranges for each
     // higher level than the ones involved in this compaction (i.e. for
-    // all L >= level_ + 2).
+    // all L > output_level_).
     size_t level_ptrs_[config::kNumLevels];
 };
 
@@ -6,7 +6,9 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeRangeDeletion varstring varstring |
+//    kTypeMerge varstring varstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -32,6 +34,14 @@ WriteBatch::~WriteBatch() = default;
 
 WriteBatch::Handler::~Handler() = default;
 
+void WriteBatch::Handler::DeleteRange(const Slice& begin, const Slice& end) {
+    unsupported_ = Status::NotSupported("WriteBatch::Handler::DeleteRange");
+}
+
+void WriteBatch::Handler::Merge(const Slice& key, const Slice& value) {
+    unsupported_ = Status::NotSupported("WriteBatch::Handler::Merge");
+}
+
 void WriteBatch::Clear() {
     rep_.clear();
     rep_.resize(kHeader);
@@ -68,6 +78,28 @@ Status WriteBatch::Iterate(Handler* handler) const {
                 return Status::Corruption("bad WriteBatch Delete");
             }
             break;
+        case kTypeRangeDeletion:
+            if (GetLengthPrefixedSlice(&input, &key) &&
+                GetLengthPrefixedSlice(&input, &value)) {
+                handler->DeleteRange(key, value);
+                if (!handler->unsupported_.ok()) {
+                    return handler->unsupported_;
+                }
+            } else {
+                return Status::Corruption("bad WriteBatch DeleteRange");
+            }
+            break;
+        case kTypeMerge:
+            if (GetLengthPrefixedSlice(&input, &key) &&
+                GetLengthPrefixedSlice(&input, &value)) {
+                handler->Merge(key, value);
+                if (!handler->unsupported_.ok()) {
+                    return handler->unsupported_;
+                }
+            } else {
+                return Status::Corruption("bad WriteBatch Merge");
+            }
+            break;
         default:
             return Status::Corruption("unknown WriteBatch tag");
         }
@@ -108,6 +140,20 @@ void WriteBatch::Delete(const Slice& key) {
     PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::DeleteRange(const Slice& begin, const Slice& end) {
+    WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+    rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+    PutLengthPrefixedSlice(&rep_, begin);
+    PutLengthPrefixedSlice(&rep_, end);
+}
+
+void WriteBatch::Merge(const Slice& key, const Slice& value) {
+    WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+    rep_.push_back(static_cast<char>(kTypeMerge));
+    PutLengthPrefixedSlice(&rep_, key);
+    PutLengthPrefixedSlice(&rep_, value);
+}
+
 void WriteBatch::Append(const WriteBatch& source) {
     WriteBatchInternal::Append(this, &source);
 }
@@ -126,6 +172,14 @@ class MemTableInserter : public WriteBatch::Handler {
         mem_->Add(sequence_, kTypeDeletion, key, Slice());
         sequence_++;
     }
+    void DeleteRange(const Slice& begin, const Slice& end) override {
+        mem_->Add(sequence_, kTypeRangeDeletion, begin, end);
+        sequence_++;
+    }
+    void Merge(const Slice& key, const Slice& value) override {
+        mem_->Add(sequence_, kTypeMerge, key, value);
+        sequence_++;
+    }
 };
 } // namespace
 
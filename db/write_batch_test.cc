@@ -38,11 +38,43 @@ static std::string PrintContents(WriteBatch* b) {
             state.append(")");
             count++;
             break;
+        case kTypeMerge:
+            state.append("Merge(");
+            state.append(ikey.user_key.ToString());
+            state.append(", ");
+            state.append(iter->value().ToString());
+            state.append(")");
+            count++;
+            break;
+        case kTypeBlobIndex:
+            // Blob indexes are only written by flushes and compactions;
+            // a WriteBatch cannot hold one.
+            ADD_FAILURE() << "blob index in a write batch";
+            break;
+        case kTypeRangeDeletion:
+            break;
         }
         state.append("@");
         state.append(NumberToString(ikey.sequence));
     }
     delete iter;
+    iter = mem->NewRangeTombstoneIterator();
+    if (iter != nullptr) {
+        iter->SeekToFirst();
+    }
+    for (; iter != nullptr && iter->Valid(); iter->Next()) {
+        ParsedInternalKey ikey;
+        EXPECT_TRUE(ParseInternalKey(iter->key(), &ikey));
+        EXPECT_EQ(kTypeRangeDeletion, ikey.type);
+        state.append("DeleteRange(");
+        state.append(ikey.user_key.ToString());
+        state.append(", ");
+        state.append(iter->value().ToString());
+        state.append(")@");
+        state.append(NumberToString(ikey.sequence));
+        count++;
+    }
+    delete iter;
     if (!s.ok()) {
         state.append("ParseError()");
     } else if (count != WriteBatchInternal::Count(b)) {
@@ -72,6 +104,67 @@ TEST(WriteBatchTest, Multiple) {
               PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, DeleteRange) {
+    WriteBatch batch;
+    batch.Put(Slice("foo"), Slice("bar"));
+    batch.DeleteRange(Slice("a"), Slice("m"));
+    batch.Put(Slice("baz"), Slice("boo"));
+    batch.DeleteRange(Slice("b"), Slice("c"));
+    WriteBatchInternal::SetSequence(&batch, 100);
+    ASSERT_EQ(4, WriteBatchInternal::Count(&batch));
+    ASSERT_EQ("Put(baz, boo)@102"
+              "Put(foo, bar)@100"
+              "DeleteRange(a, m)@101"
+              "DeleteRange(b, c)@103",
+              PrintContents(&batch));
+}
+
+// A handler that only knows about puts and deletions.
+class CountingHandler : public WriteBatch::Handler {
+  public:
+    CountingHandler() : count(0) {}
+    void Put(const Slice& key, const Slice& value) override { count++; }
+    void Delete(const Slice& key) override { count++; }
+
+    int count;
+};
+
+TEST(WriteBatchTest, DeleteRangeNotHandled) {
+    WriteBatch batch;
+    batch.Put(Slice("foo"), Slice("bar"));
+    CountingHandler handler;
+    ASSERT_TRUE(batch.Iterate(&handler).ok());
+    ASSERT_EQ(1, handler.count);
+
+    batch.DeleteRange(Slice("a"), Slice("m"));
+    batch.Delete(Slice("box"));
+    CountingHandler old_handler;
+    ASSERT_TRUE(batch.Iterate(&old_handler).IsNotSupportedError());
+    ASSERT_EQ(1, old_handler.count);
+}
+
+TEST(WriteBatchTest, Merge) {
+    WriteBatch batch;
+    batch.Put(Slice("foo"), Slice("bar"));
+    batch.Merge(Slice("foo"), Slice("baz"));
+    batch.Merge(Slice("box"), Slice("boo"));
+    WriteBatchInternal::SetSequence(&batch, 100);
+    ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+    ASSERT_EQ("Merge(box, boo)@102"
+              "Merge(foo, baz)@101"
+              "Put(foo, bar)@100",
+              PrintContents(&batch));
+}
+
+TEST(WriteBatchTest, MergeNotHandled) {
+    WriteBatch batch;
+    batch.Put(Slice("foo"), Slice("bar"));
+    batch.Merge(Slice("foo"), Slice("baz"));
+    CountingHandler handler;
+    ASSERT_TRUE(batch.Iterate(&handler).IsNotSupportedError());
+    ASSERT_EQ(1, handler.count);
+}
+
 TEST(WriteBatchTest, Corruption) {
     WriteBatch batch;
     batch.Put(Slice("foo"), Slice("bar"));
@@ -7,10 +7,11 @@
 // length strings, may use the length of the string as the charge for
 // the string.
 //
-// A builtin cache implementation with a least-recently-used eviction
-// policy is provided.  Clients may use their own implementations if
-// they want something more sophisticated (like scan-resistance, a
-// custom eviction policy, variable cache sizing, etc.)
+// Builtin cache implementations with a least-recently-used eviction
+// policy and with a CLOCK approximation of it are provided.  Clients may
+// use their own implementations if they want something more sophisticated
+// (like scan-resistance, a custom eviction policy, variable cache sizing,
+// etc.)
 
 #ifndef STORAGE_MYDB_INCLUDE_CACHE_H_
 #define STORAGE_MYDB_INCLUDE_CACHE_H_
@@ -26,7 +27,31 @@ class MYDB_EXPORT Cache;
 
 // Create a new cache with a fixed size capacity.  This implementation
 // of Cache uses a least-recently-used eviction policy.
-MYDB_EXPORT Cache* NewLRUCache(size_t capacity);
+//
+// If "high_pri_pool_ratio" is positive, up to that fraction of the capacity
+// is set aside as a high-priority pool for entries inserted with
+// Cache::Priority::kHigh and for entries that were looked up again after
+// being inserted.  Unused entries in the pool are only evicted once no
+// other unused entry is left; entries pushed out of a full pool fall back
+// to ordinary LRU order.
+//
+// The cache is split into 2^"num_shard_bits" shards, each with its own
+// mutex and an equal share of the capacity.
+MYDB_EXPORT Cache* NewLRUCache(size_t capacity,
+                               double high_pri_pool_ratio = 0.0,
+                               int num_shard_bits = 4);
+
+// Create a new cache with a fixed size capacity that approximates LRU with
+// the CLOCK algorithm.  Lookup() and Release() only use atomic operations,
+// so concurrent hits do not contend on a mutex.  Entries inserted with
+// Cache::Priority::kHigh survive more sweeps of the clock than others.
+//
+// The cache is split into 2^"num_shard_bits" shards; a negative value picks
+// a shard count from the capacity.  Each shard is a hash table sized for
+// capacity / "estimated_entry_charge" entries, so when entries are much
+// smaller than estimated, entries are evicted before the capacity is used.
+MYDB_EXPORT Cache* NewClockCache(size_t capacity, int num_shard_bits = -1,
+                                 size_t estimated_entry_charge = 4096);
 
 class MYDB_EXPORT Cache {
   public:
@@ -42,6 +67,11 @@ class MYDB_EXPORT Cache {
     // Opaque handle to an entry stored in the cache.
     struct Handle {};
 
+    // Hint for how eagerly an entry may be evicted.  Entries that are
+    // expensive to rebuild or used by every lookup, such as index and
+    // filter blocks, should be inserted with kHigh.
+    enum class Priority { kHigh, kLow };
+
     // Insert a mapping from key->value into the cache and assign it
     // the specified charge against the total cache capacity.
     //
@@ -54,6 +84,12 @@ class MYDB_EXPORT Cache {
     virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                            void (*deleter)(const Slice& key, void* value)) = 0;
 
+    // Like Insert() above, but with an eviction priority hint.  The
+    // default implementation ignores "priority".
+    virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value),
+                           Priority priority);
+
     // If the cache has no mapping for "key", returns nullptr.
     //
     // Else return a handle that corresponds to the mapping.  The caller
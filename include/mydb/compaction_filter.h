@@ -0,0 +1,59 @@
+
+
+//
+// A CompactionFilter lets an application drop or rewrite values while
+// compactions copy them, so that data that has outlived its purpose goes
+// away without a separate pass that reads and deletes it.
+
+#ifndef STORAGE_MYDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_MYDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <string>
+
+#include "mydb/export.h"
+
+namespace mydb {
+
+class Env;
+class Slice;
+
+// A CompactionFilter must be thread-safe since compactions may invoke it
+// from background threads.
+class MYDB_EXPORT CompactionFilter {
+  public:
+    enum Decision {
+        kKeep,        // Keep the value unchanged
+        kRemove,      // Delete the key
+        kChangeValue, // Replace the value with *new_value
+    };
+
+    virtual ~CompactionFilter();
+
+    // The name of the filter, for logging.
+    virtual const char* Name() const = 0;
+
+    // Called for every value a compaction of "level" keeps that was
+    // written after the newest live snapshot, so no snapshot reads it.
+    // Values still visible to a snapshot are passed over, and so are
+    // deletions.  The value may already be overwritten by a newer one
+    // outside the compaction.  Return what to do with the value;
+    // kChangeValue requires *new_value to be set.
+    virtual Decision Filter(int level, const Slice& key,
+                            const Slice& existing_value,
+                            std::string* new_value) const = 0;
+};
+
+// Return a filter that removes values whose time to live has run out.  Such
+// values start with their expiry time, encoded as a little-endian fixed64
+// number of seconds since the Unix epoch; values that are shorter or have an
+// expiry time of zero never expire.  The current time is read from
+// env->NowMicros().  Reads still return expired values until a compaction
+// removes them, so readers should check the expiry time too.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+MYDB_EXPORT const CompactionFilter* NewTTLCompactionFilter(Env* env);
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_INCLUDE_COMPACTION_FILTER_H_
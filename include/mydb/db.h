@@ -5,6 +5,8 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "mydb/export.h"
 #include "mydb/iterator.h"
@@ -51,6 +53,18 @@ class MYDB_EXPORT DB {
     static Status Open(const Options& options, const std::string& name,
                        DB** dbptr);
 
+    // Open the database with the specified "name", which another process
+    // (the primary) may have open for writing, as a read-only secondary
+    // instance.  The secondary takes no lock, never changes any file of
+    // the database, and keeps its info log in "secondary_path".  It sees
+    // the state of the database as of the open, and moves on to a later
+    // one with TryCatchUpWithPrimary().
+    // Stores nullptr in *dbptr and returns a non-OK status on error.
+    static Status OpenAsSecondary(const Options& options,
+                                  const std::string& name,
+                                  const std::string& secondary_path,
+                                  DB** dbptr);
+
     DB() = default;
 
     DB(const DB&) = delete;
@@ -70,6 +84,22 @@ class MYDB_EXPORT DB {
     // Note: consider setting options.sync = true.
     virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+    // Remove the database entries (if any) for every key in ["begin",
+    // "end").  The deletion is recorded as a single range tombstone, so it
+    // costs the same however many keys it covers.  Returns OK on success,
+    // and a non-OK status on error.
+    // Note: consider setting options.sync = true.
+    virtual Status DeleteRange(const WriteOptions& options, const Slice& begin,
+                               const Slice& end) = 0;
+
+    // Merge "value" into the database entry for "key" with the database's
+    // Options::merge_operator, without reading the current value.  Returns
+    // OK on success, and a non-OK status on error, including when no merge
+    // operator is configured.
+    // Note: consider setting options.sync = true.
+    virtual Status Merge(const WriteOptions& options, const Slice& key,
+                         const Slice& value) = 0;
+
     // Apply the specified updates to the database.
     // Returns OK on success, non-OK on failure.
     // Note: consider setting options.sync = true.
@@ -143,6 +173,37 @@ class MYDB_EXPORT DB {
     // Therefore the following call will compact the entire database:
     //    db->CompactRange(nullptr, nullptr);
     virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+    // Add the tables in "paths", written by SstFileWriter with the same
+    // comparator as this database, without going through the log or the
+    // memtable.  The files must not overlap each other.  Their entries
+    // become visible atomically, as if written by a single Write() issued
+    // now, and replace any older entries for the same keys.
+    //
+    // Each file is placed in the deepest level that has no data
+    // overlapping it at or above that level, so loading sorted data into
+    // an empty key range is not followed by compactions that rewrite it.
+    // Writes and compactions pause while the files are added, and the
+    // memtable is flushed first if it overlaps them.
+    virtual Status IngestExternalFile(
+        const std::vector<std::string>& paths,
+        const IngestExternalFileOptions& options) = 0;
+
+    // Create a consistent copy of the database in the new directory "dir",
+    // which can then be opened as a database of its own.  Table and blob
+    // files are hard-linked into "dir" when it is on the same file system,
+    // and copied otherwise; the MANIFEST and the logs are always copied.
+    // Writes may go on while the checkpoint is created; it holds every
+    // write that completed before the call.
+    virtual Status CreateCheckpoint(const std::string& dir) = 0;
+
+    // Bring a secondary instance (see OpenAsSecondary()) up to date with
+    // the writes and compactions of the primary, by reading what the
+    // primary appended to its MANIFEST and logs since the last call.
+    // The primary deletes the files that its compactions replace, so
+    // reads through iterators or snapshots that are much older than the
+    // last call may fail.  Returns NotSupported for other databases.
+    virtual Status TryCatchUpWithPrimary();
 };
 
 // Destroy the contents of the specified database.
@@ -155,7 +216,10 @@ MYDB_EXPORT Status DestroyDB(const std::string& name, const Options& options);
 // If a DB cannot be opened, you may attempt to call this method to
 // resurrect as much of the contents of the database as possible.
 // Some data may be lost, so be careful when calling this function
-// on a database that contains important information.
+// on a database that contains important information.  A table added with
+// DB::IngestExternalFile() whose sequence number no surviving MANIFEST
+// records is moved to the "lost" subdirectory instead of being read at
+// the wrong place among the other writes; ingest it again to restore it.
 MYDB_EXPORT Status RepairDB(const std::string& dbname, const Options& options);
 
 } // namespace mydb
@@ -16,6 +16,7 @@
 #include <vector>
 
 #include "mydb/export.h"
+#include "mydb/slice.h"
 #include "mydb/status.h"
 
 // This workaround can be removed when mydb::Env::DeleteFile is removed.
@@ -42,7 +43,6 @@ class FileLock;
 class Logger;
 class RandomAccessFile;
 class SequentialFile;
-class Slice;
 class WritableFile;
 
 class MYDB_EXPORT Env {
@@ -107,6 +107,31 @@ class MYDB_EXPORT Env {
     virtual Status NewAppendableFile(const std::string& fname,
                                      WritableFile** result);
 
+    // Like NewRandomAccessFile(), but the file's reads bypass the operating
+    // system's page cache where the file system allows it.  Prefetch()
+    // then reads ahead into memory held by the file.
+    //
+    // The default implementation calls NewRandomAccessFile().
+    virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                             RandomAccessFile** result);
+
+    // Like NewWritableFile(), but the file's writes bypass the operating
+    // system's page cache where the file system allows it.  Data that
+    // Flush() hands over may stay buffered until Sync() or Close().
+    //
+    // The default implementation calls NewWritableFile().
+    virtual Status NewDirectWritableFile(const std::string& fname,
+                                         WritableFile** result);
+
+    // Like NewRandomAccessFile(), but the file is memory-mapped where
+    // possible, whatever the Env's own limit on mapped files, so that
+    // Read() returns pointers into the mapping instead of copying.  The
+    // caller is responsible for bounding the number of such files.
+    //
+    // The default implementation calls NewRandomAccessFile().
+    virtual Status NewMmapRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
     // Returns true iff the named file exists.
     virtual bool FileExists(const std::string& fname) = 0;
 
@@ -167,6 +192,10 @@ class MYDB_EXPORT Env {
     virtual Status RenameFile(const std::string& src,
                               const std::string& target) = 0;
 
+    // Create "target" as a hard link to the existing file "src".  The
+    // default implementation returns NotSupported.
+    virtual Status LinkFile(const std::string& src, const std::string& target);
+
     // Lock the specified file.  Used to prevent concurrent access to
     // the same db by multiple processes.  On failure, stores nullptr in
     // *lock and returns non-OK.
@@ -247,6 +276,17 @@ class MYDB_EXPORT SequentialFile {
     virtual Status Skip(uint64_t n) = 0;
 };
 
+// One read of a batch passed to RandomAccessFile::MultiRead().
+struct MYDB_EXPORT ReadRequest {
+    uint64_t offset;
+    size_t n;
+    char* scratch; // Room for "n" bytes
+
+    // Set by MultiRead() as Read() would set them.
+    Slice result;
+    Status status;
+};
+
 // A file abstraction for randomly reading the contents of a file.
 class MYDB_EXPORT RandomAccessFile {
   public:
@@ -268,6 +308,33 @@ class MYDB_EXPORT RandomAccessFile {
     // Safe for concurrent use by multiple threads.
     virtual Status Read(uint64_t offset, size_t n, Slice* result,
                         char* scratch) const = 0;
+
+    // Hint that "n" bytes starting at "offset" will be read soon, so the
+    // implementation may start fetching them in the background.  Reads do
+    // not depend on it; the default implementation returns NotSupported.
+    //
+    // Safe for concurrent use by multiple threads.
+    virtual Status Prefetch(uint64_t offset, size_t n) const;
+
+    // Perform the "n" reads in "reqs[0..n-1]" and wait for all of them to
+    // finish.  Each request gets the result and status that Read() would
+    // have given it; returns the first non-OK status among them.  The
+    // implementation may hand the reads to the operating system together
+    // so that the device serves them in parallel.  The default
+    // implementation calls Read() for each request in turn.
+    //
+    // Safe for concurrent use by multiple threads.
+    virtual Status MultiRead(ReadRequest* reqs, size_t n) const;
+
+    // How the file is going to be read.
+    enum AccessPattern { kNormal, kRandom, kSequential };
+
+    // Hint how the file is going to be read from now on, so that the
+    // implementation can read more or less ahead of each access.  Reads
+    // do not depend on it; the default implementation does nothing.
+    //
+    // Safe for concurrent use by multiple threads.
+    virtual void Hint(AccessPattern pattern) const;
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -286,6 +353,18 @@ class MYDB_EXPORT WritableFile {
     virtual Status Close() = 0;
     virtual Status Flush() = 0;
     virtual Status Sync() = 0;
+
+    // Hint that the file will hold the bytes in [offset, offset + len), so
+    // the implementation may reserve space for them up front.  Does not
+    // change the size of the file.  The default implementation returns
+    // NotSupported.
+    virtual Status Allocate(uint64_t offset, uint64_t len);
+
+    // Start writing the bytes in [offset, offset + len), which Flush() has
+    // handed over, to stable storage without waiting for them, so that a
+    // later Sync() has less left to do.  The default implementation
+    // returns NotSupported.
+    virtual Status RangeSync(uint64_t offset, uint64_t len);
 };
 
 // An interface for writing log messages.
@@ -324,6 +403,10 @@ void Log(Logger* info_log, const char* format, ...)
 MYDB_EXPORT Status WriteStringToFile(Env* env, const Slice& data,
                                      const std::string& fname);
 
+// A utility routine: copy the named file to "dst" and sync the copy.
+MYDB_EXPORT Status CopyFile(Env* env, const std::string& src,
+                            const std::string& dst);
+
 // A utility routine: read contents of named file into *data
 MYDB_EXPORT Status ReadFileToString(Env* env, const std::string& fname,
                                     std::string* data);
@@ -355,6 +438,18 @@ class MYDB_EXPORT EnvWrapper : public Env {
     Status NewAppendableFile(const std::string& f, WritableFile** r) override {
         return target_->NewAppendableFile(f, r);
     }
+    Status NewDirectRandomAccessFile(const std::string& f,
+                                     RandomAccessFile** r) override {
+        return target_->NewDirectRandomAccessFile(f, r);
+    }
+    Status NewDirectWritableFile(const std::string& f,
+                                 WritableFile** r) override {
+        return target_->NewDirectWritableFile(f, r);
+    }
+    Status NewMmapRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+        return target_->NewMmapRandomAccessFile(f, r);
+    }
     bool FileExists(const std::string& f) override {
         return target_->FileExists(f);
     }
@@ -377,6 +472,9 @@ class MYDB_EXPORT EnvWrapper : public Env {
     Status RenameFile(const std::string& s, const std::string& t) override {
         return target_->RenameFile(s, t);
     }
+    Status LinkFile(const std::string& s, const std::string& t) override {
+        return target_->LinkFile(s, t);
+    }
     Status LockFile(const std::string& f, FileLock** l) override {
         return target_->LockFile(f, l);
     }
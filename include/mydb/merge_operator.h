@@ -0,0 +1,60 @@
+
+
+//
+// A MergeOperator lets a database apply read-modify-write updates
+// without reading the old value first.  DB::Merge() records an operand
+// for a key, and the operands are combined with the value they apply
+// to lazily: when the key is read, and during compactions.
+//
+// A counter, for example, can store increments as operands and sum
+// them up in FullMerge(), so that an increment is a single blind write
+// instead of a Get() followed by a Put().
+
+#ifndef STORAGE_MYDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_MYDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "mydb/export.h"
+#include "mydb/slice.h"
+
+namespace mydb {
+
+class MYDB_EXPORT MergeOperator {
+  public:
+    virtual ~MergeOperator();
+
+    // The name of the merge operator.  It is not persisted, but a database
+    // must always be opened with an operator that understands the operands
+    // stored in it.
+    virtual const char* Name() const = 0;
+
+    // Apply "operands" to the value of "key" and store the result in
+    // *new_value.  "existing_value" is nullptr if the key had no value
+    // (it was never written, or was deleted) before the first operand.
+    // "operands" are ordered from oldest to newest and hold at least one
+    // operand.
+    //
+    // Return false if the operands cannot be applied; the read or the
+    // compaction that needed the result then fails with a corruption
+    // error.
+    virtual bool FullMerge(const Slice& key, const Slice* existing_value,
+                           const std::vector<Slice>& operands,
+                           std::string* new_value) const = 0;
+
+    // Combine two operands for "key" into one operand with the same effect
+    // and store it in *new_value.  "left_operand" is older than
+    // "right_operand".  Compactions use this to shorten operand chains
+    // whose base value lives in an older file.
+    //
+    // Return false if the operands cannot be combined; both are then kept.
+    // The default implementation never combines operands.
+    virtual bool PartialMerge(const Slice& key, const Slice& left_operand,
+                              const Slice& right_operand,
+                              std::string* new_value) const;
+};
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_INCLUDE_MERGE_OPERATOR_H_
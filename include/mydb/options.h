@@ -4,16 +4,21 @@
 #define STORAGE_MYDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "mydb/export.h"
 
 namespace mydb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MergeOperator;
+class RateLimiter;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -28,6 +33,20 @@ enum CompressionType {
     kZstdCompression = 0x2,
 };
 
+// How the database organizes its tables and picks compactions.
+enum CompactionStyle {
+    // Each level above level-0 holds one sorted run that is ten times
+    // bigger than the previous one, and compactions merge a few files of
+    // one level into the next.  Reads touch few tables, but every byte is
+    // rewritten about ten times per level.
+    kLeveled = 0,
+    // Memtables are always flushed to level-0, and compactions merge whole
+    // sorted runs (a level-0 file or a level) of similar size into one run.
+    // Data is rewritten far less often, at the cost of more runs for reads
+    // to check and more space held by overwritten data.
+    kTiered = 1,
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct MYDB_EXPORT Options {
     // Create an Options object with default values for all fields.
@@ -85,6 +104,17 @@ struct MYDB_EXPORT Options {
     // one open file per 2MB of working set).
     int max_open_files = 1000;
 
+    // If positive, DB::Open() opens the tables of the database on this many
+    // threads before it returns, as many of them as the table cache holds,
+    // so that the first reads of each table do not have to read its
+    // footer, index and filter.
+    int table_preload_threads = 0;
+
+    // Once this many bytes of changes have been appended to the MANIFEST,
+    // it is replaced by a new one that starts with a snapshot of the
+    // current state, which keeps the time to replay it on open bounded.
+    size_t max_manifest_file_size = 64 * 1024 * 1024;
+
     // Control over blocks (user data is stored in a set of blocks, and
     // a block is the unit of reading from disk).
 
@@ -92,6 +122,13 @@ struct MYDB_EXPORT Options {
     // If null, mydb will automatically create and use an 8MB internal cache.
     Cache* block_cache = nullptr;
 
+    // If non-null, use the specified cache for blocks in the compressed
+    // form in which they are stored in the file.  Blocks missing from
+    // block_cache are looked up here before being read from the file, so
+    // a miss costs a decompression instead of a read.  Blocks stored
+    // uncompressed are never added to this cache.
+    Cache* block_cache_compressed = nullptr;
+
     // Approximate size of user data packed per block.  Note that the
     // block size specified here corresponds to uncompressed data.  The
     // actual size of the unit read from disk may be smaller if
@@ -103,6 +140,41 @@ struct MYDB_EXPORT Options {
     // leave this parameter alone.
     int block_restart_interval = 16;
 
+    // If true, the index and filter of each table are split by key range
+    // into partitions of roughly "metadata_block_size" bytes that are
+    // addressed through a small top-level index.  Only the top-level index
+    // stays resident while a table is open; partitions are read on demand
+    // through the block cache, so metadata memory follows the working set
+    // rather than the total data size.
+    //
+    // Tables written with this option cannot be read by releases that do
+    // not understand partitioned indexes.
+    bool partition_index_and_filters = false;
+
+    // Approximate size of an index partition when
+    // partition_index_and_filters is true.
+    size_t metadata_block_size = 4 * 1024;
+
+    // If true, the index and filter blocks of each table are kept in
+    // block_cache and charged against its capacity instead of being held
+    // for as long as the table is open.  They are inserted with
+    // Cache::Priority::kHigh, as are index and filter partitions, so a
+    // cache with a high-priority pool (see NewLRUCache) evicts them only
+    // after ordinary data blocks.  When block_cache is nullptr the internal
+    // cache is created with half of its capacity reserved for them.
+    bool cache_index_and_filter_blocks = false;
+
+    // If true, each data block carries a small hash index from user keys
+    // to restart points, so point lookups (Get) usually avoid the binary
+    // search over the restart array and can rule out absent keys without
+    // decoding any entry.  It costs about one byte per key; range scans do
+    // not use it.  Blocks with more than 253 restart points are written
+    // without an index.
+    //
+    // The index lives ahead of the block's first restart point, so the
+    // tables stay readable by releases that do not know about it.
+    bool data_block_hash_index = false;
+
     // Leveldb will write up to this amount of bytes to a file before
     // switching to a new one.
     // Most clients should leave this parameter alone.  However if your
@@ -113,6 +185,81 @@ struct MYDB_EXPORT Options {
     // initially populating a large database.
     size_t max_file_size = 2 * 1024 * 1024;
 
+    // Compactions read their input tables sequentially and prefetch this
+    // many bytes ahead of the block being read (see
+    // ReadOptions::readahead_size).
+    size_t compaction_readahead_size = 2 * 1024 * 1024;
+
+    // If true, tables and blob files are read with direct I/O (see
+    // Env::NewDirectRandomAccessFile()), so the block cache is the only
+    // cache of their contents and scans do not evict other data from the
+    // operating system's page cache.  Consider a larger block cache.
+    bool use_direct_reads = false;
+
+    // If true, tables and blob files are read through memory maps (see
+    // Env::NewMmapRandomAccessFile()), and uncompressed blocks are read
+    // in place instead of being copied into the block cache, so that the
+    // page cache is the only cache of their data.  Every table in the
+    // table cache stays mapped until the cache evicts it, so
+    // max_open_files bounds the number of mappings.  Best used with
+    // compression = kNoCompression and a 64-bit address space.  Ignored
+    // if use_direct_reads is set.
+    bool use_mmap_reads = false;
+
+    // If true, flushes and compactions write their tables and blob files
+    // with direct I/O (see Env::NewDirectWritableFile()), so that the
+    // data they write does not push other data out of the page cache.
+    bool use_direct_io_for_flush_and_compaction = false;
+
+    // If non-zero, tables and blob files are handed to the operating
+    // system for writing out (see WritableFile::RangeSync()) every
+    // bytes_per_sync bytes while they are being written, instead of all
+    // at once by the Sync() that finishes them.  This smooths out the
+    // I/O of flushes and compactions.  1MB is a reasonable value.
+    uint64_t bytes_per_sync = 0;
+
+    // Like bytes_per_sync, for log files.  Has no effect on writes with
+    // WriteOptions::sync set, which sync the log anyway.
+    uint64_t wal_bytes_per_sync = 0;
+
+    // If non-null, flushes and compactions are throttled to the rate of
+    // this limiter: the table and blob files they write, and the tables
+    // compactions read, are charged to it, with flushes at high
+    // priority.  Log writes and foreground reads are not limited.
+    RateLimiter* rate_limiter = nullptr;
+
+    // Compress log records of at least wal_compression_min_size bytes,
+    // that is, large write batches, with this algorithm before writing
+    // them (see "compression" for the choices).  This trades CPU time for
+    // less log I/O, and pays off for compressible values.  A database
+    // whose logs hold compressed records cannot be opened by versions
+    // that do not support them until the logs have been replayed.
+    CompressionType wal_compression = kNoCompression;
+    size_t wal_compression_min_size = 4096;
+
+    // If true, the size limits of the levels are derived from the size of
+    // the last level instead of being fixed at 10MB for level-1, 100MB for
+    // level-2 and so on.  Each level may hold a tenth of the next one, and
+    // level-0 compacts straight into the first level, counting up from the
+    // last one, whose limit is at most 10MB; the levels above it stay
+    // empty.  About 90% of the data then lives in the last level whatever
+    // the size of the database, which bounds the space used by overwritten
+    // and deleted data to about 10%.  kLeveled only.
+    bool dynamic_level_bytes = false;
+
+    // The compaction style.  A database may be reopened with a different
+    // style; existing tables are then gradually reorganized.
+    CompactionStyle compaction_style = kLeveled;
+
+    // kTiered only: a compaction that starts with the newest sorted runs
+    // picks up the next older run as long as that run is at most this many
+    // percent bigger than the runs picked so far.
+    int tiered_size_ratio = 1;
+
+    // kTiered only: once the database holds this many sorted runs, a
+    // compaction merges enough of them to get below this number again.
+    int tiered_max_sorted_runs = 8;
+
     // Compress blocks using the specified compression algorithm.  This
     // parameter can be changed dynamically.
     //
@@ -133,6 +280,49 @@ struct MYDB_EXPORT Options {
     // Currently only the range [-5,22] is supported. Default is 1.
     int zstd_compression_level = 1;
 
+    // If non-empty, tables written to level L are compressed with
+    // compression_per_level[L], or with the last entry for levels past the
+    // end, instead of "compression".  This allows, for example, skipping
+    // compression for the small, frequently rewritten upper levels.
+    // Memtable flushes always use the entry for level-0.
+    std::vector<CompressionType> compression_per_level;
+
+    // If true, tables that compactions write to the bottommost level, i.e.
+    // when no deeper level holds any data, are compressed with zstd at
+    // bottommost_zstd_compression_level, overriding the settings above.
+    // That level holds most of the data and is rarely rewritten, so a
+    // slower, stronger compression pays off there.
+    bool bottommost_zstd = false;
+    int bottommost_zstd_compression_level = 9;
+
+    // If greater than 1, the tables that flushes and compactions write hand
+    // their data blocks to a pool of this many background threads for
+    // compression while they keep adding keys, so expensive settings such
+    // as high zstd levels do not limit a compaction to one core.  The pool
+    // is owned by the DB and shared by all the tables it writes.  Blocks
+    // are still written in order and the resulting file is the same.
+    // Ignored with kNoCompression.
+    int compression_threads = 1;
+
+    // If non-zero, values of at least this many bytes are moved out of the
+    // tables into separate blob files when memtables are flushed and when
+    // compactions write them, and the tables only hold a small reference
+    // to each of them.  Compactions then rewrite the references instead of
+    // the values, which cuts their I/O for large values, at the cost of one
+    // extra read per value looked up.  Values in the log are not affected.
+    size_t min_blob_size = 0;
+
+    // Compactions start a new blob file once the current one reaches this
+    // size.
+    size_t blob_file_size = 256 * 1024 * 1024;
+
+    // A blob file whose live values make up less than this fraction of it
+    // is garbage collected: compactions move its live values to a new blob
+    // file, and the tables that refer to it are compacted for that reason
+    // alone (kLeveled only).  A blob file is deleted once none of its
+    // values are live.  Zero disables garbage collection.
+    double blob_gc_live_ratio = 0.5;
+
     // EXPERIMENTAL: If true, append to existing MANIFEST and log files
     // when a database is opened.  This can significantly speed up open.
     //
@@ -143,6 +333,19 @@ struct MYDB_EXPORT Options {
     // Many applications will benefit from passing the result of
     // NewBloomFilterPolicy() here.
     const FilterPolicy* filter_policy = nullptr;
+
+    // If non-null, DB::Merge() and WriteBatch::Merge() may be used, and
+    // this operator combines the merge operands written for a key.
+    //
+    // REQUIRES: A database holding merge operands must always be opened
+    // with an operator that understands them.
+    const MergeOperator* merge_operator = nullptr;
+
+    // If non-null, compactions pass the values they keep through this
+    // filter, which may remove them or change them.  See
+    // mydb/compaction_filter.h, and NewTTLCompactionFilter() there for a
+    // filter that expires values.
+    const CompactionFilter* compaction_filter = nullptr;
 };
 
 // Options that control read operations
@@ -160,6 +363,17 @@ struct MYDB_EXPORT ReadOptions {
     // not have been released).  If "snapshot" is null, use an implicit
     // snapshot of the state at the beginning of this read operation.
     const Snapshot* snapshot = nullptr;
+
+    // If non-zero, iterators ask the file system to prefetch this many
+    // bytes of a table ahead of the data block being read.  If zero, an
+    // iterator starts prefetching on its own once it has read a few blocks
+    // of a table in sequence, beginning with 8KB and doubling up to 256KB
+    // while the reads stay sequential.  Point lookups never prefetch.
+    size_t readahead_size = 0;
+
+    // If non-null, blocks read from tables are charged to this limiter at
+    // low priority.  Blocks found in the block cache are not charged.
+    RateLimiter* rate_limiter = nullptr;
 };
 
 // Options that control write operations
@@ -183,6 +397,14 @@ struct MYDB_EXPORT WriteOptions {
     bool sync = false;
 };
 
+// Options that control DB::IngestExternalFile
+struct MYDB_EXPORT IngestExternalFileOptions {
+    // If true, the files are renamed into the database directory instead
+    // of being copied, which is only possible on the same file system.  If
+    // a rename fails the file is copied.
+    bool move_files = false;
+};
+
 } // namespace mydb
 
 #endif // STORAGE_MYDB_INCLUDE_OPTIONS_H_
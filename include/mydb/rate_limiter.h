@@ -0,0 +1,62 @@
+
+
+//
+// A RateLimiter caps the rate at which a database reads and writes its
+// files in the background, so that flushes and compactions do not
+// saturate the disk and delay foreground reads.  It is a token bucket:
+// a budget of bytes is handed out in every refill period, and a
+// request for more bytes than are left waits for the next one.
+//
+// A limiter may be shared by several databases, and its rate may be
+// changed at any time.
+
+#ifndef STORAGE_MYDB_INCLUDE_RATE_LIMITER_H_
+#define STORAGE_MYDB_INCLUDE_RATE_LIMITER_H_
+
+#include <cstdint>
+
+#include "mydb/export.h"
+
+namespace mydb {
+
+class MYDB_EXPORT RateLimiter {
+  public:
+    // Flushes are charged with kHigh and compactions with kLow.  Bytes
+    // go to kHigh requests first while any are waiting.
+    enum class Priority { kHigh, kLow };
+
+    virtual ~RateLimiter();
+
+    // Change the rate limit.  With auto-tuning, this is the upper bound
+    // of the rate.  REQUIRES: bytes_per_second > 0.
+    virtual void SetBytesPerSecond(int64_t bytes_per_second) = 0;
+
+    // The current rate limit.
+    virtual int64_t GetBytesPerSecond() const = 0;
+
+    // Block until "bytes" bytes may be read or written with "priority".
+    virtual void Request(int64_t bytes, Priority priority) = 0;
+
+    // Total number of bytes granted to requests with "priority".
+    virtual int64_t GetTotalBytesThrough(Priority priority) const = 0;
+};
+
+// Create a rate limiter that grants "bytes_per_second" bytes per second,
+// refilled every "refill_period_us" microseconds.  Shorter periods make
+// for smoother I/O at the cost of more wakeups.
+//
+// If "auto_tuned" is true, the rate moves between bytes_per_second / 20
+// and bytes_per_second depending on how often requests have to wait: it
+// goes up while the limit is what holds back flushes and compactions,
+// and down while it is not, so that the limit only bites when the
+// background work would otherwise burst.
+//
+// Callers must delete the result after any database that is using it
+// has been closed.
+MYDB_EXPORT RateLimiter* NewGenericRateLimiter(
+    int64_t bytes_per_second, int64_t refill_period_us = 100 * 1000,
+    bool auto_tuned = false);
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_INCLUDE_RATE_LIMITER_H_
@@ -0,0 +1,62 @@
+
+
+// SstFileWriter builds a table file outside of any database that can later
+// be added to one with DB::IngestExternalFile().
+//
+// Keys must be added in strictly increasing order according to the
+// comparator in the options, which must match the comparator of the
+// database the file is ingested into.
+
+#ifndef STORAGE_MYDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_MYDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "mydb/export.h"
+#include "mydb/options.h"
+#include "mydb/slice.h"
+#include "mydb/status.h"
+
+namespace mydb {
+
+class MYDB_EXPORT SstFileWriter {
+  public:
+    explicit SstFileWriter(const Options& options);
+
+    SstFileWriter(const SstFileWriter&) = delete;
+    SstFileWriter& operator=(const SstFileWriter&) = delete;
+
+    // Abandons the file if Finish() has not been called.
+    ~SstFileWriter();
+
+    // Create the file named fname and start writing to it.
+    Status Open(const std::string& fname);
+
+    // Add a mapping for key.
+    // REQUIRES: key is after any previously added key.
+    Status Put(const Slice& key, const Slice& value);
+
+    // Add a deletion of key, hiding any older value in the database.
+    // REQUIRES: key is after any previously added key.
+    Status Delete(const Slice& key);
+
+    // Write out the rest of the table and close the file.  Fails if no
+    // keys were added.
+    Status Finish();
+
+    // Size of the file generated so far, or of the finished file after a
+    // successful Finish().
+    uint64_t FileSize() const;
+
+  private:
+    struct Rep;
+
+    Status Add(const Slice& key, const Slice& value, bool deletion);
+
+    Rep* rep_;
+};
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_INCLUDE_SST_FILE_WRITER_H_
@@ -10,8 +10,8 @@
 namespace mydb {
 
 class Block;
+struct BlockContents;
 class BlockHandle;
-class Footer;
 struct Options;
 class RandomAccessFile;
 struct ReadOptions;
@@ -57,9 +57,15 @@ class MYDB_EXPORT Table {
 
   private:
     friend class TableCache;
+    struct Readahead;
     struct Rep;
 
     static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+    static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                          const Slice&);
+    static Iterator* CachedBlockReader(void*, const ReadOptions&,
+                                       const Slice&, bool metadata,
+                                       bool point_lookup);
 
     explicit Table(Rep* rep) : rep_(rep) {}
 
@@ -70,9 +76,27 @@ class MYDB_EXPORT Table {
                        void (*handle_result)(void* arg, const Slice& k,
                                              const Slice& v));
 
-    void ReadMeta(const Footer& footer);
+    // Returns an iterator over the index block named by the footer.
+    Iterator* NewIndexBlockIterator(const ReadOptions&) const;
+    // Returns an iterator over the data block handles of the table.
+    Iterator* NewIndexIterator(const ReadOptions&) const;
+    bool PartitionMayMatch(const ReadOptions&, const Slice& partition_value,
+                           const Slice& key);
+    bool KeyMayMatch(const ReadOptions&, uint64_t block_offset,
+                     const Slice& key);
+    bool CachedFilterMayMatch(const ReadOptions&,
+                              const BlockHandle& filter_handle,
+                              uint64_t block_offset, const Slice& key);
+
+    Status LoadBlock(const ReadOptions&, const BlockHandle& handle,
+                     BlockContents* contents) const;
+    Status ReadMeta(const BlockContents& metaindex_contents);
     void ReadFilter(const Slice& filter_handle_value);
 
+    // Returns an iterator over the table's range tombstone block, or
+    // nullptr if it has none.
+    Iterator* NewRangeTombstoneIterator() const;
+
     Rep* const rep_;
 };
 
@@ -20,6 +20,7 @@ namespace mydb {
 
 class BlockBuilder;
 class BlockHandle;
+class CompressionPool;
 class WritableFile;
 
 class MYDB_EXPORT TableBuilder {
@@ -29,6 +30,13 @@ class MYDB_EXPORT TableBuilder {
     // caller to close the file after calling Finish().
     TableBuilder(const Options& options, WritableFile* file);
 
+    // Like the above, but if "pool" is non-null and options.compression is
+    // not kNoCompression, data blocks are compressed on the threads of
+    // "pool" while the caller keeps adding keys.  The file is the same
+    // either way.  REQUIRES: "pool" outlives the builder.
+    TableBuilder(const Options& options, WritableFile* file,
+                 CompressionPool* pool);
+
     TableBuilder(const TableBuilder&) = delete;
     TableBuilder& operator=(const TableBuilder&) = delete;
 
@@ -48,6 +56,12 @@ class MYDB_EXPORT TableBuilder {
     // REQUIRES: Finish(), Abandon() have not been called
     void Add(const Slice& key, const Slice& value);
 
+    // Add an entry to the table's range tombstone block, which is kept
+    // apart from the entries added by Add().  Entries may be added in any
+    // order but must have distinct keys.
+    // REQUIRES: Finish(), Abandon() have not been called
+    void AddRangeTombstone(const Slice& key, const Slice& value);
+
     // Advanced operation: flush any buffered key/value pairs to file.
     // Can be used to ensure that two adjacent entries never live in
     // the same data block.  Most clients should not need to use this method.
@@ -72,14 +86,22 @@ class MYDB_EXPORT TableBuilder {
     // Number of calls to Add() so far.
     uint64_t NumEntries() const;
 
-    // Size of the file generated so far.  If invoked after a successful
-    // Finish() call, returns the size of the final generated file.
+    // Size of the file generated so far, counting data blocks that are
+    // still being compressed at their uncompressed size.  If invoked after
+    // a successful Finish() call, returns the size of the final generated
+    // file.
     uint64_t FileSize() const;
 
   private:
     bool ok() const { return status().ok(); }
     void WriteBlock(BlockBuilder* block, BlockHandle* handle);
     void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+    void AddIndexEntry(const Slice& key, const BlockHandle& handle);
+    void FlushIndexPartition(const Slice& last_index_key);
+    void AddPendingIndexEntry(const Slice& key);
+    void QueueBlock();
+    void WriteQueuedBlocks(bool wait);
+    static void CompressQueuedBlock(void* arg);
 
     struct Rep;
     Rep* rep_;
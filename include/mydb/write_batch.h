@@ -34,6 +34,17 @@ class MYDB_EXPORT WriteBatch {
         virtual ~Handler();
         virtual void Put(const Slice& key, const Slice& value) = 0;
         virtual void Delete(const Slice& key) = 0;
+        // The defaults make Iterate() fail with NotSupported, so a handler
+        // written before range deletions and merge operands existed cannot
+        // skip them silently.
+        virtual void DeleteRange(const Slice& begin, const Slice& end);
+        virtual void Merge(const Slice& key, const Slice& value);
+
+      private:
+        friend class WriteBatch;
+
+        // Set by the default implementations above.
+        Status unsupported_;
     };
 
     WriteBatch();
@@ -50,6 +61,14 @@ class MYDB_EXPORT WriteBatch {
     // If the database contains a mapping for "key", erase it.  Else do nothing.
     void Delete(const Slice& key);
 
+    // Erase every mapping with a key in ["begin", "end").  Does nothing if
+    // "end" is not after "begin".
+    void DeleteRange(const Slice& begin, const Slice& end);
+
+    // Merge "value" into the mapping for "key" with the database's
+    // Options::merge_operator.
+    void Merge(const Slice& key, const Slice& value);
+
     // Clear all updates buffered in this batch.
     void Clear();
 
@@ -12,6 +12,7 @@
 
 #include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 #include "util/logging.h"
 
 namespace mydb {
@@ -91,6 +92,11 @@ class Block::Iter : public Iterator {
     Slice value_;
     Status status_;
 
+    // Hash index used by Seek(), if any.
+    const uint8_t* hash_buckets_;
+    uint32_t num_buckets_;
+    bool internal_keys_;
+
     inline int Compare(const Slice& a, const Slice& b) const {
         return comparator_->Compare(a, b);
     }
@@ -120,10 +126,21 @@ class Block::Iter : public Iterator {
          uint32_t num_restarts)
         : comparator_(comparator), data_(data), restarts_(restarts),
           num_restarts_(num_restarts), current_(restarts_),
-          restart_index_(num_restarts_) {
+          restart_index_(num_restarts_), hash_buckets_(nullptr),
+          num_buckets_(0), internal_keys_(false) {
         assert(num_restarts_ > 0);
     }
 
+    // Make Seek() a point lookup that consults the hash index in
+    // buckets[0..num_buckets-1].  Seek() then leaves the iterator invalid
+    // when the index shows that no entry has the target's key.
+    void UseHashIndex(const uint8_t* buckets, uint32_t num_buckets,
+                      bool internal_keys) {
+        hash_buckets_ = buckets;
+        num_buckets_ = num_buckets;
+        internal_keys_ = internal_keys;
+    }
+
     bool Valid() const override { return current_ < restarts_; }
     Status status() const override { return status_; }
     Slice key() const override {
@@ -162,6 +179,10 @@ class Block::Iter : public Iterator {
     }
 
     void Seek(const Slice& target) override {
+        if (hash_buckets_ != nullptr && SeekWithHashIndex(target)) {
+            return;
+        }
+
         // Binary search in restart array to find the last restart point
         // with a key < target
         uint32_t left = 0;
@@ -239,6 +260,34 @@ class Block::Iter : public Iterator {
     }
 
   private:
+    // Returns false if the hash index cannot tell where target's key is.
+    bool SeekWithHashIndex(const Slice& target) {
+        Slice hash_key = target;
+        if (internal_keys_) {
+            if (hash_key.size() < 8) {
+                return false;
+            }
+            hash_key = Slice(hash_key.data(), hash_key.size() - 8);
+        }
+        const uint8_t restart =
+            hash_buckets_[Hash(hash_key.data(), hash_key.size(),
+                               kHashIndexSeed) %
+                          num_buckets_];
+        if (restart == kHashIndexNoEntry) {
+            current_ = restarts_;
+            restart_index_ = num_restarts_;
+            return true;
+        }
+        if (restart >= num_restarts_) {
+            return false; // Includes kHashIndexCollision
+        }
+        SeekToRestartPoint(restart);
+        while (ParseNextKey() && Compare(key_, target) < 0) {
+            // Linear search for first key >= target
+        }
+        return true;
+    }
+
     void CorruptionError() {
         current_ = restarts_;
         restart_index_ = num_restarts_;
@@ -277,16 +326,28 @@ class Block::Iter : public Iterator {
     }
 };
 
-Iterator* Block::NewIterator(const Comparator* comparator) {
+Iterator* Block::NewIterator(const Comparator* comparator,
+                             bool point_lookup) {
     if (size_ < sizeof(uint32_t)) {
         return NewErrorIterator(Status::Corruption("bad block contents"));
     }
     const uint32_t num_restarts = NumRestarts();
     if (num_restarts == 0) {
         return NewEmptyIterator();
-    } else {
-        return new Iter(comparator, data_, restart_offset_, num_restarts);
     }
+    Iter* iter = new Iter(comparator, data_, restart_offset_, num_restarts);
+    if (point_lookup) {
+        // A hash index, if present, fills the space before the first
+        // restart point and ends with its tag.
+        const uint32_t index_size = DecodeFixed32(data_ + restart_offset_);
+        if (index_size > 1 && index_size <= restart_offset_ &&
+            data_[index_size - 1] == kDataBlockHashIndexTag) {
+            iter->UseHashIndex(reinterpret_cast<const uint8_t*>(data_),
+                               index_size - 1,
+                               IsInternalKeyComparator(comparator));
+        }
+    }
+    return iter;
 }
 
 } // namespace mydb
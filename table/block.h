@@ -24,7 +24,12 @@ class Block {
     ~Block();
 
     size_t size() const { return size_; }
-    Iterator* NewIterator(const Comparator* comparator);
+
+    // If "point_lookup" is set, the iterator is only used to Seek() to a
+    // key that it reports as absent, by becoming invalid, when the block's
+    // hash index shows that no entry has the same user key.
+    Iterator* NewIterator(const Comparator* comparator,
+                          bool point_lookup = false);
 
   private:
     class Iter;
@@ -23,6 +23,17 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// A block built with a hash index starts with the index, followed by the
+// entries as usual:
+//     buckets: uint8[num_buckets]
+//     tag: uint8 (kDataBlockHashIndexTag)
+// Each key hashes to a bucket that holds the index of the restart point
+// of the first entry for the key, kHashIndexNoEntry if no key hashes
+// there, or kHashIndexCollision if keys in different restart intervals
+// do.  Internal keys are hashed without their sequence number and type.
+// Since every read starts at a restart point and restarts[0] is the size
+// of the index, readers that do not know about the index skip it.
 
 #include "table/block_builder.h"
 
@@ -32,12 +43,16 @@
 #include "mydb/comparator.h"
 #include "mydb/options.h"
 
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 
 namespace mydb {
 
-BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+BlockBuilder::BlockBuilder(const Options* options, bool hash_index)
+    : options_(options), restarts_(), counter_(0), finished_(false),
+      hash_index_(hash_index),
+      internal_keys_(IsInternalKeyComparator(options->comparator)) {
     assert(options->block_restart_interval >= 1);
     restarts_.push_back(0); // First restart point is at offset 0
 }
@@ -49,15 +64,37 @@ void BlockBuilder::Reset() {
     counter_ = 0;
     finished_ = false;
     last_key_.clear();
+    hash_entries_.clear();
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
     return (buffer_.size() +                      // Raw data buffer
             restarts_.size() * sizeof(uint32_t) + // Restart array
-            sizeof(uint32_t));                    // Restart array length
+            sizeof(uint32_t) +                    // Restart array length
+            hash_entries_.size() * 4 / 3);        // Hash index
 }
 
 Slice BlockBuilder::Finish() {
+    if (!hash_entries_.empty() && restarts_.size() < kHashIndexCollision) {
+        // Aim for buckets to be about 3/4 full.
+        const size_t num_buckets = hash_entries_.size() * 4 / 3 + 1;
+        std::string index(num_buckets, static_cast<char>(kHashIndexNoEntry));
+        for (const auto& entry : hash_entries_) {
+            char* bucket = &index[entry.first % num_buckets];
+            const uint8_t restart = static_cast<uint8_t>(entry.second);
+            if (static_cast<uint8_t>(*bucket) == kHashIndexNoEntry) {
+                *bucket = restart;
+            } else if (static_cast<uint8_t>(*bucket) != restart) {
+                *bucket = static_cast<char>(kHashIndexCollision);
+            }
+        }
+        index.push_back(kDataBlockHashIndexTag);
+        buffer_.insert(0, index);
+        for (size_t i = 0; i < restarts_.size(); i++) {
+            restarts_[i] += index.size();
+        }
+    }
+
     // Append restart array
     for (size_t i = 0; i < restarts_.size(); i++) {
         PutFixed32(&buffer_, restarts_[i]);
@@ -97,6 +134,24 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
     buffer_.append(key.data() + shared, non_shared);
     buffer_.append(value.data(), value.size());
 
+    if (hash_index_) {
+        Slice hash_key = key;
+        Slice last_hash_key = last_key_piece;
+        if (internal_keys_) {
+            assert(key.size() >= 8);
+            hash_key = Slice(hash_key.data(), hash_key.size() - 8);
+            if (last_hash_key.size() >= 8) {
+                last_hash_key =
+                    Slice(last_hash_key.data(), last_hash_key.size() - 8);
+            }
+        }
+        if (hash_entries_.empty() || hash_key != last_hash_key) {
+            hash_entries_.emplace_back(
+                Hash(hash_key.data(), hash_key.size(), kHashIndexSeed),
+                restarts_.size() - 1);
+        }
+    }
+
     // Update state
     last_key_.resize(shared);
     last_key_.append(key.data() + shared, non_shared);
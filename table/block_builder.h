@@ -4,6 +4,8 @@
 #define STORAGE_MYDB_TABLE_BLOCK_BUILDER_H_
 
 #include <cstdint>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "mydb/slice.h"
@@ -14,7 +16,9 @@ struct Options;
 
 class BlockBuilder {
   public:
-    explicit BlockBuilder(const Options* options);
+    // If "hash_index" is set, Finish() prefixes the block with a hash
+    // index for point lookups (see block_builder.cc).
+    explicit BlockBuilder(const Options* options, bool hash_index = false);
 
     BlockBuilder(const BlockBuilder&) = delete;
     BlockBuilder& operator=(const BlockBuilder&) = delete;
@@ -45,6 +49,12 @@ class BlockBuilder {
     int counter_;                    // Number of entries emitted since restart
     bool finished_;                  // Has Finish() been called?
     std::string last_key_;
+
+    // Hash index state; unused unless hash_index_ is set.
+    const bool hash_index_;
+    const bool internal_keys_; // Whether keys end with a sequence number
+    // Hash of each distinct hash key and its first restart point.
+    std::vector<std::pair<uint32_t, uint32_t>> hash_entries_;
 };
 
 } // namespace mydb
@@ -0,0 +1,62 @@
+
+
+#include "table/compression_pool.h"
+
+#include <cassert>
+
+#include "mydb/env.h"
+
+#include "util/mutexlock.h"
+
+namespace mydb {
+
+CompressionPool::CompressionPool(Env* env, int threads)
+    : env_(env), threads_(threads), work_cv_(&mu_), exit_cv_(&mu_),
+      live_threads_(0), started_(false), shutting_down_(false) {
+    assert(threads > 0);
+}
+
+CompressionPool::~CompressionPool() {
+    MutexLock l(&mu_);
+    assert(queue_.empty());
+    shutting_down_ = true;
+    work_cv_.SignalAll();
+    while (live_threads_ > 0) {
+        exit_cv_.Wait();
+    }
+}
+
+void CompressionPool::Schedule(void (*function)(void* arg), void* arg) {
+    MutexLock l(&mu_);
+    if (!started_) {
+        started_ = true;
+        for (int i = 0; i < threads_; i++) {
+            live_threads_++;
+            env_->StartThread(&CompressionPool::ThreadMain, this);
+        }
+    }
+    queue_.emplace_back(function, arg);
+    work_cv_.Signal();
+}
+
+void CompressionPool::ThreadMain(void* arg) {
+    CompressionPool* pool = reinterpret_cast<CompressionPool*>(arg);
+    MutexLock l(&pool->mu_);
+    while (true) {
+        while (pool->queue_.empty() && !pool->shutting_down_) {
+            pool->work_cv_.Wait();
+        }
+        if (pool->queue_.empty()) {
+            break;
+        }
+        std::pair<void (*)(void*), void*> work = pool->queue_.front();
+        pool->queue_.pop_front();
+        pool->mu_.Unlock();
+        (*work.first)(work.second);
+        pool->mu_.Lock();
+    }
+    pool->live_threads_--;
+    pool->exit_cv_.SignalAll();
+}
+
+} // namespace mydb
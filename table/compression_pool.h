@@ -0,0 +1,55 @@
+
+
+// A CompressionPool is a fixed set of threads that compress data blocks
+// for TableBuilders.  A DB owns one and shares it between the tables its
+// flushes and compactions write, so the number of compression threads
+// does not grow with the number of tables being built.
+
+#ifndef STORAGE_MYDB_TABLE_COMPRESSION_POOL_H_
+#define STORAGE_MYDB_TABLE_COMPRESSION_POOL_H_
+
+#include <deque>
+#include <utility>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
+namespace mydb {
+
+class Env;
+
+class CompressionPool {
+  public:
+    // The pool starts "threads" threads through env->StartThread() the
+    // first time work is scheduled.
+    CompressionPool(Env* env, int threads);
+
+    CompressionPool(const CompressionPool&) = delete;
+    CompressionPool& operator=(const CompressionPool&) = delete;
+
+    // Waits for the threads to exit.
+    // REQUIRES: All scheduled work has completed.
+    ~CompressionPool();
+
+    // Arrange to run "function(arg)" once on one of the threads.  Work is
+    // started in the order it was scheduled.
+    void Schedule(void (*function)(void* arg), void* arg);
+
+  private:
+    static void ThreadMain(void* arg);
+
+    Env* const env_;
+    const int threads_;
+
+    port::Mutex mu_;
+    port::CondVar work_cv_; // Signalled when work is added or on shutdown
+    port::CondVar exit_cv_; // Signalled when a thread exits
+    std::deque<std::pair<void (*)(void*), void*>> queue_ GUARDED_BY(mu_);
+    int live_threads_ GUARDED_BY(mu_);
+    bool started_ GUARDED_BY(mu_);
+    bool shutting_down_ GUARDED_BY(mu_);
+};
+
+} // namespace mydb
+
+#endif // STORAGE_MYDB_TABLE_COMPRESSION_POOL_H_
@@ -2,8 +2,13 @@
 
 #include "table/format.h"
 
+#include <cstring>
+#include <vector>
+
+#include "mydb/comparator.h"
 #include "mydb/env.h"
 #include "mydb/options.h"
+#include "mydb/rate_limiter.h"
 
 #include "port/port.h"
 #include "table/block.h"
@@ -65,23 +70,19 @@ Status Footer::DecodeFrom(Slice* input) {
     return result;
 }
 
-Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result) {
+bool IsInternalKeyComparator(const Comparator* comparator) {
+    return std::strcmp(comparator->Name(), "mydb.InternalKeyComparator") == 0;
+}
+
+// Check the block of "n" bytes that a read into "buf" returned as
+// "contents" and fill *result and *type from it.  Takes ownership of "buf".
+static Status FinishRawBlock(const ReadOptions& options, size_t n, char* buf,
+                             const Slice& contents, BlockContents* result,
+                             char* type) {
     result->data = Slice();
     result->cachable = false;
     result->heap_allocated = false;
 
-    // Read the block contents as well as the type/crc footer.
-    // See table_builder.cc for the code that built this structure.
-    size_t n = static_cast<size_t>(handle.size());
-    char* buf = new char[n + kBlockTrailerSize];
-    Slice contents;
-    Status s =
-        file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
-    if (!s.ok()) {
-        delete[] buf;
-        return s;
-    }
     if (contents.size() != n + kBlockTrailerSize) {
         delete[] buf;
         return Status::Corruption("truncated block read");
@@ -94,74 +95,189 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
         const uint32_t actual = crc32c::Value(data, n + 1);
         if (actual != crc) {
             delete[] buf;
-            s = Status::Corruption("block checksum mismatch");
-            return s;
+            return Status::Corruption("block checksum mismatch");
         }
     }
 
-    switch (data[n]) {
+    *type = data[n];
+    if (data != buf) {
+        // File implementation gave us pointer to some other data.
+        // Use it directly under the assumption that it will be live
+        // while the file is open.
+        delete[] buf;
+        result->data = Slice(data, n);
+        result->heap_allocated = false;
+        result->cachable = false; // Do not double-cache
+    } else {
+        result->data = Slice(buf, n);
+        result->heap_allocated = true;
+        result->cachable = true;
+    }
+    return Status::OK();
+}
+
+Status ReadRawBlock(RandomAccessFile* file, const ReadOptions& options,
+                    const BlockHandle& handle, BlockContents* result,
+                    char* type) {
+    // Read the block contents as well as the type/crc footer.
+    // See table_builder.cc for the code that built this structure.
+    size_t n = static_cast<size_t>(handle.size());
+    if (options.rate_limiter != nullptr) {
+        options.rate_limiter->Request(n + kBlockTrailerSize,
+                                      RateLimiter::Priority::kLow);
+    }
+    char* buf = new char[n + kBlockTrailerSize];
+    Slice contents;
+    Status s =
+        file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+    if (!s.ok()) {
+        delete[] buf;
+        result->data = Slice();
+        result->cachable = false;
+        result->heap_allocated = false;
+        return s;
+    }
+    return FinishRawBlock(options, n, buf, contents, result, type);
+}
+
+Slice CompressBlock(const Slice& raw, int zstd_compression_level,
+                    std::string* compressed, CompressionType* type) {
+    bool ok = false;
+    // TODO(postrelease): Support more compression options: zlib?
+    switch (*type) {
     case kNoCompression:
-        if (data != buf) {
-            // File implementation gave us pointer to some other data.
-            // Use it directly under the assumption that it will be live
-            // while the file is open.
-            delete[] buf;
-            result->data = Slice(data, n);
-            result->heap_allocated = false;
-            result->cachable = false; // Do not double-cache
-        } else {
-            result->data = Slice(buf, n);
-            result->heap_allocated = true;
-            result->cachable = true;
-        }
+        break;
 
-        // Ok
+    case kSnappyCompression:
+        ok = port::Snappy_Compress(raw.data(), raw.size(), compressed);
         break;
+
+    case kZstdCompression:
+        ok = port::Zstd_Compress(zstd_compression_level, raw.data(),
+                                 raw.size(), compressed);
+        break;
+    }
+    if (ok && compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return *compressed;
+    }
+    *type = kNoCompression;
+    return raw;
+}
+
+Status UncompressBlock(const Slice& raw, char type, BlockContents* result) {
+    const char* data = raw.data();
+    const size_t n = raw.size();
+    switch (type) {
     case kSnappyCompression: {
         size_t ulength = 0;
         if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-            delete[] buf;
             return Status::Corruption(
                 "corrupted snappy compressed block length");
         }
         char* ubuf = new char[ulength];
         if (!port::Snappy_Uncompress(data, n, ubuf)) {
-            delete[] buf;
             delete[] ubuf;
             return Status::Corruption(
                 "corrupted snappy compressed block contents");
         }
-        delete[] buf;
         result->data = Slice(ubuf, ulength);
-        result->heap_allocated = true;
-        result->cachable = true;
         break;
     }
     case kZstdCompression: {
         size_t ulength = 0;
         if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
-            delete[] buf;
             return Status::Corruption("corrupted zstd compressed block length");
         }
         char* ubuf = new char[ulength];
         if (!port::Zstd_Uncompress(data, n, ubuf)) {
-            delete[] buf;
             delete[] ubuf;
             return Status::Corruption(
                 "corrupted zstd compressed block contents");
         }
-        delete[] buf;
         result->data = Slice(ubuf, ulength);
-        result->heap_allocated = true;
-        result->cachable = true;
         break;
     }
     default:
-        delete[] buf;
         return Status::Corruption("bad block type");
     }
-
+    result->heap_allocated = true;
+    result->cachable = true;
     return Status::OK();
 }
 
+// Replace the raw block in *result, stored with compression "type", with
+// its uncompressed contents.
+static Status Uncompress(char type, BlockContents* result) {
+    if (type == kNoCompression) {
+        return Status::OK();
+    }
+    BlockContents raw = *result;
+    Status s = UncompressBlock(raw.data, type, result);
+    if (raw.heap_allocated) {
+        delete[] raw.data.data();
+    }
+    return s;
+}
+
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 const BlockHandle& handle, BlockContents* result) {
+    char type;
+    Status s = ReadRawBlock(file, options, handle, result, &type);
+    if (s.ok()) {
+        s = Uncompress(type, result);
+    }
+    return s;
+}
+
+Status ReadBlocks(RandomAccessFile* file, const ReadOptions& options,
+                  const BlockHandle* handles, size_t n,
+                  BlockContents* results) {
+    std::vector<ReadRequest> reqs(n);
+    int64_t total_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        reqs[i].offset = handles[i].offset();
+        reqs[i].n = static_cast<size_t>(handles[i].size()) + kBlockTrailerSize;
+        reqs[i].scratch = new char[reqs[i].n];
+        total_bytes += reqs[i].n;
+    }
+    if (options.rate_limiter != nullptr) {
+        options.rate_limiter->Request(total_bytes,
+                                      RateLimiter::Priority::kLow);
+    }
+    file->MultiRead(reqs.data(), n);
+
+    Status s;
+    size_t done = 0;
+    for (; done < n; done++) {
+        ReadRequest* req = &reqs[done];
+        char type;
+        if (req->status.ok()) {
+            s = FinishRawBlock(options, req->n - kBlockTrailerSize,
+                               req->scratch, req->result, &results[done],
+                               &type);
+        } else {
+            s = req->status;
+            delete[] req->scratch;
+        }
+        if (s.ok()) {
+            s = Uncompress(type, &results[done]);
+        }
+        if (!s.ok()) {
+            break;
+        }
+    }
+    if (!s.ok()) {
+        // Release the blocks read so far and the buffers not handed over.
+        for (size_t i = 0; i < done; i++) {
+            if (results[i].heap_allocated) {
+                delete[] results[i].data.data();
+            }
+        }
+        for (size_t i = done + 1; i < n; i++) {
+            delete[] reqs[i].scratch;
+        }
+    }
+    return s;
+}
+
 } // namespace mydb
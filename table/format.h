@@ -13,6 +13,7 @@
 namespace mydb {
 
 class Block;
+class Comparator;
 class RandomAccessFile;
 struct ReadOptions;
 
@@ -76,6 +77,26 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Metaindex keys written for tables with a partitioned index.  The
+// partitioned filter key is followed by the filter policy name.
+static const char kPartitionedIndexMetaKey[] = "index.partitioned";
+static const char kPartitionedFilterMetaPrefix[] = "partitionedfilter.";
+
+// Metaindex key of the block holding range tombstones, which sorts after
+// every other metaindex key.
+static const char kRangeDelMetaKey[] = "rangedel.tombstones";
+
+// Data block hash index (see block_builder.cc).
+static const char kDataBlockHashIndexTag = 1;
+static const uint8_t kHashIndexNoEntry = 255;
+static const uint8_t kHashIndexCollision = 254;
+static const uint32_t kHashIndexSeed = 0x5c2d1b3f;
+
+// Returns true if "comparator" orders internal keys (see db/dbformat.h),
+// whose last eight bytes hold a sequence number and value type that the
+// data block hash index leaves out.
+bool IsInternalKeyComparator(const Comparator* comparator);
+
 struct BlockContents {
     Slice data;          // Actual contents of data
     bool cachable;       // True iff data can be cached
@@ -87,6 +108,29 @@ struct BlockContents {
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
                  const BlockHandle& handle, BlockContents* result);
 
+// Read the "n" blocks identified by "handles[0..n-1]" from "file" with a
+// single batched read into results[0..n-1].  Fails if any of the blocks
+// cannot be read, in which case none of the results are filled.
+Status ReadBlocks(RandomAccessFile* file, const ReadOptions& options,
+                  const BlockHandle* handles, size_t n,
+                  BlockContents* results);
+
+// Like ReadBlock(), but leave the block as it is stored in the file and
+// set *type to its compression type.
+Status ReadRawBlock(RandomAccessFile* file, const ReadOptions& options,
+                    const BlockHandle& handle, BlockContents* result,
+                    char* type);
+
+// Compress "raw" with "*type", unless that does not save at least 12.5%
+// or the compression library is not available.  Returns the contents to
+// store, "raw" or "*compressed", and sets "*type" to match.
+Slice CompressBlock(const Slice& raw, int zstd_compression_level,
+                    std::string* compressed, CompressionType* type);
+
+// Uncompress the contents "raw" of a block stored with compression
+// "type" into a new heap-allocated *result.
+Status UncompressBlock(const Slice& raw, char type, BlockContents* result);
+
 // Implementation details follow.  Clients should ignore,
 
 inline BlockHandle::BlockHandle()
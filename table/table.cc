@@ -2,6 +2,8 @@
 
 #include "mydb/table.h"
 
+#include <algorithm>
+
 #include "mydb/cache.h"
 #include "mydb/comparator.h"
 #include "mydb/env.h"
@@ -21,20 +23,132 @@ struct Table::Rep {
         delete filter;
         delete[] filter_data;
         delete index_block;
+        delete range_del_block;
     }
 
     Options options;
     Status status;
     RandomAccessFile* file;
     uint64_t cache_id;
+    uint64_t compressed_cache_id;
     FilterBlockReader* filter;
     const char* filter_data;
 
     BlockHandle
         metaindex_handle; // Handle to metaindex_block: saved from footer
-    Block* index_block;
+    BlockHandle index_handle;
+    Block* index_block; // nullptr if the index lives in the block cache
+    Block* range_del_block; // nullptr if the table has no range tombstones
+
+    // Set if the filter lives in the block cache instead of in "filter".
+    bool filter_cached;
+    BlockHandle filter_handle;
+
+    // If partitioned_index is set, index_block is a top-level index whose
+    // values are the handles of index partitions, each followed by the
+    // handle of its filter partition when partitioned_filter is set.
+    bool partitioned_index;
+    bool partitioned_filter;
 };
 
+// A filter partition held in the block cache.
+struct CachedFilter {
+    CachedFilter(const FilterPolicy* policy, const BlockContents& contents)
+        : reader(policy, contents.data),
+          data(contents.heap_allocated ? contents.data.data() : nullptr) {}
+    ~CachedFilter() { delete[] data; }
+
+    FilterBlockReader reader;
+    const char* data; // Owned copy of the filter contents, if any
+};
+
+// Adaptive readahead starts after this many sequential block reads.
+static const int kReadaheadMinSequentialReads = 2;
+static const size_t kInitialReadaheadSize = 8 * 1024;
+static const size_t kMaxReadaheadSize = 256 * 1024;
+
+// Readahead state of one table iterator.  Data blocks read back to back
+// are prefetched from the file before the iterator gets to them, so long
+// scans are not bound by the latency of each read.
+struct Table::Readahead {
+    Readahead(Table* t, size_t fixed)
+        : table(t), fixed_size(fixed), size(kInitialReadaheadSize),
+          sequential_reads(0), next_offset(0), limit(0) {}
+
+    // Called before the data block at "handle" is read.
+    void BlockRead(const BlockHandle& handle);
+
+    Table* const table;
+    const size_t fixed_size; // ReadOptions::readahead_size
+    size_t size;             // Current adaptive readahead size
+    int sequential_reads;
+    uint64_t next_offset; // File offset just past the last block read
+    uint64_t limit;       // File offset up to which data was prefetched
+};
+
+void Table::Readahead::BlockRead(const BlockHandle& handle) {
+    const uint64_t offset = handle.offset();
+    const uint64_t end = offset + handle.size() + kBlockTrailerSize;
+    if (offset == next_offset) {
+        sequential_reads++;
+    } else {
+        sequential_reads = 0;
+        size = kInitialReadaheadSize;
+        limit = 0;
+    }
+    next_offset = end;
+
+    size_t n = fixed_size;
+    if (n == 0) {
+        if (sequential_reads < kReadaheadMinSequentialReads) {
+            return;
+        }
+        n = size;
+    }
+    if (end <= limit) {
+        return; // Already prefetched
+    }
+    const uint64_t start = std::max(offset, limit);
+    limit = std::max(end, offset + n);
+    table->rep_->file->Prefetch(start, limit - start);
+    if (fixed_size == 0) {
+        size = std::min(2 * size, kMaxReadaheadSize);
+    }
+}
+
+static void DeleteBlock(void* arg, void* ignored) {
+    delete reinterpret_cast<Block*>(arg);
+}
+
+static void DeleteCachedBlock(const Slice& key, void* value) {
+    Block* block = reinterpret_cast<Block*>(value);
+    delete block;
+}
+
+static void ReleaseBlock(void* arg, void* h) {
+    Cache* cache = reinterpret_cast<Cache*>(arg);
+    Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
+    cache->Release(handle);
+}
+
+static void DeleteCachedFilter(const Slice& key, void* value) {
+    CachedFilter* filter = reinterpret_cast<CachedFilter*>(value);
+    delete filter;
+}
+
+static void DeleteCachedCompressedBlock(const Slice& key, void* value) {
+    std::string* block = reinterpret_cast<std::string*>(value);
+    delete block;
+}
+
+// Returns the block cache key of the block at "offset" in the table
+// identified by "cache_id".  "buf" must have room for 16 bytes.
+static Slice BlockCacheKey(uint64_t cache_id, uint64_t offset, char* buf) {
+    EncodeFixed64(buf, cache_id);
+    EncodeFixed64(buf + 8, offset);
+    return Slice(buf, 16);
+}
+
 Status Table::Open(const Options& options, RandomAccessFile* file,
                    uint64_t size, Table** table) {
     *table = nullptr;
@@ -54,15 +168,18 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     if (!s.ok())
         return s;
 
-    // Read the index block
-    BlockContents index_block_contents;
+    // Read the index and metaindex blocks together.
+    const BlockHandle handles[2] = {footer.index_handle(),
+                                    footer.metaindex_handle()};
+    BlockContents contents[2];
     ReadOptions opt;
     if (options.paranoid_checks) {
         opt.verify_checksums = true;
     }
-    s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+    s = ReadBlocks(file, opt, handles, 2, contents);
 
     if (s.ok()) {
+        const BlockContents& index_block_contents = contents[0];
         // We've successfully read the footer and the index block: we're
         // ready to serve requests.
         Block* index_block = new Block(index_block_contents);
@@ -70,46 +187,93 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
         rep->options = options;
         rep->file = file;
         rep->metaindex_handle = footer.metaindex_handle();
+        rep->index_handle = footer.index_handle();
         rep->index_block = index_block;
+        rep->range_del_block = nullptr;
         rep->cache_id =
             (options.block_cache ? options.block_cache->NewId() : 0);
+        rep->compressed_cache_id =
+            (options.block_cache_compressed
+                 ? options.block_cache_compressed->NewId()
+                 : 0);
         rep->filter_data = nullptr;
         rep->filter = nullptr;
+        rep->filter_cached = false;
+        if (options.cache_index_and_filter_blocks &&
+            options.block_cache != nullptr && index_block_contents.cachable) {
+            // Hand the index block over to the block cache.
+            char cache_key_buffer[16];
+            options.block_cache->Release(options.block_cache->Insert(
+                BlockCacheKey(rep->cache_id, rep->index_handle.offset(),
+                              cache_key_buffer),
+                index_block, index_block->size(), &DeleteCachedBlock,
+                Cache::Priority::kHigh));
+            rep->index_block = nullptr;
+        }
+        rep->partitioned_index = false;
+        rep->partitioned_filter = false;
         *table = new Table(rep);
-        (*table)->ReadMeta(footer);
+        s = (*table)->ReadMeta(contents[1]);
+        if (!s.ok()) {
+            delete *table;
+            *table = nullptr;
+        }
     }
 
     return s;
 }
 
-void Table::ReadMeta(const Footer& footer) {
-    if (rep_->options.filter_policy == nullptr) {
-        return; // Do not need any metadata
-    }
-
-    // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-    // it is an empty block.
+Status Table::ReadMeta(const BlockContents& metaindex_contents) {
     ReadOptions opt;
     if (rep_->options.paranoid_checks) {
         opt.verify_checksums = true;
     }
-    BlockContents contents;
-    if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents)
-             .ok()) {
-        // Do not propagate errors since meta info is not needed for operation
-        return;
-    }
-    Block* meta = new Block(contents);
+    Status s;
+    Block* meta = new Block(metaindex_contents);
 
     Iterator* iter = meta->NewIterator(BytewiseComparator());
-    std::string key = "filter.";
-    key.append(rep_->options.filter_policy->Name());
-    iter->Seek(key);
-    if (iter->Valid() && iter->key() == Slice(key)) {
-        ReadFilter(iter->value());
+    iter->Seek(kPartitionedIndexMetaKey);
+    if (iter->Valid() && iter->key() == Slice(kPartitionedIndexMetaKey)) {
+        rep_->partitioned_index = true;
+    }
+    if (rep_->options.filter_policy != nullptr) {
+        std::string key =
+            rep_->partitioned_index ? kPartitionedFilterMetaPrefix : "filter.";
+        key.append(rep_->options.filter_policy->Name());
+        iter->Seek(key);
+        if (iter->Valid() && iter->key() == Slice(key)) {
+            if (rep_->partitioned_index) {
+                rep_->partitioned_filter = true;
+            } else {
+                ReadFilter(iter->value());
+            }
+        }
+    }
+    iter->Seek(kRangeDelMetaKey);
+    if (iter->Valid() && iter->key() == Slice(kRangeDelMetaKey)) {
+        // Unlike filters, tombstones affect results, so failing to read
+        // them fails the open.
+        Slice v = iter->value();
+        BlockHandle handle;
+        BlockContents range_del_contents;
+        s = handle.DecodeFrom(&v);
+        if (s.ok()) {
+            s = ReadBlock(rep_->file, opt, handle, &range_del_contents);
+        }
+        if (s.ok()) {
+            rep_->range_del_block = new Block(range_del_contents);
+        }
     }
     delete iter;
     delete meta;
+    return s;
+}
+
+Iterator* Table::NewRangeTombstoneIterator() const {
+    if (rep_->range_del_block == nullptr) {
+        return nullptr;
+    }
+    return rep_->range_del_block->NewIterator(rep_->options.comparator);
 }
 
 void Table::ReadFilter(const Slice& filter_handle_value) {
@@ -129,6 +293,21 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
     if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
         return;
     }
+    Cache* block_cache = rep_->options.block_cache;
+    if (rep_->options.cache_index_and_filter_blocks &&
+        block_cache != nullptr && block.cachable) {
+        // Hand the filter over to the block cache.
+        char cache_key_buffer[16];
+        block_cache->Release(block_cache->Insert(
+            BlockCacheKey(rep_->cache_id, filter_handle.offset(),
+                          cache_key_buffer),
+            new CachedFilter(rep_->options.filter_policy, block),
+            filter_handle.size(), &DeleteCachedFilter,
+            Cache::Priority::kHigh));
+        rep_->filter_cached = true;
+        rep_->filter_handle = filter_handle;
+        return;
+    }
     if (block.heap_allocated) {
         rep_->filter_data = block.data.data(); // Will need to delete later
     }
@@ -138,25 +317,73 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
 
 Table::~Table() { delete rep_; }
 
-static void DeleteBlock(void* arg, void* ignored) {
-    delete reinterpret_cast<Block*>(arg);
-}
+// Read the block at "handle", going through block_cache_compressed if
+// there is one.
+Status Table::LoadBlock(const ReadOptions& options, const BlockHandle& handle,
+                        BlockContents* contents) const {
+    Cache* compressed_cache = rep_->options.block_cache_compressed;
+    if (compressed_cache == nullptr) {
+        return ReadBlock(rep_->file, options, handle, contents);
+    }
 
-static void DeleteCachedBlock(const Slice& key, void* value) {
-    Block* block = reinterpret_cast<Block*>(value);
-    delete block;
-}
+    // Compressed blocks are cached as their stored bytes followed by the
+    // compression type.
+    char cache_key_buffer[16];
+    Slice key = BlockCacheKey(rep_->compressed_cache_id, handle.offset(),
+                              cache_key_buffer);
+    Cache::Handle* cache_handle = compressed_cache->Lookup(key);
+    if (cache_handle != nullptr) {
+        const std::string* block = reinterpret_cast<const std::string*>(
+            compressed_cache->Value(cache_handle));
+        Status s = UncompressBlock(Slice(block->data(), block->size() - 1),
+                                   block->back(), contents);
+        compressed_cache->Release(cache_handle);
+        return s;
+    }
 
-static void ReleaseBlock(void* arg, void* h) {
-    Cache* cache = reinterpret_cast<Cache*>(arg);
-    Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
-    cache->Release(handle);
+    BlockContents raw;
+    char type;
+    Status s = ReadRawBlock(rep_->file, options, handle, &raw, &type);
+    if (!s.ok() || type == kNoCompression) {
+        *contents = raw;
+        return s;
+    }
+    if (raw.cachable && options.fill_cache) {
+        std::string* block = new std::string(raw.data.data(), raw.data.size());
+        block->push_back(type);
+        compressed_cache->Release(
+            compressed_cache->Insert(key, block, block->size(),
+                                     &DeleteCachedCompressedBlock));
+    }
+    s = UncompressBlock(raw.data, type, contents);
+    if (raw.heap_allocated) {
+        delete[] raw.data.data();
+    }
+    return s;
 }
 
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
+    Readahead* readahead = reinterpret_cast<Readahead*>(arg);
+    BlockHandle handle;
+    Slice input = index_value;
+    if (handle.DecodeFrom(&input).ok()) {
+        readahead->BlockRead(handle);
+    }
+    return CachedBlockReader(readahead->table, options, index_value, false,
+                             false);
+}
+
+// Shared by BlockReader and the index readers.  If "metadata" is set the
+// block is part of the index: every lookup in the table needs it, so it is
+// cached with high priority regardless of options.fill_cache.  If
+// "point_lookup" is set the returned iterator may use the block's hash
+// index; see Block::NewIterator().
+Iterator* Table::CachedBlockReader(void* arg, const ReadOptions& options,
+                                   const Slice& index_value, bool metadata,
+                                   bool point_lookup) {
     Table* table = reinterpret_cast<Table*>(arg);
     Cache* block_cache = table->rep_->options.block_cache;
     Block* block = nullptr;
@@ -172,25 +399,30 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
         BlockContents contents;
         if (block_cache != nullptr) {
             char cache_key_buffer[16];
-            EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-            EncodeFixed64(cache_key_buffer + 8, handle.offset());
-            Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+            Slice key = BlockCacheKey(table->rep_->cache_id, handle.offset(),
+                                      cache_key_buffer);
             cache_handle = block_cache->Lookup(key);
             if (cache_handle != nullptr) {
                 block =
                     reinterpret_cast<Block*>(block_cache->Value(cache_handle));
             } else {
-                s = ReadBlock(table->rep_->file, options, handle, &contents);
+                s = table->LoadBlock(options, handle, &contents);
                 if (s.ok()) {
                     block = new Block(contents);
-                    if (contents.cachable && options.fill_cache) {
+                    // Index partitions are cached even if they point into a
+                    // memory-mapped file, so they are not parsed again on
+                    // every lookup.  The cache key is unique to this table,
+                    // so the entry is never used once the file is closed.
+                    if (metadata || (contents.cachable && options.fill_cache)) {
                         cache_handle = block_cache->Insert(
-                            key, block, block->size(), &DeleteCachedBlock);
+                            key, block, block->size(), &DeleteCachedBlock,
+                            metadata ? Cache::Priority::kHigh
+                                     : Cache::Priority::kLow);
                     }
                 }
             }
         } else {
-            s = ReadBlock(table->rep_->file, options, handle, &contents);
+            s = table->LoadBlock(options, handle, &contents);
             if (s.ok()) {
                 block = new Block(contents);
             }
@@ -199,7 +431,8 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 
     Iterator* iter;
     if (block != nullptr) {
-        iter = block->NewIterator(table->rep_->options.comparator);
+        iter = block->NewIterator(table->rep_->options.comparator,
+                                  point_lookup);
         if (cache_handle == nullptr) {
             iter->RegisterCleanup(&DeleteBlock, block, nullptr);
         } else {
@@ -211,45 +444,162 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
     return iter;
 }
 
+// Convert a top-level index value (i.e., the encoded BlockHandle of an
+// index partition) into an iterator over the data block handles of that
+// partition.
+Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+    // The filter partition handle that may follow is ignored.
+    return CachedBlockReader(arg, options, index_value, true, false);
+}
+
+Iterator* Table::NewIndexBlockIterator(const ReadOptions& options) const {
+    if (rep_->index_block != nullptr) {
+        return rep_->index_block->NewIterator(rep_->options.comparator);
+    }
+    std::string handle_encoding;
+    rep_->index_handle.EncodeTo(&handle_encoding);
+    return CachedBlockReader(const_cast<Table*>(this), options,
+                             handle_encoding, true, false);
+}
+
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+    Iterator* iter = NewIndexBlockIterator(options);
+    if (rep_->partitioned_index) {
+        iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader,
+                                   const_cast<Table*>(this), options);
+    }
+    return iter;
+}
+
+// Consult the filter partition named by "partition_value" (a top-level
+// index value).  Returns true if "key" may be in the partition.
+bool Table::PartitionMayMatch(const ReadOptions& options,
+                              const Slice& partition_value, const Slice& key) {
+    Slice input = partition_value;
+    BlockHandle partition_handle, filter_handle;
+    if (!rep_->partitioned_filter ||
+        !partition_handle.DecodeFrom(&input).ok() ||
+        !filter_handle.DecodeFrom(&input).ok()) {
+        return true;
+    }
+    return CachedFilterMayMatch(options, filter_handle, 0, key);
+}
+
+bool Table::KeyMayMatch(const ReadOptions& options, uint64_t block_offset,
+                        const Slice& key) {
+    if (rep_->filter != nullptr) {
+        return rep_->filter->KeyMayMatch(block_offset, key);
+    }
+    if (rep_->filter_cached) {
+        return CachedFilterMayMatch(options, rep_->filter_handle, block_offset,
+                                    key);
+    }
+    return true;
+}
+
+// Consult the filter block at "filter_handle" through the block cache.
+// Returns true if "key" may be in the data block at "block_offset".
+bool Table::CachedFilterMayMatch(const ReadOptions& options,
+                                 const BlockHandle& filter_handle,
+                                 uint64_t block_offset, const Slice& key) {
+    ReadOptions opt = options;
+    if (rep_->options.paranoid_checks) {
+        opt.verify_checksums = true;
+    }
+    Cache* block_cache = rep_->options.block_cache;
+    if (block_cache == nullptr) {
+        BlockContents contents;
+        if (!ReadBlock(rep_->file, opt, filter_handle, &contents).ok()) {
+            return true; // Errors are treated as potential matches
+        }
+        CachedFilter filter(rep_->options.filter_policy, contents);
+        return filter.reader.KeyMayMatch(block_offset, key);
+    }
+
+    char cache_key_buffer[16];
+    Slice cache_key =
+        BlockCacheKey(rep_->cache_id, filter_handle.offset(), cache_key_buffer);
+    Cache::Handle* cache_handle = block_cache->Lookup(cache_key);
+    if (cache_handle == nullptr) {
+        BlockContents contents;
+        if (!ReadBlock(rep_->file, opt, filter_handle, &contents).ok()) {
+            return true;
+        }
+        // Cached even if "contents" points into a memory-mapped file; see
+        // CachedBlockReader().
+        cache_handle = block_cache->Insert(
+            cache_key, new CachedFilter(rep_->options.filter_policy, contents),
+            filter_handle.size(), &DeleteCachedFilter, Cache::Priority::kHigh);
+    }
+    CachedFilter* filter =
+        reinterpret_cast<CachedFilter*>(block_cache->Value(cache_handle));
+    bool result = filter->reader.KeyMayMatch(block_offset, key);
+    block_cache->Release(cache_handle);
+    return result;
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-    return NewTwoLevelIterator(
-        rep_->index_block->NewIterator(rep_->options.comparator),
-        &Table::BlockReader, const_cast<Table*>(this), options);
+    Readahead* readahead =
+        new Readahead(const_cast<Table*>(this), options.readahead_size);
+    Iterator* iter = NewTwoLevelIterator(
+        NewIndexIterator(options), &Table::BlockReader, readahead, options);
+    iter->RegisterCleanup(
+        [](void* arg, void* ignored) {
+            delete reinterpret_cast<Readahead*>(arg);
+        },
+        readahead, nullptr);
+    return iter;
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
                                                 const Slice&)) {
     Status s;
-    Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+    Iterator* iiter = NewIndexBlockIterator(options);
     iiter->Seek(k);
-    if (iiter->Valid()) {
+    if (iiter->Valid() && rep_->partitioned_index) {
+        // Descend into the partition that covers k, unless its filter
+        // rules k out.
+        Iterator* partition_iter = nullptr;
+        if (PartitionMayMatch(options, iiter->value(), k)) {
+            partition_iter =
+                IndexPartitionReader(this, options, iiter->value());
+            partition_iter->Seek(k);
+        }
+        delete iiter;
+        iiter = partition_iter;
+    } else if (iiter->Valid()) {
         Slice handle_value = iiter->value();
-        FilterBlockReader* filter = rep_->filter;
         BlockHandle handle;
-        if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
-            !filter->KeyMayMatch(handle.offset(), k)) {
+        if (handle.DecodeFrom(&handle_value).ok() &&
+            !KeyMayMatch(options, handle.offset(), k)) {
             // Not found
-        } else {
-            Iterator* block_iter = BlockReader(this, options, iiter->value());
-            block_iter->Seek(k);
-            if (block_iter->Valid()) {
-                (*handle_result)(arg, block_iter->key(), block_iter->value());
-            }
-            s = block_iter->status();
-            delete block_iter;
+            delete iiter;
+            iiter = nullptr;
         }
     }
-    if (s.ok()) {
-        s = iiter->status();
+    if (iiter != nullptr && iiter->Valid()) {
+        Iterator* block_iter = CachedBlockReader(this, options, iiter->value(),
+                                                 false, true);
+        block_iter->Seek(k);
+        if (block_iter->Valid()) {
+            (*handle_result)(arg, block_iter->key(), block_iter->value());
+        }
+        s = block_iter->status();
+        delete block_iter;
+    }
+    if (iiter != nullptr) {
+        if (s.ok()) {
+            s = iiter->status();
+        }
+        delete iiter;
     }
-    delete iiter;
     return s;
 }
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-    Iterator* index_iter =
-        rep_->index_block->NewIterator(rep_->options.comparator);
+    Iterator* index_iter = NewIndexIterator(ReadOptions());
     index_iter->Seek(key);
     uint64_t result;
     if (index_iter->Valid()) {
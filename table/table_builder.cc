@@ -2,33 +2,84 @@
 
 #include "mydb/table_builder.h"
 
+#include <algorithm>
 #include <cassert>
+#include <deque>
+#include <utility>
+#include <vector>
 
 #include "mydb/comparator.h"
 #include "mydb/env.h"
 #include "mydb/filter_policy.h"
 #include "mydb/options.h"
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "table/block_builder.h"
+#include "table/compression_pool.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/mutexlock.h"
 
 namespace mydb {
 
+namespace {
+
+// A data block handed to the compression pool.  The builder writes queued
+// blocks in order once they are compressed.
+struct QueuedBlock {
+    TableBuilder* builder;
+    std::string raw;
+    CompressionType requested_type;
+    int zstd_compression_level;
+
+    // Keys of the block, for the filter.
+    std::vector<std::string> keys;
+
+    // Index key of the block; set once the next block's first key (or the
+    // end of the table) is known.
+    std::string index_key;
+    bool has_index_key = false;
+
+    // Filled in by the compression pool.
+    std::string compressed;
+    CompressionType type = kNoCompression;
+    bool done = false;
+};
+
+} // namespace
+
 struct TableBuilder::Rep {
-    Rep(const Options& opt, WritableFile* f)
+    Rep(const Options& opt, WritableFile* f, CompressionPool* p)
         : options(opt), index_block_options(opt), file(f), offset(0),
-          data_block(&options), index_block(&index_block_options),
-          num_entries(0), closed(false),
+          data_block(&options, options.data_block_hash_index),
+          index_block(&index_block_options),
+          top_level_index_block(&index_block_options), num_entries(0),
+          closed(false),
           filter_block(opt.filter_policy == nullptr
                            ? nullptr
                            : new FilterBlockBuilder(opt.filter_policy)),
-          pending_index_entry(false) {
+          pending_index_entry(false),
+          pool(p), parallel(p != nullptr && opt.compression != kNoCompression),
+          max_queued(2 * std::max(opt.compression_threads, 1)),
+          queued_bytes(0), done_cv(&mu), in_flight(0) {
         index_block_options.block_restart_interval = 1;
     }
 
+    ~Rep() {
+        // Blocks handed to the pool cannot be taken back.
+        mu.Lock();
+        while (in_flight > 0) {
+            done_cv.Wait();
+        }
+        mu.Unlock();
+        for (QueuedBlock* block : queue) {
+            delete block;
+        }
+    }
+
     Options options;
     Options index_block_options;
     WritableFile* file;
@@ -36,10 +87,15 @@ struct TableBuilder::Rep {
     Status status;
     BlockBuilder data_block;
     BlockBuilder index_block;
+    // When options.partition_index_and_filters is set, index_block (and
+    // filter_block) only hold the current partition, and finished
+    // partitions are recorded here.
+    BlockBuilder top_level_index_block;
     std::string last_key;
     int64_t num_entries;
     bool closed; // Either Finish() or Abandon() has been called.
     FilterBlockBuilder* filter_block;
+    std::vector<std::pair<std::string, std::string>> range_tombstones;
 
     // We do not emit the index entry for a block until we have seen the
     // first key for the next data block.  This allows us to use shorter
@@ -54,10 +110,41 @@ struct TableBuilder::Rep {
     BlockHandle pending_handle; // Handle to add to index block
 
     std::string compressed_output;
+
+    // State for compressing data blocks in the pool.  The builder thread
+    // owns "queue" and everything else above; pool threads only touch the
+    // blocks handed to them.
+    CompressionPool* const pool;
+    const bool parallel;
+    std::deque<QueuedBlock*> queue; // Blocks not yet written, in file order
+    std::vector<std::string> block_keys; // Keys of data_block
+    const size_t max_queued;            // Bounds the memory held by queue
+    uint64_t queued_bytes;              // Raw size of the blocks in queue
+
+    port::Mutex mu;
+    port::CondVar done_cv; // Signalled when a block is done
+    int in_flight GUARDED_BY(mu); // Blocks handed to the pool and not done
 };
 
+void TableBuilder::CompressQueuedBlock(void* arg) {
+    QueuedBlock* block = reinterpret_cast<QueuedBlock*>(arg);
+    block->type = block->requested_type;
+    CompressBlock(block->raw, block->zstd_compression_level,
+                  &block->compressed, &block->type);
+
+    Rep* r = block->builder->rep_;
+    MutexLock l(&r->mu);
+    block->done = true;
+    r->in_flight--;
+    r->done_cv.SignalAll();
+}
+
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
-    : rep_(new Rep(options, file)) {
+    : TableBuilder(options, file, nullptr) {}
+
+TableBuilder::TableBuilder(const Options& options, WritableFile* file,
+                           CompressionPool* pool)
+    : rep_(new Rep(options, file, pool)) {
     if (rep_->filter_block != nullptr) {
         rep_->filter_block->StartBlock(0);
     }
@@ -77,6 +164,15 @@ Status TableBuilder::ChangeOptions(const Options& options) {
         return Status::InvalidArgument(
             "changing comparator while building table");
     }
+    if (options.partition_index_and_filters !=
+        rep_->options.partition_index_and_filters) {
+        return Status::InvalidArgument(
+            "changing index partitioning while building table");
+    }
+    if (options.data_block_hash_index != rep_->options.data_block_hash_index) {
+        return Status::InvalidArgument(
+            "changing data block hash index while building table");
+    }
 
     // Note that any live BlockBuilders point to rep_->options and therefore
     // will automatically pick up the updated options.
@@ -86,6 +182,12 @@ Status TableBuilder::ChangeOptions(const Options& options) {
     return Status::OK();
 }
 
+void TableBuilder::AddRangeTombstone(const Slice& key, const Slice& value) {
+    Rep* r = rep_;
+    assert(!r->closed);
+    r->range_tombstones.emplace_back(key.ToString(), value.ToString());
+}
+
 void TableBuilder::Add(const Slice& key, const Slice& value) {
     Rep* r = rep_;
     assert(!r->closed);
@@ -98,14 +200,16 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     if (r->pending_index_entry) {
         assert(r->data_block.empty());
         r->options.comparator->FindShortestSeparator(&r->last_key, key);
-        std::string handle_encoding;
-        r->pending_handle.EncodeTo(&handle_encoding);
-        r->index_block.Add(r->last_key, Slice(handle_encoding));
-        r->pending_index_entry = false;
+        AddPendingIndexEntry(r->last_key);
     }
 
     if (r->filter_block != nullptr) {
-        r->filter_block->AddKey(key);
+        if (r->parallel) {
+            // Added to the filter when the block is written.
+            r->block_keys.emplace_back(key.data(), key.size());
+        } else {
+            r->filter_block->AddKey(key);
+        }
     }
 
     r->last_key.assign(key.data(), key.size());
@@ -126,16 +230,139 @@ void TableBuilder::Flush() {
     if (r->data_block.empty())
         return;
     assert(!r->pending_index_entry);
+    if (r->parallel) {
+        QueueBlock();
+        return;
+    }
     WriteBlock(&r->data_block, &r->pending_handle);
     if (ok()) {
         r->pending_index_entry = true;
         r->status = r->file->Flush();
     }
-    if (r->filter_block != nullptr) {
+    if (r->filter_block != nullptr &&
+        !r->options.partition_index_and_filters) {
+        // Partition filters cover whole partitions, not file offsets.
         r->filter_block->StartBlock(r->offset);
     }
 }
 
+void TableBuilder::AddPendingIndexEntry(const Slice& key) {
+    Rep* r = rep_;
+    if (r->parallel) {
+        QueuedBlock* block = r->queue.back();
+        block->index_key.assign(key.data(), key.size());
+        block->has_index_key = true;
+        WriteQueuedBlocks(false);
+    } else {
+        AddIndexEntry(key, r->pending_handle);
+    }
+    r->pending_index_entry = false;
+}
+
+void TableBuilder::QueueBlock() {
+    Rep* r = rep_;
+    QueuedBlock* block = new QueuedBlock;
+    block->builder = this;
+    block->raw = r->data_block.Finish().ToString();
+    block->requested_type = r->options.compression;
+    block->zstd_compression_level = r->options.zstd_compression_level;
+    block->keys.swap(r->block_keys);
+    r->data_block.Reset();
+    r->queue.push_back(block);
+    r->queued_bytes += block->raw.size();
+    r->pending_index_entry = true;
+    {
+        MutexLock l(&r->mu);
+        r->in_flight++;
+    }
+    r->pool->Schedule(&TableBuilder::CompressQueuedBlock, block);
+
+    while (ok() && r->queue.size() > r->max_queued) {
+        WriteQueuedBlocks(true);
+    }
+}
+
+void TableBuilder::WriteQueuedBlocks(bool wait) {
+    // Blocks are written, and their filter keys and index entries added, in
+    // the order they were queued, so the file comes out exactly as if it
+    // had been built without compression threads.
+    Rep* r = rep_;
+    while (ok() && !r->queue.empty() && r->queue.front()->has_index_key) {
+        QueuedBlock* block = r->queue.front();
+        {
+            MutexLock l(&r->mu);
+            while (wait && !block->done) {
+                r->done_cv.Wait();
+            }
+            if (!block->done) {
+                return;
+            }
+        }
+        r->queue.pop_front();
+        r->queued_bytes -= block->raw.size();
+
+        if (r->filter_block != nullptr) {
+            for (const std::string& key : block->keys) {
+                r->filter_block->AddKey(key);
+            }
+        }
+        BlockHandle handle;
+        WriteRawBlock(block->type == kNoCompression ? block->raw
+                                                    : block->compressed,
+                      block->type, &handle);
+        if (ok()) {
+            r->status = r->file->Flush();
+        }
+        if (r->filter_block != nullptr &&
+            !r->options.partition_index_and_filters) {
+            r->filter_block->StartBlock(r->offset);
+        }
+        if (ok()) {
+            AddIndexEntry(block->index_key, handle);
+        }
+        delete block;
+        wait = false;
+    }
+}
+
+void TableBuilder::AddIndexEntry(const Slice& key, const BlockHandle& handle) {
+    Rep* r = rep_;
+    std::string handle_encoding;
+    handle.EncodeTo(&handle_encoding);
+    r->index_block.Add(key, Slice(handle_encoding));
+    if (r->options.partition_index_and_filters &&
+        r->index_block.CurrentSizeEstimate() >=
+            r->options.metadata_block_size) {
+        FlushIndexPartition(key);
+    }
+}
+
+void TableBuilder::FlushIndexPartition(const Slice& last_index_key) {
+    // A partition is written as a filter covering the keys of its data
+    // blocks, followed by the index block itself.  The top-level index
+    // maps the last key of the partition to both handles.
+    Rep* r = rep_;
+    assert(!r->index_block.empty());
+    BlockHandle filter_handle, partition_handle;
+    if (r->filter_block != nullptr) {
+        WriteRawBlock(r->filter_block->Finish(), kNoCompression,
+                      &filter_handle);
+        delete r->filter_block;
+        r->filter_block = new FilterBlockBuilder(r->options.filter_policy);
+    }
+    if (ok()) {
+        WriteBlock(&r->index_block, &partition_handle);
+    }
+    if (ok()) {
+        std::string handle_encoding;
+        partition_handle.EncodeTo(&handle_encoding);
+        if (r->filter_block != nullptr) {
+            filter_handle.EncodeTo(&handle_encoding);
+        }
+        r->top_level_index_block.Add(last_index_key, Slice(handle_encoding));
+    }
+}
+
 void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
     // File format contains a sequence of blocks where each block has:
     //    block_data: uint8[n]
@@ -145,43 +372,10 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
     Rep* r = rep_;
     Slice raw = block->Finish();
 
-    Slice block_contents;
     CompressionType type = r->options.compression;
-    // TODO(postrelease): Support more compression options: zlib?
-    switch (type) {
-    case kNoCompression:
-        block_contents = raw;
-        break;
-
-    case kSnappyCompression: {
-        std::string* compressed = &r->compressed_output;
-        if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-            compressed->size() < raw.size() - (raw.size() / 8u)) {
-            block_contents = *compressed;
-        } else {
-            // Snappy not supported, or compressed less than 12.5%, so just
-            // store uncompressed form
-            block_contents = raw;
-            type = kNoCompression;
-        }
-        break;
-    }
-
-    case kZstdCompression: {
-        std::string* compressed = &r->compressed_output;
-        if (port::Zstd_Compress(r->options.zstd_compression_level, raw.data(),
-                                raw.size(), compressed) &&
-            compressed->size() < raw.size() - (raw.size() / 8u)) {
-            block_contents = *compressed;
-        } else {
-            // Zstd not supported, or compressed less than 12.5%, so just
-            // store uncompressed form
-            block_contents = raw;
-            type = kNoCompression;
-        }
-        break;
-    }
-    }
+    Slice block_contents =
+        CompressBlock(raw, r->options.zstd_compression_level,
+                      &r->compressed_output, &type);
     WriteRawBlock(block_contents, type, handle);
     r->compressed_output.clear();
     block->Reset();
@@ -215,18 +409,60 @@ Status TableBuilder::Finish() {
     assert(!r->closed);
     r->closed = true;
 
-    BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+    const bool partitioned = r->options.partition_index_and_filters;
+
+    BlockHandle filter_block_handle, range_del_block_handle,
+        metaindex_block_handle, index_block_handle;
+
+    // Complete the index entry for the last data block.  With a partitioned
+    // index this may write the final partition, which has to happen before
+    // the metaindex block.
+    if (ok() && r->pending_index_entry) {
+        r->options.comparator->FindShortSuccessor(&r->last_key);
+        AddPendingIndexEntry(r->last_key);
+    }
+    while (ok() && !r->queue.empty()) {
+        WriteQueuedBlocks(true);
+    }
+    if (ok() && partitioned && !r->index_block.empty()) {
+        FlushIndexPartition(r->last_key);
+    }
 
     // Write filter block
-    if (ok() && r->filter_block != nullptr) {
+    if (ok() && r->filter_block != nullptr && !partitioned) {
         WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                       &filter_block_handle);
     }
 
+    // Write range tombstone block
+    if (ok() && !r->range_tombstones.empty()) {
+        const Comparator* cmp = r->options.comparator;
+        std::sort(r->range_tombstones.begin(), r->range_tombstones.end(),
+                  [cmp](const std::pair<std::string, std::string>& a,
+                        const std::pair<std::string, std::string>& b) {
+                      return cmp->Compare(a.first, b.first) < 0;
+                  });
+        BlockBuilder range_del_block(&r->options);
+        for (const auto& tombstone : r->range_tombstones) {
+            range_del_block.Add(tombstone.first, tombstone.second);
+        }
+        WriteBlock(&range_del_block, &range_del_block_handle);
+    }
+
     // Write metaindex block
     if (ok()) {
         BlockBuilder meta_index_block(&r->options);
-        if (r->filter_block != nullptr) {
+        if (partitioned) {
+            // Entries mark the index as partitioned and, if present, the
+            // filter partitions as built by this policy.  Keys are added in
+            // sorted order.
+            meta_index_block.Add(kPartitionedIndexMetaKey, Slice());
+            if (r->filter_block != nullptr) {
+                std::string key = kPartitionedFilterMetaPrefix;
+                key.append(r->options.filter_policy->Name());
+                meta_index_block.Add(key, Slice());
+            }
+        } else if (r->filter_block != nullptr) {
             // Add mapping from "filter.Name" to location of filter data
             std::string key = "filter.";
             key.append(r->options.filter_policy->Name());
@@ -234,6 +470,11 @@ Status TableBuilder::Finish() {
             filter_block_handle.EncodeTo(&handle_encoding);
             meta_index_block.Add(key, handle_encoding);
         }
+        if (!r->range_tombstones.empty()) {
+            std::string handle_encoding;
+            range_del_block_handle.EncodeTo(&handle_encoding);
+            meta_index_block.Add(kRangeDelMetaKey, handle_encoding);
+        }
 
         // TODO(postrelease): Add stats and other meta blocks
         WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -241,14 +482,8 @@ Status TableBuilder::Finish() {
 
     // Write index block
     if (ok()) {
-        if (r->pending_index_entry) {
-            r->options.comparator->FindShortSuccessor(&r->last_key);
-            std::string handle_encoding;
-            r->pending_handle.EncodeTo(&handle_encoding);
-            r->index_block.Add(r->last_key, Slice(handle_encoding));
-            r->pending_index_entry = false;
-        }
-        WriteBlock(&r->index_block, &index_block_handle);
+        WriteBlock(partitioned ? &r->top_level_index_block : &r->index_block,
+                   &index_block_handle);
     }
 
     // Write footer
@@ -274,6 +509,8 @@ void TableBuilder::Abandon() {
 
 uint64_t TableBuilder::NumEntries() const { return rep_->num_entries; }
 
-uint64_t TableBuilder::FileSize() const { return rep_->offset; }
+uint64_t TableBuilder::FileSize() const {
+    return rep_->offset + rep_->queued_bytes;
+}
 
 } // namespace mydb
@@ -8,14 +8,17 @@
 #include <map>
 #include <string>
 
+#include "mydb/cache.h"
 #include "mydb/db.h"
 #include "mydb/env.h"
+#include "mydb/filter_policy.h"
 #include "mydb/iterator.h"
 #include "mydb/options.h"
 #include "mydb/table_builder.h"
 
 #include "table/block.h"
 #include "table/block_builder.h"
+#include "table/compression_pool.h"
 #include "table/format.h"
 #include "util/random.h"
 #include "util/testutil.h"
@@ -182,7 +185,7 @@ class BlockConstructor : public Constructor {
     Status FinishImpl(const Options& options, const KVMap& data) override {
         delete block_;
         block_ = nullptr;
-        BlockBuilder builder(&options);
+        BlockBuilder builder(&options, options.data_block_hash_index);
 
         for (const auto& kvp : data) {
             builder.Add(kvp.first, kvp.second);
@@ -378,6 +381,8 @@ struct TestArgs {
     TestType type;
     bool reverse_compare;
     int restart_interval;
+    bool partitioned_index;
+    bool data_block_hash_index;
 };
 
 static const TestArgs kTestArgList[] = {
@@ -388,12 +393,23 @@ static const TestArgs kTestArgList[] = {
     {TABLE_TEST, true, 1},
     {TABLE_TEST, true, 1024},
 
+    // Partitioned index with many small partitions
+    {TABLE_TEST, false, 16, true},
+    {TABLE_TEST, false, 1, true},
+    {TABLE_TEST, true, 16, true},
+
+    // Data block hash index, which scans must skip
+    {TABLE_TEST, false, 16, false, true},
+    {TABLE_TEST, false, 1, false, true},
+
     {BLOCK_TEST, false, 16},
     {BLOCK_TEST, false, 1},
     {BLOCK_TEST, false, 1024},
     {BLOCK_TEST, true, 16},
     {BLOCK_TEST, true, 1},
     {BLOCK_TEST, true, 1024},
+    {BLOCK_TEST, false, 16, false, true},
+    {BLOCK_TEST, true, 1, false, true},
 
     // Restart interval does not matter for memtables
     {MEMTABLE_TEST, false, 16},
@@ -418,6 +434,9 @@ class Harness : public testing::Test {
         // Use shorter block size for tests to exercise block boundary
         // conditions more.
         options_.block_size = 256;
+        options_.partition_index_and_filters = args.partitioned_index;
+        options_.metadata_block_size = 64;
+        options_.data_block_hash_index = args.data_block_hash_index;
         if (args.reverse_compare) {
             options_.comparator = &reverse_key_comparator;
         }
@@ -731,6 +750,52 @@ TEST_F(Harness, RandomizedLongDB) {
     ASSERT_GT(files, 0);
 }
 
+TEST(BlockTest, HashIndexPointLookup) {
+    Options options;
+    options.block_restart_interval = 4;
+    BlockBuilder builder(&options, true);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 200; i++) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "k%06d", i * 2);
+        keys.push_back(buf);
+        builder.Add(keys.back(), "v" + keys.back());
+    }
+    BlockContents contents;
+    std::string data = builder.Finish().ToString();
+    contents.data = data;
+    contents.cachable = false;
+    contents.heap_allocated = false;
+    Block block(contents);
+
+    Iterator* iter = block.NewIterator(options.comparator, true);
+    for (const std::string& key : keys) {
+        iter->Seek(key);
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(key, iter->key().ToString());
+        ASSERT_EQ("v" + key, iter->value().ToString());
+    }
+    // Absent keys either leave the iterator invalid or land on a
+    // different key, as a binary search would.
+    for (int i = 0; i < 200; i++) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "k%06d", i * 2 + 1);
+        iter->Seek(buf);
+        ASSERT_TRUE(!iter->Valid() || iter->key().ToString() != buf);
+    }
+    ASSERT_MYDB_OK(iter->status());
+    delete iter;
+
+    // Ordinary iterators skip the index.
+    iter = block.NewIterator(options.comparator);
+    size_t n = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        ASSERT_EQ(keys[n++], iter->key().ToString());
+    }
+    ASSERT_EQ(keys.size(), n);
+    delete iter;
+}
+
 TEST(MemTableTest, Simple) {
     InternalKeyComparator cmp(BytewiseComparator());
     MemTable* memtable = new MemTable(cmp);
@@ -795,6 +860,89 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
     ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
+TEST(TableTest, ApproximateOffsetOfPartitioned) {
+    TableConstructor c(BytewiseComparator());
+    c.Add("k01", "hello");
+    c.Add("k02", "hello2");
+    c.Add("k03", std::string(10000, 'x'));
+    c.Add("k04", std::string(200000, 'x'));
+    c.Add("k05", std::string(300000, 'x'));
+    c.Add("k06", "hello3");
+    c.Add("k07", std::string(100000, 'x'));
+    std::vector<std::string> keys;
+    KVMap kvmap;
+    Options options;
+    options.block_size = 1024;
+    options.compression = kNoCompression;
+    options.partition_index_and_filters = true;
+    options.metadata_block_size = 1; // One data block per partition
+    c.Finish(options, &keys, &kvmap);
+
+    // Each partition adds a small index block after its data block.
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"), 0, 0));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k01"), 0, 0));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k03"), 0, 100));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04"), 10000, 11100));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k05"), 210000, 211200));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k06"), 510000, 511300));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k07"), 510000, 511300));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612500));
+}
+
+TEST(TableTest, IndexAndFilterInBlockCache) {
+    const FilterPolicy* policy = NewBloomFilterPolicy(10);
+    Cache* cache = NewLRUCache(1 << 20, 0.5);
+    Options options;
+    options.block_size = 256;
+    options.filter_policy = policy;
+    options.block_cache = cache;
+    options.cache_index_and_filter_blocks = true;
+
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    for (int i = 0; i < 1000; i++) {
+        char key[20];
+        std::snprintf(key, sizeof(key), "k%06d", i);
+        builder.Add(key, std::string(50, 'v'));
+    }
+    ASSERT_MYDB_OK(builder.Finish());
+
+    StringSource source(sink.contents());
+    Table* table = nullptr;
+    ASSERT_MYDB_OK(
+        Table::Open(options, &source, sink.contents().size(), &table));
+
+    // Open hands the index and filter over to the cache.
+    const size_t metadata_charge = cache->TotalCharge();
+    ASSERT_GT(metadata_charge, 0);
+
+    Iterator* iter = table->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        count++;
+    }
+    ASSERT_MYDB_OK(iter->status());
+    ASSERT_EQ(1000, count);
+    iter->Seek("k000500");
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("k000500", iter->key().ToString());
+    delete iter;
+    ASSERT_GT(cache->TotalCharge(), metadata_charge);
+
+    // Evicted metadata is read back on demand.
+    cache->Prune();
+    ASSERT_EQ(0, cache->TotalCharge());
+    iter = table->NewIterator(ReadOptions());
+    iter->Seek("k000999");
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("k000999", iter->key().ToString());
+    delete iter;
+
+    delete table;
+    delete cache;
+    delete policy;
+}
+
 static bool CompressionSupported(CompressionType type) {
     std::string out;
     Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -806,4 +954,197 @@ static bool CompressionSupported(CompressionType type) {
     return false;
 }
 
+// A StringSource that counts the reads issued against it.
+class CountingSource : public StringSource {
+  public:
+    CountingSource(const Slice& contents) : StringSource(contents), reads_(0) {}
+
+    Status Read(uint64_t offset, size_t n, Slice* result,
+                char* scratch) const override {
+        reads_++;
+        return StringSource::Read(offset, n, result, scratch);
+    }
+
+    int reads() const { return reads_; }
+
+  private:
+    mutable int reads_;
+};
+
+// Records the ranges it is asked to prefetch.
+class PrefetchingSource : public StringSource {
+  public:
+    PrefetchingSource(const Slice& contents) : StringSource(contents) {}
+
+    Status Prefetch(uint64_t offset, size_t n) const override {
+        prefetches_.emplace_back(offset, n);
+        return Status::OK();
+    }
+
+    std::vector<std::pair<uint64_t, size_t>>* prefetches() const {
+        return &prefetches_;
+    }
+
+  private:
+    mutable std::vector<std::pair<uint64_t, size_t>> prefetches_;
+};
+
+TEST(TableTest, Readahead) {
+    Options options;
+    options.block_size = 1024;
+    options.compression = kNoCompression;
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    for (int i = 0; i < 2000; i++) {
+        char key[20];
+        std::snprintf(key, sizeof(key), "k%06d", i);
+        builder.Add(key, std::string(100, 'a' + i % 26));
+    }
+    ASSERT_MYDB_OK(builder.Finish());
+
+    PrefetchingSource source(sink.contents());
+    std::vector<std::pair<uint64_t, size_t>>* prefetches = source.prefetches();
+    Table* table = nullptr;
+    ASSERT_MYDB_OK(
+        Table::Open(options, &source, sink.contents().size(), &table));
+
+    // A scan prefetches once it turns out to be sequential, in growing
+    // contiguous ranges.
+    Iterator* iter = table->NewIterator(ReadOptions());
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    }
+    ASSERT_MYDB_OK(iter->status());
+    delete iter;
+    ASSERT_GE(prefetches->size(), 3);
+    ASSERT_LT(prefetches->size(), 20);
+    ASSERT_GT((*prefetches)[0].first, 0);
+    for (size_t i = 1; i < prefetches->size(); i++) {
+        const auto& prev = (*prefetches)[i - 1];
+        ASSERT_EQ(prev.first + prev.second, (*prefetches)[i].first);
+    }
+    ASSERT_GT((*prefetches)[prefetches->size() - 2].second,
+              (*prefetches)[0].second);
+
+    // Scattered seeks do not.
+    prefetches->clear();
+    iter = table->NewIterator(ReadOptions());
+    for (int i = 1900; i >= 0; i -= 100) {
+        char key[20];
+        std::snprintf(key, sizeof(key), "k%06d", i);
+        iter->Seek(key);
+        ASSERT_TRUE(iter->Valid());
+    }
+    delete iter;
+    ASSERT_EQ(0, prefetches->size());
+
+    // A fixed readahead size applies from the first block.
+    ReadOptions read_options;
+    read_options.readahead_size = 64 * 1024;
+    iter = table->NewIterator(read_options);
+    iter->SeekToFirst();
+    ASSERT_TRUE(iter->Valid());
+    delete iter;
+    ASSERT_EQ(1, prefetches->size());
+    ASSERT_EQ(0, (*prefetches)[0].first);
+    ASSERT_EQ(64 * 1024, (*prefetches)[0].second);
+
+    delete table;
+}
+
+TEST(TableTest, CompressedBlockCache) {
+    CompressionType type = kNoCompression;
+    if (CompressionSupported(kSnappyCompression)) {
+        type = kSnappyCompression;
+    } else if (CompressionSupported(kZstdCompression)) {
+        type = kZstdCompression;
+    } else {
+        GTEST_SKIP() << "no compression support";
+    }
+
+    Cache* compressed_cache = NewLRUCache(1 << 20);
+    Options options;
+    options.block_size = 1024;
+    options.compression = type;
+    options.block_cache_compressed = compressed_cache;
+
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    for (int i = 0; i < 1000; i++) {
+        char key[20];
+        std::snprintf(key, sizeof(key), "k%06d", i);
+        builder.Add(key, std::string(100, 'a' + i % 26));
+    }
+    ASSERT_MYDB_OK(builder.Finish());
+
+    CountingSource source(sink.contents());
+    Table* table = nullptr;
+    ASSERT_MYDB_OK(
+        Table::Open(options, &source, sink.contents().size(), &table));
+
+    // Without an uncompressed block cache, the first scan reads every
+    // block from the file and the second one only decompresses them.
+    for (int pass = 0; pass < 2; pass++) {
+        const int reads_before = source.reads();
+        Iterator* iter = table->NewIterator(ReadOptions());
+        int count = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+            count++;
+        }
+        ASSERT_MYDB_OK(iter->status());
+        ASSERT_EQ(1000, count);
+        delete iter;
+        if (pass == 0) {
+            ASSERT_GT(source.reads(), reads_before);
+        } else {
+            ASSERT_EQ(source.reads(), reads_before);
+        }
+    }
+    ASSERT_GT(compressed_cache->TotalCharge(), 0);
+    ASSERT_LT(compressed_cache->TotalCharge(), 1000 * 100);
+
+    delete table;
+    delete compressed_cache;
+}
+
+static std::string BuildTable(const Options& options, CompressionPool* pool,
+                              int value_size) {
+    StringSink sink;
+    TableBuilder builder(options, &sink, pool);
+    Random rnd(301);
+    for (int i = 0; i < 500000 / value_size; i++) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "k%08d", i);
+        std::string value;
+        test::CompressibleString(&rnd, 0.5, value_size, &value);
+        builder.Add(key, value);
+    }
+    EXPECT_MYDB_OK(builder.Finish());
+    EXPECT_EQ(sink.contents().size(), builder.FileSize());
+    return sink.contents();
+}
+
+TEST(TableTest, ParallelCompression) {
+    const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+    CompressionPool pool(Env::Default(), 4);
+    for (bool partitioned : {false, true}) {
+        // Blocks larger than twice the 2KB covered by each filter of an
+        // unpartitioned filter block leave empty filters behind them.
+        for (int value_size : {100, 5000}) {
+            Options options;
+            options.block_size = 256;
+            options.compression = kSnappyCompression;
+            options.filter_policy = filter_policy;
+            options.partition_index_and_filters = partitioned;
+            options.metadata_block_size = 256;
+            options.compression_threads = 4;
+            const std::string serial = BuildTable(options, nullptr, value_size);
+
+            // Blocks compressed in the pool are written in the same order
+            // with the same filters and index entries.
+            ASSERT_EQ(serial, BuildTable(options, &pool, value_size));
+        }
+    }
+    delete filter_policy;
+}
+
 } // namespace mydb
@@ -15,6 +15,13 @@ namespace mydb {
 
 Cache::~Cache() {}
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+                             void (*deleter)(const Slice& key, void* value),
+                             Priority priority) {
+    (void)priority;
+    return Insert(key, value, charge, deleter);
+}
+
 namespace {
 
 // LRU cache implementation
@@ -35,6 +42,13 @@ namespace {
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
+//
+// When a high-priority pool is configured, the LRU list is split in two.
+// Unreferenced items that were inserted with Cache::Priority::kHigh, or that
+// have been looked up since insertion, go to the high-priority LRU list
+// while its total charge stays within the pool capacity; the oldest items
+// are demoted to the newest end of the low-priority list when it does not.
+// Eviction drains the low-priority list before touching the high one.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -47,6 +61,9 @@ struct LRUHandle {
     size_t charge; // TODO(opt): Only allow uint32_t?
     size_t key_length;
     bool in_cache;    // Whether entry is in the cache.
+    bool high_pri;    // Whether entry was inserted with high priority.
+    bool hit;         // Whether entry was looked up since insertion.
+    bool in_high_pri_pool; // Whether entry is on the high-priority LRU list.
     uint32_t refs;    // References, including cache reference, if present.
     uint32_t hash;    // Hash of key(); used for fast sharding and comparisons
     char key_data[1]; // Beginning of key
@@ -153,12 +170,17 @@ class LRUCache {
     ~LRUCache();
 
     // Separate from constructor so caller can easily make an array of LRUCache
-    void SetCapacity(size_t capacity) { capacity_ = capacity; }
+    void SetCapacity(size_t capacity, double high_pri_pool_ratio) {
+        capacity_ = capacity;
+        high_pri_pool_capacity_ =
+            static_cast<size_t>(capacity * high_pri_pool_ratio);
+    }
 
     // Like Cache methods, but with an extra "hash" parameter.
     Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
                           size_t charge,
-                          void (*deleter)(const Slice& key, void* value));
+                          void (*deleter)(const Slice& key, void* value),
+                          Cache::Priority priority);
     Cache::Handle* Lookup(const Slice& key, uint32_t hash);
     void Release(Cache::Handle* handle);
     void Erase(const Slice& key, uint32_t hash);
@@ -171,22 +193,33 @@ class LRUCache {
   private:
     void LRU_Remove(LRUHandle* e);
     void LRU_Append(LRUHandle* list, LRUHandle* e);
+    void LRU_Insert(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    void MaintainPoolSize() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    LRUHandle* OldestUnused() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
     void Ref(LRUHandle* e);
     void Unref(LRUHandle* e);
     bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
     // Initialized before use.
     size_t capacity_;
+    size_t high_pri_pool_capacity_;
 
     // mutex_ protects the following state.
     mutable port::Mutex mutex_;
     size_t usage_ GUARDED_BY(mutex_);
 
+    // Total charge of the entries on high_pri_lru_.
+    size_t high_pri_pool_usage_ GUARDED_BY(mutex_);
+
     // Dummy head of LRU list.
     // lru.prev is newest entry, lru.next is oldest entry.
     // Entries have refs==1 and in_cache==true.
     LRUHandle lru_ GUARDED_BY(mutex_);
 
+    // Dummy head of the high-priority LRU list.  Same ordering and
+    // invariants as lru_; always empty when high_pri_pool_capacity_ == 0.
+    LRUHandle high_pri_lru_ GUARDED_BY(mutex_);
+
     // Dummy head of in-use list.
     // Entries are in use by clients, and have refs >= 2 and in_cache==true.
     LRUHandle in_use_ GUARDED_BY(mutex_);
@@ -194,10 +227,14 @@ class LRUCache {
     HandleTable table_ GUARDED_BY(mutex_);
 };
 
-LRUCache::LRUCache() : capacity_(0), usage_(0) {
+LRUCache::LRUCache()
+    : capacity_(0), high_pri_pool_capacity_(0), usage_(0),
+      high_pri_pool_usage_(0) {
     // Make empty circular linked lists.
     lru_.next = &lru_;
     lru_.prev = &lru_;
+    high_pri_lru_.next = &high_pri_lru_;
+    high_pri_lru_.prev = &high_pri_lru_;
     in_use_.next = &in_use_;
     in_use_.prev = &in_use_;
 }
@@ -205,13 +242,13 @@ LRUCache::LRUCache() : capacity_(0), usage_(0) {
 LRUCache::~LRUCache() {
     assert(in_use_.next ==
            &in_use_); // Error if caller has an unreleased handle
-    for (LRUHandle* e = lru_.next; e != &lru_;) {
-        LRUHandle* next = e->next;
+    LRUHandle* e;
+    while ((e = OldestUnused()) != nullptr) {
+        LRU_Remove(e);
         assert(e->in_cache);
         e->in_cache = false;
         assert(e->refs == 1); // Invariant of lru_ list.
         Unref(e);
-        e = next;
     }
 }
 
@@ -233,13 +270,18 @@ void LRUCache::Unref(LRUHandle* e) {
     } else if (e->in_cache && e->refs == 1) {
         // No longer in use; move to lru_ list.
         LRU_Remove(e);
-        LRU_Append(&lru_, e);
+        LRU_Insert(e);
     }
 }
 
 void LRUCache::LRU_Remove(LRUHandle* e) {
     e->next->prev = e->prev;
     e->prev->next = e->next;
+    if (e->in_high_pri_pool) {
+        assert(high_pri_pool_usage_ >= e->charge);
+        high_pri_pool_usage_ -= e->charge;
+        e->in_high_pri_pool = false;
+    }
 }
 
 void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
@@ -250,11 +292,43 @@ void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
     e->next->prev = e;
 }
 
+void LRUCache::LRU_Insert(LRUHandle* e) {
+    if (high_pri_pool_capacity_ > 0 && (e->high_pri || e->hit)) {
+        LRU_Append(&high_pri_lru_, e);
+        e->in_high_pri_pool = true;
+        high_pri_pool_usage_ += e->charge;
+        MaintainPoolSize();
+    } else {
+        LRU_Append(&lru_, e);
+    }
+}
+
+void LRUCache::MaintainPoolSize() {
+    while (high_pri_pool_usage_ > high_pri_pool_capacity_) {
+        // The pool is non-empty since its usage is positive.
+        LRUHandle* e = high_pri_lru_.next;
+        assert(e != &high_pri_lru_);
+        LRU_Remove(e);
+        LRU_Append(&lru_, e);
+    }
+}
+
+LRUHandle* LRUCache::OldestUnused() {
+    if (lru_.next != &lru_) {
+        return lru_.next;
+    }
+    if (high_pri_lru_.next != &high_pri_lru_) {
+        return high_pri_lru_.next;
+    }
+    return nullptr;
+}
+
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
     MutexLock l(&mutex_);
     LRUHandle* e = table_.Lookup(key, hash);
     if (e != nullptr) {
         Ref(e);
+        e->hit = true;
     }
     return reinterpret_cast<Cache::Handle*>(e);
 }
@@ -266,7 +340,8 @@ void LRUCache::Release(Cache::Handle* handle) {
 
 Cache::Handle*
 LRUCache::Insert(const Slice& key, uint32_t hash, void* value, size_t charge,
-                 void (*deleter)(const Slice& key, void* value)) {
+                 void (*deleter)(const Slice& key, void* value),
+                 Cache::Priority priority) {
     MutexLock l(&mutex_);
 
     LRUHandle* e = reinterpret_cast<LRUHandle*>(
@@ -277,6 +352,9 @@ LRUCache::Insert(const Slice& key, uint32_t hash, void* value, size_t charge,
     e->key_length = key.size();
     e->hash = hash;
     e->in_cache = false;
+    e->high_pri = (priority == Cache::Priority::kHigh);
+    e->hit = false;
+    e->in_high_pri_pool = false;
     e->refs = 1; // for the returned handle.
     std::memcpy(e->key_data, key.data(), key.size());
 
@@ -290,8 +368,8 @@ LRUCache::Insert(const Slice& key, uint32_t hash, void* value, size_t charge,
         // next is read by key() in an assert, so it must be initialized
         e->next = nullptr;
     }
-    while (usage_ > capacity_ && lru_.next != &lru_) {
-        LRUHandle* old = lru_.next;
+    LRUHandle* old;
+    while (usage_ > capacity_ && (old = OldestUnused()) != nullptr) {
         assert(old->refs == 1);
         bool erased = FinishErase(table_.Remove(old->key(), old->hash));
         if (!erased) { // to avoid unused variable when compiled NDEBUG
@@ -322,8 +400,8 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
 
 void LRUCache::Prune() {
     MutexLock l(&mutex_);
-    while (lru_.next != &lru_) {
-        LRUHandle* e = lru_.next;
+    LRUHandle* e;
+    while ((e = OldestUnused()) != nullptr) {
         assert(e->refs == 1);
         bool erased = FinishErase(table_.Remove(e->key(), e->hash));
         if (!erased) { // to avoid unused variable when compiled NDEBUG
@@ -332,12 +410,10 @@ void LRUCache::Prune() {
     }
 }
 
-static const int kNumShardBits = 4;
-static const int kNumShards = 1 << kNumShardBits;
-
 class ShardedLRUCache : public Cache {
   private:
-    LRUCache shard_[kNumShards];
+    const int num_shard_bits_;
+    LRUCache* shard_;
     port::Mutex id_mutex_;
     uint64_t last_id_;
 
@@ -345,22 +421,32 @@ class ShardedLRUCache : public Cache {
         return Hash(s.data(), s.size(), 0);
     }
 
-    static uint32_t Shard(uint32_t hash) {
-        return hash >> (32 - kNumShardBits);
+    uint32_t Shard(uint32_t hash) const {
+        return num_shard_bits_ > 0 ? hash >> (32 - num_shard_bits_) : 0;
     }
 
   public:
-    explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
-        const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
-        for (int s = 0; s < kNumShards; s++) {
-            shard_[s].SetCapacity(per_shard);
+    ShardedLRUCache(size_t capacity, double high_pri_pool_ratio,
+                    int num_shard_bits)
+        : num_shard_bits_(num_shard_bits), last_id_(0) {
+        const int num_shards = 1 << num_shard_bits;
+        const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+        shard_ = new LRUCache[num_shards];
+        for (int s = 0; s < num_shards; s++) {
+            shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
         }
     }
-    ~ShardedLRUCache() override {}
+    ~ShardedLRUCache() override { delete[] shard_; }
     Handle* Insert(const Slice& key, void* value, size_t charge,
                    void (*deleter)(const Slice& key, void* value)) override {
+        return Insert(key, value, charge, deleter, Priority::kLow);
+    }
+    Handle* Insert(const Slice& key, void* value, size_t charge,
+                   void (*deleter)(const Slice& key, void* value),
+                   Priority priority) override {
         const uint32_t hash = HashSlice(key);
-        return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+        return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                          priority);
     }
     Handle* Lookup(const Slice& key) override {
         const uint32_t hash = HashSlice(key);
@@ -382,13 +468,13 @@ class ShardedLRUCache : public Cache {
         return ++(last_id_);
     }
     void Prune() override {
-        for (int s = 0; s < kNumShards; s++) {
+        for (int s = 0; s < (1 << num_shard_bits_); s++) {
             shard_[s].Prune();
         }
     }
     size_t TotalCharge() const override {
         size_t total = 0;
-        for (int s = 0; s < kNumShards; s++) {
+        for (int s = 0; s < (1 << num_shard_bits_); s++) {
             total += shard_[s].TotalCharge();
         }
         return total;
@@ -397,6 +483,19 @@ class ShardedLRUCache : public Cache {
 
 } // end anonymous namespace
 
-Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio,
+                   int num_shard_bits) {
+    if (high_pri_pool_ratio < 0.0) {
+        high_pri_pool_ratio = 0.0;
+    } else if (high_pri_pool_ratio > 1.0) {
+        high_pri_pool_ratio = 1.0;
+    }
+    if (num_shard_bits < 0) {
+        num_shard_bits = 0;
+    } else if (num_shard_bits > 20) {
+        num_shard_bits = 20;
+    }
+    return new ShardedLRUCache(capacity, high_pri_pool_ratio, num_shard_bits);
+}
 
 } // namespace mydb
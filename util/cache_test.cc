@@ -2,9 +2,12 @@
 
 #include "mydb/cache.h"
 
+#include <atomic>
 #include <vector>
 
+#include "mydb/env.h"
 #include "util/coding.h"
+#include "util/random.h"
 
 #include "gtest/gtest.h"
 
@@ -23,7 +26,9 @@ static int DecodeKey(const Slice& k) {
 static void* EncodeValue(uintptr_t v) { return reinterpret_cast<void*>(v); }
 static int DecodeValue(void* v) { return reinterpret_cast<uintptr_t>(v); }
 
-class CacheTest : public testing::Test {
+enum class CacheType { kLRU, kClock };
+
+class CacheTest : public testing::TestWithParam<CacheType> {
   public:
     static void Deleter(const Slice& key, void* v) {
         current_->deleted_keys_.push_back(DecodeKey(key));
@@ -35,7 +40,7 @@ class CacheTest : public testing::Test {
     std::vector<int> deleted_values_;
     Cache* cache_;
 
-    CacheTest() : cache_(NewLRUCache(kCacheSize)) { current_ = this; }
+    CacheTest() : cache_(NewCache(kCacheSize)) { current_ = this; }
 
     ~CacheTest() { delete cache_; }
 
@@ -54,17 +59,31 @@ class CacheTest : public testing::Test {
                                        charge, &CacheTest::Deleter));
     }
 
+    void InsertHighPri(int key, int value, int charge = 1) {
+        cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value),
+                                       charge, &CacheTest::Deleter,
+                                       Cache::Priority::kHigh));
+    }
+
     Cache::Handle* InsertAndReturnHandle(int key, int value, int charge = 1) {
         return cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
                               &CacheTest::Deleter);
     }
 
     void Erase(int key) { cache_->Erase(EncodeKey(key)); }
+
+    static Cache* NewCache(size_t capacity) {
+        if (GetParam() == CacheType::kClock) {
+            return NewClockCache(capacity, -1, 1);
+        }
+        return NewLRUCache(capacity);
+    }
+
     static CacheTest* current_;
 };
 CacheTest* CacheTest::current_;
 
-TEST_F(CacheTest, HitAndMiss) {
+TEST_P(CacheTest, HitAndMiss) {
     ASSERT_EQ(-1, Lookup(100));
 
     Insert(100, 101);
@@ -87,7 +106,7 @@ TEST_F(CacheTest, HitAndMiss) {
     ASSERT_EQ(101, deleted_values_[0]);
 }
 
-TEST_F(CacheTest, Erase) {
+TEST_P(CacheTest, Erase) {
     Erase(200);
     ASSERT_EQ(0, deleted_keys_.size());
 
@@ -106,7 +125,7 @@ TEST_F(CacheTest, Erase) {
     ASSERT_EQ(1, deleted_keys_.size());
 }
 
-TEST_F(CacheTest, EntriesArePinned) {
+TEST_P(CacheTest, EntriesArePinned) {
     Insert(100, 101);
     Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
     ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
@@ -131,7 +150,7 @@ TEST_F(CacheTest, EntriesArePinned) {
     ASSERT_EQ(102, deleted_values_[1]);
 }
 
-TEST_F(CacheTest, EvictionPolicy) {
+TEST_P(CacheTest, EvictionPolicy) {
     Insert(100, 101);
     Insert(200, 201);
     Insert(300, 301);
@@ -150,7 +169,7 @@ TEST_F(CacheTest, EvictionPolicy) {
     cache_->Release(h);
 }
 
-TEST_F(CacheTest, UseExceedsCacheSize) {
+TEST_P(CacheTest, UseExceedsCacheSize) {
     // Overfill the cache, keeping handles on all inserted entries.
     std::vector<Cache::Handle*> h;
     for (int i = 0; i < kCacheSize + 100; i++) {
@@ -167,7 +186,7 @@ TEST_F(CacheTest, UseExceedsCacheSize) {
     }
 }
 
-TEST_F(CacheTest, HeavyEntries) {
+TEST_P(CacheTest, HeavyEntries) {
     // Add a bunch of light and heavy entries and then count the combined
     // size of items still in the cache, which must be approximately the
     // same as the total capacity.
@@ -194,13 +213,13 @@ TEST_F(CacheTest, HeavyEntries) {
     ASSERT_LE(cached_weight, kCacheSize + kCacheSize / 10);
 }
 
-TEST_F(CacheTest, NewId) {
+TEST_P(CacheTest, NewId) {
     uint64_t a = cache_->NewId();
     uint64_t b = cache_->NewId();
     ASSERT_NE(a, b);
 }
 
-TEST_F(CacheTest, Prune) {
+TEST_P(CacheTest, Prune) {
     Insert(1, 100);
     Insert(2, 200);
 
@@ -213,12 +232,165 @@ TEST_F(CacheTest, Prune) {
     ASSERT_EQ(-1, Lookup(2));
 }
 
-TEST_F(CacheTest, ZeroSizeCache) {
+TEST_P(CacheTest, HighPriorityEntriesOutliveLowPriority) {
+    if (GetParam() != CacheType::kLRU) {
+        GTEST_SKIP() << "LRU only";
+    }
+    delete cache_;
+    cache_ = NewLRUCache(kCacheSize, 0.5);
+
+    InsertHighPri(100, 101);
+    Insert(200, 201);
+    for (int i = 0; i < kCacheSize + 100; i++) {
+        Insert(1000 + i, 2000 + i);
+    }
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST_P(CacheTest, HitEntriesArePromoted) {
+    if (GetParam() != CacheType::kLRU) {
+        GTEST_SKIP() << "LRU only";
+    }
     delete cache_;
-    cache_ = NewLRUCache(0);
+    cache_ = NewLRUCache(kCacheSize, 0.5);
+
+    Insert(100, 101);
+    Insert(200, 201);
+    ASSERT_EQ(101, Lookup(100));
+    for (int i = 0; i < kCacheSize + 100; i++) {
+        Insert(1000 + i, 2000 + i);
+    }
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST_P(CacheTest, HighPriorityPoolIsBounded) {
+    if (GetParam() != CacheType::kLRU) {
+        GTEST_SKIP() << "LRU only";
+    }
+    delete cache_;
+    cache_ = NewLRUCache(kCacheSize, 0.5);
+
+    // Fill the whole cache with high priority entries; those that do not
+    // fit in the pool are demoted and then evicted by low priority ones.
+    for (int i = 0; i < kCacheSize; i++) {
+        InsertHighPri(i, 1000 + i);
+    }
+    for (int i = 0; i < kCacheSize + 100; i++) {
+        Insert(10000 + i, 20000 + i);
+    }
+    int survivors = 0;
+    for (int i = 0; i < kCacheSize; i++) {
+        if (Lookup(i) >= 0) {
+            survivors++;
+        }
+    }
+    ASSERT_LE(survivors, kCacheSize / 2);
+    ASSERT_GE(survivors, kCacheSize / 3);
+    ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize / 10);
+}
+
+TEST_P(CacheTest, ZeroSizeCache) {
+    delete cache_;
+    cache_ = NewCache(0);
 
     Insert(1, 100);
     ASSERT_EQ(-1, Lookup(1));
 }
 
+TEST_P(CacheTest, ClockHighPriorityEntriesOutliveLowPriority) {
+    if (GetParam() != CacheType::kClock) {
+        GTEST_SKIP() << "CLOCK only";
+    }
+    for (int i = 0; i < 100; i++) {
+        InsertHighPri(i, 1000 + i);
+        Insert(100 + i, 1100 + i);
+    }
+    for (int i = 0; i < kCacheSize; i++) {
+        Insert(10000 + i, 20000 + i);
+    }
+    int high_survivors = 0;
+    int low_survivors = 0;
+    for (int i = 0; i < 100; i++) {
+        high_survivors += Lookup(i) >= 0;
+        low_survivors += Lookup(100 + i) >= 0;
+    }
+    ASSERT_GT(high_survivors, low_survivors);
+}
+
+// Many threads looking up keys from a skewed distribution, and inserting
+// the ones they miss.
+struct ConcurrentState {
+    Cache* cache;
+    int ops_per_thread;
+    std::atomic<int> done;
+    std::atomic<int> hits;
+};
+
+struct ConcurrentThread {
+    ConcurrentState* state;
+    int id;
+};
+
+static void DeleteNothing(const Slice& key, void* value) {}
+
+static void ConcurrentThreadBody(void* arg) {
+    ConcurrentThread* t = reinterpret_cast<ConcurrentThread*>(arg);
+    ConcurrentState* state = t->state;
+    Random rnd(1000 + t->id);
+    int hits = 0;
+    for (int i = 0; i < state->ops_per_thread; i++) {
+        const std::string key = EncodeKey(rnd.Skewed(12));
+        Cache::Handle* h = state->cache->Lookup(key);
+        if (h != nullptr) {
+            hits++;
+        } else {
+            h = state->cache->Insert(key, EncodeValue(i), 1, &DeleteNothing);
+        }
+        state->cache->Release(h);
+    }
+    state->hits.fetch_add(hits, std::memory_order_relaxed);
+    state->done.fetch_add(1, std::memory_order_release);
+}
+
+TEST_P(CacheTest, ConcurrentHitRate) {
+    const int kNumThreads = 8;
+    Env* env = Env::Default();
+    for (int shard_bits : {0, 4}) {
+        delete cache_;
+        cache_ = GetParam() == CacheType::kClock
+                     ? NewClockCache(kCacheSize, shard_bits, 1)
+                     : NewLRUCache(kCacheSize, 0.0, shard_bits);
+
+        ConcurrentState state;
+        state.cache = cache_;
+        state.ops_per_thread = 100000;
+        state.done.store(0, std::memory_order_relaxed);
+        state.hits.store(0, std::memory_order_relaxed);
+        ConcurrentThread threads[kNumThreads];
+        for (int id = 0; id < kNumThreads; id++) {
+            threads[id].state = &state;
+            threads[id].id = id;
+            env->StartThread(ConcurrentThreadBody, &threads[id]);
+        }
+        while (state.done.load(std::memory_order_acquire) < kNumThreads) {
+            env->SleepForMicroseconds(1000);
+        }
+
+        // Most lookups hit, with one shard as with many, and the cache
+        // stays close to its capacity.
+        const int total = kNumThreads * state.ops_per_thread;
+        const double hit_rate =
+            static_cast<double>(state.hits.load(std::memory_order_relaxed)) /
+            total;
+        ASSERT_GT(hit_rate, 0.5);
+        ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize / 10);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(LRU, CacheTest, testing::Values(CacheType::kLRU));
+INSTANTIATE_TEST_SUITE_P(Clock, CacheTest,
+                         testing::Values(CacheType::kClock));
+
 } // namespace mydb
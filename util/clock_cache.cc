@@ -0,0 +1,488 @@
+
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "mydb/cache.h"
+
+#include "util/hash.h"
+
+namespace mydb {
+
+namespace {
+
+// CLOCK cache implementation
+//
+// Each shard is a fixed-size open-addressing hash table of ClockHandle
+// slots.  All of the mutable state of a slot is packed into one atomic
+// word ("meta"), so Lookup() and Release() never take a lock: a hit is a
+// single compare-and-swap that takes a reference and resets the clock
+// countdown, and a release is a single atomic decrement.  The word also
+// carries some bits of the entry's hash so that probing rarely touches
+// entries for other keys.
+//
+// A slot moves through the following states:
+// - empty:         meta == 0.  Free for Insert() to claim.
+// - construction:  owned by exactly one thread that is filling it in or
+//                  tearing it down.  Nobody else reads the payload.
+// - visible:       in the cache; Lookup() may take references.
+// - invisible:     erased or replaced, but still referenced by clients.
+//                  The last Release() tears it down.
+// References can only be taken in the visible state, and only the thread
+// that moves a slot into construction (from visible or invisible with no
+// references) may free it, so a slot is never freed while referenced.
+//
+// Eviction is a CLOCK sweep: a shared hand walks the table, decrementing
+// the countdown of unreferenced visible entries and evicting those whose
+// countdown is already zero.  Hits reset the countdown to its maximum.
+//
+// Probing uses double hashing.  Every slot counts the entries whose probe
+// sequence passes over it ("displacements"), so a lookup can stop at the
+// first slot with no displacements instead of scanning the whole table.
+
+static const uint64_t kRefMask = (uint64_t{1} << 30) - 1;
+static const int kClockShift = 30;
+static const uint64_t kMaxClock = 3;
+static const uint64_t kClockMask = kMaxClock << kClockShift;
+static const int kStateShift = 32;
+static const uint64_t kStateMask = uint64_t{3} << kStateShift;
+static const int kTagShift = 34;
+static const uint64_t kTagMask = ~uint64_t{0} << kTagShift;
+
+static const uint64_t kStateEmpty = 0;
+static const uint64_t kStateConstruction = 1;
+static const uint64_t kStateVisible = 2;
+static const uint64_t kStateInvisible = 3;
+
+static inline uint64_t Refs(uint64_t meta) { return meta & kRefMask; }
+static inline uint64_t Clock(uint64_t meta) {
+    return (meta & kClockMask) >> kClockShift;
+}
+static inline uint64_t State(uint64_t meta) {
+    return (meta & kStateMask) >> kStateShift;
+}
+static inline uint64_t Tag(uint32_t hash) {
+    return static_cast<uint64_t>(hash) << kTagShift;
+}
+
+struct ClockHandle {
+    // Packed slot state:
+    //   bits  0..29: references held by clients
+    //   bits 30..31: clock countdown
+    //   bits 32..33: slot state
+    //   bits 34..63: low bits of the hash, if visible or invisible
+    std::atomic<uint64_t> meta;
+
+    // Number of entries whose probe sequence passes over this slot.
+    std::atomic<uint32_t> displacements;
+
+    // The fields below are written in the construction state and are
+    // read-only while the slot is visible or invisible.
+    uint32_t hash;
+    uint32_t probe_increment;
+    bool detached; // Not part of a table; freed by the last Release()
+    size_t charge;
+    void* value;
+    void (*deleter)(const Slice&, void* value);
+    char* key_data;
+    size_t key_length;
+
+    Slice key() const { return Slice(key_data, key_length); }
+};
+
+// A single shard of sharded cache.
+class ClockCacheShard {
+  public:
+    ClockCacheShard();
+    ~ClockCacheShard();
+
+    // Separate from constructor so caller can easily make an array of shards
+    void Init(size_t capacity, size_t estimated_entry_charge);
+
+    // Like Cache methods, but with an extra "hash" parameter.
+    Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
+                          size_t charge,
+                          void (*deleter)(const Slice& key, void* value),
+                          Cache::Priority priority);
+    Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+    void Release(ClockHandle* h);
+    void Erase(const Slice& key, uint32_t hash);
+    void Prune();
+    size_t TotalCharge() const {
+        return usage_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static uint32_t ProbeIncrement(const Slice& key) {
+        // Odd, so that the probe sequence visits every slot.
+        return Hash(key.data(), key.size(), 0x9e3779b9) | 1;
+    }
+
+    bool Acquire(ClockHandle* h, uint32_t hash, bool touch);
+    bool MarkInvisible(ClockHandle* h);
+    void EraseMatching(const Slice& key, uint32_t hash,
+                       const ClockHandle* keep);
+    void EvictFor(size_t charge);
+    void Free(ClockHandle* h);
+
+    // Initialized before use.
+    size_t capacity_;
+    size_t length_; // Number of slots; a power of two
+    size_t occupancy_limit_;
+    ClockHandle* table_;
+
+    std::atomic<size_t> usage_;
+    std::atomic<size_t> occupancy_; // Slots that are not empty
+    std::atomic<uint64_t> clock_hand_;
+};
+
+ClockCacheShard::ClockCacheShard()
+    : capacity_(0), length_(0), occupancy_limit_(0), table_(nullptr),
+      usage_(0), occupancy_(0), clock_hand_(0) {}
+
+ClockCacheShard::~ClockCacheShard() {
+    for (size_t i = 0; i < length_; i++) {
+        ClockHandle* h = &table_[i];
+        const uint64_t meta = h->meta.load(std::memory_order_relaxed);
+        // Error if caller has an unreleased handle
+        assert(Refs(meta) == 0);
+        if (State(meta) == kStateVisible) {
+            (*h->deleter)(h->key(), h->value);
+            delete[] h->key_data;
+        }
+    }
+    delete[] table_;
+}
+
+void ClockCacheShard::Init(size_t capacity, size_t estimated_entry_charge) {
+    capacity_ = capacity;
+    // Aim for a load factor of about 0.7 when the cache is full of
+    // entries of the estimated size.
+    const size_t entries = capacity / estimated_entry_charge;
+    const size_t target = entries + entries * 3 / 7;
+    length_ = 16;
+    while (length_ < target) {
+        length_ *= 2;
+    }
+    occupancy_limit_ = length_ - length_ / 8;
+    table_ = new ClockHandle[length_];
+    for (size_t i = 0; i < length_; i++) {
+        table_[i].meta.store(0, std::memory_order_relaxed);
+        table_[i].displacements.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Take a reference on "h" if it is visible and may hold an entry with
+// the given hash.  If "touch" is set, also mark the entry as recently used.
+bool ClockCacheShard::Acquire(ClockHandle* h, uint32_t hash, bool touch) {
+    uint64_t meta = h->meta.load(std::memory_order_acquire);
+    while (State(meta) == kStateVisible && (meta & kTagMask) == Tag(hash)) {
+        uint64_t desired = meta + 1;
+        if (touch) {
+            desired = (desired & ~kClockMask) | (kMaxClock << kClockShift);
+        }
+        if (h->meta.compare_exchange_weak(meta, desired,
+                                          std::memory_order_acq_rel)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ClockCacheShard::Release(ClockHandle* h) {
+    const uint64_t old = h->meta.fetch_sub(1, std::memory_order_acq_rel);
+    assert(Refs(old) > 0);
+    if (Refs(old) == 1 && State(old) == kStateInvisible) {
+        uint64_t expected = old - 1;
+        if (h->meta.compare_exchange_strong(
+                expected, kStateConstruction << kStateShift,
+                std::memory_order_acq_rel)) {
+            Free(h);
+        }
+    }
+}
+
+// Remove a visible entry from the cache.  It is freed once the last
+// reference to it has been released.
+bool ClockCacheShard::MarkInvisible(ClockHandle* h) {
+    uint64_t meta = h->meta.load(std::memory_order_acquire);
+    while (State(meta) == kStateVisible) {
+        const uint64_t desired =
+            (meta & ~kStateMask) | (kStateInvisible << kStateShift);
+        if (h->meta.compare_exchange_weak(meta, desired,
+                                          std::memory_order_acq_rel)) {
+            usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Tear down *h, which the caller has moved into the construction state.
+void ClockCacheShard::Free(ClockHandle* h) {
+    (*h->deleter)(h->key(), h->value);
+    delete[] h->key_data;
+    if (h->detached) {
+        delete h;
+        return;
+    }
+    // Undo the displacements recorded when the entry was inserted.
+    const size_t mask = length_ - 1;
+    for (size_t index = h->hash & mask; &table_[index] != h;
+         index = (index + h->probe_increment) & mask) {
+        table_[index].displacements.fetch_sub(1, std::memory_order_relaxed);
+    }
+    occupancy_.fetch_sub(1, std::memory_order_relaxed);
+    h->meta.store(0, std::memory_order_release);
+}
+
+Cache::Handle* ClockCacheShard::Lookup(const Slice& key, uint32_t hash) {
+    const uint32_t increment = ProbeIncrement(key);
+    const size_t mask = length_ - 1;
+    size_t index = hash & mask;
+    for (size_t probes = 0; probes < length_; probes++) {
+        ClockHandle* h = &table_[index];
+        if (Acquire(h, hash, true)) {
+            if (h->hash == hash && h->key() == key) {
+                return reinterpret_cast<Cache::Handle*>(h);
+            }
+            Release(h);
+        }
+        if (h->displacements.load(std::memory_order_acquire) == 0) {
+            break;
+        }
+        index = (index + increment) & mask;
+    }
+    return nullptr;
+}
+
+// Erase every visible entry for "key" other than "keep".  Racing inserts
+// of the same key may leave more than one behind.
+void ClockCacheShard::EraseMatching(const Slice& key, uint32_t hash,
+                                    const ClockHandle* keep) {
+    const uint32_t increment = ProbeIncrement(key);
+    const size_t mask = length_ - 1;
+    size_t index = hash & mask;
+    for (size_t probes = 0; probes < length_; probes++) {
+        ClockHandle* h = &table_[index];
+        if (h != keep && Acquire(h, hash, false)) {
+            if (h->hash == hash && h->key() == key) {
+                MarkInvisible(h);
+            }
+            Release(h);
+        }
+        if (h->displacements.load(std::memory_order_acquire) == 0) {
+            break;
+        }
+        index = (index + increment) & mask;
+    }
+}
+
+void ClockCacheShard::Erase(const Slice& key, uint32_t hash) {
+    EraseMatching(key, hash, nullptr);
+}
+
+void ClockCacheShard::EvictFor(size_t charge) {
+    // Every countdown reaches zero within kMaxClock + 1 rounds, so give up
+    // after that: the remaining entries are all in use.
+    const size_t max_steps = length_ * (kMaxClock + 1);
+    for (size_t step = 0; step < max_steps; step++) {
+        if (usage_.load(std::memory_order_relaxed) + charge <= capacity_ &&
+            occupancy_.load(std::memory_order_relaxed) < occupancy_limit_) {
+            break;
+        }
+        ClockHandle* h =
+            &table_[clock_hand_.fetch_add(1, std::memory_order_relaxed) &
+                    (length_ - 1)];
+        uint64_t meta = h->meta.load(std::memory_order_acquire);
+        if (State(meta) != kStateVisible || Refs(meta) != 0) {
+            continue;
+        }
+        if (Clock(meta) > 0) {
+            h->meta.compare_exchange_strong(meta,
+                                            meta - (uint64_t{1} << kClockShift),
+                                            std::memory_order_acq_rel);
+        } else if (h->meta.compare_exchange_strong(
+                       meta, kStateConstruction << kStateShift,
+                       std::memory_order_acq_rel)) {
+            usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+            Free(h);
+        }
+    }
+}
+
+Cache::Handle*
+ClockCacheShard::Insert(const Slice& key, uint32_t hash, void* value,
+                        size_t charge,
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority) {
+    const uint32_t increment = ProbeIncrement(key);
+    const uint64_t countdown =
+        priority == Cache::Priority::kHigh ? kMaxClock : 1;
+    char* key_data = new char[key.size()];
+    std::memcpy(key_data, key.data(), key.size());
+
+    if (capacity_ > 0) {
+        EvictFor(charge);
+        const size_t mask = length_ - 1;
+        size_t index = hash & mask;
+        size_t probes = 0;
+        for (; probes < length_; probes++) {
+            ClockHandle* h = &table_[index];
+            uint64_t expected = 0;
+            if (h->meta.compare_exchange_strong(
+                    expected, kStateConstruction << kStateShift,
+                    std::memory_order_acq_rel)) {
+                occupancy_.fetch_add(1, std::memory_order_relaxed);
+                h->hash = hash;
+                h->probe_increment = increment;
+                h->detached = false;
+                h->charge = charge;
+                h->value = value;
+                h->deleter = deleter;
+                h->key_data = key_data;
+                h->key_length = key.size();
+                usage_.fetch_add(charge, std::memory_order_relaxed);
+                // One reference for the returned handle.
+                h->meta.store(Tag(hash) | (kStateVisible << kStateShift) |
+                                  (countdown << kClockShift) | 1,
+                              std::memory_order_release);
+                EraseMatching(key, hash, h);
+                return reinterpret_cast<Cache::Handle*>(h);
+            }
+            table_[index].displacements.fetch_add(1,
+                                                  std::memory_order_relaxed);
+            index = (index + increment) & mask;
+        }
+        // The table is full of entries in use; undo the displacements.
+        index = hash & mask;
+        for (size_t i = 0; i < probes; i++) {
+            table_[index].displacements.fetch_sub(1,
+                                                  std::memory_order_relaxed);
+            index = (index + increment) & mask;
+        }
+    }
+
+    // Don't cache; the caller holds the only reference.  (capacity_==0 is
+    // supported and turns off caching.)
+    ClockHandle* h = new ClockHandle;
+    h->hash = hash;
+    h->probe_increment = increment;
+    h->detached = true;
+    h->charge = charge;
+    h->value = value;
+    h->deleter = deleter;
+    h->key_data = key_data;
+    h->key_length = key.size();
+    h->displacements.store(0, std::memory_order_relaxed);
+    h->meta.store((kStateInvisible << kStateShift) | 1,
+                  std::memory_order_release);
+    return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCacheShard::Prune() {
+    for (size_t i = 0; i < length_; i++) {
+        ClockHandle* h = &table_[i];
+        uint64_t meta = h->meta.load(std::memory_order_acquire);
+        if (State(meta) == kStateVisible && Refs(meta) == 0 &&
+            h->meta.compare_exchange_strong(
+                meta, kStateConstruction << kStateShift,
+                std::memory_order_acq_rel)) {
+            usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+            Free(h);
+        }
+    }
+}
+
+class ClockCache : public Cache {
+  private:
+    const int num_shard_bits_;
+    ClockCacheShard* shards_;
+    std::atomic<uint64_t> last_id_;
+
+    static inline uint32_t HashSlice(const Slice& s) {
+        return Hash(s.data(), s.size(), 0);
+    }
+
+    uint32_t Shard(uint32_t hash) const {
+        return num_shard_bits_ > 0 ? hash >> (32 - num_shard_bits_) : 0;
+    }
+
+  public:
+    ClockCache(size_t capacity, int num_shard_bits,
+               size_t estimated_entry_charge)
+        : num_shard_bits_(num_shard_bits), last_id_(0) {
+        const int num_shards = 1 << num_shard_bits;
+        const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+        shards_ = new ClockCacheShard[num_shards];
+        for (int s = 0; s < num_shards; s++) {
+            shards_[s].Init(per_shard, estimated_entry_charge);
+        }
+    }
+    ~ClockCache() override { delete[] shards_; }
+    Handle* Insert(const Slice& key, void* value, size_t charge,
+                   void (*deleter)(const Slice& key, void* value)) override {
+        return Insert(key, value, charge, deleter, Priority::kLow);
+    }
+    Handle* Insert(const Slice& key, void* value, size_t charge,
+                   void (*deleter)(const Slice& key, void* value),
+                   Priority priority) override {
+        const uint32_t hash = HashSlice(key);
+        return shards_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                           priority);
+    }
+    Handle* Lookup(const Slice& key) override {
+        const uint32_t hash = HashSlice(key);
+        return shards_[Shard(hash)].Lookup(key, hash);
+    }
+    void Release(Handle* handle) override {
+        ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+        shards_[Shard(h->hash)].Release(h);
+    }
+    void Erase(const Slice& key) override {
+        const uint32_t hash = HashSlice(key);
+        shards_[Shard(hash)].Erase(key, hash);
+    }
+    void* Value(Handle* handle) override {
+        return reinterpret_cast<ClockHandle*>(handle)->value;
+    }
+    uint64_t NewId() override {
+        return last_id_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    void Prune() override {
+        for (int s = 0; s < (1 << num_shard_bits_); s++) {
+            shards_[s].Prune();
+        }
+    }
+    size_t TotalCharge() const override {
+        size_t total = 0;
+        for (int s = 0; s < (1 << num_shard_bits_); s++) {
+            total += shards_[s].TotalCharge();
+        }
+        return total;
+    }
+};
+
+} // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity, int num_shard_bits,
+                     size_t estimated_entry_charge) {
+    if (num_shard_bits < 0) {
+        // Keep shards at 512KB or more, and use at most 64 of them.
+        num_shard_bits = 0;
+        while (num_shard_bits < 6 &&
+               (capacity >> (num_shard_bits + 1)) >= 512 * 1024) {
+            num_shard_bits++;
+        }
+    } else if (num_shard_bits > 20) {
+        num_shard_bits = 20;
+    }
+    if (estimated_entry_charge == 0) {
+        estimated_entry_charge = 1;
+    }
+    return new ClockCache(capacity, num_shard_bits, estimated_entry_charge);
+}
+
+} // namespace mydb
@@ -0,0 +1,44 @@
+
+
+#include "mydb/compaction_filter.h"
+
+#include "mydb/env.h"
+#include "mydb/slice.h"
+
+#include "util/coding.h"
+
+namespace mydb {
+
+CompactionFilter::~CompactionFilter() {}
+
+namespace {
+
+class TTLCompactionFilter : public CompactionFilter {
+  public:
+    explicit TTLCompactionFilter(Env* env) : env_(env) {}
+
+    const char* Name() const override { return "mydb.TTLCompactionFilter"; }
+
+    Decision Filter(int level, const Slice& key, const Slice& existing_value,
+                    std::string* new_value) const override {
+        if (existing_value.size() < 8) {
+            return kKeep;
+        }
+        const uint64_t expiry = DecodeFixed64(existing_value.data());
+        if (expiry != 0 && expiry <= env_->NowMicros() / 1000000) {
+            return kRemove;
+        }
+        return kKeep;
+    }
+
+  private:
+    Env* const env_;
+};
+
+} // namespace
+
+const CompactionFilter* NewTTLCompactionFilter(Env* env) {
+    return new TTLCompactionFilter(env);
+}
+
+} // namespace mydb
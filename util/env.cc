@@ -20,6 +20,25 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
     return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::NewDirectRandomAccessFile(const std::string& fname,
+                                      RandomAccessFile** result) {
+    return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewDirectWritableFile(const std::string& fname,
+                                  WritableFile** result) {
+    return NewWritableFile(fname, result);
+}
+
+Status Env::NewMmapRandomAccessFile(const std::string& fname,
+                                    RandomAccessFile** result) {
+    return NewRandomAccessFile(fname, result);
+}
+
+Status Env::LinkFile(const std::string& src, const std::string& target) {
+    return Status::NotSupported("LinkFile", src);
+}
+
 Status Env::RemoveDir(const std::string& dirname) { return DeleteDir(dirname); }
 Status Env::DeleteDir(const std::string& dirname) { return RemoveDir(dirname); }
 
@@ -30,8 +49,34 @@ SequentialFile::~SequentialFile() = default;
 
 RandomAccessFile::~RandomAccessFile() = default;
 
+Status RandomAccessFile::Prefetch(uint64_t offset, size_t n) const {
+    return Status::NotSupported("Prefetch");
+}
+
+Status RandomAccessFile::MultiRead(ReadRequest* reqs, size_t n) const {
+    Status result;
+    for (size_t i = 0; i < n; i++) {
+        ReadRequest* req = &reqs[i];
+        req->status = Read(req->offset, req->n, &req->result, req->scratch);
+        if (result.ok()) {
+            result = req->status;
+        }
+    }
+    return result;
+}
+
+void RandomAccessFile::Hint(AccessPattern pattern) const {}
+
 WritableFile::~WritableFile() = default;
 
+Status WritableFile::Allocate(uint64_t offset, uint64_t len) {
+    return Status::NotSupported("Allocate");
+}
+
+Status WritableFile::RangeSync(uint64_t offset, uint64_t len) {
+    return Status::NotSupported("RangeSync");
+}
+
 Logger::~Logger() = default;
 
 FileLock::~FileLock() = default;
@@ -101,6 +146,46 @@ Status ReadFileToString(Env* env, const std::string& fname, std::string* data) {
     return s;
 }
 
+Status CopyFile(Env* env, const std::string& src, const std::string& dst) {
+    SequentialFile* in;
+    Status s = env->NewSequentialFile(src, &in);
+    if (!s.ok()) {
+        return s;
+    }
+    WritableFile* out;
+    s = env->NewWritableFile(dst, &out);
+    if (!s.ok()) {
+        delete in;
+        return s;
+    }
+    static const int kBufferSize = 1 << 20;
+    char* space = new char[kBufferSize];
+    while (true) {
+        Slice fragment;
+        s = in->Read(kBufferSize, &fragment, space);
+        if (!s.ok() || fragment.empty()) {
+            break;
+        }
+        s = out->Append(fragment);
+        if (!s.ok()) {
+            break;
+        }
+    }
+    delete[] space;
+    delete in;
+    if (s.ok()) {
+        s = out->Sync();
+    }
+    if (s.ok()) {
+        s = out->Close();
+    }
+    delete out;
+    if (!s.ok()) {
+        env->RemoveFile(dst);
+    }
+    return s;
+}
+
 EnvWrapper::~EnvWrapper() {}
 
 } // namespace mydb
@@ -6,6 +6,7 @@
 #ifndef __Fuchsia__
 #include <sys/resource.h>
 #endif
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -32,6 +33,7 @@
 #include "port/port.h"
 #include "port/thread_annotations.h"
 #include "util/env_posix_test_helper.h"
+#include "util/mutexlock.h"
 #include "util/posix_logger.h"
 
 namespace mydb {
@@ -56,6 +58,13 @@ constexpr const int kOpenBaseFlags = 0;
 
 constexpr const size_t kWritableFileBufferSize = 65536;
 
+// Files opened with O_DIRECT are read and written in whole blocks of this
+// size, from memory aligned to it.
+constexpr const size_t kDirectIOAlignment = 4096;
+
+// Every write of a direct file goes to the device, so it is buffered more.
+constexpr const size_t kDirectWritableFileBufferSize = 1024 * 1024;
+
 Status PosixError(const std::string& context, int error_number) {
     if (error_number == ENOENT) {
         return Status::NotFound(context, std::strerror(error_number));
@@ -64,6 +73,35 @@ Status PosixError(const std::string& context, int error_number) {
     }
 }
 
+// Ensures that all the caches associated with the given file descriptor's
+// data are flushed all the way to durable media, and can withstand power
+// failures.
+//
+// The path argument is only used to populate the description string in the
+// returned Status if an error occurs.
+Status SyncFd(int fd, const std::string& fd_path) {
+#if HAVE_FULLFSYNC
+    // On macOS and iOS, fsync() doesn't guarantee durability past power
+    // failures. fcntl(F_FULLFSYNC) is required for that purpose. Some
+    // filesystems don't support fcntl(F_FULLFSYNC), and require a fallback
+    // to fsync().
+    if (::fcntl(fd, F_FULLFSYNC) == 0) {
+        return Status::OK();
+    }
+#endif // HAVE_FULLFSYNC
+
+#if HAVE_FDATASYNC
+    bool sync_success = ::fdatasync(fd) == 0;
+#else
+    bool sync_success = ::fsync(fd) == 0;
+#endif // HAVE_FDATASYNC
+
+    if (sync_success) {
+        return Status::OK();
+    }
+    return PosixError(fd_path, errno);
+}
+
 // Helper class to limit resource usage to avoid exhaustion.
 // Currently used to limit read-only file descriptors and mmap file usage
 // so that we do not run out of file descriptors or virtual memory, or run into
@@ -225,6 +263,33 @@ class PosixRandomAccessFile final : public RandomAccessFile {
         return status;
     }
 
+    Status Prefetch(uint64_t offset, size_t n) const override {
+#if HAVE_POSIX_FADVISE
+        // Without a permanent descriptor there is nothing to hint on.
+        if (has_permanent_fd_) {
+            int error = ::posix_fadvise(fd_, static_cast<off_t>(offset),
+                                        static_cast<off_t>(n),
+                                        POSIX_FADV_WILLNEED);
+            if (error != 0) {
+                return PosixError(filename_, error);
+            }
+        }
+        return Status::OK();
+#else
+        return Status::NotSupported("Prefetch", filename_);
+#endif // HAVE_POSIX_FADVISE
+    }
+
+    void Hint(AccessPattern pattern) const override {
+#if HAVE_POSIX_FADVISE
+        if (has_permanent_fd_) {
+            static const int kAdvice[] = {POSIX_FADV_NORMAL, POSIX_FADV_RANDOM,
+                                          POSIX_FADV_SEQUENTIAL};
+            ::posix_fadvise(fd_, 0, 0, kAdvice[pattern]);
+        }
+#endif // HAVE_POSIX_FADVISE
+    }
+
   private:
     const bool has_permanent_fd_; // If false, the file is opened on every read.
     const int fd_;                // -1 if has_permanent_fd_ is false.
@@ -245,7 +310,8 @@ class PosixMmapReadableFile final : public RandomAccessFile {
     //
     // |mmap_limiter| must outlive this instance. The caller must have already
     // acquired the right to use one mmap region, which will be released when
-    // this instance is destroyed.
+    // this instance is destroyed.  |mmap_limiter| is nullptr for regions that
+    // are not counted against the limit.
     PosixMmapReadableFile(std::string filename, char* mmap_base, size_t length,
                           Limiter* mmap_limiter)
         : mmap_base_(mmap_base), length_(length), mmap_limiter_(mmap_limiter),
@@ -253,7 +319,9 @@ class PosixMmapReadableFile final : public RandomAccessFile {
 
     ~PosixMmapReadableFile() override {
         ::munmap(static_cast<void*>(mmap_base_), length_);
-        mmap_limiter_->Release();
+        if (mmap_limiter_ != nullptr) {
+            mmap_limiter_->Release();
+        }
     }
 
     Status Read(uint64_t offset, size_t n, Slice* result,
@@ -267,6 +335,27 @@ class PosixMmapReadableFile final : public RandomAccessFile {
         return Status::OK();
     }
 
+    Status Prefetch(uint64_t offset, size_t n) const override {
+        if (offset >= length_) {
+            return Status::OK();
+        }
+        n = std::min<uint64_t>(n, length_ - offset);
+        // madvise() needs a page-aligned start address.
+        static const size_t kPageSize = ::sysconf(_SC_PAGESIZE);
+        const size_t skew = offset % kPageSize;
+        if (::madvise(mmap_base_ + offset - skew, n + skew, MADV_WILLNEED) !=
+            0) {
+            return PosixError(filename_, errno);
+        }
+        return Status::OK();
+    }
+
+    void Hint(AccessPattern pattern) const override {
+        static const int kAdvice[] = {MADV_NORMAL, MADV_RANDOM,
+                                      MADV_SEQUENTIAL};
+        ::madvise(mmap_base_, length_, kAdvice[pattern]);
+    }
+
   private:
     char* const mmap_base_;
     const size_t length_;
@@ -274,11 +363,145 @@ class PosixMmapReadableFile final : public RandomAccessFile {
     const std::string filename_;
 };
 
+#if HAVE_O_DIRECT
+// Returns memory for "size" bytes aligned for direct I/O, or nullptr.  The
+// memory must be released with std::free().
+char* NewAlignedBuffer(size_t size) {
+    void* buf;
+    if (::posix_memalign(&buf, kDirectIOAlignment, size) != 0) {
+        return nullptr;
+    }
+    return static_cast<char*>(buf);
+}
+
+// Implements random read access in a file opened with O_DIRECT.
+//
+// O_DIRECT needs aligned offsets, sizes and memory, so reads are widened to
+// whole blocks and copied out of an aligned buffer.  Since the page cache no
+// longer reads ahead, Prefetch() reads the range into a buffer held by the
+// file, and reads it covers are served from there.
+//
+// Instances of this class are thread-safe, as required by the
+// RandomAccessFile API.
+class PosixDirectRandomAccessFile final : public RandomAccessFile {
+  public:
+    // The new instance takes ownership of |fd|, for which the caller has
+    // acquired a resource from |fd_limiter|.
+    PosixDirectRandomAccessFile(std::string filename, int fd,
+                                Limiter* fd_limiter)
+        : fd_(fd), fd_limiter_(fd_limiter), filename_(std::move(filename)),
+          readahead_(nullptr), readahead_offset_(0), readahead_size_(0) {}
+
+    ~PosixDirectRandomAccessFile() override {
+        std::free(readahead_);
+        ::close(fd_);
+        fd_limiter_->Release();
+    }
+
+    Status Read(uint64_t offset, size_t n, Slice* result,
+                char* scratch) const override {
+        {
+            MutexLock lock(&mutex_);
+            if (readahead_ != nullptr && offset >= readahead_offset_ &&
+                offset + n <= readahead_offset_ + readahead_size_) {
+                std::memcpy(scratch, readahead_ + (offset - readahead_offset_),
+                            n);
+                *result = Slice(scratch, n);
+                return Status::OK();
+            }
+            if (readahead_ != nullptr &&
+                offset >= readahead_offset_ + readahead_size_) {
+                // The reads have moved past the prefetched data.
+                std::free(readahead_);
+                readahead_ = nullptr;
+            }
+        }
+
+        char* buf;
+        uint64_t buf_offset;
+        size_t size;
+        Status status = ReadAligned(offset, n, &buf, &buf_offset, &size);
+        if (!status.ok()) {
+            *result = Slice();
+            return status;
+        }
+        const size_t skip = offset - buf_offset;
+        n = (size > skip) ? std::min(n, size - skip) : 0;
+        std::memcpy(scratch, buf + skip, n);
+        std::free(buf);
+        *result = Slice(scratch, n);
+        return Status::OK();
+    }
+
+    Status Prefetch(uint64_t offset, size_t n) const override {
+        char* buf;
+        uint64_t buf_offset;
+        size_t size;
+        Status status = ReadAligned(offset, n, &buf, &buf_offset, &size);
+        if (status.ok()) {
+            MutexLock lock(&mutex_);
+            std::free(readahead_);
+            readahead_ = buf;
+            readahead_offset_ = buf_offset;
+            readahead_size_ = size;
+        }
+        return status;
+    }
+
+  private:
+    // Read the aligned blocks that cover [offset, offset + n) into a new
+    // aligned *buf.  On success *buf holds *size bytes of the file starting
+    // at *buf_offset; fewer than asked for at the end of the file.
+    Status ReadAligned(uint64_t offset, size_t n, char** buf,
+                       uint64_t* buf_offset, size_t* size) const {
+        const uint64_t start = offset - offset % kDirectIOAlignment;
+        const uint64_t end = offset + n + kDirectIOAlignment - 1;
+        const size_t length = end - end % kDirectIOAlignment - start;
+        *buf = NewAlignedBuffer(std::max(length, kDirectIOAlignment));
+        if (*buf == nullptr) {
+            return PosixError(filename_, ENOMEM);
+        }
+        size_t done = 0;
+        while (done < length) {
+            ssize_t read_size = ::pread(fd_, *buf + done, length - done,
+                                        static_cast<off_t>(start + done));
+            if (read_size < 0) {
+                if (errno == EINTR) {
+                    continue; // Retry
+                }
+                int error = errno;
+                std::free(*buf);
+                *buf = nullptr;
+                return PosixError(filename_, error);
+            }
+            done += read_size;
+            if (read_size == 0 || read_size % kDirectIOAlignment != 0) {
+                break; // End of file.
+            }
+        }
+        *buf_offset = start;
+        *size = done;
+        return Status::OK();
+    }
+
+    const int fd_;
+    Limiter* const fd_limiter_;
+    const std::string filename_;
+
+    mutable port::Mutex mutex_;
+    // Data read by Prefetch(), if any.
+    mutable char* readahead_ GUARDED_BY(mutex_);
+    mutable uint64_t readahead_offset_ GUARDED_BY(mutex_);
+    mutable size_t readahead_size_ GUARDED_BY(mutex_);
+};
+#endif // HAVE_O_DIRECT
+
 class PosixWritableFile final : public WritableFile {
   public:
     PosixWritableFile(std::string filename, int fd)
-        : pos_(0), fd_(fd), is_manifest_(IsManifest(filename)),
-          filename_(std::move(filename)), dirname_(Dirname(filename_)) {}
+        : pos_(0), fd_(fd), preallocated_(false),
+          is_manifest_(IsManifest(filename)), filename_(std::move(filename)),
+          dirname_(Dirname(filename_)) {}
 
     ~PosixWritableFile() override {
         if (fd_ >= 0) {
@@ -318,6 +541,9 @@ class PosixWritableFile final : public WritableFile {
 
     Status Close() override {
         Status status = FlushBuffer();
+        if (preallocated_) {
+            ReleasePreallocation();
+        }
         const int close_result = ::close(fd_);
         if (close_result < 0 && status.ok()) {
             status = PosixError(filename_, errno);
@@ -347,7 +573,40 @@ class PosixWritableFile final : public WritableFile {
         return SyncFd(fd_, filename_);
     }
 
+    Status Allocate(uint64_t offset, uint64_t len) override {
+#if HAVE_FALLOCATE
+        if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, offset, len) != 0) {
+            return PosixError(filename_, errno);
+        }
+        preallocated_ = true;
+        return Status::OK();
+#else
+        return WritableFile::Allocate(offset, len);
+#endif // HAVE_FALLOCATE
+    }
+
+    Status RangeSync(uint64_t offset, uint64_t len) override {
+#if HAVE_SYNC_FILE_RANGE
+        if (::sync_file_range(fd_, offset, len, SYNC_FILE_RANGE_WRITE) != 0) {
+            return PosixError(filename_, errno);
+        }
+        return Status::OK();
+#else
+        return WritableFile::RangeSync(offset, len);
+#endif // HAVE_SYNC_FILE_RANGE
+    }
+
   private:
+    // Gives back the space that Allocate() reserved past the end of the
+    // file.  Best effort: the file's contents are not affected either way.
+    void ReleasePreallocation() {
+        struct ::stat file_stat;
+        if (::fstat(fd_, &file_stat) == 0) {
+            ::ftruncate(fd_, file_stat.st_size);
+        }
+        preallocated_ = false;
+    }
+
     Status FlushBuffer() {
         Status status = WriteUnbuffered(buf_, pos_);
         pos_ = 0;
@@ -385,35 +644,6 @@ class PosixWritableFile final : public WritableFile {
         return status;
     }
 
-    // Ensures that all the caches associated with the given file descriptor's
-    // data are flushed all the way to durable media, and can withstand power
-    // failures.
-    //
-    // The path argument is only used to populate the description string in the
-    // returned Status if an error occurs.
-    static Status SyncFd(int fd, const std::string& fd_path) {
-#if HAVE_FULLFSYNC
-        // On macOS and iOS, fsync() doesn't guarantee durability past power
-        // failures. fcntl(F_FULLFSYNC) is required for that purpose. Some
-        // filesystems don't support fcntl(F_FULLFSYNC), and require a fallback
-        // to fsync().
-        if (::fcntl(fd, F_FULLFSYNC) == 0) {
-            return Status::OK();
-        }
-#endif // HAVE_FULLFSYNC
-
-#if HAVE_FDATASYNC
-        bool sync_success = ::fdatasync(fd) == 0;
-#else
-        bool sync_success = ::fsync(fd) == 0;
-#endif // HAVE_FDATASYNC
-
-        if (sync_success) {
-            return Status::OK();
-        }
-        return PosixError(fd_path, errno);
-    }
-
     // Returns the directory name in a path pointing to a file.
     //
     // Returns "." if the path does not contain any directory separator.
@@ -455,12 +685,132 @@ class PosixWritableFile final : public WritableFile {
     char buf_[kWritableFileBufferSize];
     size_t pos_;
     int fd_;
+    bool preallocated_; // Allocate() has reserved space for the file
 
     const bool is_manifest_; // True if the file's name starts with MANIFEST.
     const std::string filename_;
     const std::string dirname_; // The directory of filename_.
 };
 
+#if HAVE_O_DIRECT
+// Implements sequential writing to a file opened with O_DIRECT.
+//
+// Data is written in whole aligned blocks.  Sync() and Close() write the
+// last, partial block padded with zeros and then cut the file back to the
+// size of the data; the partial block is written again once more data
+// follows it.
+class PosixDirectWritableFile final : public WritableFile {
+  public:
+    // Takes ownership of |fd| and of |buf|, which must have room for
+    // kDirectWritableFileBufferSize bytes aligned for direct I/O.
+    PosixDirectWritableFile(std::string filename, int fd, char* buf)
+        : buf_(buf), pos_(0), file_offset_(0), fd_(fd),
+          filename_(std::move(filename)) {}
+
+    ~PosixDirectWritableFile() override {
+        if (fd_ >= 0) {
+            // Ignoring any potential errors
+            Close();
+        }
+        std::free(buf_);
+    }
+
+    Status Append(const Slice& data) override {
+        const char* write_data = data.data();
+        size_t write_size = data.size();
+        while (write_size > 0) {
+            size_t copy_size =
+                std::min(write_size, kDirectWritableFileBufferSize - pos_);
+            std::memcpy(buf_ + pos_, write_data, copy_size);
+            write_data += copy_size;
+            write_size -= copy_size;
+            pos_ += copy_size;
+            if (pos_ == kDirectWritableFileBufferSize) {
+                Status status = WriteBuffer();
+                if (!status.ok()) {
+                    return status;
+                }
+            }
+        }
+        return Status::OK();
+    }
+
+    Status Close() override {
+        Status status = WriteBuffer();
+        if (status.ok()) {
+            status = Truncate();
+        }
+        const int close_result = ::close(fd_);
+        if (close_result < 0 && status.ok()) {
+            status = PosixError(filename_, errno);
+        }
+        fd_ = -1;
+        return status;
+    }
+
+    // Only whole blocks can be written, so the data stays buffered.
+    Status Flush() override { return Status::OK(); }
+
+    Status Sync() override {
+        Status status = WriteBuffer();
+        if (status.ok()) {
+            status = Truncate();
+        }
+        if (!status.ok()) {
+            return status;
+        }
+        return SyncFd(fd_, filename_);
+    }
+
+  private:
+    // Write buf_[0, pos_ - 1] at file_offset_, padding the last block, and
+    // keep only the partial last block in buf_.
+    Status WriteBuffer() {
+        const size_t tail = pos_ % kDirectIOAlignment;
+        size_t size = pos_;
+        if (tail != 0) {
+            size += kDirectIOAlignment - tail;
+            std::memset(buf_ + pos_, 0, size - pos_);
+        }
+        size_t done = 0;
+        while (done < size) {
+            ssize_t write_result =
+                ::pwrite(fd_, buf_ + done, size - done,
+                         static_cast<off_t>(file_offset_ + done));
+            if (write_result < 0) {
+                if (errno == EINTR) {
+                    continue; // Retry
+                }
+                return PosixError(filename_, errno);
+            }
+            done += write_result;
+        }
+        const size_t full = pos_ - tail;
+        std::memmove(buf_, buf_ + full, tail);
+        file_offset_ += full;
+        pos_ = tail;
+        return Status::OK();
+    }
+
+    // Cut off the padding of the last block.
+    Status Truncate() {
+        if (::ftruncate(fd_, static_cast<off_t>(file_offset_ + pos_)) != 0) {
+            return PosixError(filename_, errno);
+        }
+        return Status::OK();
+    }
+
+    // buf_[0, pos_ - 1] contains data to be written at file_offset_, which
+    // is aligned.
+    char* const buf_;
+    size_t pos_;
+    uint64_t file_offset_;
+    int fd_;
+
+    const std::string filename_;
+};
+#endif // HAVE_O_DIRECT
+
 int LockOrUnlock(int fd, bool lock) {
     errno = 0;
     struct ::flock file_lock_info;
@@ -547,19 +897,7 @@ class PosixEnv : public Env {
             return Status::OK();
         }
 
-        uint64_t file_size;
-        Status status = GetFileSize(filename, &file_size);
-        if (status.ok()) {
-            void* mmap_base = ::mmap(/*addr=*/nullptr, file_size, PROT_READ,
-                                     MAP_SHARED, fd, 0);
-            if (mmap_base != MAP_FAILED) {
-                *result = new PosixMmapReadableFile(
-                    filename, reinterpret_cast<char*>(mmap_base), file_size,
-                    &mmap_limiter_);
-            } else {
-                status = PosixError(filename, errno);
-            }
-        }
+        Status status = MapFile(filename, fd, &mmap_limiter_, result);
         ::close(fd);
         if (!status.ok()) {
             mmap_limiter_.Release();
@@ -567,6 +905,23 @@ class PosixEnv : public Env {
         return status;
     }
 
+    Status NewMmapRandomAccessFile(const std::string& filename,
+                                   RandomAccessFile** result) override {
+        *result = nullptr;
+        int fd = ::open(filename.c_str(), O_RDONLY | kOpenBaseFlags);
+        if (fd < 0) {
+            return PosixError(filename, errno);
+        }
+
+        if (MapFile(filename, fd, nullptr, result).ok()) {
+            ::close(fd);
+            return Status::OK();
+        }
+        // Empty files and some file systems cannot be mapped.
+        *result = new PosixRandomAccessFile(filename, fd, &fd_limiter_);
+        return Status::OK();
+    }
+
     Status NewWritableFile(const std::string& filename,
                            WritableFile** result) override {
         int fd = ::open(filename.c_str(),
@@ -593,6 +948,54 @@ class PosixEnv : public Env {
         return Status::OK();
     }
 
+    Status NewDirectRandomAccessFile(const std::string& filename,
+                                     RandomAccessFile** result) override {
+#if HAVE_O_DIRECT
+        if (fd_limiter_.Acquire()) {
+            int fd =
+                ::open(filename.c_str(), O_RDONLY | O_DIRECT | kOpenBaseFlags);
+            if (fd >= 0) {
+                *result =
+                    new PosixDirectRandomAccessFile(filename, fd, &fd_limiter_);
+                return Status::OK();
+            }
+            const int error = errno;
+            fd_limiter_.Release();
+            if (error != EINVAL) {
+                *result = nullptr;
+                return PosixError(filename, error);
+            }
+            // The file system does not support O_DIRECT.
+        }
+#endif // HAVE_O_DIRECT
+        return NewRandomAccessFile(filename, result);
+    }
+
+    Status NewDirectWritableFile(const std::string& filename,
+                                 WritableFile** result) override {
+#if HAVE_O_DIRECT
+        int fd = ::open(
+            filename.c_str(),
+            O_TRUNC | O_WRONLY | O_CREAT | O_DIRECT | kOpenBaseFlags, 0644);
+        if (fd < 0 && errno != EINVAL) {
+            *result = nullptr;
+            return PosixError(filename, errno);
+        }
+        if (fd >= 0) {
+            char* buf = NewAlignedBuffer(kDirectWritableFileBufferSize);
+            if (buf == nullptr) {
+                ::close(fd);
+                *result = nullptr;
+                return PosixError(filename, ENOMEM);
+            }
+            *result = new PosixDirectWritableFile(filename, fd, buf);
+            return Status::OK();
+        }
+        // The file system does not support O_DIRECT.
+#endif // HAVE_O_DIRECT
+        return NewWritableFile(filename, result);
+    }
+
     bool FileExists(const std::string& filename) override {
         return ::access(filename.c_str(), F_OK) == 0;
     }
@@ -650,6 +1053,13 @@ class PosixEnv : public Env {
         return Status::OK();
     }
 
+    Status LinkFile(const std::string& from, const std::string& to) override {
+        if (::link(from.c_str(), to.c_str()) != 0) {
+            return PosixError(from, errno);
+        }
+        return Status::OK();
+    }
+
     Status LockFile(const std::string& filename, FileLock** lock) override {
         *lock = nullptr;
 
@@ -746,6 +1156,28 @@ class PosixEnv : public Env {
     }
 
   private:
+    // Map the file "filename", open as "fd", into memory and store a file
+    // reading from the mapping in *result.  "fd" stays open.
+    // "mmap_limiter", if non-null, is the limiter the region was acquired
+    // from.
+    Status MapFile(const std::string& filename, int fd, Limiter* mmap_limiter,
+                   RandomAccessFile** result) {
+        uint64_t file_size;
+        Status status = GetFileSize(filename, &file_size);
+        if (status.ok()) {
+            void* mmap_base = ::mmap(/*addr=*/nullptr, file_size, PROT_READ,
+                                     MAP_SHARED, fd, 0);
+            if (mmap_base != MAP_FAILED) {
+                *result = new PosixMmapReadableFile(
+                    filename, reinterpret_cast<char*>(mmap_base), file_size,
+                    mmap_limiter);
+            } else {
+                status = PosixError(filename, errno);
+            }
+        }
+        return status;
+    }
+
     void BackgroundThreadMain();
 
     static void BackgroundThreadEntryPoint(PosixEnv* env) {
@@ -214,6 +214,211 @@ TEST_F(EnvPosixTest, TestOpenOnRead) {
     ASSERT_MYDB_OK(env_->RemoveFile(test_file));
 }
 
+TEST_F(EnvPosixTest, TestPrefetch) {
+    std::string test_dir;
+    ASSERT_MYDB_OK(env_->GetTestDirectory(&test_dir));
+    std::string test_file = test_dir + "/prefetch.txt";
+    const std::string data(100000, 'x');
+    ASSERT_MYDB_OK(WriteStringToFile(env_, data, test_file));
+
+    // Cover mmap-ed files, files with a permanent descriptor and files
+    // opened on every read.
+    const int kNumFiles = kReadOnlyFileLimit + kMMapLimit + 5;
+    mydb::RandomAccessFile* files[kNumFiles] = {0};
+    for (int i = 0; i < kNumFiles; i++) {
+        ASSERT_MYDB_OK(env_->NewRandomAccessFile(test_file, &files[i]));
+    }
+    char scratch[100];
+    Slice read_result;
+    for (int i = 0; i < kNumFiles; i++) {
+        for (uint64_t offset : {0, 4097, 99990, 200000}) {
+            Status s = files[i]->Prefetch(offset, 8192);
+            ASSERT_TRUE(s.ok() || s.IsNotSupportedError()) << s.ToString();
+        }
+        ASSERT_MYDB_OK(files[i]->Read(5000, 100, &read_result, scratch));
+        ASSERT_EQ(Slice(data.data(), 100), read_result);
+    }
+    for (int i = 0; i < kNumFiles; i++) {
+        delete files[i];
+    }
+    ASSERT_MYDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestMmapRandomAccessFile) {
+    std::string test_dir;
+    ASSERT_MYDB_OK(env_->GetTestDirectory(&test_dir));
+    std::string test_file = test_dir + "/mmap_reads.txt";
+    std::string empty_file = test_dir + "/mmap_reads_empty.txt";
+    const std::string data(100000, 'x');
+    ASSERT_MYDB_OK(WriteStringToFile(env_, data, test_file));
+    ASSERT_MYDB_OK(WriteStringToFile(env_, "", empty_file));
+
+    // Files mapped past the Env's own limit, and with all access patterns,
+    // still read in place.
+    const int kNumFiles = kReadOnlyFileLimit + kMMapLimit + 5;
+    mydb::RandomAccessFile* files[kNumFiles] = {0};
+    for (int i = 0; i < kNumFiles; i++) {
+        ASSERT_MYDB_OK(env_->NewMmapRandomAccessFile(test_file, &files[i]));
+        files[i]->Hint(static_cast<RandomAccessFile::AccessPattern>(i % 3));
+    }
+    char scratch[100];
+    Slice read_result;
+    for (int i = 0; i < kNumFiles; i++) {
+        ASSERT_MYDB_OK(files[i]->Read(5000, 100, &read_result, scratch));
+        ASSERT_EQ(Slice(data.data(), 100), read_result);
+        ASSERT_TRUE(read_result.data() != scratch);
+    }
+    for (int i = 0; i < kNumFiles; i++) {
+        delete files[i];
+    }
+
+    // Empty files cannot be mapped and are read as usual.
+    mydb::RandomAccessFile* file;
+    ASSERT_MYDB_OK(env_->NewMmapRandomAccessFile(empty_file, &file));
+    file->Hint(RandomAccessFile::kRandom);
+    ASSERT_MYDB_OK(file->Read(0, 100, &read_result, scratch));
+    ASSERT_TRUE(read_result.empty());
+    delete file;
+    ASSERT_MYDB_OK(env_->RemoveFile(test_file));
+    ASSERT_MYDB_OK(env_->RemoveFile(empty_file));
+}
+
+TEST_F(EnvPosixTest, TestMultiRead) {
+    std::string test_dir;
+    ASSERT_MYDB_OK(env_->GetTestDirectory(&test_dir));
+    std::string test_file = test_dir + "/multi_read.txt";
+    std::string data;
+    for (int i = 0; i < 100000; i++) {
+        data.push_back(static_cast<char>('a' + i % 26));
+    }
+    ASSERT_MYDB_OK(WriteStringToFile(env_, data, test_file));
+
+    // Cover mmap-ed files, files with a permanent descriptor and files
+    // opened on every read.
+    const int kNumFiles = kReadOnlyFileLimit + kMMapLimit + 5;
+    mydb::RandomAccessFile* files[kNumFiles] = {0};
+    for (int i = 0; i < kNumFiles; i++) {
+        ASSERT_MYDB_OK(env_->NewRandomAccessFile(test_file, &files[i]));
+    }
+    for (size_t batch : {1, 3, 100}) {
+        std::vector<std::string> scratch(batch, std::string(500, '\0'));
+        std::vector<ReadRequest> reqs(batch);
+        for (int i = 0; i < kNumFiles; i++) {
+            for (size_t j = 0; j < batch; j++) {
+                reqs[j].offset = (j * 7919) % (data.size() - 500);
+                reqs[j].n = 1 + j % 500;
+                reqs[j].scratch = &scratch[j][0];
+            }
+            ASSERT_MYDB_OK(files[i]->MultiRead(reqs.data(), batch));
+            for (size_t j = 0; j < batch; j++) {
+                ASSERT_MYDB_OK(reqs[j].status);
+                ASSERT_EQ(Slice(data.data() + reqs[j].offset, reqs[j].n),
+                          reqs[j].result);
+            }
+        }
+    }
+    for (int i = 0; i < kNumFiles; i++) {
+        delete files[i];
+    }
+    ASSERT_MYDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestDirectIO) {
+    std::string test_dir;
+    ASSERT_MYDB_OK(env_->GetTestDirectory(&test_dir));
+    std::string test_file = test_dir + "/direct_io.txt";
+
+    // Appends of all sizes, with syncs that write partial blocks which
+    // later appends extend.
+    std::string data;
+    WritableFile* writable_file;
+    ASSERT_MYDB_OK(env_->NewDirectWritableFile(test_file, &writable_file));
+    for (int i = 0; i < 200; i++) {
+        std::string piece(i * 97 % 30000, static_cast<char>('a' + i % 26));
+        ASSERT_MYDB_OK(writable_file->Append(piece));
+        data += piece;
+        if (i % 7 == 0) {
+            ASSERT_MYDB_OK(writable_file->Sync());
+        } else {
+            ASSERT_MYDB_OK(writable_file->Flush());
+        }
+    }
+    ASSERT_MYDB_OK(writable_file->Close());
+    delete writable_file;
+
+    uint64_t file_size;
+    ASSERT_MYDB_OK(env_->GetFileSize(test_file, &file_size));
+    ASSERT_EQ(data.size(), file_size);
+    std::string contents;
+    ASSERT_MYDB_OK(ReadFileToString(env_, test_file, &contents));
+    ASSERT_TRUE(contents == data);
+
+    RandomAccessFile* file;
+    ASSERT_MYDB_OK(env_->NewDirectRandomAccessFile(test_file, &file));
+    std::string scratch(10000, '\0');
+    Slice result;
+    for (uint64_t offset : {0, 1, 4095, 4096, 123457}) {
+        ASSERT_MYDB_OK(file->Read(offset, 10000, &result, &scratch[0]));
+        ASSERT_EQ(Slice(data.data() + offset, 10000), result);
+    }
+    // Reads served from prefetched data, and reads past it.
+    Status s = file->Prefetch(50001, 100000);
+    ASSERT_TRUE(s.ok() || s.IsNotSupportedError()) << s.ToString();
+    for (uint64_t offset = 50001; offset < 200000; offset += 9999) {
+        ASSERT_MYDB_OK(file->Read(offset, 10000, &result, &scratch[0]));
+        ASSERT_EQ(Slice(data.data() + offset, 10000), result);
+    }
+    // A read at the end of the file is short.
+    ASSERT_MYDB_OK(file->Read(data.size() - 10, 10000, &result, &scratch[0]));
+    ASSERT_EQ(Slice(data.data() + data.size() - 10, 10), result);
+    delete file;
+    ASSERT_MYDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestAllocateAndRangeSync) {
+    std::string test_dir;
+    ASSERT_MYDB_OK(env_->GetTestDirectory(&test_dir));
+    std::string test_file = test_dir + "/allocate.txt";
+
+    WritableFile* writable_file;
+    ASSERT_MYDB_OK(env_->NewWritableFile(test_file, &writable_file));
+    Status s = writable_file->Allocate(0, 1 << 20);
+    ASSERT_TRUE(s.ok() || s.IsNotSupportedError()) << s.ToString();
+    std::string data(100000, 'x');
+    ASSERT_MYDB_OK(writable_file->Append(data));
+    ASSERT_MYDB_OK(writable_file->Flush());
+    s = writable_file->RangeSync(0, data.size());
+    ASSERT_TRUE(s.ok() || s.IsNotSupportedError()) << s.ToString();
+    ASSERT_MYDB_OK(writable_file->Append(data));
+    ASSERT_MYDB_OK(writable_file->Close());
+    delete writable_file;
+
+    // The reserved space does not count towards the size of the file.
+    uint64_t file_size;
+    ASSERT_MYDB_OK(env_->GetFileSize(test_file, &file_size));
+    ASSERT_EQ(2 * data.size(), file_size);
+    ASSERT_MYDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestLinkFile) {
+    std::string test_dir;
+    ASSERT_MYDB_OK(env_->GetTestDirectory(&test_dir));
+    std::string test_file = test_dir + "/link_src.txt";
+    std::string link_file = test_dir + "/link_dst.txt";
+    env_->RemoveFile(link_file);
+    ASSERT_MYDB_OK(WriteStringToFile(env_, "linked", test_file));
+
+    ASSERT_MYDB_OK(env_->LinkFile(test_file, link_file));
+    ASSERT_TRUE(env_->LinkFile(test_file, link_file).IsIOError());
+
+    // The link outlives the name it was made from.
+    ASSERT_MYDB_OK(env_->RemoveFile(test_file));
+    std::string data;
+    ASSERT_MYDB_OK(ReadFileToString(env_, link_file, &data));
+    ASSERT_EQ("linked", data);
+    ASSERT_MYDB_OK(env_->RemoveFile(link_file));
+}
+
 #if HAVE_O_CLOEXEC
 
 TEST_F(EnvPosixTest, TestCloseOnExecSequentialFile) {
@@ -594,6 +594,14 @@ class WindowsEnv : public Env {
         }
     }
 
+    Status LinkFile(const std::string& from, const std::string& to) override {
+        if (!::CreateHardLinkA(to.c_str(), from.c_str(),
+                               /*lpSecurityAttributes=*/nullptr)) {
+            return WindowsError(from, ::GetLastError());
+        }
+        return Status::OK();
+    }
+
     Status LockFile(const std::string& filename, FileLock** lock) override {
         *lock = nullptr;
         Status result;
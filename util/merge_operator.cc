@@ -0,0 +1,15 @@
+
+
+#include "mydb/merge_operator.h"
+
+namespace mydb {
+
+MergeOperator::~MergeOperator() {}
+
+bool MergeOperator::PartialMerge(const Slice& key, const Slice& left_operand,
+                                 const Slice& right_operand,
+                                 std::string* new_value) const {
+    return false;
+}
+
+} // namespace mydb
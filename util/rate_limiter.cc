@@ -0,0 +1,149 @@
+
+
+#include "mydb/rate_limiter.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "mydb/env.h"
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace mydb {
+
+RateLimiter::~RateLimiter() = default;
+
+namespace {
+
+// Number of refills between two adjustments of an auto-tuned rate.
+static const int kTuningRefills = 100;
+
+class GenericRateLimiter : public RateLimiter {
+  public:
+    GenericRateLimiter(int64_t bytes_per_second, int64_t refill_period_us,
+                       bool auto_tuned)
+        : env_(Env::Default()), refill_period_us_(refill_period_us),
+          auto_tuned_(auto_tuned), max_bytes_per_second_(bytes_per_second),
+          bytes_per_second_(bytes_per_second), available_bytes_(0),
+          next_refill_us_(0), drained_(false), high_waiters_(0),
+          refills_(0), drained_refills_(0) {
+        assert(bytes_per_second > 0);
+        assert(refill_period_us > 0);
+        total_bytes_[0] = total_bytes_[1] = 0;
+    }
+
+    void SetBytesPerSecond(int64_t bytes_per_second) override {
+        assert(bytes_per_second > 0);
+        MutexLock l(&mu_);
+        max_bytes_per_second_ = bytes_per_second;
+        bytes_per_second_ = bytes_per_second;
+    }
+
+    int64_t GetBytesPerSecond() const override {
+        MutexLock l(&mu_);
+        return bytes_per_second_;
+    }
+
+    void Request(int64_t bytes, Priority priority) override {
+        const bool high = (priority == Priority::kHigh);
+        bool waited = false;
+        while (bytes > 0) {
+            uint64_t wait_us;
+            {
+                MutexLock l(&mu_);
+                if (waited && high) {
+                    high_waiters_--;
+                }
+                const uint64_t now = env_->NowMicros();
+                if (now >= next_refill_us_) {
+                    Refill(now);
+                }
+                // Low priority requests leave the budget to waiting high
+                // priority ones.
+                if (available_bytes_ > 0 && (high || high_waiters_ == 0)) {
+                    const int64_t granted = std::min(bytes, available_bytes_);
+                    available_bytes_ -= granted;
+                    total_bytes_[high ? 0 : 1] += granted;
+                    bytes -= granted;
+                    waited = false;
+                    continue;
+                }
+                drained_ = true;
+                if (high) {
+                    high_waiters_++;
+                }
+                wait_us = next_refill_us_ - now;
+            }
+            env_->SleepForMicroseconds(static_cast<int>(wait_us));
+            waited = true;
+        }
+    }
+
+    int64_t GetTotalBytesThrough(Priority priority) const override {
+        MutexLock l(&mu_);
+        return total_bytes_[priority == Priority::kHigh ? 0 : 1];
+    }
+
+  private:
+    // Start a new refill period at "now" with a fresh budget.  Unused
+    // bytes of the previous period are not carried over.
+    void Refill(uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (auto_tuned_) {
+            Tune();
+        }
+        available_bytes_ = std::max<int64_t>(
+            1, bytes_per_second_ * refill_period_us_ / 1000000);
+        next_refill_us_ = now + refill_period_us_;
+    }
+
+    // Count the period that just ended, and adjust the rate once enough
+    // periods have passed: up by 5% if requests had to wait in nine out
+    // of ten periods, down by 5% if they had to wait in fewer than half.
+    void Tune() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        refills_++;
+        if (drained_) {
+            drained_refills_++;
+            drained_ = false;
+        }
+        if (refills_ < kTuningRefills) {
+            return;
+        }
+        const int drained_percent = drained_refills_ * 100 / refills_;
+        if (drained_percent >= 90) {
+            bytes_per_second_ = std::min(max_bytes_per_second_,
+                                         bytes_per_second_ * 21 / 20);
+        } else if (drained_percent < 50) {
+            bytes_per_second_ = std::max(max_bytes_per_second_ / 20,
+                                         bytes_per_second_ * 20 / 21);
+        }
+        refills_ = 0;
+        drained_refills_ = 0;
+    }
+
+    Env* const env_;
+    const int64_t refill_period_us_;
+    const bool auto_tuned_;
+
+    mutable port::Mutex mu_;
+    int64_t max_bytes_per_second_ GUARDED_BY(mu_);
+    int64_t bytes_per_second_ GUARDED_BY(mu_);
+    int64_t available_bytes_ GUARDED_BY(mu_); // Left in this period
+    uint64_t next_refill_us_ GUARDED_BY(mu_);
+    bool drained_ GUARDED_BY(mu_); // A request waited in this period
+    int high_waiters_ GUARDED_BY(mu_);
+    int refills_ GUARDED_BY(mu_);         // Since the last tuning
+    int drained_refills_ GUARDED_BY(mu_); // Of those, periods drained_
+    int64_t total_bytes_[2] GUARDED_BY(mu_); // kHigh, kLow
+};
+
+} // namespace
+
+RateLimiter* NewGenericRateLimiter(int64_t bytes_per_second,
+                                   int64_t refill_period_us, bool auto_tuned) {
+    return new GenericRateLimiter(bytes_per_second, refill_period_us,
+                                  auto_tuned);
+}
+
+} // namespace mydb
@@ -0,0 +1,85 @@
+
+
+#include "mydb/rate_limiter.h"
+
+#include <thread>
+
+#include "mydb/env.h"
+
+#include "gtest/gtest.h"
+
+namespace mydb {
+
+TEST(RateLimiterTest, LimitsRate) {
+    RateLimiter* limiter = NewGenericRateLimiter(1 << 20, 10 * 1000);
+    Env* env = Env::Default();
+    const uint64_t start = env->NowMicros();
+    // 100KB at 1MB/s, the first 10KB of which come from the first period.
+    for (int i = 0; i < 10; i++) {
+        limiter->Request(10 << 10, RateLimiter::Priority::kLow);
+    }
+    ASSERT_GE(env->NowMicros() - start, 80 * 1000);
+    ASSERT_EQ(100 << 10,
+              limiter->GetTotalBytesThrough(RateLimiter::Priority::kLow));
+    ASSERT_EQ(0, limiter->GetTotalBytesThrough(RateLimiter::Priority::kHigh));
+    delete limiter;
+}
+
+TEST(RateLimiterTest, SetBytesPerSecond) {
+    RateLimiter* limiter = NewGenericRateLimiter(1 << 20);
+    ASSERT_EQ(1 << 20, limiter->GetBytesPerSecond());
+    limiter->SetBytesPerSecond(1 << 30);
+    ASSERT_EQ(1 << 30, limiter->GetBytesPerSecond());
+    // The new rate applies from the next refill period on.
+    limiter->Request(1 << 20, RateLimiter::Priority::kHigh);
+    limiter->Request(1 << 20, RateLimiter::Priority::kHigh);
+    ASSERT_EQ(2 << 20,
+              limiter->GetTotalBytesThrough(RateLimiter::Priority::kHigh));
+    delete limiter;
+}
+
+TEST(RateLimiterTest, ConcurrentPriorities) {
+    RateLimiter* limiter = NewGenericRateLimiter(4 << 20, 1000);
+    std::thread low([limiter]() {
+        for (int i = 0; i < 100; i++) {
+            limiter->Request(1 << 10, RateLimiter::Priority::kLow);
+        }
+    });
+    std::thread high([limiter]() {
+        for (int i = 0; i < 100; i++) {
+            limiter->Request(1 << 10, RateLimiter::Priority::kHigh);
+        }
+    });
+    low.join();
+    high.join();
+    ASSERT_EQ(100 << 10,
+              limiter->GetTotalBytesThrough(RateLimiter::Priority::kLow));
+    ASSERT_EQ(100 << 10,
+              limiter->GetTotalBytesThrough(RateLimiter::Priority::kHigh));
+    delete limiter;
+}
+
+TEST(RateLimiterTest, AutoTune) {
+    const int64_t max_rate = 1 << 20;
+    RateLimiter* limiter = NewGenericRateLimiter(max_rate, 1000, true);
+    Env* env = Env::Default();
+
+    // Requests that never have to wait lower the rate.
+    for (int i = 0; i < 300; i++) {
+        limiter->Request(1, RateLimiter::Priority::kLow);
+        env->SleepForMicroseconds(1100);
+    }
+    const int64_t lowered = limiter->GetBytesPerSecond();
+    ASSERT_LT(lowered, max_rate);
+    ASSERT_GE(lowered, max_rate / 20);
+
+    // Requests that keep draining the budget raise it again.
+    for (int i = 0; i < 300; i++) {
+        limiter->Request(1 << 10, RateLimiter::Priority::kLow);
+    }
+    ASSERT_GT(limiter->GetBytesPerSecond(), lowered);
+    ASSERT_LE(limiter->GetBytesPerSecond(), max_rate);
+    delete limiter;
+}
+
+} // namespace mydb